@@ -0,0 +1,382 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <stdio.h>
+
+#if __linux__
+#include <sys/stat.h>
+#endif
+
+/**
+ * Benchmarks of the hot paths of the library on synthetic data, no hardware
+ * needed. Results are written to stdout as JSON, one object per benchmark,
+ * so they can be compared between library versions. An argument runs only
+ * the benchmarks whose name contains it.
+ */
+
+#define BENCH_REPORT_COUNT          256     /**< Distinct synthetic reports cycled through. */
+#define BENCH_MIN_TIME              200000000ull  /**< Nanoseconds each benchmark runs at least. */
+
+// ----------------------------------------------------------------------------------------------
+// Allocation counting
+
+static SteamControllerAtomicU64 AllocationCount;
+
+#if __GLIBC__
+// glibc exports its allocator under these names too, so the library's calls
+// can be counted by replacing the public ones.
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pMemory, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size) {
+  SteamController_AtomicAdd64(&AllocationCount, 1);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  SteamController_AtomicAdd64(&AllocationCount, 1);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *pMemory, size_t size) {
+  SteamController_AtomicAdd64(&AllocationCount, 1);
+  return __libc_realloc(pMemory, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  SteamController_AtomicAdd64(&AllocationCount, 1);
+  return __libc_memalign(alignment, size);
+}
+
+#define BENCH_COUNTS_ALLOCATIONS    1
+#else
+#define BENCH_COUNTS_ALLOCATIONS    0
+#endif
+
+// ----------------------------------------------------------------------------------------------
+// Harness
+
+typedef struct {
+  SteamControllerLoopback  *pLoopback;
+  SteamControllerDevice    *pDevice;
+  SteamControllerEvent      events[BENCH_REPORT_COUNT];
+  uint8_t                   reports[BENCH_REPORT_COUNT][STEAMCONTROLLER_RAW_REPORT_SIZE];
+  SteamControllerState      state;
+  SteamControllerState      states[BENCH_REPORT_COUNT];   /**< State after each of the events. */
+  SteamControllerRemap     *pRemap;
+  const char               *pSysfsRoot;
+} BenchContext;
+
+/** Run a benchmark once for a number of operations. */
+typedef void (*BenchFunction)(BenchContext *pContext, size_t count);
+
+static const char  *BenchFilter;
+static bool         IsFirstResult = true;
+static volatile uint8_t BenchSink;   /**< Results nobody needs are stored here, so they are computed. */
+
+/**
+ * Run a benchmark with growing operation counts until it takes long enough,
+ * then print its result.
+ */
+static void Bench(BenchContext *pContext, const char *pName, BenchFunction function) {
+  if (BenchFilter && !strstr(pName, BenchFilter))
+    return;
+
+  function(pContext, 1);
+
+  size_t    count = 1;
+  uint64_t  elapsed, allocations;
+  for (;;) {
+    uint64_t allocationsBefore = SteamController_AtomicLoad64(&AllocationCount);
+    uint64_t startTime = SteamController_GetHostTime();
+    function(pContext, count);
+    elapsed     = SteamController_GetHostTime() - startTime;
+    allocations = SteamController_AtomicLoad64(&AllocationCount) - allocationsBefore;
+
+    if (elapsed >= BENCH_MIN_TIME || count >= ((size_t)1 << 30))
+      break;
+
+    // Aim a bit beyond the minimum time, but grow at most tenfold per round.
+    size_t next = elapsed ? (size_t)((double)count * BENCH_MIN_TIME * 1.2 / elapsed) : count * 10;
+    count = next > count * 10 ? count * 10 : next > count ? next : count + 1;
+  }
+
+  double nsPerOp = (double)elapsed / count;
+
+  printf("%s\n  { \"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f, \"ops_per_second\": %.0f, ",
+    IsFirstResult ? "" : ",", pName, count, nsPerOp, nsPerOp > 0.0 ? 1e9 / nsPerOp : 0.0);
+  if (BENCH_COUNTS_ALLOCATIONS)
+    printf("\"allocations_per_op\": %.3f }", (double)allocations / count);
+  else
+    printf("\"allocations_per_op\": null }");
+
+  IsFirstResult = false;
+}
+
+/** Fill the context with update reports that change a little every time, like a controller in use. */
+static void BenchMakeReports(BenchContext *pContext) {
+  for (size_t i=0; i<BENCH_REPORT_COUNT; i++) {
+    uint8_t *pReport = pContext->reports[i];
+    memset(pReport, 0, STEAMCONTROLLER_RAW_REPORT_SIZE);
+
+    pReport[0x00] = 0x01;
+    pReport[0x02] = STEAMCONTROLLER_EVENT_UPDATE;
+    pReport[0x03] = 0x3c;
+    StoreU32(pReport + 0x04, (uint32_t)i);
+    pReport[0x08] = (i & 16) ? 0x80 : 0x00;
+    pReport[0x0b] = (uint8_t)(i * 3);
+
+    for (size_t field=0x10; field<0x2e; field+=2) {
+      int16_t value = (int16_t)((i * 97 + field * 31) & 0x7fff) - 0x4000;
+      pReport[field]    = LowByte((uint16_t)value);
+      pReport[field+1]  = HighByte((uint16_t)value);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------------------------
+// Benchmarks
+
+static void BenchReadEvent(BenchContext *pContext, size_t count) {
+  SteamControllerEvent event;
+  for (size_t i=0; i<count; i++)
+    SteamController_ReadEvent(pContext->pDevice, &event);
+}
+
+static void BenchReadEvents(BenchContext *pContext, size_t count) {
+  SteamControllerEvent events[32];
+  for (size_t i=0; i<count; i+=32)
+    SteamController_ReadEvents(pContext->pDevice, events, count - i < 32 ? count - i : 32, NULL);
+}
+
+static void BenchDecodeBatch(BenchContext *pContext, size_t count) {
+  static uint8_t  eventType[BENCH_REPORT_COUNT];
+  static uint32_t timeStamp[BENCH_REPORT_COUNT], buttons[BENCH_REPORT_COUNT];
+  static uint8_t  leftTrigger[BENCH_REPORT_COUNT], rightTrigger[BENCH_REPORT_COUNT];
+  static int16_t  fields[13][BENCH_REPORT_COUNT];
+
+  SteamControllerUpdateBatch batch = {
+    eventType, timeStamp, buttons, leftTrigger, rightTrigger,
+    fields[0], fields[1], fields[2], fields[3], fields[4], fields[5], fields[6],
+    fields[7], fields[8], fields[9], fields[10], fields[11], fields[12]
+  };
+
+  for (size_t i=0; i<count; i+=BENCH_REPORT_COUNT) {
+    size_t batchCount = count - i < BENCH_REPORT_COUNT ? count - i : BENCH_REPORT_COUNT;
+    SteamController_DecodeUpdateBatch(pContext->reports[0], batchCount, &batch);
+  }
+}
+
+static void BenchUpdateState(BenchContext *pContext, size_t count) {
+  for (size_t i=0; i<count; i++)
+    SteamController_UpdateState(&pContext->state, &pContext->events[i % BENCH_REPORT_COUNT]);
+}
+
+static void BenchUpdateStateSnapshot(BenchContext *pContext, size_t count) {
+  for (size_t i=0; i<count; i++)
+    SteamController_UpdateStateSnapshot(pContext->pDevice, &pContext->events[i % BENCH_REPORT_COUNT]);
+}
+
+static void BenchRemapState(BenchContext *pContext, size_t count) {
+  uint64_t actions = 0;
+  for (size_t i=0; i<count; i++)
+    actions ^= SteamController_RemapState(pContext->pRemap, &pContext->states[i % BENCH_REPORT_COUNT]);
+  BenchSink = (uint8_t)actions;
+}
+
+static void BenchAddSettings(BenchContext *pContext, size_t count) {
+  (void)pContext;
+
+  for (size_t i=0; i<count; i++) {
+    SteamController_HIDFeatureReport report;
+    memset(&report, 0, sizeof(report));
+    report.featureId = STEAMCONTROLLER_SET_SETTINGS;
+
+    for (uint8_t setting=0; setting<STEAMCONTROLLER_MAX_SETTINGS_PER_REPORT; setting++)
+      SteamController_FeatureReportAddSetting(&report, setting, (uint16_t)(i + setting));
+
+    BenchSink = report.data[report.dataLen - 1];
+  }
+}
+
+static void BenchTriggerHaptic(BenchContext *pContext, size_t count) {
+  for (size_t i=0; i<count; i++) {
+    SteamController_TriggerHaptic(pContext->pDevice, i & 1, 200, 100, 3);
+
+    // The loopback keeps every report sent, don't let it grow without end.
+    if ((i & 1023) == 1023)
+      SteamController_LoopbackClearFeatureReports(pContext->pLoopback);
+  }
+  SteamController_LoopbackClearFeatureReports(pContext->pLoopback);
+}
+
+#if __linux__
+
+#define BENCH_SYSFS_DEVICES         8     /**< Steam controllers in the fake sysfs tree, as many other HID devices. */
+
+/** Create a directory and all its parents. */
+static bool BenchMakeDirs(const char *pPath) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s", pPath);
+
+  for (char *p = path + 1; *p; p++) {
+    if (*p != '/')
+      continue;
+    *p = 0;
+    mkdir(path, 0755);
+    *p = '/';
+  }
+  return mkdir(path, 0755) == 0;
+}
+
+static bool BenchWriteFile(const char *pPath, const void *pData, size_t len) {
+  FILE *pFile = fopen(pPath, "wb");
+  if (!pFile)
+    return false;
+
+  bool success = fwrite(pData, 1, len, pFile) == len;
+  return fclose(pFile) == 0 && success;
+}
+
+/**
+ * Build a sysfs tree below a temporary directory with Steam controllers,
+ * dongle slots and other HID devices, as SteamController_CreateRegistry sees it.
+ * @return false if the tree could not be built.
+ */
+static bool BenchMakeSysfs(char *pRoot, size_t rootSize) {
+  snprintf(pRoot, rootSize, "/tmp/SteamControllerBench.XXXXXX");
+  if (!mkdtemp(pRoot))
+    return false;
+
+  static const uint8_t steamDescriptor[] = { 0x06, 0x00, 0xff, 0x09, 0x01 };
+  static const uint8_t otherDescriptor[] = { 0x05, 0x01, 0x09, 0x06 };
+
+  for (int i=0; i<2*BENCH_SYSFS_DEVICES; i++) {
+    bool        isSteam   = i < BENCH_SYSFS_DEVICES;
+    const char *pProduct  = !isSteam ? "046D:C52B" : (i & 1) ? "28DE:1142" : "28DE:1102";
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/bus/hid/devices/0003:%s.%04X/hidraw/hidraw%d", pRoot, pProduct, i + 1, i);
+    if (!BenchMakeDirs(path))
+      return false;
+
+    snprintf(path, sizeof(path), "%s/bus/hid/devices/0003:%s.%04X/report_descriptor", pRoot, pProduct, i + 1);
+    if (!BenchWriteFile(path, isSteam ? steamDescriptor : otherDescriptor, isSteam ? sizeof(steamDescriptor) : sizeof(otherDescriptor)))
+      return false;
+  }
+
+  return true;
+}
+
+/** Remove the fake sysfs tree, it only has what BenchMakeSysfs put there. */
+static void BenchRemoveSysfs(const char *pRoot) {
+  char path[4096];
+
+  for (int i=0; i<2*BENCH_SYSFS_DEVICES; i++) {
+    bool        isSteam   = i < BENCH_SYSFS_DEVICES;
+    const char *pProduct  = !isSteam ? "046D:C52B" : (i & 1) ? "28DE:1142" : "28DE:1102";
+
+    snprintf(path, sizeof(path), "%s/bus/hid/devices/0003:%s.%04X/report_descriptor", pRoot, pProduct, i + 1);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/bus/hid/devices/0003:%s.%04X/hidraw/hidraw%d", pRoot, pProduct, i + 1, i);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/bus/hid/devices/0003:%s.%04X/hidraw", pRoot, pProduct, i + 1);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/bus/hid/devices/0003:%s.%04X", pRoot, pProduct, i + 1);
+    remove(path);
+  }
+
+  static const char *parents[] = { "/bus/hid/devices", "/bus/hid", "/bus", "" };
+  for (size_t i=0; i<sizeof(parents)/sizeof(parents[0]); i++) {
+    snprintf(path, sizeof(path), "%s%s", pRoot, parents[i]);
+    if (remove(path))
+      fprintf(stderr, "Could not remove %s\n", path);
+  }
+}
+
+static void BenchEnumerateSysfs(BenchContext *pContext, size_t count) {
+  for (size_t i=0; i<count; i++)
+    SteamController_DestroyRegistry(SteamController_CreateRegistry(pContext->pSysfsRoot, 0, NULL, NULL));
+}
+
+#endif
+
+int main(int argc, char **argv) {
+  if (argc > 1)
+    BenchFilter = argv[1];
+
+  BenchContext context;
+  memset(&context, 0, sizeof(context));
+  BenchMakeReports(&context);
+
+  context.pLoopback = SteamController_CreateLoopback();
+  if (!context.pLoopback)
+    return 1;
+
+  for (size_t i=0; i<BENCH_REPORT_COUNT; i++)
+    SteamController_LoopbackQueueReport(context.pLoopback, context.reports[i], STEAMCONTROLLER_RAW_REPORT_SIZE);
+  SteamController_LoopbackSetLooping(context.pLoopback, true);
+
+  context.pDevice = SteamController_OpenLoopback(context.pLoopback, false);
+  if (!context.pDevice)
+    return 1;
+
+  for (size_t i=0; i<BENCH_REPORT_COUNT; i++) {
+    SteamController_ReadEvent(context.pDevice, &context.events[i]);
+    SteamController_UpdateState(&context.state, &context.events[i]);
+    context.states[i] = context.state;
+  }
+
+  // A profile with something on every button, a chord and both pads.
+  SteamControllerRemapProfile profile;
+  SteamController_InitRemapProfile(&profile);
+  profile.layerButtons[0] = STEAMCONTROLLER_BUTTON_LG;
+  profile.layerButtons[1] = STEAMCONTROLLER_BUTTON_RG;
+  for (int layer=0; layer<STEAMCONTROLLER_REMAP_LAYERS; layer++) {
+    for (int button=0; button<24; button++)
+      profile.buttonActions[layer][button] = (uint8_t)((layer * 24 + button) % STEAMCONTROLLER_REMAP_MAX_ACTIONS);
+    for (int direction=0; direction<4; direction++) {
+      profile.padActions[layer][0][direction] = (uint8_t)(32 + direction);
+      profile.padActions[layer][1][direction] = (uint8_t)(36 + direction);
+    }
+  }
+  profile.padButtons[0]   = STEAMCONTROLLER_BUTTON_LFINGER;
+  profile.padButtons[1]   = STEAMCONTROLLER_BUTTON_RFINGER;
+  profile.chords[0]       = (SteamControllerRemapChord){ STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_B, 0, 40 };
+  profile.chordCount      = 1;
+
+  context.pRemap = SteamController_CreateRemap(SteamController_CompileRemapProfile(&profile));
+  if (!context.pRemap)
+    return 1;
+
+  printf("{ \"benchmarks\": [");
+
+  Bench(&context, "read_event",             BenchReadEvent);
+  Bench(&context, "read_events",            BenchReadEvents);
+  Bench(&context, "decode_update_batch",    BenchDecodeBatch);
+  Bench(&context, "update_state",           BenchUpdateState);
+  Bench(&context, "update_state_snapshot",  BenchUpdateStateSnapshot);
+  Bench(&context, "remap_state",            BenchRemapState);
+  Bench(&context, "add_settings",           BenchAddSettings);
+  Bench(&context, "trigger_haptic",         BenchTriggerHaptic);
+
+#if __linux__
+  char sysfsRoot[64];
+  if (BenchMakeSysfs(sysfsRoot, sizeof(sysfsRoot))) {
+    context.pSysfsRoot = sysfsRoot;
+    Bench(&context, "enumerate_sysfs",      BenchEnumerateSysfs);
+    BenchRemoveSysfs(sysfsRoot);
+  } else {
+    fprintf(stderr, "Could not build a fake sysfs tree, skipping enumeration\n");
+  }
+#endif
+
+  printf("\n] }\n");
+
+  SteamController_DestroyRemap(context.pRemap);
+  SteamController_Close(context.pDevice);
+  SteamController_DestroyLoopback(context.pLoopback);
+  return 0;
+}
@@ -10,7 +10,261 @@
 #define inline __inline
 #endif
 
-void Debug_DumpHex(const void *pData, size_t count);
+// ----------------------------------------------------------------------------------------------
+// Atomics
+//
+// C11 atomics, or Interlocked intrinsics and volatile accesses on MSVC. Loads
+// acquire and stores release unless they are called Relaxed, the other
+// operations are full barriers.
+
+#if _MSC_VER
+
+#include <intrin.h>
+
+typedef volatile long     SteamControllerAtomicU32;
+typedef volatile __int64  SteamControllerAtomicU64;
+typedef void * volatile   SteamControllerAtomicPtr;
+
+static inline void SteamController_AtomicFenceAcquire() {
+#if defined(_M_ARM64)
+  __dmb(_ARM64_BARRIER_ISH);
+#else
+  _ReadWriteBarrier();
+#endif
+}
+
+static inline void SteamController_AtomicFenceRelease() {
+  SteamController_AtomicFenceAcquire();
+}
+
+static inline uint32_t SteamController_AtomicLoadRelaxed32(const SteamControllerAtomicU32 *pValue) {
+  return (uint32_t)*pValue;
+}
+
+static inline uint32_t SteamController_AtomicLoad32(const SteamControllerAtomicU32 *pValue) {
+  uint32_t value = (uint32_t)*pValue;
+  SteamController_AtomicFenceAcquire();
+  return value;
+}
+
+static inline void SteamController_AtomicStoreRelaxed32(SteamControllerAtomicU32 *pValue, uint32_t value) {
+  *pValue = (long)value;
+}
+
+static inline void SteamController_AtomicStore32(SteamControllerAtomicU32 *pValue, uint32_t value) {
+  SteamController_AtomicFenceRelease();
+  *pValue = (long)value;
+}
+
+/** @return The previous value. */
+static inline uint32_t SteamController_AtomicAdd32(SteamControllerAtomicU32 *pValue, uint32_t value) {
+  return (uint32_t)_InterlockedExchangeAdd(pValue, (long)value);
+}
+
+static inline uint32_t SteamController_AtomicExchange32(SteamControllerAtomicU32 *pValue, uint32_t value) {
+  return (uint32_t)_InterlockedExchange(pValue, (long)value);
+}
+
+/** Store desired if the value is *pExpected, else load the value into *pExpected. */
+static inline bool SteamController_AtomicCompareExchange32(SteamControllerAtomicU32 *pValue, uint32_t *pExpected, uint32_t desired) {
+  uint32_t previous = (uint32_t)_InterlockedCompareExchange(pValue, (long)desired, (long)*pExpected);
+  bool     isSwapped = previous == *pExpected;
+  *pExpected = previous;
+  return isSwapped;
+}
+
+static inline uint64_t SteamController_AtomicLoad64(const SteamControllerAtomicU64 *pValue) {
+#if defined(_M_IX86)
+  // Plain 64 bit accesses are not atomic on x86.
+  return (uint64_t)_InterlockedCompareExchange64((SteamControllerAtomicU64 *)pValue, 0, 0);
+#else
+  uint64_t value = (uint64_t)*pValue;
+  SteamController_AtomicFenceAcquire();
+  return value;
+#endif
+}
+
+static inline bool SteamController_AtomicCompareExchange64(SteamControllerAtomicU64 *pValue, uint64_t *pExpected, uint64_t desired) {
+  uint64_t previous = (uint64_t)_InterlockedCompareExchange64(pValue, (__int64)desired, (__int64)*pExpected);
+  bool     isSwapped = previous == *pExpected;
+  *pExpected = previous;
+  return isSwapped;
+}
+
+static inline void SteamController_AtomicStore64(SteamControllerAtomicU64 *pValue, uint64_t value) {
+#if defined(_M_IX86)
+  uint64_t expected = SteamController_AtomicLoad64(pValue);
+  while (!SteamController_AtomicCompareExchange64(pValue, &expected, value))
+    ;
+#else
+  SteamController_AtomicFenceRelease();
+  *pValue = (__int64)value;
+#endif
+}
+
+static inline uint64_t SteamController_AtomicAdd64(SteamControllerAtomicU64 *pValue, uint64_t value) {
+  uint64_t expected = SteamController_AtomicLoad64(pValue);
+  while (!SteamController_AtomicCompareExchange64(pValue, &expected, expected + value))
+    ;
+  return expected;
+}
+
+static inline void *SteamController_AtomicLoadPtr(const SteamControllerAtomicPtr *pValue) {
+  void *value = *pValue;
+  SteamController_AtomicFenceAcquire();
+  return value;
+}
+
+static inline void SteamController_AtomicStorePtr(SteamControllerAtomicPtr *pValue, void *value) {
+  SteamController_AtomicFenceRelease();
+  *pValue = value;
+}
+
+static inline void *SteamController_AtomicExchangePtr(SteamControllerAtomicPtr *pValue, void *value) {
+  return _InterlockedExchangePointer(pValue, value);
+}
+
+static inline bool SteamController_AtomicCompareExchangePtr(SteamControllerAtomicPtr *pValue, void **pExpected, void *desired) {
+  void *previous  = _InterlockedCompareExchangePointer(pValue, desired, *pExpected);
+  bool  isSwapped = previous == *pExpected;
+  *pExpected = previous;
+  return isSwapped;
+}
+
+#else
+
+#include <stdatomic.h>
+
+typedef _Atomic uint32_t  SteamControllerAtomicU32;
+typedef _Atomic uint64_t  SteamControllerAtomicU64;
+typedef _Atomic(void *)   SteamControllerAtomicPtr;
+
+static inline void SteamController_AtomicFenceAcquire() {
+  atomic_thread_fence(memory_order_acquire);
+}
+
+static inline void SteamController_AtomicFenceRelease() {
+  atomic_thread_fence(memory_order_release);
+}
+
+static inline uint32_t SteamController_AtomicLoadRelaxed32(const SteamControllerAtomicU32 *pValue) {
+  return atomic_load_explicit(pValue, memory_order_relaxed);
+}
+
+static inline uint32_t SteamController_AtomicLoad32(const SteamControllerAtomicU32 *pValue) {
+  return atomic_load_explicit(pValue, memory_order_acquire);
+}
+
+static inline void SteamController_AtomicStoreRelaxed32(SteamControllerAtomicU32 *pValue, uint32_t value) {
+  atomic_store_explicit(pValue, value, memory_order_relaxed);
+}
+
+static inline void SteamController_AtomicStore32(SteamControllerAtomicU32 *pValue, uint32_t value) {
+  atomic_store_explicit(pValue, value, memory_order_release);
+}
+
+/** @return The previous value. */
+static inline uint32_t SteamController_AtomicAdd32(SteamControllerAtomicU32 *pValue, uint32_t value) {
+  return atomic_fetch_add_explicit(pValue, value, memory_order_acq_rel);
+}
+
+static inline uint32_t SteamController_AtomicExchange32(SteamControllerAtomicU32 *pValue, uint32_t value) {
+  return atomic_exchange_explicit(pValue, value, memory_order_acq_rel);
+}
+
+/** Store desired if the value is *pExpected, else load the value into *pExpected. */
+static inline bool SteamController_AtomicCompareExchange32(SteamControllerAtomicU32 *pValue, uint32_t *pExpected, uint32_t desired) {
+  return atomic_compare_exchange_strong_explicit(pValue, pExpected, desired, memory_order_acq_rel, memory_order_acquire);
+}
+
+static inline uint64_t SteamController_AtomicLoad64(const SteamControllerAtomicU64 *pValue) {
+  return atomic_load_explicit(pValue, memory_order_acquire);
+}
+
+static inline bool SteamController_AtomicCompareExchange64(SteamControllerAtomicU64 *pValue, uint64_t *pExpected, uint64_t desired) {
+  return atomic_compare_exchange_strong_explicit(pValue, pExpected, desired, memory_order_acq_rel, memory_order_acquire);
+}
+
+static inline void SteamController_AtomicStore64(SteamControllerAtomicU64 *pValue, uint64_t value) {
+  atomic_store_explicit(pValue, value, memory_order_release);
+}
+
+static inline uint64_t SteamController_AtomicAdd64(SteamControllerAtomicU64 *pValue, uint64_t value) {
+  return atomic_fetch_add_explicit(pValue, value, memory_order_acq_rel);
+}
+
+static inline void *SteamController_AtomicLoadPtr(const SteamControllerAtomicPtr *pValue) {
+  return atomic_load_explicit(pValue, memory_order_acquire);
+}
+
+static inline void SteamController_AtomicStorePtr(SteamControllerAtomicPtr *pValue, void *value) {
+  atomic_store_explicit(pValue, value, memory_order_release);
+}
+
+static inline void *SteamController_AtomicExchangePtr(SteamControllerAtomicPtr *pValue, void *value) {
+  return atomic_exchange_explicit(pValue, value, memory_order_acq_rel);
+}
+
+static inline bool SteamController_AtomicCompareExchangePtr(SteamControllerAtomicPtr *pValue, void **pExpected, void *desired) {
+  return atomic_compare_exchange_strong_explicit(pValue, pExpected, desired, memory_order_acq_rel, memory_order_acquire);
+}
+
+#endif
+
+/**
+ * Messages above this STEAMCONTROLLER_LOG_* level are left out of the build,
+ * e.g. -DSTEAMCONTROLLER_LOG_COMPILE_LEVEL=2 keeps errors and warnings only.
+ */
+#ifndef STEAMCONTROLLER_LOG_COMPILE_LEVEL
+#define STEAMCONTROLLER_LOG_COMPILE_LEVEL           STEAMCONTROLLER_LOG_DEBUG
+#endif
+
+#if defined(__GNUC__)
+#define STEAMCONTROLLER_PRINTF(formatIndex, argsIndex) __attribute__((format(printf, formatIndex, argsIndex)))
+#else
+#define STEAMCONTROLLER_PRINTF(formatIndex, argsIndex)
+#endif
+
+/** Rate limiting state of one place that logs. */
+typedef struct {
+  SteamControllerAtomicU64  windowStart;    /**< Host time the current interval started at. */
+  SteamControllerAtomicU32  windowCount;    /**< Messages in the current interval. */
+  SteamControllerAtomicU32  suppressed;     /**< Messages dropped since the last one logged. */
+} SteamControllerLogSite;
+
+extern SteamControllerAtomicU32 SteamController_LogLevel;
+
+/** Whether a message of a level would reach the sink. One relaxed atomic load. */
+static inline bool SteamController_IsLogging(unsigned level) {
+  return level <= SteamController_AtomicLoadRelaxed32(&SteamController_LogLevel);
+}
+
+void SteamController_LogAt(SteamControllerLogSite *pSite, unsigned level, const char *pFormat, ...) STEAMCONTROLLER_PRINTF(3, 4);
+void SteamController_LogErrnoAt(SteamControllerLogSite *pSite, const char *pWhat);
+void SteamController_LogHexAt(SteamControllerLogSite *pSite, unsigned level, const void *pData, size_t count, const char *pFormat, ...) STEAMCONTROLLER_PRINTF(5, 6);
+
+/**
+ * Run a logging call with a site of its own, if its level is compiled in and
+ * enabled. Arguments are not evaluated otherwise.
+ */
+#define SteamController_LogWith(level, call) do {                                       \
+    if ((level) <= STEAMCONTROLLER_LOG_COMPILE_LEVEL && SteamController_IsLogging(level)) { \
+      static SteamControllerLogSite logSite;                                            \
+      call;                                                                             \
+    }                                                                                   \
+  } while (0)
+
+/** Log a printf style message. */
+#define SteamController_Log(level, ...) \
+  SteamController_LogWith(level, SteamController_LogAt(&logSite, (level), __VA_ARGS__))
+
+/** Log an error with the description of errno, like perror. */
+#define SteamController_LogErrno(pWhat) \
+  SteamController_LogWith(STEAMCONTROLLER_LOG_ERROR, SteamController_LogErrnoAt(&logSite, (pWhat)))
+
+/** Log a printf style message followed by a hex dump of some data. */
+#define SteamController_LogHex(level, pData, count, ...) \
+  SteamController_LogWith(level, SteamController_LogHexAt(&logSite, (level), (pData), (count), __VA_ARGS__))
 
 #define USB_VID_VALVE                               0x28de
 #define USB_PID_STEAMCONTROLLER_WIRED               0x1102
@@ -37,6 +291,106 @@ void Debug_DumpHex(const void *pData, size_t count);
 #define STEAMCONTROLLER_GET_CHIPID                 0xBA // 1011 1010
 #define STEAMCONTROLLER_WRITE_EEPROM               0xC1 // 1100 0001
 
+#define STEAMCONTROLLER_IDENTITY_SIZE              128
+
+typedef struct SteamControllerReader SteamControllerReader;
+typedef struct SteamControllerCommandQueue SteamControllerCommandQueue;
+typedef struct SteamControllerHaptics SteamControllerHaptics;
+typedef struct SteamControllerLatency SteamControllerLatency;
+typedef struct SteamControllerLink SteamControllerLink;
+
+/**
+ * Latencies are counted in log-linear buckets: every power of two is split
+ * into 16 buckets, so a bucket is at most 1/16 wider than its lower bound and
+ * percentiles are off by less than 6.25%. Latencies below 16 ns have a bucket
+ * each, latencies beyond 2^40 ns (about 18 minutes) land in the last bucket.
+ */
+#define STEAMCONTROLLER_LATENCY_SUB_BUCKET_BITS   4
+#define STEAMCONTROLLER_LATENCY_SUB_BUCKETS       (1 << STEAMCONTROLLER_LATENCY_SUB_BUCKET_BITS)
+#define STEAMCONTROLLER_LATENCY_MAX_EXPONENT      40
+#define STEAMCONTROLLER_LATENCY_BUCKETS           ((STEAMCONTROLLER_LATENCY_MAX_EXPONENT - STEAMCONTROLLER_LATENCY_SUB_BUCKET_BITS + 2) * STEAMCONTROLLER_LATENCY_SUB_BUCKETS)
+
+/** Histogram of latencies in nanoseconds. */
+typedef struct {
+  SteamControllerAtomicU32  buckets[STEAMCONTROLLER_LATENCY_BUCKETS];
+  SteamControllerAtomicU64  count;
+  SteamControllerAtomicU64  sum;
+  SteamControllerAtomicU64  max;
+} SteamControllerHistogram;
+
+void SteamController_HistogramRecord(SteamControllerHistogram *pHistogram, uint64_t nanoseconds);
+void SteamController_HistogramReset(SteamControllerHistogram *pHistogram);
+void SteamController_HistogramGetStats(const SteamControllerHistogram *pHistogram, SteamControllerLatencyStats *pStats);
+
+#define STEAMCONTROLLER_STATE_WORDS  ((sizeof(SteamControllerState) + 3) / 4)
+
+/** Latest state of a device, published by a single writer through a seqlock. */
+typedef struct {
+  SteamControllerState      state;                                /**< Accumulated state, only touched by the writer. */
+  SteamControllerAtomicU32  sequence;                             /**< Odd while the writer is updating the words. */
+  SteamControllerAtomicU32  words[STEAMCONTROLLER_STATE_WORDS];   /**< Published copy of the state. */
+  SteamControllerAtomicU64  publishTime;                          /**< Host time of the last update, only kept while tracking latency. */
+} SteamControllerStateBlock;
+
+void SteamController_SeqlockWrite(SteamControllerAtomicU32 *pSequence, SteamControllerAtomicU32 *pWords, const void *pData, size_t wordCount);
+void SteamController_SeqlockRead(const SteamControllerAtomicU32 *pSequence, const SteamControllerAtomicU32 *pWords, void *pData, size_t wordCount);
+
+/** Attributes of a device, guarded by the lock of the attribute cache. */
+typedef struct {
+  SteamControllerAttributes attributes;       /**< Valid once queried or found in the cache. */
+  uint32_t                  generation;       /**< Bumped by SteamController_InvalidateAttributes. */
+  bool                      isVersionPending; /**< DONGLE_GET_VERSION was deferred by a lazy or cached open. */
+} SteamControllerAttributeState;
+
+/**
+ * Settings last sent to a device, see SteamController_CommitSettings. Only
+ * the committing thread touches the values, other threads invalidate them by
+ * bumping the generation.
+ */
+typedef struct {
+  SteamControllerAtomicU32  generation;
+  uint32_t                  knownGeneration;  /**< Generation the known values belong to. */
+  uint16_t                  values[256];
+  uint8_t                   isKnown[32];      /**< Bitmap of settings whose value on the device is known. */
+} SteamControllerSettingsCache;
+
+/** 
+ * Device handle shared by all platforms. Every hardware access goes through 
+ * the transport, the platform specific code only provides the backend.
+ */
+struct SteamControllerDevice {
+  const SteamControllerTransport *pTransport;
+  void                           *pTransportContext;
+  bool                            isWireless;
+  char                            identity[STEAMCONTROLLER_IDENTITY_SIZE];  /**< Stable name of the physical device, empty if unknown. */
+  SteamControllerAttributeState  *pAttributeState;    /**< Updated through const handles, see SteamController_GetAttributes. */
+
+  SteamControllerReader          *pReader;            /**< Background reader thread, if started. */
+  SteamControllerStateBlock       stateBlock;         /**< State snapshot for any number of readers. */
+
+  SteamControllerSettingsCache   *pSettingsCache;     /**< What the device has been configured to, updated through const handles. */
+  SteamControllerCommandQueue    *pCommands;          /**< Asynchronous feature report queue, created on first use. */
+  SteamControllerHaptics         *pHaptics;           /**< Haptic pattern sequencer, created on first use. */
+
+  SteamControllerRecorder        *pRecorder;          /**< Capture file for all traffic, if set. */
+  uint32_t                        recordDeviceId;     /**< Device id written to captured records. */
+
+  SteamControllerAtomicPtr        pLatency;           /**< SteamControllerLatency histograms, allocated when first enabled. */
+  SteamControllerAtomicU32        isTrackingLatency;
+  SteamControllerAtomicPtr        pLink;              /**< SteamControllerLink statistics, allocated when first enabled. */
+  SteamControllerAtomicU32        isTrackingLink;
+};
+
+/** Whether latencies of a device are counted, see SteamController_RecordLatency. */
+static inline bool SteamController_IsTrackingLatency(const SteamControllerDevice *pDevice) {
+  return SteamController_AtomicLoad32(&pDevice->isTrackingLatency) != 0;
+}
+
+/** Whether link statistics of a device are kept, see SteamController_LinkUpdate. */
+static inline bool SteamController_IsTrackingLink(const SteamControllerDevice *pDevice) {
+  return SteamController_AtomicLoad32(&pDevice->isTrackingLink) != 0;
+}
+
 typedef struct {
   uint8_t reportPage;
   uint8_t featureId;
@@ -47,8 +401,38 @@ typedef struct {
 bool SteamController_HIDSetFeatureReport(const SteamControllerDevice *pDevice, SteamController_HIDFeatureReport *pReport);
 bool SteamController_HIDGetFeatureReport(const SteamControllerDevice *pDevice, SteamController_HIDFeatureReport *pReport);
 
-bool    SteamController_Initialize(const SteamControllerDevice *pDevice);
+SteamControllerDevice *SteamController_OpenTransportEx(const SteamControllerTransport *pTransport, void *pContext, bool isWireless, const char *pIdentity, unsigned flags);
+bool    SteamController_Initialize(const SteamControllerDevice *pDevice, unsigned flags);
+bool    SteamController_LoadCachedAttributes(const SteamControllerDevice *pDevice);
+bool    SteamController_QueryAttributes(const SteamControllerDevice *pDevice, SteamControllerAttributes *pAttributes);
+bool    SteamController_QueryVersion(const SteamControllerDevice *pDevice);
+void    SteamController_DeferVersionQuery(const SteamControllerDevice *pDevice);
+void    SteamController_InvalidateAttributes(const SteamControllerDevice *pDevice);
+void    SteamController_ForgetCachedAttributes(const SteamControllerDevice *pDevice);
+
+#if __linux__
+SteamControllerDeviceEnum *SteamController_EnumControllerDevicesAt(const char *pSysfsRoot);
+const char             *SteamController_GetEnumPath(const SteamControllerDeviceEnum *pEnum);
+const char             *SteamController_GetEnumSysPath(const SteamControllerDeviceEnum *pEnum);
+bool                    SteamController_CheckHidrawDevice(const char *pHidrawSysPath, char *pDevPath, size_t devPathSize);
+SteamControllerDevice  *SteamController_OpenPath(const char *pPath, unsigned flags);
+#endif
 uint8_t SteamController_ReadRaw(const SteamControllerDevice *pDevice, uint8_t *buffer, uint8_t maxLen);
+void    SteamController_RawReportRead(const SteamControllerDevice *pDevice, const uint8_t *pReport, uint8_t len, uint64_t startTime);
+int     SteamController_GetPollFd(const SteamControllerDevice *pDevice);
+bool    SteamController_HasPendingInput(const SteamControllerDevice *pDevice);
+uint8_t SteamController_DecodeEvent(const uint8_t *pData, uint16_t len, SteamControllerEvent *pEvent);
+uint8_t SteamController_DecodeDeviceEvent(const SteamControllerDevice *pDevice, const uint8_t *pData, uint16_t len, SteamControllerEvent *pEvent);
+void    SteamController_Record(const SteamControllerDevice *pDevice, uint8_t kind, const uint8_t *pData, size_t len);
+void    SteamController_RecordLatency(const SteamControllerDevice *pDevice, unsigned stage, uint64_t nanoseconds);
+void    SteamController_LinkUpdate(const SteamControllerDevice *pDevice, const SteamControllerEvent *pEvent, uint64_t arrival);
+
+void    SteamController_BuildHapticReport(SteamController_HIDFeatureReport *pReport, uint16_t motor, uint16_t onTime, uint16_t offTime, uint16_t count);
+void    SteamController_BuildMelodyReport(SteamController_HIDFeatureReport *pReport, uint32_t melodyId);
+void    SteamController_BuildConfigureReport(SteamController_HIDFeatureReport *pReport, unsigned configFlags);
+void    SteamController_StopCommandQueue(SteamControllerDevice *pDevice);
+void    SteamController_StopHaptics(SteamControllerDevice *pDevice);
+void    SteamController_InvalidateSettings(const SteamControllerDevice *pDevice);
 
 
 static inline uint8_t LowByte(uint16_t value)   { return value & 0xff; }
@@ -56,7 +440,7 @@ static inline uint8_t HighByte(uint16_t value)  { return (value >> 8) & 0xff; }
 
 static inline void StoreU16(uint8_t *pDestination, uint16_t value) {
   pDestination[0] = (value >> 0) & 0xff;
-  pDestination[2] = (value >> 8) & 0xff;
+  pDestination[1] = (value >> 8) & 0xff;
 }
 
 static inline void StoreU32(uint8_t *pDestination, uint32_t value) {
@@ -65,3 +449,17 @@ static inline void StoreU32(uint8_t *pDestination, uint32_t value) {
   pDestination[2] = (value >> 16) & 0xff;
   pDestination[3] = (value >> 24) & 0xff;
 }
+
+#define STEAMCONTROLLER_MAX_SETTINGS_PER_REPORT     20  /**< 62 data bytes hold 20 three byte settings. */
+
+/** Raw angular velocity to radians per second. */
+#define STEAMCONTROLLER_RADIANS_PER_COUNT           (3.14159265f / 180.0f / STEAMCONTROLLER_ANGULAR_VELOCITY_PER_DPS)
+
+/** Add a settings parameter and value to an SET_SETTINGS feature report. */
+static inline void SteamController_FeatureReportAddSetting(SteamController_HIDFeatureReport *featureReport, uint8_t setting, uint16_t value) {
+  uint8_t offset = featureReport->dataLen;
+  featureReport->data[offset] = setting;
+  StoreU16(featureReport->data + offset + 1, value);
+
+  featureReport->dataLen += 3;
+}
@@ -0,0 +1,43 @@
+#include "steamcontroller.h"
+
+#include <stdio.h>
+
+#if __linux__
+
+#include <signal.h>
+
+static volatile sig_atomic_t isRunning = 1;
+
+static void HandleSignal(int signal) {
+  (void)signal;
+  isRunning = 0;
+}
+
+int main(int argc, char **argv) {
+  const char *pName = argc > 1 ? argv[1] : STEAMCONTROLLER_SHM_DEFAULT_NAME;
+
+  SteamControllerShmServer *pServer = SteamController_CreateShmServer(pName);
+  if (!pServer)
+    return 1;
+
+  signal(SIGINT, HandleSignal);
+  signal(SIGTERM, HandleSignal);
+
+  size_t count = SteamController_ShmServerAddAll(pServer);
+  fprintf(stderr, "Publishing %u devices as %s\n", (unsigned)count, pName);
+
+  while (isRunning && SteamController_ShmServerWait(pServer, 1000) >= 0) {
+  }
+
+  SteamController_DestroyShmServer(pServer);
+  return 0;
+}
+
+#else
+
+int main() {
+  fprintf(stderr, "Shared memory publishing is only supported on Linux.\n");
+  return 1;
+}
+
+#endif
@@ -2,29 +2,79 @@
 
 #include <stdio.h>
 
+static void HandleEvent(SteamControllerDevice *pDevice, const SteamControllerEvent *pEvent) {
+  if (pEvent->eventType == STEAMCONTROLLER_EVENT_CONNECTION && pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED) {
+    fprintf(stderr, "Device %p is not connected (anymore)...\n", pDevice);
+  }
+
+  if (pEvent->eventType == STEAMCONTROLLER_EVENT_CONNECTION && pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_CONNECTED) {
+    fprintf(stderr, "Device %p is connected, configuring...\n", pDevice);
+    SteamController_Configure(pDevice, STEAMCONTROLLER_CONFIG_SEND_BATTERY_STATUS|STEAMCONTROLLER_CONFIG_SEND_GYRO);
+  }
+
+  if (pEvent->eventType == STEAMCONTROLLER_EVENT_UPDATE) {
+    // just print the value of the left touch pad / stick position
+    fprintf(stderr, "%p: % 6hd % 6hd\n", pDevice, pEvent->update.leftXY.x, pEvent->update.leftXY.y);
+  }
+}
+
+#if __linux__
+
+static void HandleDevice(SteamControllerDevice *pDevice, bool isHangup, void *pUserData) {
+  (void)pUserData;
+
+  if (isHangup) {
+    fprintf(stderr, "Device %p is gone.\n", pDevice);
+    SteamController_Close(pDevice);
+    return;
+  }
+
+  SteamControllerEvent events[32];
+  bool morePending = true;
+  while (morePending) {
+    size_t count = SteamController_ReadEvents(pDevice, events, 32, &morePending);
+    for (size_t i=0; i<count; i++)
+      HandleEvent(pDevice, events + i);
+  }
+}
+
+int main() {
+  SteamControllerPoller *pPoller = SteamController_CreatePoller();
+  if (!pPoller)
+    return 1;
+
+  // Wait on all controllers and dongle slots at once.
+  SteamControllerDeviceEnum *pEnum = SteamController_EnumControllerDevices();
+  while (pEnum) {
+    SteamControllerDevice *pDevice = SteamController_Open(pEnum);
+    if (pDevice && !SteamController_PollerAdd(pPoller, pDevice, NULL))
+      SteamController_Close(pDevice);
+    pEnum = SteamController_NextControllerDevice(pEnum);
+  }
+
+  while (SteamController_PollerWait(pPoller, 1000, HandleDevice) >= 0) {
+  }
+
+  SteamController_DestroyPoller(pPoller);
+  return 0;
+}
+
+#else
+
 int main() {
   SteamControllerDeviceEnum *pEnum = SteamController_EnumControllerDevices();
   while (pEnum) {
     SteamControllerEvent event;
     SteamControllerDevice *pDevice = SteamController_Open(pEnum);
-    if (pDevice) {  
-       
+    if (pDevice) {
+
       for(;;) {
         uint8_t res = SteamController_ReadEvent(pDevice, &event);
-        if (res == STEAMCONTROLLER_EVENT_CONNECTION && event.connection.details == STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED) {
-          fprintf(stderr, "Device %p is not connected (anymore), trying next one...\n", pDevice);
-          break;
-        }
-
-        if (res == STEAMCONTROLLER_EVENT_CONNECTION && event.connection.details == STEAMCONTROLLER_CONNECTION_EVENT_CONNECTED) {
-          fprintf(stderr, "Device %p is connected, configuring...\n", pDevice);
-          SteamController_Configure(pDevice, STEAMCONTROLLER_CONFIG_SEND_BATTERY_STATUS|STEAMCONTROLLER_CONFIG_SEND_GYRO);
-        }
+        if (res)
+          HandleEvent(pDevice, &event);
 
-        if (res == 1) {
-          // just print the value of the left touch pad / stick position
-          fprintf(stderr, "% 6hd % 6hd\n", event.update.leftXY.x, event.update.leftXY.y);  
-        }
+        if (res == STEAMCONTROLLER_EVENT_CONNECTION && event.connection.details == STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED)
+          break;
       }
 
       SteamController_Close(pDevice);
@@ -33,3 +83,5 @@ int main() {
   }
   return 0;
 }
+
+#endif
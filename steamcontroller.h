@@ -54,6 +54,22 @@ typedef struct { int16_t x, y, z; }       SteamControllerVector;
 #define STEAMCONTROLLER_FLAG_PAD_STICK     (0x80 << 16)  /**< If set, STEAM_CONTROLLER_BUTTON_LFINGER to determines whether leftXY is 
                                                                pad position or stick position. */
 
+#define STEAMCONTROLLER_FIELD_BUTTONS           (1<<0)
+#define STEAMCONTROLLER_FIELD_LEFT_TRIGGER      (1<<1)
+#define STEAMCONTROLLER_FIELD_RIGHT_TRIGGER     (1<<2)
+#define STEAMCONTROLLER_FIELD_LEFT_PAD          (1<<3)
+#define STEAMCONTROLLER_FIELD_RIGHT_PAD         (1<<4)
+#define STEAMCONTROLLER_FIELD_STICK             (1<<5)
+#define STEAMCONTROLLER_FIELD_ORIENTATION       (1<<6)
+#define STEAMCONTROLLER_FIELD_ACCELERATION      (1<<7)
+#define STEAMCONTROLLER_FIELD_ANGULAR_VELOCITY  (1<<8)
+#define STEAMCONTROLLER_FIELD_BATTERY           (1<<9)
+#define STEAMCONTROLLER_FIELD_CONNECTION        (1<<10)   /**< isConnected or hasPairingRequest. */
+
+#define STEAMCONTROLLER_FIELDS_INPUT            (STEAMCONTROLLER_FIELD_BUTTONS | STEAMCONTROLLER_FIELD_LEFT_TRIGGER | STEAMCONTROLLER_FIELD_RIGHT_TRIGGER | \
+                                                 STEAMCONTROLLER_FIELD_LEFT_PAD | STEAMCONTROLLER_FIELD_RIGHT_PAD | STEAMCONTROLLER_FIELD_STICK)
+#define STEAMCONTROLLER_FIELDS_MOTION           (STEAMCONTROLLER_FIELD_ORIENTATION | STEAMCONTROLLER_FIELD_ACCELERATION | STEAMCONTROLLER_FIELD_ANGULAR_VELOCITY)
+
 /**
  * Current state of a controller including buttons and axes.
  */
@@ -61,6 +77,9 @@ typedef struct {
   uint32_t                  timeStamp;      /**< Timestamp of latest update. */
 
   uint32_t                  activeButtons;  /**< Actively pressed buttons and flags. */
+  uint32_t                  pressedButtons; /**< Buttons that went down with the latest event. */
+  uint32_t                  releasedButtons;/**< Buttons that went up with the latest event. */
+  uint32_t                  changedFields;  /**< STEAMCONTROLLER_FIELD_* bits of the fields the latest event changed. */
 
   uint8_t                   leftTrigger;    /**< Left analog trigger value. */
   uint8_t                   rightTrigger;   /**< Right analog trigger value. */
@@ -75,7 +94,8 @@ typedef struct {
    * When rotating the controller around one axis 360 degrees, the value for that
    * axis becomes negative. One further rotation and it becomes positive againg.
    * This is probably the imaginary parts of a unit quaternion representing the
-   * controller orientation in space.
+   * controller orientation in space. SteamController_FusionUpdate rebuilds the
+   * full quaternion on that assumption.
    * @todo Figure this out.
    */
   SteamControllerVector     orientation;
@@ -88,7 +108,8 @@ typedef struct {
   SteamControllerVector     acceleration;
 
   /**
-   * Data from the gyroscopes. Axes seem to be the same as for acceleration. TODO: figure out scale and units
+   * Data from the gyroscopes. Axes seem to be the same as for acceleration. TODO: figure out scale and units.
+   * SteamController_CalibrationUpdate assumes STEAMCONTROLLER_ANGULAR_VELOCITY_PER_DPS and removes the bias.
    */
   SteamControllerVector     angularVelocity;
 
@@ -157,6 +178,125 @@ SCAPI void                    SteamController_Close(SteamControllerDevice *pDevi
 SCAPI bool                    SteamController_IsWirelessDongle(const SteamControllerDevice *pDevice);
 SCAPI bool                    SteamController_TurnOff(const SteamControllerDevice *pDevice);
 
+// ----------------------------------------------------------------------------------------------
+// Transports
+
+#define   STEAMCONTROLLER_FEATURE_REPORT_SIZE   65    /**< Size of a feature report including the leading report page byte. */
+#define   STEAMCONTROLLER_INPUT_REPORT_SIZE     65    /**< Maximum size of an input report including an optional leading zero byte. */
+
+/**
+ * Backend used by a device to talk to the hardware.
+ * Every function gets the context pointer that was passed to SteamController_OpenTransport.
+ */
+typedef struct {
+  /** Read one pending input report without blocking. Returns its length or 0 if none is pending. */
+  uint8_t (*readRaw)(void *pContext, uint8_t *pBuffer, uint8_t maxLen);
+
+  /** Send a feature report of STEAMCONTROLLER_FEATURE_REPORT_SIZE bytes. */
+  bool    (*setFeatureReport)(void *pContext, uint8_t *pReport);
+
+  /** Send a feature report and replace it with the response carrying the same feature id. */
+  bool    (*getFeatureReport)(void *pContext, uint8_t *pReport);
+
+  /** Release the context when the device is closed. May be NULL. */
+  void    (*close)(void *pContext);
+
+  /** Return a file descriptor that becomes readable when input is pending, or -1. May be NULL. */
+  int     (*getPollFd)(void *pContext);
+
+  /** Return whether readRaw would return a report right now. May be NULL, then the poll descriptor is checked. */
+  bool    (*hasPendingInput)(void *pContext);
+} SteamControllerTransport;
+
+SCAPI SteamControllerDevice * SteamController_OpenTransport(const SteamControllerTransport *pTransport, void *pContext, bool isWireless);
+
+/**
+ * In-memory transport that plays back scripted input reports and records all
+ * outgoing feature reports. Not thread safe, use it from a single thread.
+ */
+typedef struct SteamControllerLoopback SteamControllerLoopback;
+
+SCAPI SteamControllerLoopback * SteamController_CreateLoopback();
+SCAPI void                      SteamController_DestroyLoopback(SteamControllerLoopback *pLoopback);
+SCAPI SteamControllerDevice *   SteamController_OpenLoopback(SteamControllerLoopback *pLoopback, bool isWireless);
+SCAPI SteamControllerDevice *   SteamController_OpenLoopbackEx(SteamControllerLoopback *pLoopback, bool isWireless, unsigned flags);
+SCAPI void                      SteamController_LoopbackSetIdentity(SteamControllerLoopback *pLoopback, const char *pIdentity);
+
+SCAPI bool                      SteamController_LoopbackQueueReport(SteamControllerLoopback *pLoopback, const uint8_t *pReport, uint8_t len);
+SCAPI void                      SteamController_LoopbackSetLooping(SteamControllerLoopback *pLoopback, bool isLooping);
+SCAPI void                      SteamController_LoopbackSetFeatureResponse(SteamControllerLoopback *pLoopback, const uint8_t *pReport);
+
+SCAPI size_t                    SteamController_LoopbackGetFeatureReportCount(const SteamControllerLoopback *pLoopback);
+SCAPI const uint8_t *           SteamController_LoopbackGetFeatureReport(const SteamControllerLoopback *pLoopback, size_t index);
+SCAPI void                      SteamController_LoopbackClearFeatureReports(SteamControllerLoopback *pLoopback);
+
+// ----------------------------------------------------------------------------------------------
+// Fast open
+
+#define   STEAMCONTROLLER_OPEN_LAZY           1     /**< Only send what is needed to use the controller, query attributes on demand. */
+
+#define   STEAMCONTROLLER_CHIPID_SIZE         32
+
+/** Firmware and hardware information reported by a device. */
+typedef struct {
+  uint32_t                  productId;
+  uint32_t                  bootloaderRevision;   /**< Build time as a unix timestamp. */
+  uint32_t                  firmwareRevision;     /**< Build time as a unix timestamp. */
+  uint32_t                  radioRevision;        /**< Build time as a unix timestamp. */
+  uint32_t                  boardRevision;
+  uint8_t                   chipId[STEAMCONTROLLER_CHIPID_SIZE];
+  uint8_t                   chipIdLength;
+  bool                      isValid;
+} SteamControllerAttributes;
+
+SCAPI SteamControllerDevice *   SteamController_OpenEx(const SteamControllerDeviceEnum *pEnum, unsigned flags);
+SCAPI size_t                    SteamController_OpenAll(SteamControllerDevice **ppDevices, size_t maxDevices, unsigned flags);
+SCAPI bool                      SteamController_GetAttributes(const SteamControllerDevice *pDevice, SteamControllerAttributes *pAttributes);
+
+// ----------------------------------------------------------------------------------------------
+// Capture and replay
+
+/**
+ * Capture files start with a header followed by fixed size records, all in
+ * host byte order. Records can be read in place after mapping the file.
+ */
+#define   STEAMCONTROLLER_RECORD_MAGIC          "SCREC\0\0"  /**< Eight bytes including the terminator. */
+#define   STEAMCONTROLLER_RECORD_VERSION        1
+
+#define   STEAMCONTROLLER_RECORD_INPUT          1     /**< Raw input report read from the device. */
+#define   STEAMCONTROLLER_RECORD_FEATURE_SET    2     /**< Feature report sent to the device. */
+#define   STEAMCONTROLLER_RECORD_FEATURE_GET    3     /**< Feature report received from the device. */
+#define   STEAMCONTROLLER_RECORD_DEVICE_INFO    4     /**< First data byte is 1 for wireless dongles. */
+
+typedef struct {
+  char                      magic[8];
+  uint32_t                  version;
+  uint32_t                  recordSize;       /**< Size of each record, readers must use this as the stride. */
+  uint64_t                  startHostTime;    /**< Host time at which the capture was started. */
+  uint8_t                   reserved[8];
+} SteamControllerRecordHeader;
+
+typedef struct {
+  uint64_t                  hostTime;         /**< See SteamController_GetHostTime. */
+  uint32_t                  deviceId;         /**< Id given to SteamController_SetRecorder. */
+  uint8_t                   kind;             /**< One of STEAMCONTROLLER_RECORD_*. */
+  uint8_t                   length;           /**< Number of valid bytes in data. */
+  uint8_t                   reserved[2];
+  uint8_t                   data[STEAMCONTROLLER_INPUT_REPORT_SIZE];
+  uint8_t                   padding[15];
+} SteamControllerRecord;
+
+typedef struct SteamControllerRecorder SteamControllerRecorder;
+
+SCAPI SteamControllerRecorder * SteamController_CreateRecorder(const char *pPath);
+SCAPI void                      SteamController_DestroyRecorder(SteamControllerRecorder *pRecorder);
+SCAPI void                      SteamController_FlushRecorder(SteamControllerRecorder *pRecorder);
+SCAPI void                      SteamController_SetRecorder(SteamControllerDevice *pDevice, SteamControllerRecorder *pRecorder, uint32_t deviceId);
+
+#if __linux__
+SCAPI SteamControllerDevice *   SteamController_OpenReplay(const char *pPath, uint32_t deviceId, bool isRealTime);
+#endif
+
 // ----------------------------------------------------------------------------------------------
 // Wireless dongle control
 
@@ -187,6 +327,20 @@ bool      SCAPI SteamController_CommitPairing(const SteamControllerDevice *pDevi
 
 #define   STEAMCONTROLLER_TIMEOUT_NEVER                           0x2784  /**< Seems to be a magic value. Didn't test it, haven't got all eternity... */ 
 
+/**
+ * A set of setting registers and values to send to a device in one go.
+ * See SteamController_CommitSettings.
+ */
+typedef struct {
+  uint16_t                  values[256];
+  uint8_t                   isSet[32];      /**< Bitmap of the settings in values that are part of the transaction. */
+} SteamControllerSettings;
+
+void      SCAPI SteamController_BeginSettings(SteamControllerSettings *pSettings);
+void      SCAPI SteamController_SetSetting(SteamControllerSettings *pSettings, uint8_t setting, uint16_t value);
+void      SCAPI SteamController_SetConfigureSettings(SteamControllerSettings *pSettings, unsigned configFlags);
+int       SCAPI SteamController_CommitSettings(const SteamControllerDevice *pDevice, const SteamControllerSettings *pSettings);
+
 bool      SCAPI SteamController_Configure(const SteamControllerDevice *pDevice, unsigned configFlags);
 bool      SCAPI SteamController_SetHomeButtonBrightness(const SteamControllerDevice *pDevice, uint8_t brightness);
 bool      SCAPI SteamController_SetTimeOut(const SteamControllerDevice *pDevice, uint16_t timeout);
@@ -195,14 +349,557 @@ bool      SCAPI SteamController_SetTimeOut(const SteamControllerDevice *pDevice,
 // State
 
 uint8_t   SCAPI SteamController_ReadEvent(const SteamControllerDevice *pDevice, SteamControllerEvent *pEvent);
+size_t    SCAPI SteamController_ReadEvents(const SteamControllerDevice *pDevice, SteamControllerEvent *pEvents, size_t maxEvents, bool *pMorePending);
+
+/** An event together with the host time at which its report was read. */
+typedef struct {
+  uint64_t                  hostTime;   /**< Monotonic host time in nanoseconds, see SteamController_GetHostTime. */
+  SteamControllerEvent      event;
+} SteamControllerTimedEvent;
+
+uint64_t  SCAPI SteamController_GetHostTime();
+
 void      SCAPI SteamController_UpdateState(SteamControllerState *pState, const SteamControllerEvent *pEvent);
 
+/** What changed while reading a number of events. */
+typedef struct {
+  uint32_t                  changedFields;    /**< STEAMCONTROLLER_FIELD_* bits of all fields that changed. */
+  uint32_t                  pressedButtons;   /**< Buttons that went down. */
+  uint32_t                  releasedButtons;  /**< Buttons that went up. A button can be both pressed and released. */
+  size_t                    eventCount;       /**< Number of events read. */
+  bool                      morePending;      /**< The device has more reports than one call reads. */
+} SteamControllerChanges;
+
+#define   STEAMCONTROLLER_READ_CHANGES_MAX_EVENTS   256   /**< Reports read by one SteamController_ReadChanges call at most. */
+
+bool      SCAPI SteamController_ReadChanges(const SteamControllerDevice *pDevice, SteamControllerState *pState, uint32_t fieldMask, SteamControllerChanges *pChanges);
+
+#define   STEAMCONTROLLER_RAW_REPORT_SIZE     64    /**< Size of an input report as delivered by the device. */
+
+/**
+ * Fields of many update events, one array per field. Used to decode captured
+ * reports in bulk. Each array must have room for the number of reports decoded.
+ */
+typedef struct {
+  uint8_t                  *eventType;          /**< Event type of each report. Other fields are only valid for updates. */
+  uint32_t                 *timeStamp;
+  uint32_t                 *buttons;
+  uint8_t                  *leftTrigger;
+  uint8_t                  *rightTrigger;
+  int16_t                  *leftX;
+  int16_t                  *leftY;
+  int16_t                  *rightX;
+  int16_t                  *rightY;
+  int16_t                  *accelerationX;
+  int16_t                  *accelerationY;
+  int16_t                  *accelerationZ;
+  int16_t                  *angularVelocityX;
+  int16_t                  *angularVelocityY;
+  int16_t                  *angularVelocityZ;
+  int16_t                  *orientationX;
+  int16_t                  *orientationY;
+  int16_t                  *orientationZ;
+} SteamControllerUpdateBatch;
+
+void      SCAPI SteamController_DecodeUpdateBatch(const uint8_t *pReports, size_t count, SteamControllerUpdateBatch *pBatch);
+
+void      SCAPI SteamController_UpdateStateSnapshot(SteamControllerDevice *pDevice, const SteamControllerEvent *pEvent);
+void      SCAPI SteamController_GetStateSnapshot(const SteamControllerDevice *pDevice, SteamControllerState *pState);
+
+/**
+ * State of many controllers, one array per field. Controllers are grouped in
+ * writer regions that are padded to whole cache lines, so threads updating
+ * different regions don't share cache lines.
+ */
+typedef struct SteamControllerStateTable SteamControllerStateTable;
+
+/**
+ * Field arrays of a state table. Each array holds length entries, use
+ * SteamController_StateTableSlot to find the entry of a controller. Padding
+ * entries are always zero.
+ */
+typedef struct {
+  size_t                    length;
+  uint32_t                 *activeButtons;
+  uint8_t                  *leftTrigger;
+  uint8_t                  *rightTrigger;
+  int16_t                  *leftPadX;
+  int16_t                  *leftPadY;
+  int16_t                  *rightPadX;
+  int16_t                  *rightPadY;
+  int16_t                  *stickX;
+  int16_t                  *stickY;
+  int16_t                  *accelerationX;
+  int16_t                  *accelerationY;
+  int16_t                  *accelerationZ;
+  int16_t                  *angularVelocityX;
+  int16_t                  *angularVelocityY;
+  int16_t                  *angularVelocityZ;
+  int16_t                  *orientationX;
+  int16_t                  *orientationY;
+  int16_t                  *orientationZ;
+  uint32_t                 *timeStamp;
+  uint16_t                 *batteryVoltage;
+  uint8_t                  *isConnected;
+  uint8_t                  *hasPairingRequest;
+} SteamControllerStateArrays;
+
+SCAPI SteamControllerStateTable * SteamController_CreateStateTable(size_t controllersPerRegion, size_t regionCount);
+SCAPI void                        SteamController_DestroyStateTable(SteamControllerStateTable *pTable);
+SCAPI void                        SteamController_StateTableGetArrays(const SteamControllerStateTable *pTable, SteamControllerStateArrays *pArrays);
+SCAPI size_t                      SteamController_StateTableSlot(const SteamControllerStateTable *pTable, size_t controller);
+SCAPI void                        SteamController_StateTableUpdate(SteamControllerStateTable *pTable, const size_t *pControllers, const SteamControllerEvent *pEvents, size_t count);
+SCAPI void                        SteamController_StateTableGetState(const SteamControllerStateTable *pTable, size_t controller, SteamControllerState *pState);
+SCAPI size_t                      SteamController_StateTableFindButtons(const SteamControllerStateTable *pTable, uint32_t buttons, size_t *pControllers, size_t maxControllers);
+SCAPI uint32_t                    SteamController_StateTableMaxStickMagnitude(const SteamControllerStateTable *pTable, size_t *pController);
+
+// ----------------------------------------------------------------------------------------------
+// Input filtering
+
+#define   STEAMCONTROLLER_FILTER_STICK          0
+#define   STEAMCONTROLLER_FILTER_LEFT_PAD       1
+#define   STEAMCONTROLLER_FILTER_RIGHT_PAD      2
+#define   STEAMCONTROLLER_FILTER_LEFT_TRIGGER   3
+#define   STEAMCONTROLLER_FILTER_RIGHT_TRIGGER  4
+#define   STEAMCONTROLLER_FILTER_AXIS_COUNT     5
+
+#define   STEAMCONTROLLER_FILTER_CURVE_SIZE     65    /**< Points of a response curve, evenly spaced from 0 to 1. */
+
+/**
+ * Filter settings of a stick, pad or trigger. Distances are fractions of the
+ * full range, for pairs they apply to the distance from the center.
+ * Processing order is smoothing, axial deadzone, radial deadzone, curve.
+ */
+typedef struct {
+  float                     innerDeadzone;    /**< Output is 0 up to here. */
+  float                     outerDeadzone;    /**< Output is full from here on, 1 for none. */
+  float                     axialDeadzone;    /**< Removed from each axis of a pair separately, against drift along one axis. */
+  float                     minCutoff;        /**< One Euro filter cutoff frequency at rest in Hz, 0 to disable smoothing. */
+  float                     beta;             /**< One Euro filter cutoff increase with speed, higher reduces lag. */
+  float                     curve[STEAMCONTROLLER_FILTER_CURVE_SIZE];  /**< Response curve, output from 0 to 1. */
+} SteamControllerAxisFilter;
+
+/**
+ * Filter chain for all axes of one controller. Owned by the caller and never
+ * allocates. Initialize with SteamController_InitFilter, then adjust the settings.
+ */
+typedef struct {
+  SteamControllerAxisFilter axes[STEAMCONTROLLER_FILTER_AXIS_COUNT];
+  float                     dpadHysteresis;   /**< Cosine of the angle from the current DPAD direction beyond which it changes. Set with SteamController_SetDpadHysteresis. */
+
+  float                     value[STEAMCONTROLLER_FILTER_AXIS_COUNT][2];        /**< Smoothed values. */
+  float                     derivative[STEAMCONTROLLER_FILTER_AXIS_COUNT][2];   /**< Smoothed rates of change. */
+  bool                      hasValue[STEAMCONTROLLER_FILTER_AXIS_COUNT];
+  uint32_t                  dpadButtons;      /**< DPAD bits currently reported. */
+} SteamControllerFilter;
+
+void      SCAPI SteamController_InitFilter(SteamControllerFilter *pFilter);
+void      SCAPI SteamController_SetFilterCurve(SteamControllerFilter *pFilter, unsigned axis, float exponent);
+void      SCAPI SteamController_SetDpadHysteresis(SteamControllerFilter *pFilter, float degrees);
+void      SCAPI SteamController_UpdateFilteredState(SteamControllerFilter *pFilter, SteamControllerState *pState, const SteamControllerEvent *pEvent, float deltaTime);
+void      SCAPI SteamController_FilterUpdateBatch(SteamControllerFilter *pFilter, SteamControllerUpdateBatch *pBatch, size_t count, float deltaTime);
+
+// ----------------------------------------------------------------------------------------------
+// Input remapping
+
+#define   STEAMCONTROLLER_REMAP_LAYERS        4     /**< Layers selected by up to two layer buttons. */
+#define   STEAMCONTROLLER_REMAP_MAX_CHORDS    16
+#define   STEAMCONTROLLER_REMAP_MAX_ACTIONS   64    /**< Actions are numbered 0 to 63. */
+#define   STEAMCONTROLLER_REMAP_NO_ACTION     0xff
+
+/** Pad directions, in the order of the STEAMCONTROLLER_BUTTON_DPAD_* bits. */
+#define   STEAMCONTROLLER_REMAP_UP            0
+#define   STEAMCONTROLLER_REMAP_RIGHT         1
+#define   STEAMCONTROLLER_REMAP_LEFT          2
+#define   STEAMCONTROLLER_REMAP_DOWN          3
+
+/** Buttons that trigger an action when all of them are held, instead of their own actions. */
+typedef struct {
+  uint32_t                  buttons;
+  uint8_t                   layer;
+  uint8_t                   action;
+} SteamControllerRemapChord;
+
+/**
+ * What buttons and pads do. Initialize with SteamController_InitRemapProfile,
+ * then fill in what is needed and compile it with SteamController_CompileRemapProfile.
+ */
+typedef struct {
+  uint32_t                  layerButtons[2];  /**< Holding the first adds 1 to the layer, the second 2. Usually the grips. */
+  uint8_t                   buttonActions[STEAMCONTROLLER_REMAP_LAYERS][24];  /**< Action of each button, by bit number. */
+
+  /**
+   * Left and right pad work as four way DPADs, with the quarters of
+   * STEAMCONTROLLER_BUTTON_DPAD_*, while all of these buttons are held.
+   * Use the finger bits for touch, or the pad click. 0 turns a pad off.
+   */
+  uint32_t                  padButtons[2];
+  int16_t                   padDeadzone;      /**< Distance from the center below which a pad is in no quarter. */
+  uint8_t                   padActions[STEAMCONTROLLER_REMAP_LAYERS][2][4];  /**< Action of each quarter, by STEAMCONTROLLER_REMAP_* direction. */
+
+  SteamControllerRemapChord chords[STEAMCONTROLLER_REMAP_MAX_CHORDS];
+  size_t                    chordCount;
+} SteamControllerRemapProfile;
+
+/** A profile compiled into lookup tables. */
+typedef struct SteamControllerRemapTable SteamControllerRemapTable;
+
+/** Holds the tables in use, which can be swapped while remapping. */
+typedef struct SteamControllerRemap SteamControllerRemap;
+
+SCAPI void                        SteamController_InitRemapProfile(SteamControllerRemapProfile *pProfile);
+SCAPI SteamControllerRemapTable * SteamController_CompileRemapProfile(const SteamControllerRemapProfile *pProfile);
+SCAPI void                        SteamController_DestroyRemapTable(SteamControllerRemapTable *pTable);
+SCAPI uint64_t                    SteamController_RemapTableState(const SteamControllerRemapTable *pTable, const SteamControllerState *pState);
+
+SCAPI SteamControllerRemap *      SteamController_CreateRemap(SteamControllerRemapTable *pTable);
+SCAPI void                        SteamController_DestroyRemap(SteamControllerRemap *pRemap);
+SCAPI SteamControllerRemapTable * SteamController_SwapRemapTable(SteamControllerRemap *pRemap, SteamControllerRemapTable *pTable);
+SCAPI uint64_t                    SteamController_RemapState(const SteamControllerRemap *pRemap, const SteamControllerState *pState);
+
+// ----------------------------------------------------------------------------------------------
+// Sensor fusion
+
+/** Rotation as a unit quaternion. */
+typedef struct { float w, x, y, z; }      SteamControllerQuaternion;
+
+#define   STEAMCONTROLLER_ACCELERATION_PER_G          16384.0f              /**< Raw acceleration of 1g. */
+#define   STEAMCONTROLLER_ANGULAR_VELOCITY_PER_DPS    (32768.0f / 2000.0f)  /**< Raw angular velocity of 1 degree per second, assuming a range of +-2000 dps. */
+
+#define   STEAMCONTROLLER_FUSION_AUTO       0   /**< Use the orientation sent by the device once there is one, integrate the sensors until then. */
+#define   STEAMCONTROLLER_FUSION_DEVICE     1   /**< Only use the orientation sent by the device (STEAMCONTROLLER_CONFIG_SEND_ORIENTATION). */
+#define   STEAMCONTROLLER_FUSION_MADGWICK   2   /**< Always integrate angular velocity and acceleration with a Madgwick filter. */
+
+#define   STEAMCONTROLLER_FUSION_DEFAULT_BETA   0.041f  /**< Madgwick filter gain, higher trusts the accelerometer more. */
+
+/**
+ * Orientation estimate of one controller. Owned by the caller, no allocations
+ * are involved. Initialize with SteamController_InitFusion.
+ */
+typedef struct {
+  SteamControllerQuaternion orientation;          /**< Current estimate. */
+  unsigned                  mode;                 /**< One of STEAMCONTROLLER_FUSION_*. */
+  float                     beta;                 /**< Madgwick filter gain. */
+  uint32_t                  updateCount;          /**< Updates since initialization. */
+  bool                      hasDeviceOrientation; /**< The device sent an orientation. */
+} SteamControllerFusion;
+
+void      SCAPI SteamController_InitFusion(SteamControllerFusion *pFusion, unsigned mode, float beta);
+void      SCAPI SteamController_FusionUpdate(SteamControllerFusion *pFusion, const SteamControllerUpdateEvent *pUpdate, float deltaTime);
+void      SCAPI SteamController_FusionUpdateBatch(SteamControllerFusion *pFusion, const SteamControllerUpdateBatch *pBatch, size_t count, float deltaTime, SteamControllerQuaternion *pOrientations);
+
+// ----------------------------------------------------------------------------------------------
+// Calibrated motion
+
+#define   STEAMCONTROLLER_STANDARD_GRAVITY      9.80665f    /**< m/s^2 per g. */
+
+/**
+ * Running gyro bias estimate of one controller. Owned by the caller, updates
+ * take constant time. Initialize with SteamController_InitCalibration.
+ */
+typedef struct {
+  float                     gyroBias[3];      /**< Raw angular velocity measured while the controller is still. */
+  uint32_t                  biasSamples;      /**< Still samples that went into the bias, saturates. */
+
+  float                     gyroMean[3];      /**< Recent mean of the raw angular velocity. */
+  float                     gyroVariance;     /**< Recent variance of the raw angular velocity, summed over the axes. */
+  uint32_t                  stillCount;       /**< Consecutive updates the controller was still. */
+} SteamControllerCalibration;
+
+/** Motion of a controller in SI units. */
+typedef struct {
+  float                     acceleration[3];    /**< m/s^2, same axes as SteamControllerState.acceleration. */
+  float                     angularVelocity[3]; /**< rad/s, with the bias removed. */
+  bool                      isStill;
+} SteamControllerMotion;
+
+/** Motion of many updates, one array per field. Each array must have room for the number of updates converted. */
+typedef struct {
+  float                    *accelerationX;
+  float                    *accelerationY;
+  float                    *accelerationZ;
+  float                    *angularVelocityX;
+  float                    *angularVelocityY;
+  float                    *angularVelocityZ;
+} SteamControllerMotionBatch;
+
+#define   STEAMCONTROLLER_CALIBRATION_MAGIC     "SCCAL\0\0"  /**< Eight bytes including the terminator. */
+#define   STEAMCONTROLLER_CALIBRATION_VERSION   1
+
+void      SCAPI SteamController_InitCalibration(SteamControllerCalibration *pCalibration);
+void      SCAPI SteamController_CalibrationUpdate(SteamControllerCalibration *pCalibration, const SteamControllerUpdateEvent *pUpdate, SteamControllerMotion *pMotion);
+void      SCAPI SteamController_ConvertMotionBatch(const SteamControllerCalibration *pCalibration, const SteamControllerUpdateBatch *pBatch, size_t count, SteamControllerMotionBatch *pMotion);
+bool      SCAPI SteamController_SaveCalibration(const SteamControllerCalibration *pCalibration, const char *pPath);
+bool      SCAPI SteamController_LoadCalibration(SteamControllerCalibration *pCalibration, const char *pPath);
+
+// ----------------------------------------------------------------------------------------------
+// Latency tracking
+
+/**
+ * Delivery is only measured where a report waits between being read and being
+ * fetched: events from SteamController_DrainEvents and states from
+ * SteamController_GetStateSnapshot. SteamController_ReadEvent returns the
+ * report it has just read and SteamController_UpdateState has no device, so
+ * neither records a delivery latency.
+ */
+#define   STEAMCONTROLLER_LATENCY_READ          0   /**< Time spent reading a report from the transport. */
+#define   STEAMCONTROLLER_LATENCY_DECODE        1   /**< Time spent decoding a report. */
+#define   STEAMCONTROLLER_LATENCY_DELIVERY      2   /**< From reading a report to its event or state being fetched by the application. */
+#define   STEAMCONTROLLER_LATENCY_STAGE_COUNT   3
+
+/** Latency statistics of one stage, in nanoseconds. */
+typedef struct {
+  uint64_t                  count;
+  uint64_t                  p50;
+  uint64_t                  p90;
+  uint64_t                  p99;
+  uint64_t                  max;
+  uint64_t                  mean;
+} SteamControllerLatencyStats;
+
+bool      SCAPI SteamController_EnableLatencyTracking(SteamControllerDevice *pDevice, bool enable);
+void      SCAPI SteamController_ResetLatencyStats(SteamControllerDevice *pDevice);
+bool      SCAPI SteamController_GetLatencyStats(const SteamControllerDevice *pDevice, unsigned stage, SteamControllerLatencyStats *pStats);
+
+// ----------------------------------------------------------------------------------------------
+// Link quality
+
+#define   STEAMCONTROLLER_LINK_LOW_RATE       (1 << 0)    /**< Fewer reports per second than the limit. */
+#define   STEAMCONTROLLER_LINK_HIGH_LOSS      (1 << 1)    /**< More reports lost than the limit. */
+#define   STEAMCONTROLLER_LINK_HIGH_JITTER    (1 << 2)    /**< Arrival times vary more than the limit. */
+
+/**
+ * Quality of the link to a controller, derived from the counter in update
+ * reports. Mostly interesting for wireless controllers. Averages follow the
+ * last few dozen reports.
+ */
+typedef struct {
+  uint64_t                  receivedCount;    /**< Update reports received. */
+  uint64_t                  lostCount;        /**< Reports missing from the counter sequence, less those that arrived late. */
+  uint32_t                  gapCount;         /**< Number of times one or more reports were missing. */
+  uint32_t                  reorderCount;     /**< Reports that arrived after a newer one, filling a gap. */
+  uint32_t                  duplicateCount;   /**< Reports with the counter of one received before. */
+  uint32_t                  restartCount;     /**< Counter jumps too large to be loss, e.g. the controller restarted. */
+  float                     reportRate;       /**< Reports received per second. */
+  float                     lossRatio;        /**< Fraction of reports lost. */
+  float                     jitter;           /**< Interarrival jitter in nanoseconds, as in RFC 3550. */
+  uint32_t                  degraded;         /**< STEAMCONTROLLER_LINK_* bits of limits currently exceeded. */
+} SteamControllerLinkStats;
+
+/** Limits for SteamController_SetLinkThresholds. A limit of 0 is not checked. */
+typedef struct {
+  float                     minReportRate;    /**< Reports per second. */
+  float                     maxLossRatio;     /**< Fraction of reports lost. */
+  float                     maxJitter;        /**< Nanoseconds. */
+} SteamControllerLinkThresholds;
+
+typedef void (*SteamControllerLinkCallback)(const SteamControllerDevice *pDevice, const SteamControllerLinkStats *pStats, void *pUserData);
+
+bool      SCAPI SteamController_EnableLinkStats(SteamControllerDevice *pDevice, bool enable);
+bool      SCAPI SteamController_SetLinkThresholds(SteamControllerDevice *pDevice, const SteamControllerLinkThresholds *pThresholds, SteamControllerLinkCallback callback, void *pUserData);
+bool      SCAPI SteamController_GetLinkStats(const SteamControllerDevice *pDevice, SteamControllerLinkStats *pStats);
+
+// ----------------------------------------------------------------------------------------------
+// Background reading (Linux only)
+
+#if __linux__
+
+#define   STEAMCONTROLLER_EVENT_RING_SIZE     256   /**< Number of events buffered per device by the reader thread. Must be a power of two. */
+
+bool      SCAPI SteamController_StartReaderThread(SteamControllerDevice *pDevice);
+void      SCAPI SteamController_StopReaderThread(SteamControllerDevice *pDevice);
+size_t    SCAPI SteamController_DrainEvents(SteamControllerDevice *pDevice, SteamControllerTimedEvent *pEvents, size_t maxEvents, uint32_t *pOverflowCount);
+
+// ----------------------------------------------------------------------------------------------
+// Event loop (Linux only)
+
+/**
+ * Waits on many devices at once using a single epoll set.
+ */
+typedef struct SteamControllerPoller SteamControllerPoller;
+
+/**
+ * Called for every device that has input pending. 
+ * If isHangup is set, the device was unplugged and has already been removed from the poller.
+ */
+typedef void (*SteamControllerPollerCallback)(SteamControllerDevice *pDevice, bool isHangup, void *pUserData);
+
+SCAPI SteamControllerPoller * SteamController_CreatePoller();
+SCAPI void                    SteamController_DestroyPoller(SteamControllerPoller *pPoller);
+SCAPI bool                    SteamController_PollerAdd(SteamControllerPoller *pPoller, SteamControllerDevice *pDevice, void *pUserData);
+SCAPI bool                    SteamController_PollerRemove(SteamControllerPoller *pPoller, SteamControllerDevice *pDevice);
+SCAPI int                     SteamController_PollerWait(SteamControllerPoller *pPoller, int timeoutMs, SteamControllerPollerCallback callback);
+
+/**
+ * Reads many devices with io_uring, keeping one read in flight per device.
+ * Falls back to poll() and read() where io_uring is not available.
+ */
+typedef struct SteamControllerUring SteamControllerUring;
+
+#define   STEAMCONTROLLER_URING_MAX_SOURCES   64    /**< Maximum number of devices and files per reader. */
+
+/**
+ * Called for every decoded event. pEvent is NULL once a source has ended.
+ * pDevice is NULL for sources added with SteamController_UringAddFile.
+ */
+typedef void (*SteamControllerUringCallback)(SteamControllerDevice *pDevice, const SteamControllerTimedEvent *pEvent, void *pUserData);
+
+SCAPI SteamControllerUring *  SteamController_CreateUring(bool forceFallback);
+SCAPI void                    SteamController_DestroyUring(SteamControllerUring *pUring);
+SCAPI bool                    SteamController_UringIsAvailable(const SteamControllerUring *pUring);
+SCAPI bool                    SteamController_UringAddDevice(SteamControllerUring *pUring, SteamControllerDevice *pDevice, void *pUserData);
+SCAPI bool                    SteamController_UringAddFile(SteamControllerUring *pUring, const char *pPath, void *pUserData);
+SCAPI int                     SteamController_UringWait(SteamControllerUring *pUring, int timeoutMs, SteamControllerUringCallback callback);
+
+// ----------------------------------------------------------------------------------------------
+// Shared memory publishing (Linux only)
+
+/**
+ * Publishes the state and recent events of controllers in a POSIX shared
+ * memory region, so processes that don't own the devices can read them.
+ */
+typedef struct SteamControllerShmServer SteamControllerShmServer;
+
+/** Read only view of a region published by a server. */
+typedef struct SteamControllerShmClient SteamControllerShmClient;
+
+#define   STEAMCONTROLLER_SHM_DEFAULT_NAME      "/steamcontroller"
+#define   STEAMCONTROLLER_SHM_MAX_CONTROLLERS   16    /**< Number of controller slots in a region. */
+#define   STEAMCONTROLLER_SHM_EVENT_RING_SIZE   256   /**< Number of recent events kept per slot. Must be a power of two. */
+
+SCAPI SteamControllerShmServer *  SteamController_CreateShmServer(const char *pName);
+SCAPI void                        SteamController_DestroyShmServer(SteamControllerShmServer *pServer);
+SCAPI int                         SteamController_ShmServerAddDevice(SteamControllerShmServer *pServer, SteamControllerDevice *pDevice);
+SCAPI void                        SteamController_ShmServerRemoveDevice(SteamControllerShmServer *pServer, unsigned slot);
+SCAPI size_t                      SteamController_ShmServerAddAll(SteamControllerShmServer *pServer);
+SCAPI int                         SteamController_ShmServerWait(SteamControllerShmServer *pServer, int timeoutMs);
+SCAPI void                        SteamController_ShmServerPublish(SteamControllerShmServer *pServer, unsigned slot, const SteamControllerTimedEvent *pEvent);
+
+SCAPI SteamControllerShmClient *  SteamController_OpenShmClient(const char *pName);
+SCAPI void                        SteamController_CloseShmClient(SteamControllerShmClient *pClient);
+SCAPI bool                        SteamController_ShmClientGetState(const SteamControllerShmClient *pClient, unsigned slot, SteamControllerState *pState);
+SCAPI size_t                      SteamController_ShmClientReadEvents(SteamControllerShmClient *pClient, unsigned slot, SteamControllerTimedEvent *pEvents, size_t maxEvents, uint32_t *pLostCount);
+
+// ----------------------------------------------------------------------------------------------
+// Virtual gamepad (Linux only)
+
+/** Mirrors a controller as an evdev gamepad through uinput. */
+typedef struct SteamControllerUinput SteamControllerUinput;
+
+#define   STEAMCONTROLLER_UINPUT_MOUSE        1     /**< Also create a mouse, moved with the right pad. */
+
+SCAPI SteamControllerUinput *     SteamController_CreateUinput(const char *pName, unsigned flags);
+SCAPI SteamControllerUinput *     SteamController_CreateUinputSink(int gamepadFd, int mouseFd);
+SCAPI void                        SteamController_DestroyUinput(SteamControllerUinput *pUinput);
+SCAPI bool                        SteamController_UinputWriteState(SteamControllerUinput *pUinput, const SteamControllerState *pState, uint64_t readTime);
+SCAPI void                        SteamController_UinputGetLatency(const SteamControllerUinput *pUinput, SteamControllerLatencyStats *pStats);
+
+// ----------------------------------------------------------------------------------------------
+// Hotplug (Linux only)
+
+/**
+ * Keeps track of the controllers on the system. It is filled by a scan of
+ * sysfs and then kept up to date from kernel uevents, without rescanning.
+ */
+typedef struct SteamControllerRegistry SteamControllerRegistry;
+
+#define   STEAMCONTROLLER_HOTPLUG_ADD         1
+#define   STEAMCONTROLLER_HOTPLUG_REMOVE      2
+
+#define   STEAMCONTROLLER_REGISTRY_NETLINK    1     /**< Listen for uevents passed on by udev. Without it, uevents can only be injected. */
+
+/**
+ * Called when a device appears or disappears. A device keeps its id while the
+ * registry exists, even if it is removed and comes back at the same place.
+ */
+typedef void (*SteamControllerHotplugCallback)(uint32_t deviceId, unsigned action, const char *pDevicePath, void *pUserData);
+
+SCAPI SteamControllerRegistry *   SteamController_CreateRegistry(const char *pSysfsRoot, unsigned flags, SteamControllerHotplugCallback callback, void *pUserData);
+SCAPI void                        SteamController_DestroyRegistry(SteamControllerRegistry *pRegistry);
+SCAPI int                         SteamController_RegistryGetFd(const SteamControllerRegistry *pRegistry);
+SCAPI size_t                      SteamController_RegistryDispatch(SteamControllerRegistry *pRegistry);
+SCAPI bool                        SteamController_RegistryInjectUevent(SteamControllerRegistry *pRegistry, const char *pUevent, size_t len);
+SCAPI size_t                      SteamController_RegistryGetDevices(const SteamControllerRegistry *pRegistry, uint32_t *pDeviceIds, size_t maxDevices);
+SCAPI SteamControllerDevice *     SteamController_RegistryOpen(const SteamControllerRegistry *pRegistry, uint32_t deviceId, unsigned flags);
+
+#endif
+
 // ----------------------------------------------------------------------------------------------
 // Feedback
 
 bool      SCAPI SteamController_TriggerHaptic(const SteamControllerDevice *pDevice, uint16_t motor, uint16_t onTime, uint16_t offTime, uint16_t count);
 void      SCAPI SteamController_PlayMelody(const SteamControllerDevice *pDevice, uint32_t melody);
 
+// ----------------------------------------------------------------------------------------------
+// Command queue (Linux only)
+
+#if __linux__
+
+#define   STEAMCONTROLLER_PRIORITY_HIGH       0     /**< Haptics, anything the user feels immediately. */
+#define   STEAMCONTROLLER_PRIORITY_NORMAL     1     /**< Melodies and other one shot commands. */
+#define   STEAMCONTROLLER_PRIORITY_LOW        2     /**< Settings. */
+#define   STEAMCONTROLLER_PRIORITY_COUNT      3
+
+#define   STEAMCONTROLLER_COMMAND_QUEUE_SIZE  64    /**< Commands queued per device and priority. Must be a power of two. */
+
+/**
+ * Called on the command thread of a device once a queued command has completed.
+ * pResponse holds the response of the device for requests that succeeded, it is NULL otherwise.
+ */
+typedef void (*SteamControllerCommandCallback)(SteamControllerDevice *pDevice, bool success, const uint8_t *pResponse, void *pUserData);
+
+bool      SCAPI SteamController_SubmitFeatureReport(SteamControllerDevice *pDevice, const uint8_t *pReport, bool isRequest, unsigned priority, SteamControllerCommandCallback callback, void *pUserData);
+bool      SCAPI SteamController_TriggerHapticAsync(SteamControllerDevice *pDevice, uint16_t motor, uint16_t onTime, uint16_t offTime, uint16_t count, SteamControllerCommandCallback callback, void *pUserData);
+bool      SCAPI SteamController_PlayMelodyAsync(SteamControllerDevice *pDevice, uint32_t melodyId, SteamControllerCommandCallback callback, void *pUserData);
+bool      SCAPI SteamController_ConfigureAsync(SteamControllerDevice *pDevice, unsigned configFlags, SteamControllerCommandCallback callback, void *pUserData);
+void      SCAPI SteamController_FlushCommands(SteamControllerDevice *pDevice);
+
+// ----------------------------------------------------------------------------------------------
+// Haptic sequencer (Linux only)
+
+#define   STEAMCONTROLLER_HAPTIC_MAX_SEGMENTS     32    /**< Segments in one pattern. */
+#define   STEAMCONTROLLER_HAPTIC_DEFAULT_RATE     100   /**< Feature reports per second the sequencer sends at most. */
+
+/** One PWM burst of a haptic pattern. */
+typedef struct {
+  uint16_t                  onTime;     /**< PWM on time in microseconds. */
+  uint16_t                  offTime;    /**< PWM off time in microseconds. */
+  uint16_t                  count;      /**< PWM cycle count, 0 for silence. */
+  uint16_t                  duration;   /**< Milliseconds until the next segment starts, 0 for the length of the burst. */
+} SteamControllerHapticSegment;
+
+bool      SCAPI SteamController_PlayHapticPattern(SteamControllerDevice *pDevice, uint16_t motor, const SteamControllerHapticSegment *pSegments, size_t segmentCount);
+void      SCAPI SteamController_StopHapticPattern(SteamControllerDevice *pDevice, uint16_t motor);
+void      SCAPI SteamController_SetHapticRate(SteamControllerDevice *pDevice, unsigned reportsPerSecond);
+uint32_t  SCAPI SteamController_GetHapticDropCount(const SteamControllerDevice *pDevice);
+
+#endif
+
+// ----------------------------------------------------------------------------------------------
+// Logging
+
+#define   STEAMCONTROLLER_LOG_NONE                0     /**< Level that silences all messages. */
+#define   STEAMCONTROLLER_LOG_ERROR               1
+#define   STEAMCONTROLLER_LOG_WARNING             2
+#define   STEAMCONTROLLER_LOG_INFO                3
+#define   STEAMCONTROLLER_LOG_DEBUG               4
+
+#define   STEAMCONTROLLER_LOG_BURST               10    /**< Messages one site may log per interval before it is suppressed. */
+#define   STEAMCONTROLLER_LOG_INTERVAL            1000000000ull  /**< Rate limiting interval in nanoseconds. */
+
+/**
+ * Receives the messages of the library.
+ * @param level           STEAMCONTROLLER_LOG_* level of the message.
+ * @param pMessage        Message without a trailing newline.
+ * @param suppressedCount Messages of the same site dropped by rate limiting since it last logged.
+ */
+typedef void (*SteamControllerLogCallback)(unsigned level, const char *pMessage, uint32_t suppressedCount, void *pUserData);
+
+void      SCAPI SteamController_SetLogCallback(SteamControllerLogCallback callback, void *pUserData);
+void      SCAPI SteamController_SetLogLevel(unsigned level);
+unsigned  SCAPI SteamController_GetLogLevel();
+uint64_t  SCAPI SteamController_GetSuppressedLogCount();
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
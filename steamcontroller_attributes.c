@@ -0,0 +1,277 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define STEAMCONTROLLER_ATTRIBUTE_CACHE_SIZE    64
+
+#define STEAMCONTROLLER_ATTRIBUTE_PRODUCT_ID    0x01
+#define STEAMCONTROLLER_ATTRIBUTE_FIRMWARE      0x04
+#define STEAMCONTROLLER_ATTRIBUTE_RADIO         0x05
+#define STEAMCONTROLLER_ATTRIBUTE_BOARD         0x09
+#define STEAMCONTROLLER_ATTRIBUTE_BOOTLOADER    0x0a
+
+typedef struct {
+  char                      identity[STEAMCONTROLLER_IDENTITY_SIZE];
+  SteamControllerAttributes attributes;
+} SteamControllerAttributeCacheEntry;
+
+/**
+ * Attributes of every device opened by this process, so reopening a device
+ * or opening another slot of the same dongle skips the queries. The lock
+ * also guards the attribute state of every device, the critical sections are
+ * a few copies.
+ */
+static SteamControllerAttributeCacheEntry SteamController_AttributeCache[STEAMCONTROLLER_ATTRIBUTE_CACHE_SIZE];
+static size_t                             SteamController_AttributeCacheNext;
+
+#if _WIN32
+static SRWLOCK                            SteamController_AttributeCacheLock = SRWLOCK_INIT;
+
+static void SteamController_LockAttributeCache() {
+  AcquireSRWLockExclusive(&SteamController_AttributeCacheLock);
+}
+
+static void SteamController_UnlockAttributeCache() {
+  ReleaseSRWLockExclusive(&SteamController_AttributeCacheLock);
+}
+#else
+static pthread_mutex_t                    SteamController_AttributeCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void SteamController_LockAttributeCache() {
+  pthread_mutex_lock(&SteamController_AttributeCacheLock);
+}
+
+static void SteamController_UnlockAttributeCache() {
+  pthread_mutex_unlock(&SteamController_AttributeCacheLock);
+}
+#endif
+
+static SteamControllerAttributeCacheEntry *SteamController_FindCachedAttributes(const char *pIdentity) {
+  for (size_t i=0; i<STEAMCONTROLLER_ATTRIBUTE_CACHE_SIZE; i++) {
+    if (!strcmp(SteamController_AttributeCache[i].identity, pIdentity))
+      return SteamController_AttributeCache + i;
+  }
+  return NULL;
+}
+
+/** Copy cached attributes of a device with the same identity into the device. Must hold the lock. */
+static bool SteamController_LoadCachedAttributesLocked(const SteamControllerDevice *pDevice) {
+  if (!pDevice->identity[0])
+    return false;
+
+  SteamControllerAttributeCacheEntry *pEntry = SteamController_FindCachedAttributes(pDevice->identity);
+  if (!pEntry)
+    return false;
+
+  pDevice->pAttributeState->attributes = pEntry->attributes;
+  return true;
+}
+
+/**
+ * Copy cached attributes of a device with the same identity into the device.
+ * @return true if the cache had them.
+ */
+bool SteamController_LoadCachedAttributes(const SteamControllerDevice *pDevice) {
+  SteamController_LockAttributeCache();
+  bool isCached = SteamController_LoadCachedAttributesLocked(pDevice);
+  SteamController_UnlockAttributeCache();
+
+  return isCached;
+}
+
+/** Remember the attributes of a device for devices with the same identity. Must hold the lock. */
+static void SteamController_StoreCachedAttributesLocked(const SteamControllerDevice *pDevice) {
+  if (!pDevice->identity[0])
+    return;
+
+  SteamControllerAttributeCacheEntry *pEntry = SteamController_FindCachedAttributes(pDevice->identity);
+  if (!pEntry) {
+    pEntry = SteamController_AttributeCache + SteamController_AttributeCacheNext;
+    SteamController_AttributeCacheNext = (SteamController_AttributeCacheNext + 1) % STEAMCONTROLLER_ATTRIBUTE_CACHE_SIZE;
+    strcpy(pEntry->identity, pDevice->identity);
+  }
+  pEntry->attributes = pDevice->pAttributeState->attributes;
+}
+
+/** Drop the cached attributes of devices with the same identity. Must hold the lock. */
+static void SteamController_ForgetCachedAttributesLocked(const SteamControllerDevice *pDevice) {
+  if (!pDevice->identity[0])
+    return;
+
+  SteamControllerAttributeCacheEntry *pEntry = SteamController_FindCachedAttributes(pDevice->identity);
+  if (pEntry)
+    pEntry->identity[0] = 0;
+}
+
+/**
+ * Drop the cached attributes of a device that is being closed. A dongle slot
+ * has the identity of the dongle, while it is closed another controller can
+ * be paired to it without anyone seeing the connection event.
+ */
+void SteamController_ForgetCachedAttributes(const SteamControllerDevice *pDevice) {
+  if (!pDevice->isWireless)
+    return;
+
+  SteamController_LockAttributeCache();
+  SteamController_ForgetCachedAttributesLocked(pDevice);
+  SteamController_UnlockAttributeCache();
+}
+
+/**
+ * Forget the attributes of a device, for example because another controller
+ * connected to a dongle slot. Safe from any thread, a query that is running
+ * meanwhile does not store its now outdated result.
+ */
+void SteamController_InvalidateAttributes(const SteamControllerDevice *pDevice) {
+  SteamControllerAttributeState *pState = pDevice->pAttributeState;
+
+  SteamController_LockAttributeCache();
+  pState->attributes.isValid = false;
+  pState->generation++;
+  SteamController_ForgetCachedAttributesLocked(pDevice);
+  SteamController_UnlockAttributeCache();
+}
+
+/**
+ * Parse a GET_ATTRIBUTES response. It is a list of five byte entries, each a
+ * tag followed by a 32 bit value.
+ *
+ *  example data:
+ *
+ *  0000   83 23 00 00 00 00 00 01 02 11 00 00 02 03 00 00
+ *  0010   00 0a 6d 92 d2 55 04 01 8c c7 56 05 6c 4a 42 56
+ *  0020   09 0a 00 00 00 00 00 00 00 00 00 00 00 00 00 00
+ *
+ *  01: product id (0x1102)
+ *  0a: bootloader revision (unix timestamp)
+ *  04: controller firmware revision (unix timestamp)
+ *  05: radio firmware revision (unix timestamp)
+ *  09: board revision (=10)
+ */
+static void SteamController_ParseAttributes(const SteamController_HIDFeatureReport *pReport, SteamControllerAttributes *pAttributes) {
+  uint8_t dataLen = pReport->dataLen < sizeof(pReport->data) ? pReport->dataLen : sizeof(pReport->data);
+
+  for (uint8_t offset=0; offset+5<=dataLen; offset+=5) {
+    const uint8_t *pEntry = pReport->data + offset;
+    uint32_t value = pEntry[1] | (pEntry[2] << 8) | (pEntry[3] << 16) | ((uint32_t)pEntry[4] << 24);
+
+    switch (pEntry[0]) {
+      case STEAMCONTROLLER_ATTRIBUTE_PRODUCT_ID:  pAttributes->productId            = value; break;
+      case STEAMCONTROLLER_ATTRIBUTE_BOOTLOADER:  pAttributes->bootloaderRevision   = value; break;
+      case STEAMCONTROLLER_ATTRIBUTE_FIRMWARE:    pAttributes->firmwareRevision     = value; break;
+      case STEAMCONTROLLER_ATTRIBUTE_RADIO:       pAttributes->radioRevision        = value; break;
+      case STEAMCONTROLLER_ATTRIBUTE_BOARD:       pAttributes->boardRevision        = value; break;
+    }
+  }
+}
+
+/**
+ * Ask the device for its attributes and chip id and cache them.
+ * @param pAttributes   If not NULL, receives the attributes.
+ * @return true if both queries succeeded.
+ */
+bool SteamController_QueryAttributes(const SteamControllerDevice *pDevice, SteamControllerAttributes *pAttributes) {
+  SteamControllerAttributeState *pState = pDevice->pAttributeState;
+
+  SteamController_LockAttributeCache();
+  uint32_t generation = pState->generation;
+  SteamController_UnlockAttributeCache();
+
+  SteamControllerAttributes attributes;
+  memset(&attributes, 0, sizeof(attributes));
+
+  SteamController_HIDFeatureReport featureReport;
+  memset(&featureReport, 0, sizeof(featureReport));
+  featureReport.featureId   = STEAMCONTROLLER_GET_ATTRIBUTES;
+
+  if (!SteamController_HIDGetFeatureReport(pDevice, &featureReport)) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "Failed to get GET_ATTRIBUTES response for controller %p", pDevice);
+    return false;
+  }
+
+  if (featureReport.dataLen < 4) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "Bad GET_ATTRIBUTES response for controller %p", pDevice);
+    // Don't fail, the controller still works without.
+  }
+
+  SteamController_ParseAttributes(&featureReport, &attributes);
+
+  // TODO: Find out more about the chip id.
+  memset(&featureReport, 0, sizeof(featureReport));
+  featureReport.featureId   = STEAMCONTROLLER_GET_CHIPID;
+
+  if (!SteamController_HIDGetFeatureReport(pDevice, &featureReport)) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "GET_CHIPID failed for controller %p", pDevice);
+    return false;
+  }
+
+  attributes.chipIdLength = featureReport.dataLen < sizeof(attributes.chipId) ? featureReport.dataLen : sizeof(attributes.chipId);
+  memcpy(attributes.chipId, featureReport.data, attributes.chipIdLength);
+  attributes.isValid = true;
+
+  // Another controller may have connected to the slot during the queries.
+  SteamController_LockAttributeCache();
+  if (pState->generation == generation) {
+    pState->attributes = attributes;
+    SteamController_StoreCachedAttributesLocked(pDevice);
+  }
+  SteamController_UnlockAttributeCache();
+
+  if (pAttributes)
+    *pAttributes = attributes;
+  return true;
+}
+
+/** Ask a dongle for its version. The result is not used. */
+bool SteamController_QueryVersion(const SteamControllerDevice *pDevice) {
+  // TODO: Neccessary? Maybe remove like the other boot loaded stuff.
+  SteamController_HIDFeatureReport featureReport;
+  memset(&featureReport, 0, sizeof(featureReport));
+  featureReport.featureId   = STEAMCONTROLLER_DONGLE_GET_VERSION;
+
+  if (!SteamController_HIDGetFeatureReport(pDevice, &featureReport)) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "DONGLE_GET_VERSION failed for controller %p", pDevice);
+    return false;
+  }
+
+  return true;
+}
+
+/** Send DONGLE_GET_VERSION with the first SteamController_GetAttributes instead of now. */
+void SteamController_DeferVersionQuery(const SteamControllerDevice *pDevice) {
+  SteamController_LockAttributeCache();
+  pDevice->pAttributeState->isVersionPending = true;
+  SteamController_UnlockAttributeCache();
+}
+
+/**
+ * Get the firmware and hardware attributes of a device. They are queried on
+ * first use if the device was opened with STEAMCONTROLLER_OPEN_LAZY. The first
+ * call also sends the requests such an open left out.
+ * @return false if the device could not be queried.
+ */
+bool SCAPI SteamController_GetAttributes(const SteamControllerDevice *pDevice, SteamControllerAttributes *pAttributes) {
+  if (!pDevice || !pAttributes)
+    return false;
+
+  SteamControllerAttributeState *pState = pDevice->pAttributeState;
+
+  SteamController_LockAttributeCache();
+  bool isVersionPending = pState->isVersionPending;
+  pState->isVersionPending = false;
+
+  bool isKnown = pState->attributes.isValid || SteamController_LoadCachedAttributesLocked(pDevice);
+  if (isKnown)
+    *pAttributes = pState->attributes;
+  SteamController_UnlockAttributeCache();
+
+  if (isVersionPending)
+    SteamController_QueryVersion(pDevice);
+
+  return isKnown || SteamController_QueryAttributes(pDevice, pAttributes);
+}
@@ -0,0 +1,204 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STEAMCONTROLLER_CALIBRATION_SSE2 1
+#endif
+
+#define STEAMCONTROLLER_METERS_PER_COUNT    (STEAMCONTROLLER_STANDARD_GRAVITY / STEAMCONTROLLER_ACCELERATION_PER_G)
+
+#define STEAMCONTROLLER_STILL_MEAN_WEIGHT     (1.0f / 16.0f)    /**< Weight of a new sample in the recent mean and variance. */
+#define STEAMCONTROLLER_STILL_MAX_VARIANCE    2000.0f           /**< Summed over the axes, about 1.5 dps of noise per axis. */
+#define STEAMCONTROLLER_STILL_MIN_GRAVITY     (0.9f * STEAMCONTROLLER_ACCELERATION_PER_G)
+#define STEAMCONTROLLER_STILL_MAX_GRAVITY     (1.1f * STEAMCONTROLLER_ACCELERATION_PER_G)
+#define STEAMCONTROLLER_STILL_UPDATES         50                /**< Consecutive quiet updates before the controller counts as still. */
+
+#define STEAMCONTROLLER_BIAS_MAX_SAMPLES      1024              /**< The bias averages over this many samples once it has them. */
+#define STEAMCONTROLLER_BIAS_TRUSTED_SAMPLES  64                /**< From here on, rates far from the bias are not stillness. */
+#define STEAMCONTROLLER_BIAS_MAX_DEVIATION    (5.0f * STEAMCONTROLLER_ANGULAR_VELOCITY_PER_DPS)
+
+/** Layout of a calibration file. */
+typedef struct {
+  char                      magic[8];
+  uint32_t                  version;
+  uint32_t                  biasSamples;
+  float                     gyroBias[3];
+  uint32_t                  reserved;
+} SteamControllerCalibrationFile;
+
+_Static_assert(sizeof(SteamControllerCalibrationFile) == 32, "calibration file layout changed");
+
+/**
+ * Initialize a calibration without any knowledge of the bias.
+ */
+void SCAPI SteamController_InitCalibration(SteamControllerCalibration *pCalibration) {
+  memset(pCalibration, 0, sizeof(SteamControllerCalibration));
+}
+
+/**
+ * Decide whether the controller is still. Stillness needs a quiet gyroscope
+ * and gravity as the only acceleration, for a while. A constant slow rotation
+ * is quiet too, so once the bias is known, the rate must also be close to it.
+ */
+static inline bool SteamController_DetectStillness(SteamControllerCalibration *pCalibration, const float gyro[3], const SteamControllerVector *pAcceleration) {
+  float variance = 0.0f;
+  bool  isNearBias = true;
+
+  for (int axis=0; axis<3; axis++) {
+    float delta = gyro[axis] - pCalibration->gyroMean[axis];
+    pCalibration->gyroMean[axis] += delta * STEAMCONTROLLER_STILL_MEAN_WEIGHT;
+    variance += delta * delta;
+
+    float deviation = gyro[axis] - pCalibration->gyroBias[axis];
+    if (deviation > STEAMCONTROLLER_BIAS_MAX_DEVIATION || deviation < -STEAMCONTROLLER_BIAS_MAX_DEVIATION)
+      isNearBias = false;
+  }
+  pCalibration->gyroVariance += (variance - pCalibration->gyroVariance) * STEAMCONTROLLER_STILL_MEAN_WEIGHT;
+
+  float ax = pAcceleration->x, ay = pAcceleration->y, az = pAcceleration->z;
+  float gravity = ax*ax + ay*ay + az*az;
+
+  bool isQuiet = pCalibration->gyroVariance < STEAMCONTROLLER_STILL_MAX_VARIANCE
+    && gravity > STEAMCONTROLLER_STILL_MIN_GRAVITY * STEAMCONTROLLER_STILL_MIN_GRAVITY
+    && gravity < STEAMCONTROLLER_STILL_MAX_GRAVITY * STEAMCONTROLLER_STILL_MAX_GRAVITY
+    && (isNearBias || pCalibration->biasSamples < STEAMCONTROLLER_BIAS_TRUSTED_SAMPLES);
+
+  pCalibration->stillCount = isQuiet ? pCalibration->stillCount + 1 : 0;
+  return pCalibration->stillCount >= STEAMCONTROLLER_STILL_UPDATES;
+}
+
+/**
+ * Update the bias estimate with an update event and convert it to SI units.
+ *
+ * While the controller is still, the bias is a running average, which starts
+ * out as a plain average and turns into an exponential one after
+ * STEAMCONTROLLER_BIAS_MAX_SAMPLES samples, so it converges quickly and then
+ * follows temperature drift.
+ *
+ * @param pCalibration  Calibration of the controller.
+ * @param pUpdate       Update event of the controller.
+ * @param pMotion       Receives the calibrated motion, may be NULL.
+ */
+void SCAPI SteamController_CalibrationUpdate(SteamControllerCalibration *pCalibration, const SteamControllerUpdateEvent *pUpdate, SteamControllerMotion *pMotion) {
+  float gyro[3] = { pUpdate->angularVelocity.x, pUpdate->angularVelocity.y, pUpdate->angularVelocity.z };
+
+  bool isStill = SteamController_DetectStillness(pCalibration, gyro, &pUpdate->acceleration);
+  if (isStill) {
+    if (pCalibration->biasSamples < STEAMCONTROLLER_BIAS_MAX_SAMPLES)
+      pCalibration->biasSamples++;
+
+    float weight = 1.0f / pCalibration->biasSamples;
+    for (int axis=0; axis<3; axis++)
+      pCalibration->gyroBias[axis] += (gyro[axis] - pCalibration->gyroBias[axis]) * weight;
+  }
+
+  if (!pMotion)
+    return;
+
+  pMotion->acceleration[0]    = pUpdate->acceleration.x * STEAMCONTROLLER_METERS_PER_COUNT;
+  pMotion->acceleration[1]    = pUpdate->acceleration.y * STEAMCONTROLLER_METERS_PER_COUNT;
+  pMotion->acceleration[2]    = pUpdate->acceleration.z * STEAMCONTROLLER_METERS_PER_COUNT;
+
+  for (int axis=0; axis<3; axis++)
+    pMotion->angularVelocity[axis] = (gyro[axis] - pCalibration->gyroBias[axis]) * STEAMCONTROLLER_RADIANS_PER_COUNT;
+
+  pMotion->isStill = isStill;
+}
+
+/** Convert one field: (raw - bias) * scale. Four at a time with SSE2. */
+static void SteamController_ConvertField(const int16_t *pRaw, size_t count, float bias, float scale, float *pOut) {
+  size_t i = 0;
+
+#if STEAMCONTROLLER_CALIBRATION_SSE2
+  const __m128 biasV  = _mm_set1_ps(bias);
+  const __m128 scaleV = _mm_set1_ps(scale);
+
+  for (; i+4<=count; i+=4) {
+    // Sign extend four words to dwords by unpacking them into the high halves.
+    __m128i raw16 = _mm_loadl_epi64((const __m128i *)(pRaw + i));
+    __m128  raw   = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw16, raw16), 16));
+    _mm_storeu_ps(pOut + i, _mm_mul_ps(_mm_sub_ps(raw, biasV), scaleV));
+  }
+#endif
+
+  for (; i<count; i++)
+    pOut[i] = (pRaw[i] - bias) * scale;
+}
+
+/**
+ * Convert many decoded updates, for example from SteamController_DecodeUpdateBatch,
+ * to SI units with the current bias. The bias is not updated. Fields of reports
+ * that are not updates are converted too, and are garbage.
+ */
+void SCAPI SteamController_ConvertMotionBatch(const SteamControllerCalibration *pCalibration, const SteamControllerUpdateBatch *pBatch, size_t count, SteamControllerMotionBatch *pMotion) {
+  SteamController_ConvertField(pBatch->accelerationX,    count, 0.0f, STEAMCONTROLLER_METERS_PER_COUNT, pMotion->accelerationX);
+  SteamController_ConvertField(pBatch->accelerationY,    count, 0.0f, STEAMCONTROLLER_METERS_PER_COUNT, pMotion->accelerationY);
+  SteamController_ConvertField(pBatch->accelerationZ,    count, 0.0f, STEAMCONTROLLER_METERS_PER_COUNT, pMotion->accelerationZ);
+
+  SteamController_ConvertField(pBatch->angularVelocityX, count, pCalibration->gyroBias[0], STEAMCONTROLLER_RADIANS_PER_COUNT, pMotion->angularVelocityX);
+  SteamController_ConvertField(pBatch->angularVelocityY, count, pCalibration->gyroBias[1], STEAMCONTROLLER_RADIANS_PER_COUNT, pMotion->angularVelocityY);
+  SteamController_ConvertField(pBatch->angularVelocityZ, count, pCalibration->gyroBias[2], STEAMCONTROLLER_RADIANS_PER_COUNT, pMotion->angularVelocityZ);
+}
+
+/**
+ * Save the bias estimate of a controller, to continue from it when the
+ * controller reconnects. The chip id from SteamController_GetAttributes is a
+ * good file name.
+ * @return false if the file could not be written.
+ */
+bool SCAPI SteamController_SaveCalibration(const SteamControllerCalibration *pCalibration, const char *pPath) {
+  if (!pCalibration || !pPath)
+    return false;
+
+  SteamControllerCalibrationFile file;
+  memset(&file, 0, sizeof(file));
+  memcpy(file.magic, STEAMCONTROLLER_CALIBRATION_MAGIC, sizeof(file.magic));
+  file.version      = STEAMCONTROLLER_CALIBRATION_VERSION;
+  file.biasSamples  = pCalibration->biasSamples;
+  memcpy(file.gyroBias, pCalibration->gyroBias, sizeof(file.gyroBias));
+
+  FILE *pFile = fopen(pPath, "wb");
+  if (!pFile) {
+    SteamController_LogErrno("fopen");
+    return false;
+  }
+
+  bool success = fwrite(&file, sizeof(file), 1, pFile) == 1;
+  if (fclose(pFile) != 0)
+    success = false;
+
+  if (!success)
+    SteamController_LogErrno("fwrite");
+
+  return success;
+}
+
+/**
+ * Initialize a calibration from a saved bias estimate. The bias is trusted
+ * as much as when it was saved, so it is used right away.
+ * @return false if the file could not be read, the calibration is initialized without a bias then.
+ */
+bool SCAPI SteamController_LoadCalibration(SteamControllerCalibration *pCalibration, const char *pPath) {
+  if (!pCalibration || !pPath)
+    return false;
+
+  SteamController_InitCalibration(pCalibration);
+
+  FILE *pFile = fopen(pPath, "rb");
+  if (!pFile)
+    return false;
+
+  SteamControllerCalibrationFile file;
+  size_t count = fread(&file, sizeof(file), 1, pFile);
+  fclose(pFile);
+
+  if (count != 1 || memcmp(file.magic, STEAMCONTROLLER_CALIBRATION_MAGIC, sizeof(file.magic)) || file.version != STEAMCONTROLLER_CALIBRATION_VERSION) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "%s: not a calibration file", pPath);
+    return false;
+  }
+
+  pCalibration->biasSamples = file.biasSamples < STEAMCONTROLLER_BIAS_MAX_SAMPLES ? file.biasSamples : STEAMCONTROLLER_BIAS_MAX_SAMPLES;
+  memcpy(pCalibration->gyroBias, file.gyroBias, sizeof(pCalibration->gyroBias));
+  return true;
+}
@@ -0,0 +1,273 @@
+#if _MSC_VER
+#pragma warning(disable: 4206)  // MSC: nonstandard extension used : translation unit is empty
+#endif
+
+#if __linux__
+
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <pthread.h>
+
+#define STEAMCONTROLLER_COMMAND_QUEUE_MASK  (STEAMCONTROLLER_COMMAND_QUEUE_SIZE - 1)
+
+_Static_assert((STEAMCONTROLLER_COMMAND_QUEUE_SIZE & STEAMCONTROLLER_COMMAND_QUEUE_MASK) == 0, "command queue size must be a power of two");
+
+typedef struct {
+  SteamController_HIDFeatureReport  report;
+  bool                              isRequest;    /**< Get the report back from the device instead of just sending it. */
+  bool                              isSettings;   /**< The report changes settings behind the settings cache. */
+  SteamControllerCommandCallback    callback;
+  void                             *pUserData;
+} SteamControllerCommand;
+
+typedef struct {
+  SteamControllerCommand  commands[STEAMCONTROLLER_COMMAND_QUEUE_SIZE];
+  size_t                  head;
+  size_t                  tail;
+} SteamControllerCommandRing;
+
+struct SteamControllerCommandQueue {
+  SteamControllerDevice      *pDevice;
+  pthread_t                   thread;
+  pthread_mutex_t             mutex;
+  pthread_cond_t              workCondition;    /**< Signalled when a command is queued or the worker should stop. */
+  pthread_cond_t              idleCondition;    /**< Signalled when the worker has run out of commands. */
+  bool                        isRunning;
+  bool                        isBusy;           /**< The worker is talking to the device. */
+  SteamControllerCommandRing  rings[STEAMCONTROLLER_PRIORITY_COUNT];
+};
+
+/** Take the next command off the highest priority ring that has one. Must hold the mutex. */
+static bool SteamController_CommandQueuePop(SteamControllerCommandQueue *pQueue, SteamControllerCommand *pCommand) {
+  for (unsigned priority=0; priority<STEAMCONTROLLER_PRIORITY_COUNT; priority++) {
+    SteamControllerCommandRing *pRing = pQueue->rings + priority;
+    if (pRing->head == pRing->tail)
+      continue;
+
+    *pCommand = pRing->commands[pRing->tail & STEAMCONTROLLER_COMMAND_QUEUE_MASK];
+    pRing->tail++;
+    return true;
+  }
+
+  return false;
+}
+
+static void SteamController_CommandComplete(SteamControllerDevice *pDevice, const SteamControllerCommand *pCommand, bool success) {
+  if (pCommand->callback)
+    pCommand->callback(pDevice, success, pCommand->isRequest && success ? (const uint8_t *)&pCommand->report : NULL, pCommand->pUserData);
+}
+
+static void *SteamController_CommandThread(void *pArg) {
+  SteamControllerCommandQueue *pQueue = (SteamControllerCommandQueue *)pArg;
+
+  pthread_mutex_lock(&pQueue->mutex);
+  for (;;) {
+    SteamControllerCommand command;
+    if (!SteamController_CommandQueuePop(pQueue, &command)) {
+      pthread_cond_broadcast(&pQueue->idleCondition);
+
+      if (!pQueue->isRunning)
+        break;
+
+      pthread_cond_wait(&pQueue->workCondition, &pQueue->mutex);
+      continue;
+    }
+
+    // Never hold the lock during the round trip, submitting must not block on it.
+    pQueue->isBusy = true;
+    pthread_mutex_unlock(&pQueue->mutex);
+
+    bool success;
+    if (command.isRequest)
+      success = SteamController_HIDGetFeatureReport(pQueue->pDevice, &command.report);
+    else
+      success = SteamController_HIDSetFeatureReport(pQueue->pDevice, &command.report);
+
+    // Even a failed report may have reached the device.
+    if (command.isSettings)
+      SteamController_InvalidateSettings(pQueue->pDevice);
+
+    SteamController_CommandComplete(pQueue->pDevice, &command, success);
+
+    pthread_mutex_lock(&pQueue->mutex);
+    pQueue->isBusy = false;
+  }
+  pthread_mutex_unlock(&pQueue->mutex);
+
+  return NULL;
+}
+
+/** Serializes creating the queue of a device on first use. */
+static pthread_mutex_t SteamController_CommandQueueCreateMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static SteamControllerCommandQueue *SteamController_CreateCommandQueue(SteamControllerDevice *pDevice) {
+  SteamControllerCommandQueue *pQueue = malloc(sizeof(SteamControllerCommandQueue));
+  if (!pQueue)
+    return NULL;
+
+  memset(pQueue, 0, sizeof(SteamControllerCommandQueue));
+  pQueue->pDevice   = pDevice;
+  pQueue->isRunning = true;
+  pthread_mutex_init(&pQueue->mutex, NULL);
+  pthread_cond_init(&pQueue->workCondition, NULL);
+  pthread_cond_init(&pQueue->idleCondition, NULL);
+
+  if (pthread_create(&pQueue->thread, NULL, SteamController_CommandThread, pQueue)) {
+    SteamController_LogErrno("pthread_create");
+    pthread_cond_destroy(&pQueue->idleCondition);
+    pthread_cond_destroy(&pQueue->workCondition);
+    pthread_mutex_destroy(&pQueue->mutex);
+    free(pQueue);
+    return NULL;
+  }
+
+  return pQueue;
+}
+
+static SteamControllerCommandQueue *SteamController_GetCommandQueue(SteamControllerDevice *pDevice) {
+  pthread_mutex_lock(&SteamController_CommandQueueCreateMutex);
+  if (!pDevice->pCommands)
+    pDevice->pCommands = SteamController_CreateCommandQueue(pDevice);
+  SteamControllerCommandQueue *pQueue = pDevice->pCommands;
+  pthread_mutex_unlock(&SteamController_CommandQueueCreateMutex);
+
+  return pQueue;
+}
+
+/**
+ * Stop the command thread of a device. Commands that were not sent yet
+ * complete with success set to false.
+ */
+void SteamController_StopCommandQueue(SteamControllerDevice *pDevice) {
+  SteamControllerCommandQueue *pQueue = pDevice->pCommands;
+  if (!pQueue)
+    return;
+
+  // Take everything that is still queued, so the worker stops after the current command.
+  SteamControllerCommandRing rings[STEAMCONTROLLER_PRIORITY_COUNT];
+
+  pthread_mutex_lock(&pQueue->mutex);
+  memcpy(rings, pQueue->rings, sizeof(rings));
+  for (unsigned priority=0; priority<STEAMCONTROLLER_PRIORITY_COUNT; priority++)
+    pQueue->rings[priority].tail = pQueue->rings[priority].head;
+  pQueue->isRunning = false;
+  pthread_cond_signal(&pQueue->workCondition);
+  pthread_mutex_unlock(&pQueue->mutex);
+
+  pthread_join(pQueue->thread, NULL);
+
+  for (unsigned priority=0; priority<STEAMCONTROLLER_PRIORITY_COUNT; priority++) {
+    SteamControllerCommandRing *pRing = rings + priority;
+    for (size_t i=pRing->tail; i!=pRing->head; i++)
+      SteamController_CommandComplete(pDevice, pRing->commands + (i & STEAMCONTROLLER_COMMAND_QUEUE_MASK), false);
+  }
+
+  pthread_cond_destroy(&pQueue->idleCondition);
+  pthread_cond_destroy(&pQueue->workCondition);
+  pthread_mutex_destroy(&pQueue->mutex);
+  pDevice->pCommands = NULL;
+  free(pQueue);
+}
+
+/** Queue a command, see SteamController_SubmitFeatureReport. */
+static bool SteamController_SubmitCommand(SteamControllerDevice *pDevice, const uint8_t *pReport, bool isRequest, bool isSettings, unsigned priority, SteamControllerCommandCallback callback, void *pUserData) {
+  if (!pDevice || !pReport || priority >= STEAMCONTROLLER_PRIORITY_COUNT)
+    return false;
+
+  SteamControllerCommandQueue *pQueue = SteamController_GetCommandQueue(pDevice);
+  if (!pQueue)
+    return false;
+
+  pthread_mutex_lock(&pQueue->mutex);
+
+  SteamControllerCommandRing *pRing = pQueue->rings + priority;
+  if (pRing->head - pRing->tail >= STEAMCONTROLLER_COMMAND_QUEUE_SIZE) {
+    pthread_mutex_unlock(&pQueue->mutex);
+    return false;
+  }
+
+  SteamControllerCommand *pCommand = pRing->commands + (pRing->head & STEAMCONTROLLER_COMMAND_QUEUE_MASK);
+  memcpy(&pCommand->report, pReport, sizeof(SteamController_HIDFeatureReport));
+  pCommand->isRequest  = isRequest;
+  pCommand->isSettings = isSettings;
+  pCommand->callback   = callback;
+  pCommand->pUserData  = pUserData;
+  pRing->head++;
+
+  pthread_cond_signal(&pQueue->workCondition);
+  pthread_mutex_unlock(&pQueue->mutex);
+  return true;
+}
+
+/**
+ * Queue a feature report to be exchanged with the device on a background
+ * thread. Never waits for the device. Commands of a higher priority are sent
+ * before any queued commands of lower priority, commands of the same priority
+ * are sent in order.
+ *
+ * @param pDevice     Device to send the report to.
+ * @param pReport     STEAMCONTROLLER_FEATURE_REPORT_SIZE bytes, copied.
+ * @param isRequest   If set, the device is asked for the report and its response is passed to the callback.
+ * @param priority    One of STEAMCONTROLLER_PRIORITY_*.
+ * @param callback    Called on the background thread once the command completed, may be NULL.
+ * @param pUserData   Passed to the callback.
+ * @return false if the queue for that priority is full.
+ */
+bool SCAPI SteamController_SubmitFeatureReport(SteamControllerDevice *pDevice, const uint8_t *pReport, bool isRequest, unsigned priority, SteamControllerCommandCallback callback, void *pUserData) {
+  return SteamController_SubmitCommand(pDevice, pReport, isRequest, false, priority, callback, pUserData);
+}
+
+/** Like SteamController_TriggerHaptic, but queued with high priority. */
+bool SCAPI SteamController_TriggerHapticAsync(SteamControllerDevice *pDevice, uint16_t motor, uint16_t onTime, uint16_t offTime, uint16_t count, SteamControllerCommandCallback callback, void *pUserData) {
+  SteamController_HIDFeatureReport featureReport;
+  SteamController_BuildHapticReport(&featureReport, motor, onTime, offTime, count);
+  return SteamController_SubmitFeatureReport(pDevice, (const uint8_t *)&featureReport, false, STEAMCONTROLLER_PRIORITY_HIGH, callback, pUserData);
+}
+
+/** Like SteamController_PlayMelody, but queued with normal priority. */
+bool SCAPI SteamController_PlayMelodyAsync(SteamControllerDevice *pDevice, uint32_t melodyId, SteamControllerCommandCallback callback, void *pUserData) {
+  SteamController_HIDFeatureReport featureReport;
+  SteamController_BuildMelodyReport(&featureReport, melodyId);
+  return SteamController_SubmitFeatureReport(pDevice, (const uint8_t *)&featureReport, false, STEAMCONTROLLER_PRIORITY_NORMAL, callback, pUserData);
+}
+
+/** Like SteamController_Configure, but queued with low priority. */
+bool SCAPI SteamController_ConfigureAsync(SteamControllerDevice *pDevice, unsigned configFlags, SteamControllerCommandCallback callback, void *pUserData) {
+  SteamController_HIDFeatureReport featureReport;
+  SteamController_BuildConfigureReport(&featureReport, configFlags);
+
+  // The settings cache is invalidated once the report went out, until then it is still right.
+  return SteamController_SubmitCommand(pDevice, (const uint8_t *)&featureReport, false, true, STEAMCONTROLLER_PRIORITY_LOW, callback, pUserData);
+}
+
+/**
+ * Wait until all queued commands of a device have completed.
+ * Must not be called from a completion callback.
+ */
+void SCAPI SteamController_FlushCommands(SteamControllerDevice *pDevice) {
+  if (!pDevice)
+    return;
+
+  pthread_mutex_lock(&SteamController_CommandQueueCreateMutex);
+  SteamControllerCommandQueue *pQueue = pDevice->pCommands;
+  pthread_mutex_unlock(&SteamController_CommandQueueCreateMutex);
+
+  if (!pQueue)
+    return;
+
+  pthread_mutex_lock(&pQueue->mutex);
+  for (;;) {
+    bool isEmpty = !pQueue->isBusy;
+    for (unsigned priority=0; priority<STEAMCONTROLLER_PRIORITY_COUNT && isEmpty; priority++)
+      isEmpty = pQueue->rings[priority].head == pQueue->rings[priority].tail;
+
+    if (isEmpty)
+      break;
+
+    pthread_cond_wait(&pQueue->idleCondition, &pQueue->mutex);
+  }
+  pthread_mutex_unlock(&pQueue->mutex);
+}
+
+#endif
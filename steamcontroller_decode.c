@@ -0,0 +1,294 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STEAMCONTROLLER_DECODE_SSE2 1
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STEAMCONTROLLER_DECODE_AVX2 1
+#define STEAMCONTROLLER_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// Built for any x86, AVX2 is only used where the CPU has it.
+#include <immintrin.h>
+#define STEAMCONTROLLER_DECODE_AVX2 1
+#define STEAMCONTROLLER_DECODE_AVX2_DISPATCH 1
+#define STEAMCONTROLLER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define STEAMCONTROLLER_DECODE_NEON 1
+#endif
+
+/*
+  The 16 bit fields of an update report (see SteamController_DecodeEvent)
+  occupy two 16 byte blocks, eight little endian words each:
+
+  0x0010  leftX leftY rightX rightY  -     -     accelX accelY
+  0x0020  accelZ gyroX gyroY gyroZ   oriX  oriY  oriZ   -
+
+  Eight reports at a time, each block is loaded as one vector per report and
+  the resulting 8x8 word matrix is transposed, giving one vector per field.
+  With AVX2 the two 128 bit lanes transpose sixteen reports at once. GCC and
+  clang build the AVX2 code even when the rest of the library targets older
+  CPUs, and SteamController_DecodeUpdateBatch checks the CPU before using it.
+*/
+
+/** Decode the byte sized and 32 bit fields of one report. */
+static inline void SteamController_DecodeUpdateHeader(const uint8_t *pReport, size_t i, SteamControllerUpdateBatch *pBatch) {
+  pBatch->eventType[i]    = pReport[0x02];
+  pBatch->timeStamp[i]    = pReport[0x04] | (pReport[0x05] << 8) | (pReport[0x06] << 16) | ((uint32_t)pReport[0x07] << 24);
+  pBatch->buttons[i]      = pReport[0x08] | (pReport[0x09] << 8) | (pReport[0x0a] << 16);
+  pBatch->leftTrigger[i]  = pReport[0x0b];
+  pBatch->rightTrigger[i] = pReport[0x0c];
+}
+
+/** Decode the 16 bit fields of one report the same way SteamController_DecodeEvent does. */
+static inline void SteamController_DecodeUpdateWords(const uint8_t *pReport, size_t i, SteamControllerUpdateBatch *pBatch) {
+  pBatch->leftX[i]            = pReport[0x10] | (pReport[0x11] << 8);
+  pBatch->leftY[i]            = pReport[0x12] | (pReport[0x13] << 8);
+  pBatch->rightX[i]           = pReport[0x14] | (pReport[0x15] << 8);
+  pBatch->rightY[i]           = pReport[0x16] | (pReport[0x17] << 8);
+
+  pBatch->accelerationX[i]    = pReport[0x1c] | (pReport[0x1d] << 8);
+  pBatch->accelerationY[i]    = pReport[0x1e] | (pReport[0x1f] << 8);
+  pBatch->accelerationZ[i]    = pReport[0x20] | (pReport[0x21] << 8);
+
+  pBatch->angularVelocityX[i] = pReport[0x22] | (pReport[0x23] << 8);
+  pBatch->angularVelocityY[i] = pReport[0x24] | (pReport[0x25] << 8);
+  pBatch->angularVelocityZ[i] = pReport[0x26] | (pReport[0x27] << 8);
+
+  pBatch->orientationX[i]     = pReport[0x28] | (pReport[0x29] << 8);
+  pBatch->orientationY[i]     = pReport[0x2a] | (pReport[0x2b] << 8);
+  pBatch->orientationZ[i]     = pReport[0x2c] | (pReport[0x2d] << 8);
+}
+
+#if STEAMCONTROLLER_DECODE_SSE2
+
+/** Transpose the words of eight vectors in place. */
+static inline void SteamController_Transpose8x16(__m128i r[8]) {
+  __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]);
+  __m128i a1 = _mm_unpackhi_epi16(r[0], r[1]);
+  __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]);
+  __m128i a3 = _mm_unpackhi_epi16(r[2], r[3]);
+  __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]);
+  __m128i a5 = _mm_unpackhi_epi16(r[4], r[5]);
+  __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]);
+  __m128i a7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+  __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+  __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+  __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+  __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+  __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+  __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+  __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+  __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+  r[0] = _mm_unpacklo_epi64(b0, b4);
+  r[1] = _mm_unpackhi_epi64(b0, b4);
+  r[2] = _mm_unpacklo_epi64(b1, b5);
+  r[3] = _mm_unpackhi_epi64(b1, b5);
+  r[4] = _mm_unpacklo_epi64(b2, b6);
+  r[5] = _mm_unpackhi_epi64(b2, b6);
+  r[6] = _mm_unpacklo_epi64(b3, b7);
+  r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+static inline void SteamController_LoadBlock(const uint8_t *pReports, size_t offset, __m128i r[8]) {
+  for (size_t i=0; i<8; i++)
+    r[i] = _mm_loadu_si128((const __m128i *)(pReports + i * STEAMCONTROLLER_RAW_REPORT_SIZE + offset));
+}
+
+static inline void SteamController_StoreField(int16_t *pField, __m128i value) {
+  _mm_storeu_si128((__m128i *)pField, value);
+}
+
+#if STEAMCONTROLLER_DECODE_AVX2
+
+/** Transpose the words within each 128 bit lane of eight vectors in place. */
+static inline STEAMCONTROLLER_TARGET_AVX2 void SteamController_Transpose8x16x2(__m256i r[8]) {
+  __m256i a0 = _mm256_unpacklo_epi16(r[0], r[1]);
+  __m256i a1 = _mm256_unpackhi_epi16(r[0], r[1]);
+  __m256i a2 = _mm256_unpacklo_epi16(r[2], r[3]);
+  __m256i a3 = _mm256_unpackhi_epi16(r[2], r[3]);
+  __m256i a4 = _mm256_unpacklo_epi16(r[4], r[5]);
+  __m256i a5 = _mm256_unpackhi_epi16(r[4], r[5]);
+  __m256i a6 = _mm256_unpacklo_epi16(r[6], r[7]);
+  __m256i a7 = _mm256_unpackhi_epi16(r[6], r[7]);
+
+  __m256i b0 = _mm256_unpacklo_epi32(a0, a2);
+  __m256i b1 = _mm256_unpackhi_epi32(a0, a2);
+  __m256i b2 = _mm256_unpacklo_epi32(a1, a3);
+  __m256i b3 = _mm256_unpackhi_epi32(a1, a3);
+  __m256i b4 = _mm256_unpacklo_epi32(a4, a6);
+  __m256i b5 = _mm256_unpackhi_epi32(a4, a6);
+  __m256i b6 = _mm256_unpacklo_epi32(a5, a7);
+  __m256i b7 = _mm256_unpackhi_epi32(a5, a7);
+
+  r[0] = _mm256_unpacklo_epi64(b0, b4);
+  r[1] = _mm256_unpackhi_epi64(b0, b4);
+  r[2] = _mm256_unpacklo_epi64(b1, b5);
+  r[3] = _mm256_unpackhi_epi64(b1, b5);
+  r[4] = _mm256_unpacklo_epi64(b2, b6);
+  r[5] = _mm256_unpackhi_epi64(b2, b6);
+  r[6] = _mm256_unpacklo_epi64(b3, b7);
+  r[7] = _mm256_unpackhi_epi64(b3, b7);
+}
+
+/** Load report i into the low lane and report i + 8 into the high lane. */
+static inline STEAMCONTROLLER_TARGET_AVX2 void SteamController_LoadBlock2(const uint8_t *pReports, size_t offset, __m256i r[8]) {
+  for (size_t i=0; i<8; i++) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)(pReports + i * STEAMCONTROLLER_RAW_REPORT_SIZE + offset));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(pReports + (i + 8) * STEAMCONTROLLER_RAW_REPORT_SIZE + offset));
+    r[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+  }
+}
+
+static inline STEAMCONTROLLER_TARGET_AVX2 void SteamController_StoreField2(int16_t *pField, __m256i value) {
+  _mm_storeu_si128((__m128i *)pField,       _mm256_castsi256_si128(value));
+  _mm_storeu_si128((__m128i *)(pField + 8), _mm256_extracti128_si256(value, 1));
+}
+
+/** Decode whole blocks of sixteen reports. @return Number of reports decoded. */
+static STEAMCONTROLLER_TARGET_AVX2 size_t SteamController_DecodeUpdateBlocksAvx2(const uint8_t *pReports, size_t count, SteamControllerUpdateBatch *pBatch) {
+  size_t i = 0;
+
+  for (; i + 16 <= count; i += 16) {
+    const uint8_t *pBlock = pReports + i * STEAMCONTROLLER_RAW_REPORT_SIZE;
+    __m256i r[8];
+
+    SteamController_LoadBlock2(pBlock, 0x10, r);
+    SteamController_Transpose8x16x2(r);
+    SteamController_StoreField2(pBatch->leftX + i,            r[0]);
+    SteamController_StoreField2(pBatch->leftY + i,            r[1]);
+    SteamController_StoreField2(pBatch->rightX + i,           r[2]);
+    SteamController_StoreField2(pBatch->rightY + i,           r[3]);
+    SteamController_StoreField2(pBatch->accelerationX + i,    r[6]);
+    SteamController_StoreField2(pBatch->accelerationY + i,    r[7]);
+
+    SteamController_LoadBlock2(pBlock, 0x20, r);
+    SteamController_Transpose8x16x2(r);
+    SteamController_StoreField2(pBatch->accelerationZ + i,    r[0]);
+    SteamController_StoreField2(pBatch->angularVelocityX + i, r[1]);
+    SteamController_StoreField2(pBatch->angularVelocityY + i, r[2]);
+    SteamController_StoreField2(pBatch->angularVelocityZ + i, r[3]);
+    SteamController_StoreField2(pBatch->orientationX + i,     r[4]);
+    SteamController_StoreField2(pBatch->orientationY + i,     r[5]);
+    SteamController_StoreField2(pBatch->orientationZ + i,     r[6]);
+
+    for (size_t j=0; j<16; j++)
+      SteamController_DecodeUpdateHeader(pBlock + j * STEAMCONTROLLER_RAW_REPORT_SIZE, i + j, pBatch);
+  }
+
+  return i;
+}
+
+/** Whether the AVX2 code can run on this CPU. */
+static inline bool SteamController_HasAvx2() {
+#if STEAMCONTROLLER_DECODE_AVX2_DISPATCH
+  return __builtin_cpu_supports("avx2");
+#else
+  return true;
+#endif
+}
+
+#endif
+
+#elif STEAMCONTROLLER_DECODE_NEON
+
+/** Transpose the words of eight vectors in place. */
+static inline void SteamController_Transpose8x16(int16x8_t r[8]) {
+  int16x8x2_t t0 = vtrnq_s16(r[0], r[1]);
+  int16x8x2_t t1 = vtrnq_s16(r[2], r[3]);
+  int16x8x2_t t2 = vtrnq_s16(r[4], r[5]);
+  int16x8x2_t t3 = vtrnq_s16(r[6], r[7]);
+
+  int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+  int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+  int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+  int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+  r[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[0]),  vget_low_s32(u2.val[0])));
+  r[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[0]),  vget_low_s32(u3.val[0])));
+  r[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[1]),  vget_low_s32(u2.val[1])));
+  r[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[1]),  vget_low_s32(u3.val[1])));
+  r[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[0]), vget_high_s32(u2.val[0])));
+  r[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[0]), vget_high_s32(u3.val[0])));
+  r[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[1]), vget_high_s32(u2.val[1])));
+  r[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[1]), vget_high_s32(u3.val[1])));
+}
+
+static inline void SteamController_LoadBlock(const uint8_t *pReports, size_t offset, int16x8_t r[8]) {
+  for (size_t i=0; i<8; i++)
+    r[i] = vreinterpretq_s16_u8(vld1q_u8(pReports + i * STEAMCONTROLLER_RAW_REPORT_SIZE + offset));
+}
+
+static inline void SteamController_StoreField(int16_t *pField, int16x8_t value) {
+  vst1q_s16(pField, value);
+}
+
+#endif
+
+/**
+ * Decode many raw update reports into one array per field.
+ * Gives the same values as SteamController_ReadEvent would, but decodes eight
+ * reports at a time with SSE2 or NEON, sixteen with AVX2, where available.
+ *
+ * @param pReports  count raw reports of STEAMCONTROLLER_RAW_REPORT_SIZE bytes each,
+ *                  without a leading zero byte.
+ * @param count     Number of reports.
+ * @param pBatch    Arrays to store the fields in, each with room for count entries.
+ *                  Fields are only meaningful where eventType is STEAMCONTROLLER_EVENT_UPDATE.
+ */
+void SCAPI SteamController_DecodeUpdateBatch(const uint8_t *pReports, size_t count, SteamControllerUpdateBatch *pBatch) {
+  if (!pReports || !pBatch)
+    return;
+
+  size_t i = 0;
+
+#if STEAMCONTROLLER_DECODE_AVX2
+  if (SteamController_HasAvx2())
+    i = SteamController_DecodeUpdateBlocksAvx2(pReports, count, pBatch);
+#endif
+
+#if STEAMCONTROLLER_DECODE_SSE2 || STEAMCONTROLLER_DECODE_NEON
+  for (; i + 8 <= count; i += 8) {
+    const uint8_t *pBlock = pReports + i * STEAMCONTROLLER_RAW_REPORT_SIZE;
+
+#if STEAMCONTROLLER_DECODE_SSE2
+    __m128i r[8];
+#else
+    int16x8_t r[8];
+#endif
+
+    SteamController_LoadBlock(pBlock, 0x10, r);
+    SteamController_Transpose8x16(r);
+    SteamController_StoreField(pBatch->leftX + i,             r[0]);
+    SteamController_StoreField(pBatch->leftY + i,             r[1]);
+    SteamController_StoreField(pBatch->rightX + i,            r[2]);
+    SteamController_StoreField(pBatch->rightY + i,            r[3]);
+    SteamController_StoreField(pBatch->accelerationX + i,     r[6]);
+    SteamController_StoreField(pBatch->accelerationY + i,     r[7]);
+
+    SteamController_LoadBlock(pBlock, 0x20, r);
+    SteamController_Transpose8x16(r);
+    SteamController_StoreField(pBatch->accelerationZ + i,     r[0]);
+    SteamController_StoreField(pBatch->angularVelocityX + i,  r[1]);
+    SteamController_StoreField(pBatch->angularVelocityY + i,  r[2]);
+    SteamController_StoreField(pBatch->angularVelocityZ + i,  r[3]);
+    SteamController_StoreField(pBatch->orientationX + i,      r[4]);
+    SteamController_StoreField(pBatch->orientationY + i,      r[5]);
+    SteamController_StoreField(pBatch->orientationZ + i,      r[6]);
+
+    for (size_t j=0; j<8; j++)
+      SteamController_DecodeUpdateHeader(pBlock + j * STEAMCONTROLLER_RAW_REPORT_SIZE, i + j, pBatch);
+  }
+#endif
+
+  for (; i < count; i++) {
+    const uint8_t *pReport = pReports + i * STEAMCONTROLLER_RAW_REPORT_SIZE;
+    SteamController_DecodeUpdateHeader(pReport, i, pBatch);
+    SteamController_DecodeUpdateWords(pReport, i, pBatch);
+  }
+}
@@ -1,6 +1,20 @@
 #include "steamcontroller.h"
 #include "common.h"
 
+/** Build the feature report for SteamController_TriggerHaptic. */
+void SteamController_BuildHapticReport(SteamController_HIDFeatureReport *pReport, uint16_t motor, uint16_t onTime, uint16_t offTime, uint16_t count) {
+  memset(pReport, 0, sizeof(SteamController_HIDFeatureReport));
+  pReport->featureId   = STEAMCONTROLLER_TRIGGER_HAPTIC_PULSE;
+  pReport->dataLen     = motor > 0xff ? 8 : 7;
+  pReport->data[0]     = LowByte(motor);
+  StoreU16(pReport->data + 1, onTime);
+  StoreU16(pReport->data + 3, offTime);
+  StoreU16(pReport->data + 5, count);
+
+  if (pReport->dataLen > 7)
+    pReport->data[7]     = HighByte(motor);
+}
+
 /**
  * Pulse the haptic feedback of the controller using pulse width modulation.
  * 
@@ -12,27 +26,12 @@
  */
 bool SCAPI SteamController_TriggerHaptic(const SteamControllerDevice *pDevice, uint16_t motor, uint16_t onTime, uint16_t offTime, uint16_t count) {
   SteamController_HIDFeatureReport featureReport;
-
-  memset(&featureReport, 0, sizeof(featureReport));
-  featureReport.featureId   = STEAMCONTROLLER_TRIGGER_HAPTIC_PULSE;
-  featureReport.dataLen     = motor > 0xff ? 8 : 7;
-  featureReport.data[0]     = LowByte(motor);
-  StoreU16(featureReport.data + 1, onTime);
-  StoreU16(featureReport.data + 3, offTime);
-  StoreU16(featureReport.data + 5, count);
-
-  if (featureReport.dataLen > 7)
-    featureReport.data[7]     = HighByte(motor);
-
+  SteamController_BuildHapticReport(&featureReport, motor, onTime, offTime, count);
   return SteamController_HIDSetFeatureReport(pDevice, &featureReport);
 }
 
-/**
- * Play one of the predefined melodies.
- */
-void SCAPI SteamController_PlayMelody(const SteamControllerDevice *pDevice, uint32_t melodyId) {
-  SteamController_HIDFeatureReport featureReport;
-
+/** Build the feature report for SteamController_PlayMelody. */
+void SteamController_BuildMelodyReport(SteamController_HIDFeatureReport *pReport, uint32_t melodyId) {
   // 00 = Warm and Happy
   // 01 = Invader
   // 02 = Controller Confirmed
@@ -48,10 +47,17 @@ void SCAPI SteamController_PlayMelody(const SteamControllerDevice *pDevice, uint
   // 0c = Triumph
   // 0d = The Mann
 
-  memset(&featureReport, 0, sizeof(featureReport));
-  featureReport.featureId   = STEAMCONTROLLER_PLAY_MELODY;
-  featureReport.dataLen     = 0x04;
-  StoreU32(featureReport.data, melodyId);
+  memset(pReport, 0, sizeof(SteamController_HIDFeatureReport));
+  pReport->featureId   = STEAMCONTROLLER_PLAY_MELODY;
+  pReport->dataLen     = 0x04;
+  StoreU32(pReport->data, melodyId);
+}
 
+/**
+ * Play one of the predefined melodies.
+ */
+void SCAPI SteamController_PlayMelody(const SteamControllerDevice *pDevice, uint32_t melodyId) {
+  SteamController_HIDFeatureReport featureReport;
+  SteamController_BuildMelodyReport(&featureReport, melodyId);
   SteamController_HIDSetFeatureReport(pDevice, &featureReport);
 }
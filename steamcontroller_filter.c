@@ -0,0 +1,231 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <math.h>
+
+#define STEAMCONTROLLER_ONE_EURO_DERIVATIVE_CUTOFF  1.0f    /**< Hz, for smoothing the speed that drives the cutoff. */
+#define STEAMCONTROLLER_FILTER_MIN_MAGNITUDE        1e-6f
+
+#define STEAMCONTROLLER_DPAD_MASK   (STEAMCONTROLLER_BUTTON_DPAD_UP | STEAMCONTROLLER_BUTTON_DPAD_RIGHT | STEAMCONTROLLER_BUTTON_DPAD_LEFT | STEAMCONTROLLER_BUTTON_DPAD_DOWN)
+
+/**
+ * Initialize a filter chain without deadzones, smoothing or curves. Everything
+ * passes through unchanged, except that pairs are limited to the unit circle.
+ */
+void SCAPI SteamController_InitFilter(SteamControllerFilter *pFilter) {
+  memset(pFilter, 0, sizeof(SteamControllerFilter));
+
+  for (unsigned axis=0; axis<STEAMCONTROLLER_FILTER_AXIS_COUNT; axis++) {
+    pFilter->axes[axis].outerDeadzone = 1.0f;
+    SteamController_SetFilterCurve(pFilter, axis, 1.0f);
+  }
+
+  SteamController_SetDpadHysteresis(pFilter, 0.0f);
+}
+
+/**
+ * Set the response curve of an axis to output = input ^ exponent.
+ * Values above 1 give finer control near the center.
+ */
+void SCAPI SteamController_SetFilterCurve(SteamControllerFilter *pFilter, unsigned axis, float exponent) {
+  if (!pFilter || axis >= STEAMCONTROLLER_FILTER_AXIS_COUNT)
+    return;
+
+  float *pCurve = pFilter->axes[axis].curve;
+  for (int i=0; i<STEAMCONTROLLER_FILTER_CURVE_SIZE; i++)
+    pCurve[i] = powf((float)i / (STEAMCONTROLLER_FILTER_CURVE_SIZE - 1), exponent);
+}
+
+/**
+ * Keep reporting a DPAD direction until the thumb is this many degrees past
+ * the border of its quarter, so it doesn't flicker when the pad is pressed
+ * near a diagonal.
+ */
+void SCAPI SteamController_SetDpadHysteresis(SteamControllerFilter *pFilter, float degrees) {
+  if (!pFilter)
+    return;
+
+  pFilter->dpadHysteresis = cosf((45.0f + degrees) * (3.14159265f / 180.0f));
+}
+
+/** Weight of a new sample in a low pass filter with the given cutoff. */
+static inline float SteamController_SmoothingFactor(float cutoff, float deltaTime) {
+  float tau = 1.0f / (2.0f * 3.14159265f * cutoff);
+  return 1.0f / (1.0f + tau / deltaTime);
+}
+
+/**
+ * One Euro filter: a low pass filter with a cutoff that rises with speed, so
+ * it removes jitter at rest without lagging behind fast movements.
+ * See "1 Euro Filter: A Simple Speed-based Low-pass Filter for Noisy Input in
+ * Interactive Systems", G. Casiez, N. Roussel, D. Vogel, 2012.
+ */
+static inline float SteamController_OneEuro(const SteamControllerAxisFilter *pAxis, float *pValue, float *pDerivative, float x, float deltaTime) {
+  float derivative = (x - *pValue) / deltaTime;
+  *pDerivative += (derivative - *pDerivative) * SteamController_SmoothingFactor(STEAMCONTROLLER_ONE_EURO_DERIVATIVE_CUTOFF, deltaTime);
+
+  float cutoff = pAxis->minCutoff + pAxis->beta * fabsf(*pDerivative);
+  *pValue += (x - *pValue) * SteamController_SmoothingFactor(cutoff, deltaTime);
+  return *pValue;
+}
+
+/** Smooth the values of an axis in place, if smoothing is enabled. */
+static inline void SteamController_SmoothAxis(SteamControllerFilter *pFilter, unsigned axis, float *pValues, int valueCount, float deltaTime) {
+  const SteamControllerAxisFilter *pAxis = pFilter->axes + axis;
+  if (pAxis->minCutoff <= 0.0f || deltaTime <= 0.0f)
+    return;
+
+  if (!pFilter->hasValue[axis]) {
+    for (int i=0; i<valueCount; i++) {
+      pFilter->value[axis][i]       = pValues[i];
+      pFilter->derivative[axis][i]  = 0.0f;
+    }
+    pFilter->hasValue[axis] = true;
+    return;
+  }
+
+  for (int i=0; i<valueCount; i++)
+    pValues[i] = SteamController_OneEuro(pAxis, &pFilter->value[axis][i], &pFilter->derivative[axis][i], pValues[i], deltaTime);
+}
+
+/** Map a distance from 0 to 1 through the radial deadzone and the response curve. */
+static inline float SteamController_ApplyResponse(const SteamControllerAxisFilter *pAxis, float magnitude) {
+  float range = fmaxf(pAxis->outerDeadzone - pAxis->innerDeadzone, STEAMCONTROLLER_FILTER_MIN_MAGNITUDE);
+  float t     = fminf(fmaxf((magnitude - pAxis->innerDeadzone) / range, 0.0f), 1.0f);
+
+  // Linear interpolation between the two nearest points of the curve.
+  float position  = t * (STEAMCONTROLLER_FILTER_CURVE_SIZE - 1);
+  int   index     = (int)position;
+  index = index < STEAMCONTROLLER_FILTER_CURVE_SIZE - 2 ? index : STEAMCONTROLLER_FILTER_CURVE_SIZE - 2;
+
+  float fraction  = position - index;
+  return pAxis->curve[index] + (pAxis->curve[index + 1] - pAxis->curve[index]) * fraction;
+}
+
+static inline void SteamController_FilterPair(SteamControllerFilter *pFilter, unsigned axis, SteamControllerAxisPair *pPair, float deltaTime) {
+  const SteamControllerAxisFilter *pAxis = pFilter->axes + axis;
+
+  float values[2] = { pPair->x * (1.0f / 32767.0f), pPair->y * (1.0f / 32767.0f) };
+  SteamController_SmoothAxis(pFilter, axis, values, 2, deltaTime);
+
+  float axialScale = 1.0f / fmaxf(1.0f - pAxis->axialDeadzone, STEAMCONTROLLER_FILTER_MIN_MAGNITUDE);
+  float x = copysignf(fmaxf(fabsf(values[0]) - pAxis->axialDeadzone, 0.0f) * axialScale, values[0]);
+  float y = copysignf(fmaxf(fabsf(values[1]) - pAxis->axialDeadzone, 0.0f) * axialScale, values[1]);
+
+  // Scale the vector to the new length, keeping its direction.
+  float magnitude = sqrtf(x*x + y*y);
+  float factor    = SteamController_ApplyResponse(pAxis, magnitude) / fmaxf(magnitude, STEAMCONTROLLER_FILTER_MIN_MAGNITUDE) * 32767.0f;
+
+  pPair->x = (int16_t)lrintf(fminf(fmaxf(x * factor, -32767.0f), 32767.0f));
+  pPair->y = (int16_t)lrintf(fminf(fmaxf(y * factor, -32767.0f), 32767.0f));
+}
+
+static inline uint8_t SteamController_FilterTrigger(SteamControllerFilter *pFilter, unsigned axis, uint8_t trigger, float deltaTime) {
+  float value = trigger * (1.0f / 255.0f);
+  SteamController_SmoothAxis(pFilter, axis, &value, 1, deltaTime);
+
+  return (uint8_t)(SteamController_ApplyResponse(pFilter->axes + axis, value) * 255.0f + 0.5f);
+}
+
+/**
+ * Apply hysteresis to the DPAD bits. A new direction reported by the device
+ * is only taken once the thumb has left the current direction far enough.
+ * Pad coordinates are positive towards the right and the top.
+ */
+static inline uint32_t SteamController_FilterDpad(SteamControllerFilter *pFilter, uint32_t buttons, const SteamControllerAxisPair *pPad) {
+  uint32_t pressed = buttons & STEAMCONTROLLER_DPAD_MASK;
+
+  if (pressed && pFilter->dpadButtons && pressed != pFilter->dpadButtons) {
+    uint32_t current = pFilter->dpadButtons;
+    float dx = (float)!!(current & STEAMCONTROLLER_BUTTON_DPAD_RIGHT) - (float)!!(current & STEAMCONTROLLER_BUTTON_DPAD_LEFT);
+    float dy = (float)!!(current & STEAMCONTROLLER_BUTTON_DPAD_UP)    - (float)!!(current & STEAMCONTROLLER_BUTTON_DPAD_DOWN);
+
+    float x = pPad->x, y = pPad->y;
+    float dot = x * dx + y * dy;
+    if (dot >= sqrtf((x*x + y*y) * (dx*dx + dy*dy)) * pFilter->dpadHysteresis)
+      pressed = current;
+  }
+
+  pFilter->dpadButtons = pressed;
+  return (buttons & ~STEAMCONTROLLER_DPAD_MASK) | pressed;
+}
+
+/**
+ * Filter the fields of one update in place. Which axis leftXY belongs to is
+ * decided the same way as in SteamController_UpdateState. Smoothing of a pad
+ * starts over whenever the thumb is lifted.
+ */
+static inline void SteamController_FilterUpdate(SteamControllerFilter *pFilter, uint32_t *pButtons, uint8_t *pLeftTrigger, uint8_t *pRightTrigger, SteamControllerAxisPair *pLeft, SteamControllerAxisPair *pRight, float deltaTime) {
+  uint32_t buttons = *pButtons;
+
+  if (buttons & STEAMCONTROLLER_DPAD_MASK)
+    buttons = SteamController_FilterDpad(pFilter, buttons, pLeft);
+  else
+    pFilter->dpadButtons = 0;
+
+  if (buttons & STEAMCONTROLLER_BUTTON_LFINGER) {
+    SteamController_FilterPair(pFilter, STEAMCONTROLLER_FILTER_LEFT_PAD, pLeft, deltaTime);
+  } else {
+    SteamController_FilterPair(pFilter, STEAMCONTROLLER_FILTER_STICK, pLeft, deltaTime);
+    // With the flag, stick and pad reports alternate while the pad is touched.
+    if ((buttons & STEAMCONTROLLER_FLAG_PAD_STICK) == 0)
+      pFilter->hasValue[STEAMCONTROLLER_FILTER_LEFT_PAD] = false;
+  }
+
+  if (buttons & STEAMCONTROLLER_BUTTON_RFINGER)
+    SteamController_FilterPair(pFilter, STEAMCONTROLLER_FILTER_RIGHT_PAD, pRight, deltaTime);
+  else
+    pFilter->hasValue[STEAMCONTROLLER_FILTER_RIGHT_PAD] = false;
+
+  *pLeftTrigger   = SteamController_FilterTrigger(pFilter, STEAMCONTROLLER_FILTER_LEFT_TRIGGER,  *pLeftTrigger,  deltaTime);
+  *pRightTrigger  = SteamController_FilterTrigger(pFilter, STEAMCONTROLLER_FILTER_RIGHT_TRIGGER, *pRightTrigger, deltaTime);
+  *pButtons       = buttons;
+}
+
+/**
+ * Like SteamController_UpdateState, but sticks, pads, triggers and DPAD bits
+ * go through a filter chain first.
+ *
+ * @param pFilter     Filter chain of the controller.
+ * @param pState      State to update.
+ * @param pEvent      Event to use.
+ * @param deltaTime   Seconds since the previous update, only used for smoothing.
+ */
+void SCAPI SteamController_UpdateFilteredState(SteamControllerFilter *pFilter, SteamControllerState *pState, const SteamControllerEvent *pEvent, float deltaTime) {
+  if (pEvent->eventType != STEAMCONTROLLER_EVENT_UPDATE) {
+    SteamController_UpdateState(pState, pEvent);
+    return;
+  }
+
+  SteamControllerEvent filtered = *pEvent;
+  SteamController_FilterUpdate(pFilter, &filtered.update.buttons, &filtered.update.leftTrigger, &filtered.update.rightTrigger,
+    &filtered.update.leftXY, &filtered.update.rightXY, deltaTime);
+
+  SteamController_UpdateState(pState, &filtered);
+}
+
+/**
+ * Filter many decoded reports of one controller in place, for example from
+ * SteamController_DecodeUpdateBatch. Reports that are not updates are left alone.
+ *
+ * @param pFilter     Filter chain of the controller.
+ * @param pBatch      Decoded reports, buttons, triggers, leftX/Y and rightX/Y are modified.
+ * @param count       Number of reports.
+ * @param deltaTime   Seconds between two reports.
+ */
+void SCAPI SteamController_FilterUpdateBatch(SteamControllerFilter *pFilter, SteamControllerUpdateBatch *pBatch, size_t count, float deltaTime) {
+  for (size_t i=0; i<count; i++) {
+    if (pBatch->eventType[i] != STEAMCONTROLLER_EVENT_UPDATE)
+      continue;
+
+    SteamControllerAxisPair left  = { pBatch->leftX[i],  pBatch->leftY[i]  };
+    SteamControllerAxisPair right = { pBatch->rightX[i], pBatch->rightY[i] };
+
+    SteamController_FilterUpdate(pFilter, pBatch->buttons + i, pBatch->leftTrigger + i, pBatch->rightTrigger + i, &left, &right, deltaTime);
+
+    pBatch->leftX[i]  = left.x;
+    pBatch->leftY[i]  = left.y;
+    pBatch->rightX[i] = right.x;
+    pBatch->rightY[i] = right.y;
+  }
+}
@@ -0,0 +1,268 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STEAMCONTROLLER_FUSION_SSE2 1
+#endif
+
+#define STEAMCONTROLLER_ORIENTATION_SCALE   (1.0f / 32767.0f)
+
+/**
+ * Initialize an orientation estimate. The first update sets it from the
+ * device orientation, or from gravity if the filter is used.
+ *
+ * @param pFusion   Estimate to initialize.
+ * @param mode      One of STEAMCONTROLLER_FUSION_*.
+ * @param beta      Madgwick filter gain, 0 for STEAMCONTROLLER_FUSION_DEFAULT_BETA.
+ */
+void SCAPI SteamController_InitFusion(SteamControllerFusion *pFusion, unsigned mode, float beta) {
+  memset(pFusion, 0, sizeof(SteamControllerFusion));
+  pFusion->orientation.w  = 1.0f;
+  pFusion->mode           = mode;
+  pFusion->beta           = beta > 0.0f ? beta : STEAMCONTROLLER_FUSION_DEFAULT_BETA;
+}
+
+/**
+ * Rebuild a unit quaternion from its imaginary part. w is chosen positive, as
+ * q and -q are the same rotation. Vectors that are too long are normalized.
+ */
+static inline void SteamController_QuaternionFromVector(const SteamControllerVector *pVector, SteamControllerQuaternion *pQ) {
+  float x = pVector->x * STEAMCONTROLLER_ORIENTATION_SCALE;
+  float y = pVector->y * STEAMCONTROLLER_ORIENTATION_SCALE;
+  float z = pVector->z * STEAMCONTROLLER_ORIENTATION_SCALE;
+  float s = x*x + y*y + z*z;
+
+  if (s > 1.0f) {
+    float scale = 1.0f / sqrtf(s);
+    pQ->w = 0.0f;
+    pQ->x = x * scale;
+    pQ->y = y * scale;
+    pQ->z = z * scale;
+  }
+  else {
+    pQ->w = sqrtf(1.0f - s);
+    pQ->x = x;
+    pQ->y = y;
+    pQ->z = z;
+  }
+}
+
+/**
+ * Rotation without yaw that turns the earth z axis into the measured gravity,
+ * to start the filter close to the truth instead of converging slowly.
+ */
+static inline void SteamController_QuaternionFromGravity(float ax, float ay, float az, SteamControllerQuaternion *pQ) {
+  float norm = sqrtf(ax*ax + ay*ay + az*az);
+  if (norm == 0.0f) {
+    pQ->w = 1.0f; pQ->x = pQ->y = pQ->z = 0.0f;
+    return;
+  }
+
+  ax /= norm; ay /= norm; az /= norm;
+
+  // Upside down, any axis in the horizontal plane will do.
+  if (az < -0.9999f) {
+    pQ->w = 0.0f; pQ->x = 1.0f; pQ->y = pQ->z = 0.0f;
+    return;
+  }
+
+  float scale = 1.0f / sqrtf(2.0f * (1.0f + az));
+  pQ->w = (1.0f + az) * scale;
+  pQ->x = ay * scale;
+  pQ->y = -ax * scale;
+  pQ->z = 0.0f;
+}
+
+/**
+ * One step of the Madgwick IMU filter: integrate the angular velocity and
+ * correct the drift by one gradient descent step towards the measured gravity.
+ * See "An efficient orientation filter for inertial and inertial/magnetic
+ * sensor arrays", S. Madgwick, 2010.
+ */
+static inline void SteamController_MadgwickStep(SteamControllerQuaternion *pQ, float beta, float gx, float gy, float gz, float ax, float ay, float az, float deltaTime) {
+  float q0 = pQ->w, q1 = pQ->x, q2 = pQ->y, q3 = pQ->z;
+
+  // Rate of change from the gyroscope.
+  float qDot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+  float qDot1 = 0.5f * ( q0 * gx + q2 * gz - q3 * gy);
+  float qDot2 = 0.5f * ( q0 * gy - q1 * gz + q3 * gx);
+  float qDot3 = 0.5f * ( q0 * gz + q1 * gy - q2 * gx);
+
+  float aNorm = ax*ax + ay*ay + az*az;
+  if (aNorm > 0.0f) {
+    float recip = 1.0f / sqrtf(aNorm);
+    ax *= recip; ay *= recip; az *= recip;
+
+    float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2, _2q3 = 2.0f * q3;
+    float _4q0 = 4.0f * q0, _4q1 = 4.0f * q1, _4q2 = 4.0f * q2;
+    float _8q1 = 8.0f * q1, _8q2 = 8.0f * q2;
+    float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+
+    // Gradient of the error between estimated and measured gravity.
+    float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+    float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+    float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+    float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+    float sNorm = s0*s0 + s1*s1 + s2*s2 + s3*s3;
+    if (sNorm > 0.0f) {
+      recip = beta / sqrtf(sNorm);
+      qDot0 -= s0 * recip;
+      qDot1 -= s1 * recip;
+      qDot2 -= s2 * recip;
+      qDot3 -= s3 * recip;
+    }
+  }
+
+  q0 += qDot0 * deltaTime;
+  q1 += qDot1 * deltaTime;
+  q2 += qDot2 * deltaTime;
+  q3 += qDot3 * deltaTime;
+
+  float recip = 1.0f / sqrtf(q0*q0 + q1*q1 + q2*q2 + q3*q3);
+  pQ->w = q0 * recip;
+  pQ->x = q1 * recip;
+  pQ->y = q2 * recip;
+  pQ->z = q3 * recip;
+}
+
+/** Whether the device orientation is used for the next update. Latches in auto mode. */
+static inline bool SteamController_FusionUsesDevice(SteamControllerFusion *pFusion, int16_t x, int16_t y, int16_t z) {
+  if (pFusion->mode == STEAMCONTROLLER_FUSION_MADGWICK)
+    return false;
+
+  if (x || y || z)
+    pFusion->hasDeviceOrientation = true;
+
+  return pFusion->mode == STEAMCONTROLLER_FUSION_DEVICE || pFusion->hasDeviceOrientation;
+}
+
+static inline void SteamController_FusionFilter(SteamControllerFusion *pFusion, const SteamControllerVector *pAngularVelocity, const SteamControllerVector *pAcceleration, float deltaTime) {
+  // Accelerometer scale does not matter, it is normalized.
+  float ax = pAcceleration->x, ay = pAcceleration->y, az = pAcceleration->z;
+
+  if (pFusion->updateCount == 0) {
+    SteamController_QuaternionFromGravity(ax, ay, az, &pFusion->orientation);
+    return;
+  }
+
+  SteamController_MadgwickStep(&pFusion->orientation, pFusion->beta,
+    pAngularVelocity->x * STEAMCONTROLLER_RADIANS_PER_COUNT,
+    pAngularVelocity->y * STEAMCONTROLLER_RADIANS_PER_COUNT,
+    pAngularVelocity->z * STEAMCONTROLLER_RADIANS_PER_COUNT,
+    ax, ay, az, deltaTime);
+}
+
+/**
+ * Update an orientation estimate with an update event.
+ *
+ * @param pFusion     Estimate to update, the result is in pFusion->orientation.
+ * @param pUpdate     Update event of the controller.
+ * @param deltaTime   Seconds since the previous update, only used by the filter.
+ */
+void SCAPI SteamController_FusionUpdate(SteamControllerFusion *pFusion, const SteamControllerUpdateEvent *pUpdate, float deltaTime) {
+  if (SteamController_FusionUsesDevice(pFusion, pUpdate->orientation.x, pUpdate->orientation.y, pUpdate->orientation.z))
+    SteamController_QuaternionFromVector(&pUpdate->orientation, &pFusion->orientation);
+  else
+    SteamController_FusionFilter(pFusion, &pUpdate->angularVelocity, &pUpdate->acceleration, deltaTime);
+
+  pFusion->updateCount++;
+}
+
+/**
+ * Rebuild quaternions from the device orientation of many reports. Four at a
+ * time with SSE2, without branches: overlong vectors are scaled down and get a
+ * w of 0, just like in SteamController_QuaternionFromVector.
+ */
+static void SteamController_QuaternionsFromVectors(const int16_t *pX, const int16_t *pY, const int16_t *pZ, size_t count, SteamControllerQuaternion *pOrientations) {
+  size_t i = 0;
+
+#if STEAMCONTROLLER_FUSION_SSE2
+  const __m128 scale  = _mm_set1_ps(STEAMCONTROLLER_ORIENTATION_SCALE);
+  const __m128 one    = _mm_set1_ps(1.0f);
+  const __m128 zero   = _mm_setzero_ps();
+
+  for (; i+4<=count; i+=4) {
+    // Sign extend four words to dwords by unpacking them into the high halves.
+    __m128i x16 = _mm_loadl_epi64((const __m128i *)(pX + i));
+    __m128i y16 = _mm_loadl_epi64((const __m128i *)(pY + i));
+    __m128i z16 = _mm_loadl_epi64((const __m128i *)(pZ + i));
+
+    __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x16, x16), 16)), scale);
+    __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(y16, y16), 16)), scale);
+    __m128 z = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(z16, z16), 16)), scale);
+
+    __m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+
+    // 1 / sqrt(0) is infinite, the minimum takes care of it.
+    __m128 normalize = _mm_min_ps(one, _mm_div_ps(one, _mm_sqrt_ps(s)));
+    __m128 w = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(one, s)));
+
+    x = _mm_mul_ps(x, normalize);
+    y = _mm_mul_ps(y, normalize);
+    z = _mm_mul_ps(z, normalize);
+
+    _MM_TRANSPOSE4_PS(w, x, y, z);
+    _mm_storeu_ps((float *)(pOrientations + i),     w);
+    _mm_storeu_ps((float *)(pOrientations + i + 1), x);
+    _mm_storeu_ps((float *)(pOrientations + i + 2), y);
+    _mm_storeu_ps((float *)(pOrientations + i + 3), z);
+  }
+#endif
+
+  for (; i<count; i++) {
+    SteamControllerVector vector = { pX[i], pY[i], pZ[i] };
+    SteamController_QuaternionFromVector(&vector, pOrientations + i);
+  }
+}
+
+/**
+ * Update an orientation estimate with many decoded reports of one controller,
+ * for example from SteamController_DecodeUpdateBatch, and store the estimate
+ * after each of them. Reports that are not updates repeat the previous estimate.
+ *
+ * Device orientations are independent of each other and are converted four
+ * at a time. The filter depends on its previous step and runs sequentially.
+ *
+ * @param pFusion         Estimate to update.
+ * @param pBatch          Decoded reports.
+ * @param count           Number of reports.
+ * @param deltaTime       Seconds between two reports.
+ * @param pOrientations   Receives count estimates.
+ */
+void SCAPI SteamController_FusionUpdateBatch(SteamControllerFusion *pFusion, const SteamControllerUpdateBatch *pBatch, size_t count, float deltaTime, SteamControllerQuaternion *pOrientations) {
+  size_t i = 0;
+
+  // Filter until the device orientation takes over.
+  for (; i<count; i++) {
+    if (pBatch->eventType[i] == STEAMCONTROLLER_EVENT_UPDATE) {
+      if (SteamController_FusionUsesDevice(pFusion, pBatch->orientationX[i], pBatch->orientationY[i], pBatch->orientationZ[i]))
+        break;
+
+      SteamControllerVector angularVelocity = { pBatch->angularVelocityX[i], pBatch->angularVelocityY[i], pBatch->angularVelocityZ[i] };
+      SteamControllerVector acceleration    = { pBatch->accelerationX[i],    pBatch->accelerationY[i],    pBatch->accelerationZ[i]    };
+      SteamController_FusionFilter(pFusion, &angularVelocity, &acceleration, deltaTime);
+      pFusion->updateCount++;
+    }
+
+    pOrientations[i] = pFusion->orientation;
+  }
+
+  if (i == count)
+    return;
+
+  SteamController_QuaternionsFromVectors(pBatch->orientationX + i, pBatch->orientationY + i, pBatch->orientationZ + i, count - i, pOrientations + i);
+
+  // Fields of other reports are garbage, hold the last estimate over them.
+  for (; i<count; i++) {
+    if (pBatch->eventType[i] == STEAMCONTROLLER_EVENT_UPDATE) {
+      pFusion->orientation = pOrientations[i];
+      pFusion->updateCount++;
+    }
+    else
+      pOrientations[i] = pFusion->orientation;
+  }
+}
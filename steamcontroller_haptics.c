@@ -0,0 +1,307 @@
+#if _MSC_VER
+#pragma warning(disable: 4206)  // MSC: nonstandard extension used : translation unit is empty
+#endif
+
+#if __linux__
+
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#define STEAMCONTROLLER_HAPTIC_MOTOR_COUNT  2
+
+/** Pattern playing on one motor. */
+typedef struct {
+  SteamControllerHapticSegment  segments[STEAMCONTROLLER_HAPTIC_MAX_SEGMENTS];
+  size_t                        segmentCount;
+  size_t                        next;       /**< Index of the next segment to play, segmentCount when done. */
+  uint64_t                      nextTime;   /**< Host time the next segment is due. */
+} SteamControllerHapticTrack;
+
+struct SteamControllerHaptics {
+  SteamControllerDevice      *pDevice;
+  pthread_t                   thread;
+  pthread_mutex_t             mutex;
+  pthread_cond_t              condition;        /**< Signalled when a pattern changes, a report completes or the thread should stop. */
+  bool                        isRunning;
+  bool                        isReportPending;  /**< A report is in the command queue. */
+  uint64_t                    minInterval;      /**< Nanoseconds between two reports. */
+  uint64_t                    lastReportTime;
+  uint32_t                    dropCount;
+  SteamControllerHapticTrack  tracks[STEAMCONTROLLER_HAPTIC_MOTOR_COUNT];
+};
+
+/** Duration of a segment in nanoseconds. */
+static uint64_t SteamController_HapticSegmentDuration(const SteamControllerHapticSegment *pSegment) {
+  if (pSegment->duration)
+    return pSegment->duration * 1000000ull;
+
+  return ((uint64_t)pSegment->onTime + pSegment->offTime) * pSegment->count * 1000ull;
+}
+
+/**
+ * Skip segments that were due so long ago that the next one is due already.
+ * Sending them late would only push the rest of the pattern back. Must hold the mutex.
+ */
+static void SteamController_HapticDropLate(SteamControllerHaptics *pHaptics, SteamControllerHapticTrack *pTrack, uint64_t now) {
+  while (pTrack->next < pTrack->segmentCount) {
+    uint64_t duration = SteamController_HapticSegmentDuration(pTrack->segments + pTrack->next);
+    if (pTrack->nextTime + duration > now)
+      break;
+
+    pTrack->nextTime += duration;
+    pTrack->next++;
+    pHaptics->dropCount++;
+  }
+}
+
+/** Called on the command thread when a report has been sent. */
+static void SteamController_HapticReportComplete(SteamControllerDevice *pDevice, bool success, const uint8_t *pResponse, void *pUserData) {
+  (void)pDevice;
+  (void)success;
+  (void)pResponse;
+
+  SteamControllerHaptics *pHaptics = (SteamControllerHaptics *)pUserData;
+
+  pthread_mutex_lock(&pHaptics->mutex);
+  pHaptics->isReportPending = false;
+  pthread_cond_signal(&pHaptics->condition);
+  pthread_mutex_unlock(&pHaptics->mutex);
+}
+
+static void SteamController_HapticWaitUntil(SteamControllerHaptics *pHaptics, uint64_t hostTime) {
+  struct timespec deadline;
+  deadline.tv_sec   = hostTime / 1000000000ull;
+  deadline.tv_nsec  = hostTime % 1000000000ull;
+  pthread_cond_timedwait(&pHaptics->condition, &pHaptics->mutex, &deadline);
+}
+
+/**
+ * Plays the patterns. Reports go through the command queue with high
+ * priority, at most one at a time and no more often than the rate limit. A
+ * segment that can't be sent before the next one of its motor is due is
+ * dropped, so patterns stay on time when the device is slow.
+ */
+static void *SteamController_HapticThread(void *pArg) {
+  SteamControllerHaptics *pHaptics = (SteamControllerHaptics *)pArg;
+
+  pthread_mutex_lock(&pHaptics->mutex);
+  while (pHaptics->isRunning) {
+    uint64_t now = SteamController_GetHostTime();
+
+    // Find the motor that is due first.
+    SteamControllerHapticTrack *pTrack = NULL;
+    uint16_t motor = 0;
+    for (uint16_t i=0; i<STEAMCONTROLLER_HAPTIC_MOTOR_COUNT; i++) {
+      SteamControllerHapticTrack *pCandidate = pHaptics->tracks + i;
+      SteamController_HapticDropLate(pHaptics, pCandidate, now);
+
+      if (pCandidate->next < pCandidate->segmentCount && (!pTrack || pCandidate->nextTime < pTrack->nextTime)) {
+        pTrack  = pCandidate;
+        motor   = i;
+      }
+    }
+
+    if (!pTrack || pHaptics->isReportPending) {
+      pthread_cond_wait(&pHaptics->condition, &pHaptics->mutex);
+      continue;
+    }
+
+    uint64_t dueTime = pTrack->nextTime;
+    if (pHaptics->lastReportTime && dueTime < pHaptics->lastReportTime + pHaptics->minInterval)
+      dueTime = pHaptics->lastReportTime + pHaptics->minInterval;
+
+    if (dueTime > now) {
+      SteamController_HapticWaitUntil(pHaptics, dueTime);
+      continue;
+    }
+
+    const SteamControllerHapticSegment *pSegment = pTrack->segments + pTrack->next;
+    pTrack->nextTime += SteamController_HapticSegmentDuration(pSegment);
+    pTrack->next++;
+
+    // Pauses need no report.
+    if (!pSegment->count)
+      continue;
+
+    SteamController_HIDFeatureReport featureReport;
+    SteamController_BuildHapticReport(&featureReport, motor, pSegment->onTime, pSegment->offTime, pSegment->count);
+
+    pHaptics->isReportPending = true;
+    pHaptics->lastReportTime  = now;
+    if (!SteamController_SubmitFeatureReport(pHaptics->pDevice, (const uint8_t *)&featureReport, false, STEAMCONTROLLER_PRIORITY_HIGH, SteamController_HapticReportComplete, pHaptics)) {
+      pHaptics->isReportPending = false;
+      pHaptics->dropCount++;
+    }
+  }
+  pthread_mutex_unlock(&pHaptics->mutex);
+
+  return NULL;
+}
+
+/** Serializes creating the sequencer of a device on first use. */
+static pthread_mutex_t SteamController_HapticsCreateMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static SteamControllerHaptics *SteamController_CreateHaptics(SteamControllerDevice *pDevice) {
+  SteamControllerHaptics *pHaptics = malloc(sizeof(SteamControllerHaptics));
+  if (!pHaptics)
+    return NULL;
+
+  memset(pHaptics, 0, sizeof(SteamControllerHaptics));
+  pHaptics->pDevice     = pDevice;
+  pHaptics->isRunning   = true;
+  pHaptics->minInterval = 1000000000ull / STEAMCONTROLLER_HAPTIC_DEFAULT_RATE;
+
+  // Deadlines are in host time, which is CLOCK_MONOTONIC.
+  pthread_condattr_t conditionAttributes;
+  pthread_condattr_init(&conditionAttributes);
+  pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC);
+  pthread_cond_init(&pHaptics->condition, &conditionAttributes);
+  pthread_condattr_destroy(&conditionAttributes);
+  pthread_mutex_init(&pHaptics->mutex, NULL);
+
+  if (pthread_create(&pHaptics->thread, NULL, SteamController_HapticThread, pHaptics)) {
+    SteamController_LogErrno("pthread_create");
+    pthread_mutex_destroy(&pHaptics->mutex);
+    pthread_cond_destroy(&pHaptics->condition);
+    free(pHaptics);
+    return NULL;
+  }
+
+  return pHaptics;
+}
+
+static SteamControllerHaptics *SteamController_GetHaptics(SteamControllerDevice *pDevice) {
+  pthread_mutex_lock(&SteamController_HapticsCreateMutex);
+  if (!pDevice->pHaptics)
+    pDevice->pHaptics = SteamController_CreateHaptics(pDevice);
+  SteamControllerHaptics *pHaptics = pDevice->pHaptics;
+  pthread_mutex_unlock(&SteamController_HapticsCreateMutex);
+
+  return pHaptics;
+}
+
+/**
+ * Stop the sequencer thread of a device. Patterns that are still playing are
+ * cut off. Must be called before the command queue is stopped.
+ */
+void SteamController_StopHaptics(SteamControllerDevice *pDevice) {
+  SteamControllerHaptics *pHaptics = pDevice->pHaptics;
+  if (!pHaptics)
+    return;
+
+  pthread_mutex_lock(&pHaptics->mutex);
+  pHaptics->isRunning = false;
+  pthread_cond_signal(&pHaptics->condition);
+  pthread_mutex_unlock(&pHaptics->mutex);
+
+  pthread_join(pHaptics->thread, NULL);
+
+  // The completion callback of a report still in the queue refers to the sequencer.
+  SteamController_FlushCommands(pDevice);
+
+  pthread_cond_destroy(&pHaptics->condition);
+  pthread_mutex_destroy(&pHaptics->mutex);
+  pDevice->pHaptics = NULL;
+  free(pHaptics);
+}
+
+/**
+ * Play a pattern on one motor, in the background. It replaces whatever the
+ * motor is playing, unless that is the same pattern and it is not finished
+ * yet, so calling this every frame with the same effect is cheap.
+ *
+ * @param pDevice       Device to use.
+ * @param motor         Actuator to use, 0 == right, 1 == left.
+ * @param pSegments     Segments of the pattern, copied.
+ * @param segmentCount  Number of segments, at most STEAMCONTROLLER_HAPTIC_MAX_SEGMENTS.
+ * @return false if the arguments are invalid or the sequencer could not be started.
+ */
+bool SCAPI SteamController_PlayHapticPattern(SteamControllerDevice *pDevice, uint16_t motor, const SteamControllerHapticSegment *pSegments, size_t segmentCount) {
+  if (!pDevice || !pSegments || motor >= STEAMCONTROLLER_HAPTIC_MOTOR_COUNT)
+    return false;
+
+  if (!segmentCount || segmentCount > STEAMCONTROLLER_HAPTIC_MAX_SEGMENTS)
+    return false;
+
+  SteamControllerHaptics *pHaptics = SteamController_GetHaptics(pDevice);
+  if (!pHaptics)
+    return false;
+
+  size_t size = segmentCount * sizeof(SteamControllerHapticSegment);
+
+  pthread_mutex_lock(&pHaptics->mutex);
+  SteamControllerHapticTrack *pTrack = pHaptics->tracks + motor;
+
+  bool isPlaying = pTrack->next < pTrack->segmentCount;
+  if (!isPlaying || pTrack->segmentCount != segmentCount || memcmp(pTrack->segments, pSegments, size)) {
+    memcpy(pTrack->segments, pSegments, size);
+    pTrack->segmentCount  = segmentCount;
+    pTrack->next          = 0;
+    pTrack->nextTime      = SteamController_GetHostTime();
+    pthread_cond_signal(&pHaptics->condition);
+  }
+  pthread_mutex_unlock(&pHaptics->mutex);
+
+  return true;
+}
+
+/** Stop the pattern playing on a motor. The current burst plays to its end. */
+void SCAPI SteamController_StopHapticPattern(SteamControllerDevice *pDevice, uint16_t motor) {
+  if (!pDevice || motor >= STEAMCONTROLLER_HAPTIC_MOTOR_COUNT)
+    return;
+
+  pthread_mutex_lock(&SteamController_HapticsCreateMutex);
+  SteamControllerHaptics *pHaptics = pDevice->pHaptics;
+  pthread_mutex_unlock(&SteamController_HapticsCreateMutex);
+
+  if (!pHaptics)
+    return;
+
+  pthread_mutex_lock(&pHaptics->mutex);
+  pHaptics->tracks[motor].segmentCount = 0;
+  pHaptics->tracks[motor].next         = 0;
+  pthread_mutex_unlock(&pHaptics->mutex);
+}
+
+/**
+ * Limit the number of feature reports the sequencer sends, so haptics leave
+ * room for everything else the device has to do.
+ * @param reportsPerSecond  Maximum rate, 0 for STEAMCONTROLLER_HAPTIC_DEFAULT_RATE.
+ */
+void SCAPI SteamController_SetHapticRate(SteamControllerDevice *pDevice, unsigned reportsPerSecond) {
+  if (!pDevice)
+    return;
+
+  SteamControllerHaptics *pHaptics = SteamController_GetHaptics(pDevice);
+  if (!pHaptics)
+    return;
+
+  pthread_mutex_lock(&pHaptics->mutex);
+  pHaptics->minInterval = 1000000000ull / (reportsPerSecond ? reportsPerSecond : STEAMCONTROLLER_HAPTIC_DEFAULT_RATE);
+  pthread_cond_signal(&pHaptics->condition);
+  pthread_mutex_unlock(&pHaptics->mutex);
+}
+
+/** Number of segments dropped so far because the device could not keep up. */
+uint32_t SCAPI SteamController_GetHapticDropCount(const SteamControllerDevice *pDevice) {
+  if (!pDevice)
+    return 0;
+
+  pthread_mutex_lock(&SteamController_HapticsCreateMutex);
+  SteamControllerHaptics *pHaptics = pDevice->pHaptics;
+  pthread_mutex_unlock(&SteamController_HapticsCreateMutex);
+
+  if (!pHaptics)
+    return 0;
+
+  pthread_mutex_lock(&pHaptics->mutex);
+  uint32_t dropCount = pHaptics->dropCount;
+  pthread_mutex_unlock(&pHaptics->mutex);
+
+  return dropCount;
+}
+
+#endif
@@ -0,0 +1,436 @@
+#if _MSC_VER
+#pragma warning(disable: 4206)  // MSC: nonstandard extension used : translation unit is empty
+#endif
+
+#if __linux__
+
+#define _GNU_SOURCE     // struct ucred
+
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+
+#define STEAMCONTROLLER_UEVENT_BUFFER_SIZE  8192
+#define STEAMCONTROLLER_UEVENT_GROUP_UDEV   2             /**< Events rebroadcast by udev once the device node is ready. */
+#define STEAMCONTROLLER_UDEV_MAGIC          0xfeedcafe
+
+/** Header of the uevents udev rebroadcasts, followed by the variables. */
+typedef struct {
+  char      prefix[8];            /**< "libudev" */
+  uint32_t  magic;                /**< STEAMCONTROLLER_UDEV_MAGIC in network byte order. */
+  uint32_t  headerSize;
+  uint32_t  propertiesOffset;
+  uint32_t  propertiesLength;
+  uint32_t  filterSubsystemHash;
+  uint32_t  filterDevtypeHash;
+  uint32_t  filterTagBloomHi;
+  uint32_t  filterTagBloomLo;
+} SteamControllerUdevHeader;
+
+typedef struct {
+  char     *pSysPath;             /**< Kernel device path of the hidraw node, the key of the entry. */
+  char      devPath[64];          /**< Current device node. */
+  char      announcedPath[64];    /**< Device node the callback was last told about. */
+  bool      isPresent;
+  bool      isAnnounced;
+} SteamControllerRegistryEntry;
+
+struct SteamControllerRegistry {
+  char                            sysfsRoot[PATH_MAX];
+  int                             fd;
+  SteamControllerHotplugCallback  callback;
+  void                           *pUserData;
+  SteamControllerRegistryEntry   *pEntries;   /**< The id of an entry is its index + 1. Entries are never removed. */
+  size_t                          entryCount;
+  size_t                          entryCapacity;
+};
+
+static SteamControllerRegistryEntry *SteamController_RegistryFind(SteamControllerRegistry *pRegistry, const char *pSysPath) {
+  for (size_t i=0; i<pRegistry->entryCount; i++) {
+    if (!strcmp(pRegistry->pEntries[i].pSysPath, pSysPath))
+      return pRegistry->pEntries + i;
+  }
+  return NULL;
+}
+
+static SteamControllerRegistryEntry *SteamController_RegistryGetEntry(SteamControllerRegistry *pRegistry, const char *pSysPath) {
+  SteamControllerRegistryEntry *pEntry = SteamController_RegistryFind(pRegistry, pSysPath);
+  if (pEntry)
+    return pEntry;
+
+  if (pRegistry->entryCount == pRegistry->entryCapacity) {
+    size_t newCapacity = pRegistry->entryCapacity ? pRegistry->entryCapacity * 2 : 8;
+    SteamControllerRegistryEntry *pEntries = realloc(pRegistry->pEntries, newCapacity * sizeof(SteamControllerRegistryEntry));
+    if (!pEntries)
+      return NULL;
+
+    pRegistry->pEntries       = pEntries;
+    pRegistry->entryCapacity  = newCapacity;
+  }
+
+  pEntry = pRegistry->pEntries + pRegistry->entryCount;
+  memset(pEntry, 0, sizeof(SteamControllerRegistryEntry));
+  pEntry->pSysPath = strdup(pSysPath);
+  if (!pEntry->pSysPath)
+    return NULL;
+
+  pRegistry->entryCount++;
+  return pEntry;
+}
+
+/**
+ * Mark every device present that the sysfs scan finds, and every other one
+ * absent. Used initially and whenever uevents were lost.
+ */
+static void SteamController_RegistryRescan(SteamControllerRegistry *pRegistry) {
+  for (size_t i=0; i<pRegistry->entryCount; i++)
+    pRegistry->pEntries[i].isPresent = false;
+
+  SteamControllerDeviceEnum *pEnum = SteamController_EnumControllerDevicesAt(pRegistry->sysfsRoot);
+  while (pEnum) {
+    SteamControllerRegistryEntry *pEntry = SteamController_RegistryGetEntry(pRegistry, SteamController_GetEnumSysPath(pEnum));
+    if (pEntry) {
+      snprintf(pEntry->devPath, sizeof(pEntry->devPath), "%s", SteamController_GetEnumPath(pEnum));
+      pEntry->isPresent = true;
+    }
+
+    pEnum = SteamController_NextControllerDevice(pEnum);
+  }
+}
+
+/**
+ * Tell the callback about every change since the last call. A device that came
+ * and went in between is not reported at all.
+ * @return Number of notifications.
+ */
+static size_t SteamController_RegistryAnnounce(SteamControllerRegistry *pRegistry) {
+  size_t count = 0;
+
+  for (size_t i=0; i<pRegistry->entryCount; i++) {
+    SteamControllerRegistryEntry *pEntry = pRegistry->pEntries + i;
+    uint32_t deviceId = (uint32_t)(i + 1);
+
+    // Removed, or replaced by a different node at the same place.
+    if (pEntry->isAnnounced && (!pEntry->isPresent || strcmp(pEntry->announcedPath, pEntry->devPath))) {
+      pEntry->isAnnounced = false;
+      if (pRegistry->callback)
+        pRegistry->callback(deviceId, STEAMCONTROLLER_HOTPLUG_REMOVE, pEntry->announcedPath, pRegistry->pUserData);
+      count++;
+    }
+
+    if (!pEntry->isAnnounced && pEntry->isPresent) {
+      pEntry->isAnnounced = true;
+      strcpy(pEntry->announcedPath, pEntry->devPath);
+      if (pRegistry->callback)
+        pRegistry->callback(deviceId, STEAMCONTROLLER_HOTPLUG_ADD, pEntry->announcedPath, pRegistry->pUserData);
+      count++;
+    }
+  }
+
+  return count;
+}
+
+/**
+ * Apply a single uevent to the registry.
+ *
+ * Uevents rebroadcast by udev start with a SteamControllerUdevHeader instead
+ * of the first line, the variables are the same.
+ *
+ *  example uevent, each line is terminated by a zero byte:
+ *
+ *  add@/devices/pci0000:00/0000:00:14.0/usb1/1-2/1-2:1.1/0003:28DE:1142.0002/hidraw/hidraw1
+ *  ACTION=add
+ *  DEVPATH=/devices/pci0000:00/0000:00:14.0/usb1/1-2/1-2:1.1/0003:28DE:1142.0002/hidraw/hidraw1
+ *  SUBSYSTEM=hidraw
+ *  MAJOR=243
+ *  MINOR=1
+ *  DEVNAME=hidraw1
+ *  SEQNUM=3271
+ *
+ * @return true if the uevent was about a steam controller.
+ */
+static bool SteamController_RegistryHandleUevent(SteamControllerRegistry *pRegistry, const char *pUevent, size_t len) {
+  const char *pAction     = NULL;
+  const char *pDevPath    = NULL;
+  const char *pSubsystem  = NULL;
+
+  // Skip the header, the same information follows as variables.
+  size_t offset;
+  if (len >= sizeof(SteamControllerUdevHeader) && !memcmp(pUevent, "libudev", 8)) {
+    SteamControllerUdevHeader header;
+    memcpy(&header, pUevent, sizeof(header));
+
+    if (ntohl(header.magic) != STEAMCONTROLLER_UDEV_MAGIC || header.propertiesOffset < sizeof(header) ||
+        header.propertiesOffset > len || header.propertiesLength > len - header.propertiesOffset)
+      return false;
+
+    offset  = header.propertiesOffset;
+    len     = header.propertiesOffset + header.propertiesLength;
+  }
+  else
+    offset = strnlen(pUevent, len) + 1;
+
+  while (offset < len) {
+    const char *pLine = pUevent + offset;
+    size_t lineLen = strnlen(pLine, len - offset);
+    if (offset + lineLen >= len)
+      break;    // Not terminated, ignore it.
+
+    if (!strncmp(pLine, "ACTION=", 7))
+      pAction = pLine + 7;
+    else if (!strncmp(pLine, "DEVPATH=", 8))
+      pDevPath = pLine + 8;
+    else if (!strncmp(pLine, "SUBSYSTEM=", 10))
+      pSubsystem = pLine + 10;
+
+    offset += lineLen + 1;
+  }
+
+  if (!pAction || !pDevPath || !pSubsystem || strcmp(pSubsystem, "hidraw"))
+    return false;
+
+  if (!strcmp(pAction, "add")) {
+    char sysPath[PATH_MAX];
+    char devPath[64];
+    snprintf(sysPath, sizeof(sysPath), "%s%s", pRegistry->sysfsRoot, pDevPath);
+
+    // Same checks as the initial scan, but only for the new node.
+    if (!SteamController_CheckHidrawDevice(sysPath, devPath, sizeof(devPath)))
+      return false;
+
+    SteamControllerRegistryEntry *pEntry = SteamController_RegistryGetEntry(pRegistry, pDevPath);
+    if (!pEntry)
+      return false;
+
+    strcpy(pEntry->devPath, devPath);
+    pEntry->isPresent = true;
+    return true;
+  }
+
+  if (!strcmp(pAction, "remove")) {
+    // The sysfs entries are gone already, only known devices can be recognized.
+    SteamControllerRegistryEntry *pEntry = SteamController_RegistryFind(pRegistry, pDevPath);
+    if (!pEntry)
+      return false;
+
+    pEntry->isPresent = false;
+    return true;
+  }
+
+  return false;
+}
+
+static int SteamController_OpenUeventSocket() {
+  int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  if (fd < 0) {
+    SteamController_LogErrno("socket(NETLINK_KOBJECT_UEVENT)");
+    return -1;
+  }
+
+  struct sockaddr_nl addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family  = AF_NETLINK;
+  // The kernel announces a node before udev created it and set its permissions,
+  // so wait for udev to pass the event on.
+  addr.nl_groups  = STEAMCONTROLLER_UEVENT_GROUP_UDEV;
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    SteamController_LogErrno("bind(NETLINK_KOBJECT_UEVENT)");
+    close(fd);
+    return -1;
+  }
+
+  // Needed to tell udev apart from other processes.
+  int passCredentials = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &passCredentials, sizeof(passCredentials)) < 0) {
+    SteamController_LogErrno("setsockopt(SO_PASSCRED)");
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/**
+ * Create a device registry. It starts out with all controllers found in sysfs,
+ * they are announced on the first dispatch.
+ *
+ * The registry is not thread safe, and the callback is only ever called from
+ * SteamController_RegistryDispatch and SteamController_RegistryInjectUevent.
+ *
+ * @param pSysfsRoot  Where sysfs is mounted, NULL for "/sys". Tests can point this to a fake tree.
+ * @param flags       STEAMCONTROLLER_REGISTRY_* flags.
+ * @param callback    Called for every device that is added or removed, may be NULL.
+ * @param pUserData   Passed to the callback.
+ * @return New registry or NULL on failure.
+ */
+SteamControllerRegistry *SteamController_CreateRegistry(const char *pSysfsRoot, unsigned flags, SteamControllerHotplugCallback callback, void *pUserData) {
+  SteamControllerRegistry *pRegistry = malloc(sizeof(SteamControllerRegistry));
+  if (!pRegistry)
+    return NULL;
+
+  memset(pRegistry, 0, sizeof(SteamControllerRegistry));
+  pRegistry->fd         = -1;
+  pRegistry->callback   = callback;
+  pRegistry->pUserData  = pUserData;
+
+  // Uevents carry the resolved path, so the root must be resolved too.
+  if (!realpath(pSysfsRoot ? pSysfsRoot : "/sys", pRegistry->sysfsRoot)) {
+    SteamController_LogErrno(pSysfsRoot ? pSysfsRoot : "/sys");
+    free(pRegistry);
+    return NULL;
+  }
+
+  // Listen before scanning, so nothing plugged in meanwhile gets lost.
+  if (flags & STEAMCONTROLLER_REGISTRY_NETLINK) {
+    pRegistry->fd = SteamController_OpenUeventSocket();
+    if (pRegistry->fd < 0) {
+      free(pRegistry);
+      return NULL;
+    }
+  }
+
+  SteamController_RegistryRescan(pRegistry);
+  return pRegistry;
+}
+
+void SCAPI SteamController_DestroyRegistry(SteamControllerRegistry *pRegistry) {
+  if (!pRegistry)
+    return;
+
+  if (pRegistry->fd >= 0)
+    close(pRegistry->fd);
+
+  for (size_t i=0; i<pRegistry->entryCount; i++)
+    free(pRegistry->pEntries[i].pSysPath);
+
+  free(pRegistry->pEntries);
+  free(pRegistry);
+}
+
+/**
+ * Get the file descriptor to poll for readability, after which
+ * SteamController_RegistryDispatch should be called.
+ * @return -1 if the registry was created without STEAMCONTROLLER_REGISTRY_NETLINK.
+ */
+int SCAPI SteamController_RegistryGetFd(const SteamControllerRegistry *pRegistry) {
+  return pRegistry ? pRegistry->fd : -1;
+}
+
+/**
+ * Process all pending uevents without blocking and call the callback for
+ * every device that was added or removed.
+ * @return Number of notifications.
+ */
+size_t SCAPI SteamController_RegistryDispatch(SteamControllerRegistry *pRegistry) {
+  if (!pRegistry)
+    return 0;
+
+  if (pRegistry->fd >= 0) {
+    char buffer[STEAMCONTROLLER_UEVENT_BUFFER_SIZE];
+
+    for (;;) {
+      struct sockaddr_nl  addr;
+      struct iovec        iov = { buffer, sizeof(buffer) };
+      char                control[CMSG_SPACE(sizeof(struct ucred))];
+      struct msghdr       msg;
+
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name        = &addr;
+      msg.msg_namelen     = sizeof(addr);
+      msg.msg_iov         = &iov;
+      msg.msg_iovlen      = 1;
+      msg.msg_control     = control;
+      msg.msg_controllen  = sizeof(control);
+
+      ssize_t len = recvmsg(pRegistry->fd, &msg, 0);
+      if (len < 0) {
+        if (errno == EINTR)
+          continue;
+
+        // The socket buffer overflowed and events were dropped, start over.
+        if (errno == ENOBUFS) {
+          SteamController_RegistryRescan(pRegistry);
+          continue;
+        }
+
+        if (errno != EAGAIN)
+          SteamController_LogErrno("recvmsg(NETLINK_KOBJECT_UEVENT)");
+        break;
+      }
+
+      // Only trust udev, which runs as root.
+      struct cmsghdr *pCmsg = CMSG_FIRSTHDR(&msg);
+      if (msg.msg_namelen != sizeof(addr) || (msg.msg_flags & MSG_TRUNC) || !pCmsg ||
+          pCmsg->cmsg_level != SOL_SOCKET || pCmsg->cmsg_type != SCM_CREDENTIALS)
+        continue;
+
+      struct ucred credentials;
+      memcpy(&credentials, CMSG_DATA(pCmsg), sizeof(credentials));
+      if (credentials.uid != 0)
+        continue;
+
+      SteamController_RegistryHandleUevent(pRegistry, buffer, (size_t)len);
+    }
+  }
+
+  return SteamController_RegistryAnnounce(pRegistry);
+}
+
+/**
+ * Feed a uevent to the registry as if it came from udev, and dispatch the
+ * result. For testing, together with a fake sysfs root.
+ *
+ * @param pUevent   Uevent in the kernel format, a header and variables, each terminated by a zero byte, or in the udev format.
+ * @param len       Length of pUevent in bytes, including the last terminator.
+ * @return true if the uevent was about a steam controller.
+ */
+bool SCAPI SteamController_RegistryInjectUevent(SteamControllerRegistry *pRegistry, const char *pUevent, size_t len) {
+  if (!pRegistry || !pUevent)
+    return false;
+
+  bool isRelevant = SteamController_RegistryHandleUevent(pRegistry, pUevent, len);
+  SteamController_RegistryAnnounce(pRegistry);
+  return isRelevant;
+}
+
+/**
+ * Get the ids of all devices that are currently present and were announced.
+ * @return Number of ids stored.
+ */
+size_t SCAPI SteamController_RegistryGetDevices(const SteamControllerRegistry *pRegistry, uint32_t *pDeviceIds, size_t maxDevices) {
+  if (!pRegistry)
+    return 0;
+
+  size_t count = 0;
+  for (size_t i=0; i<pRegistry->entryCount && count<maxDevices; i++) {
+    if (pRegistry->pEntries[i].isAnnounced)
+      pDeviceIds[count++] = (uint32_t)(i + 1);
+  }
+
+  return count;
+}
+
+/**
+ * Open a device of the registry.
+ * @param flags   STEAMCONTROLLER_OPEN_* flags.
+ * @return New device or NULL if the device is not present or could not be opened.
+ */
+SteamControllerDevice *SteamController_RegistryOpen(const SteamControllerRegistry *pRegistry, uint32_t deviceId, unsigned flags) {
+  if (!pRegistry || deviceId == 0 || deviceId > pRegistry->entryCount)
+    return NULL;
+
+  const SteamControllerRegistryEntry *pEntry = pRegistry->pEntries + deviceId - 1;
+  if (!pEntry->isAnnounced)
+    return NULL;
+
+  return SteamController_OpenPath(pEntry->announcedPath, flags);
+}
+
+#endif
@@ -0,0 +1,170 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+struct SteamControllerLatency {
+  SteamControllerHistogram  stages[STEAMCONTROLLER_LATENCY_STAGE_COUNT];
+};
+
+/** Index of the highest set bit of a value that is not zero. */
+static inline unsigned SteamController_HighestBit(uint64_t value) {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(value);
+#else
+  unsigned bit = 0;
+  while (value >>= 1)
+    bit++;
+  return bit;
+#endif
+}
+
+static inline unsigned SteamController_LatencyBucket(uint64_t nanoseconds) {
+  if (nanoseconds < STEAMCONTROLLER_LATENCY_SUB_BUCKETS)
+    return (unsigned)nanoseconds;
+
+  unsigned exponent = SteamController_HighestBit(nanoseconds);
+  if (exponent > STEAMCONTROLLER_LATENCY_MAX_EXPONENT)
+    return STEAMCONTROLLER_LATENCY_BUCKETS - 1;
+
+  unsigned shift = exponent - STEAMCONTROLLER_LATENCY_SUB_BUCKET_BITS;
+  return (shift + 1) * STEAMCONTROLLER_LATENCY_SUB_BUCKETS + (unsigned)(nanoseconds >> shift) - STEAMCONTROLLER_LATENCY_SUB_BUCKETS;
+}
+
+/** Largest latency that falls into a bucket. The last bucket also takes everything beyond it. */
+static inline uint64_t SteamController_LatencyBucketLimit(unsigned bucket) {
+  if (bucket < STEAMCONTROLLER_LATENCY_SUB_BUCKETS)
+    return bucket;
+  if (bucket == STEAMCONTROLLER_LATENCY_BUCKETS - 1)
+    return UINT64_MAX;
+
+  unsigned shift  = bucket / STEAMCONTROLLER_LATENCY_SUB_BUCKETS - 1;
+  uint64_t lower  = (uint64_t)(STEAMCONTROLLER_LATENCY_SUB_BUCKETS + bucket % STEAMCONTROLLER_LATENCY_SUB_BUCKETS) << shift;
+  return lower + ((uint64_t)1 << shift) - 1;
+}
+
+/**
+ * Count a latency of a device. Only call this if SteamController_IsTrackingLatency
+ * returned true.
+ */
+void SteamController_RecordLatency(const SteamControllerDevice *pDevice, unsigned stage, uint64_t nanoseconds) {
+  SteamControllerLatency *pLatency = SteamController_AtomicLoadPtr(&pDevice->pLatency);
+  SteamController_HistogramRecord(&pLatency->stages[stage], nanoseconds);
+}
+
+/** Count a latency. Any number of threads may record at once. Wait free, a few atomic adds. */
+void SteamController_HistogramRecord(SteamControllerHistogram *pHistogram, uint64_t nanoseconds) {
+  SteamController_AtomicAdd32(&pHistogram->buckets[SteamController_LatencyBucket(nanoseconds)], 1);
+  SteamController_AtomicAdd64(&pHistogram->count, 1);
+  SteamController_AtomicAdd64(&pHistogram->sum, nanoseconds);
+
+  uint64_t max = SteamController_AtomicLoad64(&pHistogram->max);
+  while (nanoseconds > max && !SteamController_AtomicCompareExchange64(&pHistogram->max, &max, nanoseconds))
+    ;
+}
+
+/**
+ * Start or stop counting latencies of a device. While stopped, the cost of
+ * the instrumentation is one atomic load per report. The histograms are kept
+ * while stopped, use SteamController_ResetLatencyStats to clear them.
+ * @return false if the histograms could not be allocated.
+ */
+bool SCAPI SteamController_EnableLatencyTracking(SteamControllerDevice *pDevice, bool enable) {
+  if (!pDevice)
+    return false;
+
+  if (enable && !SteamController_AtomicLoadPtr(&pDevice->pLatency)) {
+    SteamControllerLatency *pLatency = calloc(1, sizeof(SteamControllerLatency));
+    if (!pLatency)
+      return false;
+
+    void *pExpected = NULL;
+    if (!SteamController_AtomicCompareExchangePtr(&pDevice->pLatency, &pExpected, pLatency))
+      free(pLatency);
+  }
+
+  SteamController_AtomicStore32(&pDevice->isTrackingLatency, enable);
+  return true;
+}
+
+/** Clear the latency histograms of a device. Latencies recorded meanwhile may be lost. */
+void SCAPI SteamController_ResetLatencyStats(SteamControllerDevice *pDevice) {
+  if (!pDevice)
+    return;
+
+  SteamControllerLatency *pLatency = SteamController_AtomicLoadPtr(&pDevice->pLatency);
+  if (!pLatency)
+    return;
+
+  for (unsigned stage=0; stage<STEAMCONTROLLER_LATENCY_STAGE_COUNT; stage++)
+    SteamController_HistogramReset(&pLatency->stages[stage]);
+}
+
+/** Clear a histogram. Latencies recorded meanwhile may be lost. */
+void SteamController_HistogramReset(SteamControllerHistogram *pHistogram) {
+  for (unsigned bucket=0; bucket<STEAMCONTROLLER_LATENCY_BUCKETS; bucket++)
+    SteamController_AtomicStoreRelaxed32(&pHistogram->buckets[bucket], 0);
+
+  SteamController_AtomicStore64(&pHistogram->count, 0);
+  SteamController_AtomicStore64(&pHistogram->sum, 0);
+  SteamController_AtomicStore64(&pHistogram->max, 0);
+}
+
+/**
+ * Get percentiles of one latency stage of a device. Safe to call from any
+ * thread while latencies are recorded, takes no locks.
+ *
+ * @param pDevice   Device to query.
+ * @param stage     STEAMCONTROLLER_LATENCY_* stage.
+ * @param pStats    Where to store the statistics, all zero if nothing was recorded.
+ * @return false if the stage is not valid.
+ */
+bool SCAPI SteamController_GetLatencyStats(const SteamControllerDevice *pDevice, unsigned stage, SteamControllerLatencyStats *pStats) {
+  if (!pDevice || !pStats || stage >= STEAMCONTROLLER_LATENCY_STAGE_COUNT)
+    return false;
+
+  SteamControllerLatency *pLatency = SteamController_AtomicLoadPtr(&pDevice->pLatency);
+  if (!pLatency) {
+    memset(pStats, 0, sizeof(SteamControllerLatencyStats));
+    return true;
+  }
+
+  SteamController_HistogramGetStats(&pLatency->stages[stage], pStats);
+  return true;
+}
+
+/**
+ * Get percentiles of a histogram. Safe to call while latencies are recorded.
+ * Percentiles are the upper bound of their bucket, never more than the maximum.
+ */
+void SteamController_HistogramGetStats(const SteamControllerHistogram *pHistogram, SteamControllerLatencyStats *pStats) {
+  memset(pStats, 0, sizeof(SteamControllerLatencyStats));
+
+  // Take the bucket counts once. The count is summed from them, so the
+  // percentiles agree with each other even while recording goes on.
+  static const unsigned percentiles[] = { 50, 90, 99 };
+  uint64_t *pResults[] = { &pStats->p50, &pStats->p90, &pStats->p99 };
+
+  uint32_t buckets[STEAMCONTROLLER_LATENCY_BUCKETS];
+  uint64_t count = 0;
+  for (unsigned bucket=0; bucket<STEAMCONTROLLER_LATENCY_BUCKETS; bucket++) {
+    buckets[bucket] = SteamController_AtomicLoadRelaxed32(&pHistogram->buckets[bucket]);
+    count += buckets[bucket];
+  }
+
+  if (!count)
+    return;
+
+  pStats->count = count;
+  pStats->max   = SteamController_AtomicLoad64(&pHistogram->max);
+  pStats->mean  = SteamController_AtomicLoad64(&pHistogram->sum) / count;
+
+  uint64_t  seen  = 0;
+  unsigned  next  = 0;
+  for (unsigned bucket=0; bucket<STEAMCONTROLLER_LATENCY_BUCKETS && next<3; bucket++) {
+    seen += buckets[bucket];
+
+    while (next < 3 && seen * 100 >= count * percentiles[next]) {
+      uint64_t limit = SteamController_LatencyBucketLimit(bucket);
+      *pResults[next++] = limit < pStats->max ? limit : pStats->max;
+    }
+  }
+}
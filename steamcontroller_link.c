@@ -0,0 +1,293 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#define STEAMCONTROLLER_LINK_STATS_WORDS    (sizeof(SteamControllerLinkStats) / 4)
+
+#define STEAMCONTROLLER_LINK_RATE_WEIGHT    (1.0f / 32.0f)    /**< Weight of a new arrival in the report interval average. */
+#define STEAMCONTROLLER_LINK_LOSS_WEIGHT    (1.0f / 64.0f)    /**< Weight of one expected report in the loss average. */
+#define STEAMCONTROLLER_LINK_JITTER_WEIGHT  (1.0f / 16.0f)    /**< As in RFC 3550. */
+#define STEAMCONTROLLER_LINK_MAX_GAP        1024              /**< Longer gaps are a restart of the counter, not loss. */
+#define STEAMCONTROLLER_LINK_WARMUP         64                /**< Reports after a restart before thresholds are checked. */
+#define STEAMCONTROLLER_LINK_HYSTERESIS     0.8f              /**< A condition clears once it is this far within its threshold. */
+#define STEAMCONTROLLER_LINK_STEP_WINDOW    16                /**< Advances of the counter the step is estimated from. */
+#define STEAMCONTROLLER_LINK_LOST_HISTORY   64                /**< Reports behind the newest one a late report is matched against. */
+
+_Static_assert(sizeof(SteamControllerLinkStats) % 4 == 0, "link stats are copied in 32 bit words");
+
+struct SteamControllerLink {
+  // Only touched by the thread decoding the events of the device.
+  SteamControllerLinkStats      stats;
+  bool                          hasSequence;
+  uint32_t                      lastSequence;
+  uint32_t                      sequenceStep;     /**< Most frequent recent advance of the counter, one report. */
+  uint32_t                      steps[STEAMCONTROLLER_LINK_STEP_WINDOW];    /**< Recent advances of the counter, 0 if unused. */
+  uint32_t                      stepIndex;
+  uint64_t                      lostMask;         /**< Bit n is set if the report n steps before lastSequence was lost. */
+  uint32_t                      warmupCount;
+  uint64_t                      lastArrival;
+  float                         interval;         /**< Average time between arrivals in nanoseconds. */
+
+  SteamControllerLinkThresholds thresholds;
+  SteamControllerLinkCallback   callback;
+  void                         *pUserData;
+
+  // Published copy of stats for any thread.
+  SteamControllerAtomicU32      sequence;
+  SteamControllerAtomicU32      words[STEAMCONTROLLER_LINK_STATS_WORDS];
+};
+
+/** Forget the counter, the next update starts over. Totals are kept. */
+static void SteamController_LinkRestart(SteamControllerLink *pLink) {
+  pLink->hasSequence  = false;
+  pLink->sequenceStep = 0;
+  pLink->stepIndex    = 0;
+  pLink->lostMask     = 0;
+  pLink->warmupCount  = 0;
+  memset(pLink->steps, 0, sizeof(pLink->steps));
+}
+
+static inline uint32_t SteamController_LinkCountSteps(const SteamControllerLink *pLink, uint32_t step) {
+  uint32_t count = 0;
+  for (int i=0; i<STEAMCONTROLLER_LINK_STEP_WINDOW; i++)
+    count += pLink->steps[i] == step;
+  return count;
+}
+
+/**
+ * Estimate how far the counter advances per report from one more advance.
+ * The estimate is the most frequent of the recent advances, so neither lost
+ * reports nor a single short advance throw it off.
+ */
+static void SteamController_LinkEstimateStep(SteamControllerLink *pLink, uint32_t delta) {
+  pLink->steps[pLink->stepIndex] = delta;
+  pLink->stepIndex = (pLink->stepIndex + 1) % STEAMCONTROLLER_LINK_STEP_WINDOW;
+
+  if (pLink->sequenceStep == delta)
+    return;
+
+  uint32_t count      = SteamController_LinkCountSteps(pLink, delta);
+  uint32_t stepCount  = SteamController_LinkCountSteps(pLink, pLink->sequenceStep);
+  if (!pLink->sequenceStep || count > stepCount || (count == stepCount && delta < pLink->sequenceStep)) {
+    pLink->sequenceStep = delta;
+    pLink->lostMask     = 0;    // Positions in units of the old step.
+  }
+}
+
+/** Number of reports a difference of the counter spans, rounded. */
+static inline uint32_t SteamController_LinkSteps(const SteamControllerLink *pLink, uint32_t delta) {
+  return (delta + pLink->sequenceStep / 2) / pLink->sequenceStep;
+}
+
+/** Start over at a counter that jumped too far to be loss. */
+static void SteamController_LinkJump(SteamControllerLink *pLink, uint32_t sequence, uint64_t arrival) {
+  pLink->stats.restartCount++;
+  SteamController_LinkRestart(pLink);
+  pLink->hasSequence  = true;
+  pLink->lastSequence = sequence;
+  pLink->lastArrival  = arrival;
+}
+
+/** Set or clear one condition, with some hysteresis so it does not flap. */
+static inline void SteamController_LinkCondition(uint32_t *pDegraded, uint32_t flag, float value, float threshold, bool isUpperLimit) {
+  if (threshold <= 0.0f)
+    *pDegraded &= ~flag;
+  else if (isUpperLimit ? value > threshold : value < threshold)
+    *pDegraded |= flag;
+  else if (isUpperLimit ? value < threshold * STEAMCONTROLLER_LINK_HYSTERESIS : value * STEAMCONTROLLER_LINK_HYSTERESIS > threshold)
+    *pDegraded &= ~flag;
+}
+
+/** Account for a report that advanced the counter by a number of reports. */
+static void SteamController_LinkAdvance(SteamControllerLink *pLink, uint32_t steps, uint64_t arrival) {
+  SteamControllerLinkStats *pStats = &pLink->stats;
+
+  uint32_t lost = steps - 1;
+  if (lost) {
+    pStats->gapCount++;
+    pStats->lostCount += lost;
+  }
+
+  // Remember which of the skipped reports may still arrive late.
+  pLink->lostMask = steps < STEAMCONTROLLER_LINK_LOST_HISTORY ? pLink->lostMask << steps : 0;
+  for (uint32_t i=1; i<steps && i<STEAMCONTROLLER_LINK_LOST_HISTORY; i++)
+    pLink->lostMask |= (uint64_t)1 << i;
+
+  float weight = (lost + 1) * STEAMCONTROLLER_LINK_LOSS_WEIGHT;
+  if (weight > 1.0f)
+    weight = 1.0f;
+  pStats->lossRatio += ((float)lost / (lost + 1) - pStats->lossRatio) * weight;
+
+  float elapsed = (float)(arrival - pLink->lastArrival);
+  if (pLink->interval <= 0.0f)
+    pLink->interval = elapsed / steps;
+  else
+    pLink->interval += (elapsed - pLink->interval) * STEAMCONTROLLER_LINK_RATE_WEIGHT;
+
+  if (pLink->interval > 0.0f)
+    pStats->reportRate = 1e9f / pLink->interval;
+
+  // The counter is the send time in units of the report interval, so the
+  // difference in transit time of two reports is this.
+  float transit = elapsed - steps * pLink->interval;
+  if (transit < 0.0f)
+    transit = -transit;
+  pStats->jitter += (transit - pStats->jitter) * STEAMCONTROLLER_LINK_JITTER_WEIGHT;
+}
+
+/**
+ * Update the link statistics of a device with an event. Only call this from
+ * the thread decoding the events of the device and if SteamController_IsTrackingLink
+ * returned true.
+ *
+ * @param pDevice   Device the event came from.
+ * @param pEvent    Decoded event.
+ * @param arrival   Host time at which the report of the event was read.
+ */
+void SteamController_LinkUpdate(const SteamControllerDevice *pDevice, const SteamControllerEvent *pEvent, uint64_t arrival) {
+  SteamControllerLink       *pLink  = SteamController_AtomicLoadPtr(&pDevice->pLink);
+  SteamControllerLinkStats  *pStats = &pLink->stats;
+
+  if (pEvent->eventType == STEAMCONTROLLER_EVENT_CONNECTION) {
+    if (pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_CONNECTED || pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED)
+      SteamController_LinkRestart(pLink);
+    return;
+  }
+
+  if (pEvent->eventType != STEAMCONTROLLER_EVENT_UPDATE)
+    return;
+
+  uint32_t sequence = pEvent->update.timeStamp;
+  pStats->receivedCount++;
+
+  if (!pLink->hasSequence) {
+    pLink->hasSequence  = true;
+    pLink->lastSequence = sequence;
+    pLink->lastArrival  = arrival;
+  } else {
+    int32_t delta = (int32_t)(sequence - pLink->lastSequence);
+
+    if (delta == 0) {
+      pStats->duplicateCount++;
+    } else if (delta < 0) {
+      uint32_t steps = pLink->sequenceStep ? SteamController_LinkSteps(pLink, (uint32_t)-delta) : 0;
+
+      if (!pLink->sequenceStep || steps > STEAMCONTROLLER_LINK_MAX_GAP) {
+        SteamController_LinkJump(pLink, sequence, arrival);
+      } else if (steps < STEAMCONTROLLER_LINK_LOST_HISTORY && (pLink->lostMask & ((uint64_t)1 << steps))) {
+        // A late report, it was counted as lost when the gap was seen.
+        pLink->lostMask &= ~((uint64_t)1 << steps);
+        pStats->reorderCount++;
+        pStats->lostCount--;
+      } else if (steps < STEAMCONTROLLER_LINK_LOST_HISTORY) {
+        pStats->duplicateCount++;
+      }
+    } else {
+      SteamController_LinkEstimateStep(pLink, (uint32_t)delta);
+
+      uint32_t steps = SteamController_LinkSteps(pLink, (uint32_t)delta);
+      if (!steps)
+        steps = 1;    // Shorter than usual, the counter runs unevenly.
+
+      if (steps > STEAMCONTROLLER_LINK_MAX_GAP) {
+        SteamController_LinkJump(pLink, sequence, arrival);
+      } else {
+        SteamController_LinkAdvance(pLink, steps, arrival);
+        if (pLink->warmupCount < STEAMCONTROLLER_LINK_WARMUP)
+          pLink->warmupCount++;
+
+        pLink->lastSequence = sequence;
+        pLink->lastArrival  = arrival;
+      }
+    }
+  }
+
+  uint32_t degraded = pStats->degraded;
+  if (pLink->warmupCount >= STEAMCONTROLLER_LINK_WARMUP) {
+    SteamController_LinkCondition(&degraded, STEAMCONTROLLER_LINK_LOW_RATE,    pStats->reportRate, pLink->thresholds.minReportRate, false);
+    SteamController_LinkCondition(&degraded, STEAMCONTROLLER_LINK_HIGH_LOSS,   pStats->lossRatio,  pLink->thresholds.maxLossRatio,  true);
+    SteamController_LinkCondition(&degraded, STEAMCONTROLLER_LINK_HIGH_JITTER, pStats->jitter,     pLink->thresholds.maxJitter,     true);
+  }
+
+  bool hasChanged = degraded != pStats->degraded;
+  pStats->degraded = degraded;
+
+  SteamController_SeqlockWrite(&pLink->sequence, pLink->words, pStats, STEAMCONTROLLER_LINK_STATS_WORDS);
+
+  if (hasChanged && pLink->callback)
+    pLink->callback(pDevice, pStats, pLink->pUserData);
+}
+
+/**
+ * Start or stop tracking the quality of the link to a device. The statistics
+ * are derived from the counter in update reports and the host time they
+ * arrive at, and cost a few float operations per report. They are kept while
+ * tracking is stopped.
+ * @return false if the statistics could not be allocated.
+ */
+bool SCAPI SteamController_EnableLinkStats(SteamControllerDevice *pDevice, bool enable) {
+  if (!pDevice)
+    return false;
+
+  if (enable && !SteamController_AtomicLoadPtr(&pDevice->pLink)) {
+    SteamControllerLink *pLink = calloc(1, sizeof(SteamControllerLink));
+    if (!pLink)
+      return false;
+
+    void *pExpected = NULL;
+    if (!SteamController_AtomicCompareExchangePtr(&pDevice->pLink, &pExpected, pLink))
+      free(pLink);
+  }
+
+  SteamController_AtomicStore32(&pDevice->isTrackingLink, enable);
+  return true;
+}
+
+/**
+ * Set limits for the link quality of a device and a function to call when
+ * the link crosses them. The callback runs on the thread decoding the events
+ * of the device, each time the set of exceeded limits changes. Limits are
+ * checked once some reports arrived after a (re)connect. Must be called while
+ * no other thread reads events from the device.
+ *
+ * @param pDevice       Device with link statistics enabled.
+ * @param pThresholds   Limits, a limit of 0 is not checked. NULL checks none.
+ * @param callback      Function to call, or NULL.
+ * @param pUserData     Passed to the callback.
+ * @return false if link statistics are not enabled for the device.
+ */
+bool SCAPI SteamController_SetLinkThresholds(SteamControllerDevice *pDevice, const SteamControllerLinkThresholds *pThresholds, SteamControllerLinkCallback callback, void *pUserData) {
+  if (!pDevice)
+    return false;
+
+  SteamControllerLink *pLink = SteamController_AtomicLoadPtr(&pDevice->pLink);
+  if (!pLink)
+    return false;
+
+  if (pThresholds)
+    pLink->thresholds = *pThresholds;
+  else
+    memset(&pLink->thresholds, 0, sizeof(pLink->thresholds));
+
+  pLink->callback   = callback;
+  pLink->pUserData  = pUserData;
+  return true;
+}
+
+/**
+ * Get the link statistics of a device. Safe to call from any thread, takes
+ * no locks.
+ * @return false if link statistics were never enabled for the device.
+ */
+bool SCAPI SteamController_GetLinkStats(const SteamControllerDevice *pDevice, SteamControllerLinkStats *pStats) {
+  if (!pDevice || !pStats)
+    return false;
+
+  const SteamControllerLink *pLink = SteamController_AtomicLoadPtr(&pDevice->pLink);
+  if (!pLink)
+    return false;
+
+  uint32_t words[STEAMCONTROLLER_LINK_STATS_WORDS];
+  SteamController_SeqlockRead(&pLink->sequence, pLink->words, words, STEAMCONTROLLER_LINK_STATS_WORDS);
+  memcpy(pStats, words, sizeof(SteamControllerLinkStats));
+  return true;
+}
@@ -14,38 +14,41 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <glob.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
 
-#define GLOB_PATTERN_STEAMCONTROLLER_ALL_DEVICES_WIRED              "/sys/bus/hid/devices/????:28DE:1102.*/hidraw/hidraw*"
-#define GLOB_PATTERN_STEAMCONTROLLER_ALL_DEVICES_WIRELESS           "/sys/bus/hid/devices/????:28DE:1142.*/hidraw/hidraw*"
-#define GLOB_PATTERN_STEAMCONTROLLER_ALL_DEVICES_DONGLE_BOOTLOADER  "/sys/bus/hid/devices/????:28DE:1042.*/hidraw/hidraw*"
-#define GLOB_PATTERN_STEAMCONTROLLER_DEVICE_WIRED                   "/sys/bus/hid/devices/????:28DE:1102.*/hidraw/hidraw%d"
+#define GLOB_PATTERN_STEAMCONTROLLER_ALL_DEVICES_WIRED              "%s/bus/hid/devices/????:28DE:1102.*/hidraw/hidraw*"
+#define GLOB_PATTERN_STEAMCONTROLLER_ALL_DEVICES_WIRELESS           "%s/bus/hid/devices/????:28DE:1142.*/hidraw/hidraw*"
+#define GLOB_PATTERN_STEAMCONTROLLER_ALL_DEVICES_DONGLE_BOOTLOADER  "%s/bus/hid/devices/????:28DE:1042.*/hidraw/hidraw*"
 
-struct SteamControllerDevice {
-  int     fd;
-  bool    isWireless;
-};
+#define FNMATCH_PATTERN_STEAMCONTROLLER_WIRED                       "????:28DE:1102.*"
+#define FNMATCH_PATTERN_STEAMCONTROLLER_WIRELESS                    "????:28DE:1142.*"
+#define FNMATCH_PATTERN_STEAMCONTROLLER_DONGLE_BOOTLOADER           "????:28DE:1042.*"
 
 struct SteamControllerDeviceEnum {
   struct SteamControllerDeviceEnum *next;
   char *path;
+  char *sysPath;    /**< Kernel device path of the hidraw node, relative to the sysfs root. */
 };
 
+/** Transport context of a hidraw device. */
+typedef struct {
+  int     fd;
+} SteamControllerHidraw;
+
 /** 
  * Send a feature report to the device. 
  * Tries 50 times.
- * @param pController    Steam controller device object to operate on.
+ * @param pContext       Hidraw transport context.
  * @param pReport        Feature report to send.
- * @param resetOnFailure If true, the device will be reset if a ioctl call fails.
  */
-bool SteamController_HIDSetFeatureReport(const SteamControllerDevice *pDevice, SteamController_HIDFeatureReport *pReport) {
-  if (!pDevice)
-    return false;
-
-  if (!pReport)
-    return false;
+static bool SteamController_HidrawSetFeatureReport(void *pContext, uint8_t *pReport) {
+  SteamControllerHidraw *pHidraw = (SteamControllerHidraw *)pContext;
 
   for (int tries=0; tries<50; tries++) {
-    int res = ioctl(pDevice->fd, HIDIOCSFEATURE(sizeof(*pReport)), pReport);
+    int res = ioctl(pHidraw->fd, HIDIOCSFEATURE(STEAMCONTROLLER_FEATURE_REPORT_SIZE), pReport);
     if (res >= 0)
       return true;
 
@@ -53,31 +56,28 @@ bool SteamController_HIDSetFeatureReport(const SteamControllerDevice *pDevice, S
       usleep(500);
   }
 
-  perror("HIDIOCSFEATURE");
+  SteamController_LogErrno("HIDIOCSFEATURE");
   return false;
 }
 
 /** 
  * Get a specific feature report back from the device.
  * Tries 50 times, discards non relevant (non matching feature id) reports.
- * @param pController    Steam controller device object to operate on.
+ * @param pContext       Hidraw transport context.
  * @param pReport        Feature report to send.
  */
-bool SteamController_HIDGetFeatureReport(const SteamControllerDevice *pDevice, SteamController_HIDFeatureReport *pReport) {
-  if (!pDevice)
-    return false;
-
-  if (!pReport)
-    return false;
+static bool SteamController_HidrawGetFeatureReport(void *pContext, uint8_t *pReport) {
+  SteamControllerHidraw *pHidraw = (SteamControllerHidraw *)pContext;
+  SteamController_HIDFeatureReport *pFeatureReport = (SteamController_HIDFeatureReport *)pReport;
 
-  uint8_t featureId  = pReport->featureId;
+  uint8_t featureId  = pFeatureReport->featureId;
 
-  SteamController_HIDSetFeatureReport(pDevice, pReport);
+  SteamController_HidrawSetFeatureReport(pContext, pReport);
 
   for (int tries=0; tries<50; tries++) {
-    int res = ioctl(pDevice->fd, HIDIOCGFEATURE(sizeof(*pReport)), pReport);
+    int res = ioctl(pHidraw->fd, HIDIOCGFEATURE(STEAMCONTROLLER_FEATURE_REPORT_SIZE), pReport);
     if (res >= 0) {
-      if (pReport->featureId == featureId) {
+      if (pFeatureReport->featureId == featureId) {
         return true;
       }
       continue;
@@ -86,10 +86,44 @@ bool SteamController_HIDGetFeatureReport(const SteamControllerDevice *pDevice, S
     if (tries < 49)
       usleep(500);
   }
-  perror("HIDIOCGFEATURE");
+  SteamController_LogErrno("HIDIOCGFEATURE");
   return false;
 }
 
+static uint8_t SteamController_HidrawReadRaw(void *pContext, uint8_t *buffer, uint8_t maxLen) {
+  SteamControllerHidraw *pHidraw = (SteamControllerHidraw *)pContext;
+
+  int res = read(pHidraw->fd, buffer, maxLen);
+  if (res <= 0) {
+//    fprintf(stderr, "fd: %d\n", pHidraw->fd);
+//    perror("ReadRaw");
+    return 0;
+  }
+
+  return res;
+}
+
+static void SteamController_HidrawClose(void *pContext) {
+  SteamControllerHidraw *pHidraw = (SteamControllerHidraw *)pContext;
+
+  close(pHidraw->fd);
+  free(pHidraw);
+}
+
+static int SteamController_HidrawGetPollFd(void *pContext) {
+  SteamControllerHidraw *pHidraw = (SteamControllerHidraw *)pContext;
+  return pHidraw->fd;
+}
+
+static const SteamControllerTransport HidrawTransport = {
+  .readRaw          = SteamController_HidrawReadRaw,
+  .setFeatureReport = SteamController_HidrawSetFeatureReport,
+  .getFeatureReport = SteamController_HidrawGetFeatureReport,
+  .close            = SteamController_HidrawClose,
+  .getPollFd        = SteamController_HidrawGetPollFd,
+  .hasPendingInput  = NULL,
+};
+
 /**
  * Check if a controller device is a wired controller or wireless dongle.
  * Compares the USB vendor and product ID to known values.
@@ -116,9 +150,15 @@ static bool SteamController_GetType(int fd, bool *isWireless) {
 }
 
 /**
- * Enumerate all steam controllers and wireless dongles on the system.
+ * Check that a hidraw node in sysfs belongs to a steam controller or wireless
+ * dongle, and find its device node.
+ *
+ * @param pHidrawSysPath  Path of the hidraw node in sysfs, ending in /hidraw/hidraw<num>.
+ * @param pDevPath        Where to store the path of the device node.
+ * @param devPathSize     Size of pDevPath.
+ * @return true if it is a steam controller device.
  */
-SteamControllerDeviceEnum *SteamController_EnumControllerDevices() {
+bool SteamController_CheckHidrawDevice(const char *pHidrawSysPath, char *pDevPath, size_t devPathSize) {
 
   // "HID: Vendor specific page". Report descriptor must start with these
   // bytes to be a valid steam controller device.
@@ -126,64 +166,106 @@ SteamControllerDeviceEnum *SteamController_EnumControllerDevices() {
     0x06, 0x00, 0xff  
   };
 
+  // Path should end with /hidraw<num>. Extract num as the deviceId.
+  const char *pLastDirSep = strrchr(pHidrawSysPath, '/');
+  if (!pLastDirSep) 
+    return false;
+
+  if (strncmp(pLastDirSep, "/hidraw", 7))
+    return false;
+
+  int deviceId = strtol(pLastDirSep + 7, NULL, 10);
+
+  // Find report descriptor path for the device.
+  char reportDescriptorPath[4096];
+  snprintf(reportDescriptorPath, sizeof(reportDescriptorPath), "%s", pHidrawSysPath);
+
+  char *pHidRawHidRaw = strstr(reportDescriptorPath, "/hidraw/hidraw");
+  if (!pHidRawHidRaw)
+    return false;
+
+  // The HID device directory is named after bus, vendor and product.
+  *pHidRawHidRaw = 0;
+  const char *pHidDeviceName = strrchr(reportDescriptorPath, '/');
+  if (!pHidDeviceName)
+    return false;
+
+  if (fnmatch(FNMATCH_PATTERN_STEAMCONTROLLER_WIRED, pHidDeviceName + 1, 0) &&
+      fnmatch(FNMATCH_PATTERN_STEAMCONTROLLER_WIRELESS, pHidDeviceName + 1, 0) &&
+      fnmatch(FNMATCH_PATTERN_STEAMCONTROLLER_DONGLE_BOOTLOADER, pHidDeviceName + 1, 0))
+    return false;
+
+  strncpy(pHidRawHidRaw, "/report_descriptor", reportDescriptorPath+4096-pHidRawHidRaw);
+
+  // Open report descriptor and check if it begins with a vendor specific page.
+  int fdReportDescriptor = open(reportDescriptorPath, O_CLOEXEC);
+  if (fdReportDescriptor < 0)
+    return false;
+
+  char bufMagic[3];
+  ssize_t res = read(fdReportDescriptor, bufMagic, 3);
+  close(fdReportDescriptor);
+
+  if (res != 3 || memcmp(bufMagic, ReportDescriptorMagic, 3)) {
+    SteamController_Log(STEAMCONTROLLER_LOG_INFO, "Device %d: report descriptor mismatch...", deviceId);
+    return false;
+  }
+
+  snprintf(pDevPath, devPathSize, "/dev/hidraw%d", deviceId);
+  return true;
+}
+
+/**
+ * Enumerate all steam controllers and wireless dongles below a sysfs root.
+ * @param pSysfsRoot  Where sysfs is mounted, normally "/sys".
+ */
+SteamControllerDeviceEnum *SteamController_EnumControllerDevicesAt(const char *pSysfsRoot) {
   static const char * pGlobPatterns[] = {
     GLOB_PATTERN_STEAMCONTROLLER_ALL_DEVICES_WIRELESS,
     GLOB_PATTERN_STEAMCONTROLLER_ALL_DEVICES_WIRED,
+    GLOB_PATTERN_STEAMCONTROLLER_ALL_DEVICES_DONGLE_BOOTLOADER,
     NULL
   };
 
   const char ** ppGlobPattern = pGlobPatterns;
 
+  char realRoot[PATH_MAX];
+  if (!realpath(pSysfsRoot, realRoot))
+    return NULL;
+
   SteamControllerDeviceEnum *pEnum = NULL;
 
   while(*ppGlobPattern) {
+    char    pattern[PATH_MAX];
     glob_t  globData;
-    if (glob(*ppGlobPattern, 0, NULL, &globData) == 0) {     
+
+    snprintf(pattern, sizeof(pattern), *ppGlobPattern, pSysfsRoot);
+    if (glob(pattern, 0, NULL, &globData) == 0) {     
       for (size_t i=0; i<globData.gl_pathc; i++) {
         // Get full path of hidraw device.
         char *pHidrawPath = globData.gl_pathv[i];
         if (!pHidrawPath)
           continue;
 
-        // Path should end with /hidraw<num>. Extract num as the deviceId.
-        char *pLastDirSep = strrchr(pHidrawPath, '/');
-        if (!pLastDirSep) 
+        char devPath[64];
+        if (!SteamController_CheckHidrawDevice(pHidrawPath, devPath, sizeof(devPath)))
           continue;
 
-        if (strncmp(pLastDirSep, "/hidraw", 7))
+        // Resolve the bus symlinks to get the same path the kernel reports in uevents.
+        char sysPath[PATH_MAX];
+        if (!realpath(pHidrawPath, sysPath))
           continue;
 
-        int deviceId = strtol(pLastDirSep + 7, NULL, 10);
+        size_t rootLen = strlen(realRoot);
+        const char *pKernelPath = strncmp(sysPath, realRoot, rootLen) ? sysPath : sysPath + rootLen;
 
-        // Find report descriptor path for the device.
-        char reportDescriptorPath[4096];
-        strncpy(reportDescriptorPath, pHidrawPath, sizeof(reportDescriptorPath));
-
-        char *pHidRawHidRaw = strstr(reportDescriptorPath, "/hidraw/hidraw");
-        if (!pHidRawHidRaw)
-          continue;
-
-        strncpy(pHidRawHidRaw, "/report_descriptor", reportDescriptorPath+4096-pHidRawHidRaw);
-
-        // Open report descriptor and check if it begins with a vendor specific page.
-        int fdReportDescriptor = open(reportDescriptorPath, O_CLOEXEC);
-        if (fdReportDescriptor < 0)
-          continue;
-
-        char bufMagic[3];
-        read(fdReportDescriptor, bufMagic, 3);
-        close(fdReportDescriptor);
-
-        if (memcmp(bufMagic, ReportDescriptorMagic, 3)) {
-          fprintf(stderr, "Device %d: report descriptor mismatch...\n", deviceId);
+        SteamControllerDeviceEnum *pNewEnum = malloc(sizeof(SteamControllerDeviceEnum));
+        if (!pNewEnum)
           continue;
-        }
-
-        snprintf(reportDescriptorPath, sizeof(reportDescriptorPath), "/dev/hidraw%d", deviceId);
 
-        SteamControllerDeviceEnum *pNewEnum = malloc(sizeof(SteamControllerDeviceEnum));
-        pNewEnum->next = pEnum;
-        pNewEnum->path = strdup(reportDescriptorPath);
+        pNewEnum->next    = pEnum;
+        pNewEnum->path    = strdup(devPath);
+        pNewEnum->sysPath = strdup(pKernelPath);
         pEnum = pNewEnum;
       }
       globfree(&globData);
@@ -194,6 +276,23 @@ SteamControllerDeviceEnum *SteamController_EnumControllerDevices() {
   return pEnum;
 }
 
+/**
+ * Enumerate all steam controllers and wireless dongles on the system.
+ */
+SteamControllerDeviceEnum *SteamController_EnumControllerDevices() {
+  return SteamController_EnumControllerDevicesAt("/sys");
+}
+
+/** Device node path of an enumerated device. */
+const char *SteamController_GetEnumPath(const SteamControllerDeviceEnum *pEnum) {
+  return pEnum->path;
+}
+
+/** Kernel device path of an enumerated device, as used in uevents. */
+const char *SteamController_GetEnumSysPath(const SteamControllerDeviceEnum *pEnum) {
+  return pEnum->sysPath;
+}
+
 SteamControllerDeviceEnum *SteamController_NextControllerDevice(SteamControllerDeviceEnum *pCurrent) {
   if (!pCurrent)
     return NULL;
@@ -201,77 +300,172 @@ SteamControllerDeviceEnum *SteamController_NextControllerDevice(SteamControllerD
   SteamControllerDeviceEnum *pNext = pCurrent->next;
 
   free(pCurrent->path);
+  free(pCurrent->sysPath);
   free(pCurrent);
 
   return pNext;
 }
 
+/**
+ * Build a name for the physical device behind a hidraw node that stays the
+ * same when it is reopened, on any port: USB ids plus the serial number and
+ * the interface from the physical path, which tells dongle slots apart.
+ * Devices without a serial number get no name, a port path alone may belong
+ * to another device after replugging.
+ */
+static void SteamController_GetIdentity(int fd, char *pIdentity, size_t size) {
+  pIdentity[0] = 0;
+
+#ifdef HIDIOCGRAWUNIQ
+  struct hidraw_devinfo devInfo;
+  char uniq[64];
+  char phys[96];
+
+  if (ioctl(fd, HIDIOCGRAWINFO, &devInfo) < 0)
+    return;
+
+  memset(uniq, 0, sizeof(uniq));
+  if (ioctl(fd, HIDIOCGRAWUNIQ(sizeof(uniq) - 1), uniq) < 0 || !uniq[0])
+    return;
+
+  memset(phys, 0, sizeof(phys));
+  if (ioctl(fd, HIDIOCGRAWPHYS(sizeof(phys) - 1), phys) < 0)
+    phys[0] = 0;
+
+  const char *pInterface = strrchr(phys, '/');
+  snprintf(pIdentity, size, "%04hx:%04hx:%s%s", (unsigned short)devInfo.vendor, (unsigned short)devInfo.product, uniq, pInterface ? pInterface : "");
+#else
+  (void)fd;
+  (void)size;
+#endif
+}
+
 /** 
  * Open a steam controller device.
- * @param pController   Controller object to initialize.
- * @param deviceId      Id of device to open.
- * @return true if successful.
+ * @param pEnum   Device to open.
+ * @return New device or NULL on failure.
  */
 SteamControllerDevice *SteamController_Open(const SteamControllerDeviceEnum *pEnum) {
+  return SteamController_OpenEx(pEnum, 0);
+}
+
+/**
+ * Open a steam controller device.
+ * @param pEnum   Device to open.
+ * @param flags   STEAMCONTROLLER_OPEN_* flags.
+ * @return New device or NULL on failure.
+ */
+SteamControllerDevice *SteamController_OpenEx(const SteamControllerDeviceEnum *pEnum, unsigned flags) {
   if (!pEnum)
     return NULL;
 
-  if (!pEnum->path)
+  return SteamController_OpenPath(pEnum->path, flags);
+}
+
+/**
+ * Open a steam controller by the path of its hidraw device node.
+ * @param pPath   Device node, like /dev/hidraw0.
+ * @param flags   STEAMCONTROLLER_OPEN_* flags.
+ * @return New device or NULL on failure.
+ */
+SteamControllerDevice *SteamController_OpenPath(const char *pPath, unsigned flags) {
+  if (!pPath)
     return NULL;
 
   // Try to open the hidraw device with the specified id.
-  int fd = open(pEnum->path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  int fd = open(pPath, O_RDWR | O_NONBLOCK | O_CLOEXEC);
   if (fd < 0) {
-    perror(pEnum->path);
+    SteamController_LogErrno(pPath);
     return NULL;
   }
 
   // Identify steam controller.
   bool isWireless;
   if (!SteamController_GetType(fd, &isWireless)) {
+    close(fd);
     return NULL;
   }
 
-  SteamControllerDevice *pDevice = malloc(sizeof(SteamControllerDevice));
-  pDevice->fd = fd;
-  pDevice->isWireless = isWireless;
+  char identity[STEAMCONTROLLER_IDENTITY_SIZE];
+  SteamController_GetIdentity(fd, identity, sizeof(identity));
 
-  SteamController_Initialize(pDevice);
-  return pDevice;
-}
+  SteamControllerHidraw *pHidraw = malloc(sizeof(SteamControllerHidraw));
+  pHidraw->fd = fd;
 
-/**
- * Close a controller device.
- * @note This only closes the device. It does not unpair, disconnect or turn off
- *       any controller.
- * @param pController   Controller object to deinitialize.
- */
-void SteamController_Close(SteamControllerDevice *pDevice) {
+  SteamControllerDevice *pDevice = SteamController_OpenTransportEx(&HidrawTransport, pHidraw, isWireless, identity, flags);
   if (!pDevice)
-    return;
+    SteamController_HidrawClose(pHidraw);
 
-  close(pDevice->fd);
-  free(pDevice);
+  return pDevice;
 }
 
-bool SteamController_IsWirelessDongle(const SteamControllerDevice *pDevice) {
-  if (!pDevice)
-    return false;
-  return pDevice->isWireless;
+typedef struct {
+  const SteamControllerDeviceEnum  *pEnum;
+  unsigned                          flags;
+  SteamControllerDevice            *pDevice;
+  pthread_t                         thread;
+  bool                              isStarted;
+} SteamControllerOpenJob;
+
+static void *SteamController_OpenThread(void *pArg) {
+  SteamControllerOpenJob *pJob = (SteamControllerOpenJob *)pArg;
+  pJob->pDevice = SteamController_OpenEx(pJob->pEnum, pJob->flags);
+  return NULL;
 }
 
-uint8_t SteamController_ReadRaw(const SteamControllerDevice *pDevice, uint8_t *buffer, uint8_t maxLen) {
-  if (!pDevice)
+/**
+ * Open all steam controllers and wireless dongle slots at once. Each device
+ * is initialized on its own thread, so the time this takes does not grow with
+ * the number of devices.
+ *
+ * @param ppDevices   Where to store the opened devices.
+ * @param maxDevices  Number of devices ppDevices can hold.
+ * @param flags       STEAMCONTROLLER_OPEN_* flags.
+ * @return Number of devices stored in ppDevices.
+ */
+size_t SteamController_OpenAll(SteamControllerDevice **ppDevices, size_t maxDevices, unsigned flags) {
+  if (!ppDevices || !maxDevices)
     return 0;
 
-  int res = read(pDevice->fd, buffer, maxLen);
-  if (res <= 0) {
-//    fprintf(stderr, "fd: %d\n", pDevice->fd);
-//    perror("ReadRaw");
+  SteamControllerOpenJob *pJobs = calloc(maxDevices, sizeof(SteamControllerOpenJob));
+  if (!pJobs)
     return 0;
+
+  SteamControllerDeviceEnum *pFirstEnum = SteamController_EnumControllerDevices();
+
+  size_t jobCount = 0;
+  for (const SteamControllerDeviceEnum *pEnum = pFirstEnum; pEnum && jobCount < maxDevices; pEnum = pEnum->next) {
+    SteamControllerOpenJob *pJob = pJobs + jobCount++;
+    pJob->pEnum = pEnum;
+    pJob->flags = flags;
+
+    if (pthread_create(&pJob->thread, NULL, SteamController_OpenThread, pJob) == 0)
+      pJob->isStarted = true;
+    else
+      SteamController_OpenThread(pJob);
   }
 
-  return res;
+  size_t count = 0;
+  for (size_t i=0; i<jobCount; i++) {
+    if (pJobs[i].isStarted)
+      pthread_join(pJobs[i].thread, NULL);
+
+    if (pJobs[i].pDevice)
+      ppDevices[count++] = pJobs[i].pDevice;
+  }
+
+  while (pFirstEnum)
+    pFirstEnum = SteamController_NextControllerDevice(pFirstEnum);
+
+  free(pJobs);
+  return count;
+}
+
+/** Current CLOCK_MONOTONIC time in nanoseconds. */
+uint64_t SteamController_GetHostTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
 }
 
 #endif
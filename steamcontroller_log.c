@@ -0,0 +1,173 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <stdarg.h>
+#include <errno.h>
+
+#define STEAMCONTROLLER_LOG_MESSAGE_SIZE    512
+#define STEAMCONTROLLER_LOG_HEX_SIZE        2048    /**< Fits a hex dump of 64 bytes with some text. */
+
+SteamControllerAtomicU32 SteamController_LogLevel = STEAMCONTROLLER_LOG_WARNING;
+
+typedef struct SteamControllerLogSink {
+  SteamControllerLogCallback  callback;
+  void                       *pUserData;
+} SteamControllerLogSink;
+
+/**
+ * The callback is set in the slot that is not current, then published with
+ * one pointer store, so a thread that logs meanwhile sees a matching pair.
+ */
+static SteamControllerLogSink               SteamController_LogSinks[2];
+static SteamControllerAtomicPtr             SteamController_LogSink = &SteamController_LogSinks[0];
+static SteamControllerAtomicU64             SteamController_SuppressedLogCount;
+
+/**
+ * Set the function that receives the messages of the library, instead of
+ * stderr. It may be called from any thread that uses the library, from
+ * several at once. Set it before other threads use the library.
+ *
+ * @param callback    Function to call, NULL to log to stderr again.
+ * @param pUserData   Passed to the callback.
+ */
+void SCAPI SteamController_SetLogCallback(SteamControllerLogCallback callback, void *pUserData) {
+  SteamControllerLogSink *pSink = SteamController_AtomicLoadPtr(&SteamController_LogSink) == &SteamController_LogSinks[0] ? &SteamController_LogSinks[1] : &SteamController_LogSinks[0];
+
+  pSink->callback   = callback;
+  pSink->pUserData  = pUserData;
+  SteamController_AtomicStorePtr(&SteamController_LogSink, pSink);
+}
+
+/**
+ * Set the most verbose STEAMCONTROLLER_LOG_* level that is logged, the default
+ * is STEAMCONTROLLER_LOG_WARNING. Messages of higher levels cost one atomic
+ * load and are never formatted. Levels above STEAMCONTROLLER_LOG_COMPILE_LEVEL
+ * of the build are not available.
+ */
+void SCAPI SteamController_SetLogLevel(unsigned level) {
+  SteamController_AtomicStoreRelaxed32(&SteamController_LogLevel, level);
+}
+
+unsigned SCAPI SteamController_GetLogLevel() {
+  return SteamController_AtomicLoadRelaxed32(&SteamController_LogLevel);
+}
+
+/**
+ * Get the number of messages dropped because their site logged more than
+ * STEAMCONTROLLER_LOG_BURST messages within STEAMCONTROLLER_LOG_INTERVAL.
+ */
+uint64_t SCAPI SteamController_GetSuppressedLogCount() {
+  return SteamController_AtomicLoad64(&SteamController_SuppressedLogCount);
+}
+
+/**
+ * Check the rate limit of a site before a message is formatted.
+ * @return false if the message is suppressed.
+ */
+static bool SteamController_LogAdmit(SteamControllerLogSite *pSite, uint32_t *pSuppressed) {
+  uint64_t now   = SteamController_GetHostTime();
+  uint64_t start = SteamController_AtomicLoad64(&pSite->windowStart);
+
+  if (now - start >= STEAMCONTROLLER_LOG_INTERVAL && SteamController_AtomicCompareExchange64(&pSite->windowStart, &start, now))
+    SteamController_AtomicStore32(&pSite->windowCount, 0);
+
+  if (SteamController_AtomicAdd32(&pSite->windowCount, 1) >= STEAMCONTROLLER_LOG_BURST) {
+    SteamController_AtomicAdd32(&pSite->suppressed, 1);
+    SteamController_AtomicAdd64(&SteamController_SuppressedLogCount, 1);
+    return false;
+  }
+
+  *pSuppressed = SteamController_AtomicExchange32(&pSite->suppressed, 0);
+  return true;
+}
+
+static void SteamController_LogEmit(unsigned level, const char *pMessage, uint32_t suppressedCount) {
+  const SteamControllerLogSink *pSink = SteamController_AtomicLoadPtr(&SteamController_LogSink);
+  if (pSink->callback) {
+    pSink->callback(level, pMessage, suppressedCount, pSink->pUserData);
+    return;
+  }
+
+  if (suppressedCount)
+    fprintf(stderr, "%s (%u similar messages suppressed)\n", pMessage, suppressedCount);
+  else
+    fprintf(stderr, "%s\n", pMessage);
+}
+
+/** Log a message through the rate limit of a site. Use SteamController_Log instead. */
+void SteamController_LogAt(SteamControllerLogSite *pSite, unsigned level, const char *pFormat, ...) {
+  int error = errno;
+
+  uint32_t suppressedCount;
+  if (SteamController_LogAdmit(pSite, &suppressedCount)) {
+    char message[STEAMCONTROLLER_LOG_MESSAGE_SIZE];
+
+    va_list args;
+    va_start(args, pFormat);
+    vsnprintf(message, sizeof(message), pFormat, args);
+    va_end(args);
+
+    SteamController_LogEmit(level, message, suppressedCount);
+  }
+
+  errno = error;
+}
+
+/** Log the description of errno. Use SteamController_LogErrno instead. */
+void SteamController_LogErrnoAt(SteamControllerLogSite *pSite, const char *pWhat) {
+  int error = errno;
+
+  uint32_t suppressedCount;
+  if (SteamController_LogAdmit(pSite, &suppressedCount)) {
+    char message[STEAMCONTROLLER_LOG_MESSAGE_SIZE];
+#if _MSC_VER
+    char description[128];
+    strerror_s(description, sizeof(description), error);
+#else
+    const char *description = strerror(error);
+#endif
+
+    snprintf(message, sizeof(message), "%s: %s", pWhat, description);
+    SteamController_LogEmit(STEAMCONTROLLER_LOG_ERROR, message, suppressedCount);
+  }
+
+  errno = error;
+}
+
+/**
+ * Log a message followed by a hex dump of some data, 16 bytes per line with
+ * their printable characters. Use SteamController_LogHex instead.
+ */
+void SteamController_LogHexAt(SteamControllerLogSite *pSite, unsigned level, const void *pData, size_t count, const char *pFormat, ...) {
+  int error = errno;
+
+  uint32_t suppressedCount;
+  if (SteamController_LogAdmit(pSite, &suppressedCount)) {
+    char    message[STEAMCONTROLLER_LOG_HEX_SIZE];
+    size_t  size = sizeof(message);
+
+    va_list args;
+    va_start(args, pFormat);
+    int length = vsnprintf(message, size, pFormat, args);
+    va_end(args);
+
+    size_t          used = length < 0 ? 0 : (size_t)length;
+    const uint8_t  *data = (const uint8_t *)pData;
+
+    // Each line takes 16 * 3 + 1 + 16 + 1 characters.
+    for (size_t line=0; line<count && used + 67 < size; line+=16) {
+      message[used++] = '\n';
+      for (size_t i=line; i<line+16; i++)
+        used += i < count ? snprintf(message + used, size - used, "%02x ", data[i]) : snprintf(message + used, size - used, "   ");
+
+      message[used++] = ' ';
+      for (size_t i=line; i<line+16 && i<count; i++)
+        message[used++] = data[i] > 31 && data[i] < 0x80 ? (char)data[i] : '.';
+      message[used] = '\0';
+    }
+
+    SteamController_LogEmit(level, message, suppressedCount);
+  }
+
+  errno = error;
+}
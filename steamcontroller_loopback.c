@@ -0,0 +1,223 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+struct SteamControllerLoopback {
+  // Scripted input reports, each stored in a STEAMCONTROLLER_INPUT_REPORT_SIZE slot.
+  uint8_t                          *pReports;
+  uint8_t                          *pReportLengths;
+  size_t                            reportCount;
+  size_t                            reportCapacity;
+  size_t                            readIndex;
+  bool                              isLooping;
+
+  // Every feature report sent through the transport, in order.
+  SteamController_HIDFeatureReport *pSentReports;
+  size_t                            sentCount;
+  size_t                            sentCapacity;
+
+  // Canned responses for get requests, indexed by feature id.
+  SteamController_HIDFeatureReport  responses[256];
+  bool                              hasResponse[256];
+
+  // Identity devices opened on the loopback get, empty for none.
+  char                              identity[STEAMCONTROLLER_IDENTITY_SIZE];
+};
+
+/** Append a feature report to the list of sent reports. */
+static bool SteamController_LoopbackRecord(SteamControllerLoopback *pLoopback, const uint8_t *pReport) {
+  if (pLoopback->sentCount == pLoopback->sentCapacity) {
+    size_t newCapacity = pLoopback->sentCapacity ? pLoopback->sentCapacity * 2 : 64;
+
+    SteamController_HIDFeatureReport *pSentReports = realloc(pLoopback->pSentReports, newCapacity * sizeof(SteamController_HIDFeatureReport));
+    if (!pSentReports)
+      return false;
+
+    pLoopback->pSentReports = pSentReports;
+    pLoopback->sentCapacity = newCapacity;
+  }
+
+  memcpy(pLoopback->pSentReports + pLoopback->sentCount, pReport, sizeof(SteamController_HIDFeatureReport));
+  pLoopback->sentCount++;
+  return true;
+}
+
+static uint8_t SteamController_LoopbackTransportReadRaw(void *pContext, uint8_t *buffer, uint8_t maxLen) {
+  SteamControllerLoopback *pLoopback = (SteamControllerLoopback *)pContext;
+
+  if (pLoopback->readIndex >= pLoopback->reportCount) {
+    if (!pLoopback->isLooping || !pLoopback->reportCount)
+      return 0;
+    pLoopback->readIndex = 0;
+  }
+
+  size_t  index = pLoopback->readIndex++;
+  uint8_t len   = pLoopback->pReportLengths[index];
+  if (len > maxLen)
+    len = maxLen;
+
+  memcpy(buffer, pLoopback->pReports + index * STEAMCONTROLLER_INPUT_REPORT_SIZE, len);
+  return len;
+}
+
+static bool SteamController_LoopbackTransportSetFeatureReport(void *pContext, uint8_t *pReport) {
+  return SteamController_LoopbackRecord((SteamControllerLoopback *)pContext, pReport);
+}
+
+/**
+ * Record the request and answer with the canned response for its feature id.
+ * Without a canned response the request is echoed back.
+ */
+static bool SteamController_LoopbackTransportGetFeatureReport(void *pContext, uint8_t *pReport) {
+  SteamControllerLoopback *pLoopback = (SteamControllerLoopback *)pContext;
+
+  if (!SteamController_LoopbackRecord(pLoopback, pReport))
+    return false;
+
+  uint8_t featureId = ((SteamController_HIDFeatureReport *)pReport)->featureId;
+  if (pLoopback->hasResponse[featureId])
+    memcpy(pReport, &pLoopback->responses[featureId], sizeof(SteamController_HIDFeatureReport));
+
+  return true;
+}
+
+static bool SteamController_LoopbackTransportHasPendingInput(void *pContext) {
+  SteamControllerLoopback *pLoopback = (SteamControllerLoopback *)pContext;
+  return pLoopback->readIndex < pLoopback->reportCount || (pLoopback->isLooping && pLoopback->reportCount);
+}
+
+static const SteamControllerTransport LoopbackTransport = {
+  .readRaw          = SteamController_LoopbackTransportReadRaw,
+  .setFeatureReport = SteamController_LoopbackTransportSetFeatureReport,
+  .getFeatureReport = SteamController_LoopbackTransportGetFeatureReport,
+  .close            = NULL,
+  .getPollFd        = NULL,
+  .hasPendingInput  = SteamController_LoopbackTransportHasPendingInput,
+};
+
+/** Create an empty loopback transport. */
+SteamControllerLoopback *SteamController_CreateLoopback() {
+  SteamControllerLoopback *pLoopback = malloc(sizeof(SteamControllerLoopback));
+  if (!pLoopback)
+    return NULL;
+
+  memset(pLoopback, 0, sizeof(SteamControllerLoopback));
+  return pLoopback;
+}
+
+/** Free a loopback transport. Devices opened on it must be closed first. */
+void SteamController_DestroyLoopback(SteamControllerLoopback *pLoopback) {
+  if (!pLoopback)
+    return;
+
+  free(pLoopback->pReports);
+  free(pLoopback->pReportLengths);
+  free(pLoopback->pSentReports);
+  free(pLoopback);
+}
+
+/**
+ * Open a device that reads from and writes to a loopback transport.
+ * The loopback is not owned by the device and has to outlive it.
+ */
+SteamControllerDevice *SteamController_OpenLoopback(SteamControllerLoopback *pLoopback, bool isWireless) {
+  return SteamController_OpenLoopbackEx(pLoopback, isWireless, 0);
+}
+
+/**
+ * Open a device on a loopback transport like SteamController_OpenLoopback.
+ * @param flags   STEAMCONTROLLER_OPEN_* flags.
+ */
+SteamControllerDevice *SteamController_OpenLoopbackEx(SteamControllerLoopback *pLoopback, bool isWireless, unsigned flags) {
+  if (!pLoopback)
+    return NULL;
+
+  return SteamController_OpenTransportEx(&LoopbackTransport, pLoopback, isWireless, pLoopback->identity[0] ? pLoopback->identity : NULL, flags);
+}
+
+/**
+ * Set the identity of devices opened on the loopback from now on, as if they
+ * were the same physical device.
+ * @param pIdentity   Name of the device, or NULL for none.
+ */
+void SteamController_LoopbackSetIdentity(SteamControllerLoopback *pLoopback, const char *pIdentity) {
+  if (!pLoopback)
+    return;
+
+  snprintf(pLoopback->identity, sizeof(pLoopback->identity), "%s", pIdentity ? pIdentity : "");
+}
+
+/**
+ * Append an input report to the script.
+ * @param pReport   Raw report data as it would be read from the device.
+ * @param len       Length of the report, at most STEAMCONTROLLER_INPUT_REPORT_SIZE.
+ */
+bool SteamController_LoopbackQueueReport(SteamControllerLoopback *pLoopback, const uint8_t *pReport, uint8_t len) {
+  if (!pLoopback || !pReport || !len || len > STEAMCONTROLLER_INPUT_REPORT_SIZE)
+    return false;
+
+  if (pLoopback->reportCount == pLoopback->reportCapacity) {
+    size_t newCapacity = pLoopback->reportCapacity ? pLoopback->reportCapacity * 2 : 64;
+
+    uint8_t *pReports = realloc(pLoopback->pReports, newCapacity * STEAMCONTROLLER_INPUT_REPORT_SIZE);
+    if (!pReports)
+      return false;
+    pLoopback->pReports = pReports;
+
+    uint8_t *pReportLengths = realloc(pLoopback->pReportLengths, newCapacity);
+    if (!pReportLengths)
+      return false;
+    pLoopback->pReportLengths = pReportLengths;
+
+    pLoopback->reportCapacity = newCapacity;
+  }
+
+  memcpy(pLoopback->pReports + pLoopback->reportCount * STEAMCONTROLLER_INPUT_REPORT_SIZE, pReport, len);
+  pLoopback->pReportLengths[pLoopback->reportCount] = len;
+  pLoopback->reportCount++;
+  return true;
+}
+
+/** If looping is enabled, the script restarts from the beginning once all reports were read. */
+void SteamController_LoopbackSetLooping(SteamControllerLoopback *pLoopback, bool isLooping) {
+  if (!pLoopback)
+    return;
+
+  pLoopback->isLooping = isLooping;
+}
+
+/**
+ * Set the response for get requests with the feature id of the given report.
+ * @param pReport   Feature report of STEAMCONTROLLER_FEATURE_REPORT_SIZE bytes.
+ */
+void SteamController_LoopbackSetFeatureResponse(SteamControllerLoopback *pLoopback, const uint8_t *pReport) {
+  if (!pLoopback || !pReport)
+    return;
+
+  uint8_t featureId = ((const SteamController_HIDFeatureReport *)pReport)->featureId;
+  memcpy(&pLoopback->responses[featureId], pReport, sizeof(SteamController_HIDFeatureReport));
+  pLoopback->hasResponse[featureId] = true;
+}
+
+/** Number of feature reports sent to the loopback so far. */
+size_t SteamController_LoopbackGetFeatureReportCount(const SteamControllerLoopback *pLoopback) {
+  if (!pLoopback)
+    return 0;
+
+  return pLoopback->sentCount;
+}
+
+/** Get a recorded feature report of STEAMCONTROLLER_FEATURE_REPORT_SIZE bytes. */
+const uint8_t *SteamController_LoopbackGetFeatureReport(const SteamControllerLoopback *pLoopback, size_t index) {
+  if (!pLoopback || index >= pLoopback->sentCount)
+    return NULL;
+
+  return (const uint8_t *)(pLoopback->pSentReports + index);
+}
+
+/** Forget all recorded feature reports. */
+void SteamController_LoopbackClearFeatureReports(SteamControllerLoopback *pLoopback) {
+  if (!pLoopback)
+    return;
+
+  pLoopback->sentCount = 0;
+}
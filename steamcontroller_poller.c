@@ -0,0 +1,177 @@
+#if _MSC_VER
+#pragma warning(disable: 4206)  // MSC: nonstandard extension used : translation unit is empty
+#endif
+
+#if __linux__
+
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define STEAMCONTROLLER_POLLER_MAX_EVENTS   64
+
+typedef struct SteamControllerPollerEntry {
+  struct SteamControllerPollerEntry *next;
+  SteamControllerDevice             *pDevice;
+  void                              *pUserData;
+  bool                               isRemoved;
+} SteamControllerPollerEntry;
+
+struct SteamControllerPoller {
+  int                         epollFd;
+  SteamControllerPollerEntry *pEntries;
+  bool                        isDispatching;
+};
+
+/** Create a poller without any devices. */
+SteamControllerPoller *SteamController_CreatePoller() {
+  int epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0) {
+    SteamController_LogErrno("epoll_create1");
+    return NULL;
+  }
+
+  SteamControllerPoller *pPoller = malloc(sizeof(SteamControllerPoller));
+  pPoller->epollFd        = epollFd;
+  pPoller->pEntries       = NULL;
+  pPoller->isDispatching  = false;
+  return pPoller;
+}
+
+/** Free removed entries. Entries can not be freed while the epoll results still point to them. */
+static void SteamController_PollerSweep(SteamControllerPoller *pPoller) {
+  SteamControllerPollerEntry **ppEntry = &pPoller->pEntries;
+  while (*ppEntry) {
+    SteamControllerPollerEntry *pEntry = *ppEntry;
+    if (pEntry->isRemoved) {
+      *ppEntry = pEntry->next;
+      free(pEntry);
+    } else {
+      ppEntry = &pEntry->next;
+    }
+  }
+}
+
+/**
+ * Destroy a poller.
+ * @note The devices that were added are not closed.
+ */
+void SteamController_DestroyPoller(SteamControllerPoller *pPoller) {
+  if (!pPoller)
+    return;
+
+  for (SteamControllerPollerEntry *pEntry = pPoller->pEntries; pEntry; pEntry = pEntry->next)
+    pEntry->isRemoved = true;
+
+  SteamController_PollerSweep(pPoller);
+  close(pPoller->epollFd);
+  free(pPoller);
+}
+
+/**
+ * Start watching a device for input.
+ * @param pPoller     Poller to use.
+ * @param pDevice     Device to add. Its transport must provide a pollable file descriptor.
+ * @param pUserData   Passed to the callback when the device has input pending.
+ * @return true if successful.
+ */
+bool SteamController_PollerAdd(SteamControllerPoller *pPoller, SteamControllerDevice *pDevice, void *pUserData) {
+  if (!pPoller || !pDevice)
+    return false;
+
+  int fd = SteamController_GetPollFd(pDevice);
+  if (fd < 0)
+    return false;
+
+  SteamControllerPollerEntry *pEntry = malloc(sizeof(SteamControllerPollerEntry));
+  pEntry->pDevice   = pDevice;
+  pEntry->pUserData = pUserData;
+  pEntry->isRemoved = false;
+
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events    = EPOLLIN;
+  event.data.ptr  = pEntry;
+
+  if (epoll_ctl(pPoller->epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+    SteamController_LogErrno("EPOLL_CTL_ADD");
+    free(pEntry);
+    return false;
+  }
+
+  pEntry->next      = pPoller->pEntries;
+  pPoller->pEntries = pEntry;
+  return true;
+}
+
+/**
+ * Stop watching a device. Can be called from within the callback.
+ * @return true if the device was found.
+ */
+bool SteamController_PollerRemove(SteamControllerPoller *pPoller, SteamControllerDevice *pDevice) {
+  if (!pPoller || !pDevice)
+    return false;
+
+  for (SteamControllerPollerEntry *pEntry = pPoller->pEntries; pEntry; pEntry = pEntry->next) {
+    if (pEntry->pDevice != pDevice || pEntry->isRemoved)
+      continue;
+
+    int fd = SteamController_GetPollFd(pDevice);
+    if (fd >= 0)
+      epoll_ctl(pPoller->epollFd, EPOLL_CTL_DEL, fd, NULL);
+
+    pEntry->isRemoved = true;
+    if (!pPoller->isDispatching)
+      SteamController_PollerSweep(pPoller);
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * Wait until at least one device has input pending and call the callback for
+ * each such device. The callback should drain the device, for example with
+ * SteamController_ReadEvents, otherwise it will be reported again right away.
+ *
+ * @param pPoller     Poller to use.
+ * @param timeoutMs   Maximum time to wait in milliseconds, -1 to wait forever.
+ * @param callback    Function to call for every ready device.
+ * @return Number of devices dispatched, 0 on timeout or -1 on error.
+ */
+int SteamController_PollerWait(SteamControllerPoller *pPoller, int timeoutMs, SteamControllerPollerCallback callback) {
+  if (!pPoller || !callback)
+    return -1;
+
+  struct epoll_event events[STEAMCONTROLLER_POLLER_MAX_EVENTS];
+  int count = epoll_wait(pPoller->epollFd, events, STEAMCONTROLLER_POLLER_MAX_EVENTS, timeoutMs);
+  if (count < 0) {
+    if (errno == EINTR)
+      return 0;
+    SteamController_LogErrno("epoll_wait");
+    return -1;
+  }
+
+  pPoller->isDispatching = true;
+  for (int i=0; i<count; i++) {
+    SteamControllerPollerEntry *pEntry = (SteamControllerPollerEntry *)events[i].data.ptr;
+    if (pEntry->isRemoved)
+      continue;
+
+    // A vanished device keeps reporting errors, so stop watching it.
+    bool isHangup = (events[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+    if (isHangup)
+      SteamController_PollerRemove(pPoller, pEntry->pDevice);
+
+    callback(pEntry->pDevice, isHangup, pEntry->pUserData);
+  }
+  pPoller->isDispatching = false;
+
+  SteamController_PollerSweep(pPoller);
+  return count;
+}
+
+#endif
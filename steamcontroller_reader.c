@@ -0,0 +1,184 @@
+#if _MSC_VER
+#pragma warning(disable: 4206)  // MSC: nonstandard extension used : translation unit is empty
+#endif
+
+#if __linux__
+
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define STEAMCONTROLLER_CACHE_LINE_SIZE   64
+#define STEAMCONTROLLER_EVENT_RING_MASK   (STEAMCONTROLLER_EVENT_RING_SIZE - 1)
+
+_Static_assert((STEAMCONTROLLER_EVENT_RING_SIZE & STEAMCONTROLLER_EVENT_RING_MASK) == 0, "event ring size must be a power of two");
+
+/**
+ * Single producer, single consumer ring of events. Producer and consumer
+ * indices live on separate cache lines so they don't bounce between cores.
+ */
+typedef struct {
+  _Alignas(STEAMCONTROLLER_CACHE_LINE_SIZE) SteamControllerAtomicU32  head;           /**< Next slot to write, owned by the reader thread. */
+  _Alignas(STEAMCONTROLLER_CACHE_LINE_SIZE) SteamControllerAtomicU32  tail;           /**< Next slot to read, owned by the consumer. */
+  _Alignas(STEAMCONTROLLER_CACHE_LINE_SIZE) SteamControllerAtomicU32  overflowCount;  /**< Events dropped because the ring was full. */
+  _Alignas(STEAMCONTROLLER_CACHE_LINE_SIZE) SteamControllerTimedEvent events[STEAMCONTROLLER_EVENT_RING_SIZE];
+} SteamControllerEventRing;
+
+struct SteamControllerReader {
+  SteamControllerEventRing  ring;
+  SteamControllerDevice    *pDevice;
+  pthread_t                 thread;
+  SteamControllerAtomicU32  isRunning;
+};
+
+static void SteamController_ReaderPush(SteamControllerEventRing *pRing, const SteamControllerTimedEvent *pEvent) {
+  uint32_t head = SteamController_AtomicLoadRelaxed32(&pRing->head);
+  uint32_t tail = SteamController_AtomicLoad32(&pRing->tail);
+
+  if (head - tail >= STEAMCONTROLLER_EVENT_RING_SIZE) {
+    SteamController_AtomicAdd32(&pRing->overflowCount, 1);
+    return;
+  }
+
+  pRing->events[head & STEAMCONTROLLER_EVENT_RING_MASK] = *pEvent;
+  SteamController_AtomicStore32(&pRing->head, head + 1);
+}
+
+static void *SteamController_ReaderThread(void *pArg) {
+  SteamControllerReader *pReader = (SteamControllerReader *)pArg;
+  SteamControllerDevice *pDevice = pReader->pDevice;
+
+  int fd = SteamController_GetPollFd(pDevice);
+
+  while (SteamController_AtomicLoadRelaxed32(&pReader->isRunning)) {
+    if (fd >= 0) {
+      // Wake up regularly to notice when we are asked to stop.
+      struct pollfd pollFd = { .fd = fd, .events = POLLIN };
+      int res = poll(&pollFd, 1, 100);
+      if (res <= 0)
+        continue;
+
+      if (pollFd.revents & (POLLHUP | POLLERR | POLLNVAL))
+        break;
+    }
+
+    uint8_t eventDataBuf[STEAMCONTROLLER_INPUT_REPORT_SIZE];
+    bool    hasRead = false;
+
+    // Bounded, so a transport that never runs dry can't keep us from stopping.
+    for (size_t i=0; i<STEAMCONTROLLER_EVENT_RING_SIZE; i++) {
+      uint16_t len = SteamController_ReadRaw(pDevice, eventDataBuf, sizeof(eventDataBuf));
+      if (!len)
+        break;
+
+      hasRead = true;
+
+      SteamControllerTimedEvent timedEvent;
+      timedEvent.hostTime = SteamController_GetHostTime();
+      if (SteamController_DecodeDeviceEvent(pDevice, eventDataBuf, len, &timedEvent.event)) {
+        SteamController_UpdateStateSnapshot(pDevice, &timedEvent.event);
+        SteamController_ReaderPush(&pReader->ring, &timedEvent);
+      }
+    }
+
+    // Transports without a file descriptor can only be polled.
+    if (fd < 0 && !hasRead)
+      usleep(1000);
+  }
+
+  return NULL;
+}
+
+/**
+ * Start a thread that reads and decodes all events of a device into a ring
+ * buffer. Use SteamController_DrainEvents to fetch them. The thread also keeps
+ * the state snapshot of the device up to date. While the thread is
+ * running, SteamController_ReadEvent and SteamController_ReadEvents must not
+ * be used on the device.
+ * @return true if the thread is running.
+ */
+bool SCAPI SteamController_StartReaderThread(SteamControllerDevice *pDevice) {
+  if (!pDevice)
+    return false;
+
+  if (pDevice->pReader)
+    return true;
+
+  SteamControllerReader *pReader = aligned_alloc(STEAMCONTROLLER_CACHE_LINE_SIZE, sizeof(SteamControllerReader));
+  if (!pReader)
+    return false;
+
+  memset(pReader, 0, sizeof(SteamControllerReader));
+  SteamController_AtomicStoreRelaxed32(&pReader->isRunning, true);
+  pReader->pDevice = pDevice;
+
+  if (pthread_create(&pReader->thread, NULL, SteamController_ReaderThread, pReader)) {
+    SteamController_LogErrno("pthread_create");
+    free(pReader);
+    return false;
+  }
+
+  pDevice->pReader = pReader;
+  return true;
+}
+
+/** Stop the reader thread and discard all buffered events. */
+void SCAPI SteamController_StopReaderThread(SteamControllerDevice *pDevice) {
+  if (!pDevice || !pDevice->pReader)
+    return;
+
+  SteamControllerReader *pReader = pDevice->pReader;
+  SteamController_AtomicStore32(&pReader->isRunning, false);
+  pthread_join(pReader->thread, NULL);
+
+  pDevice->pReader = NULL;
+  free(pReader);
+}
+
+/**
+ * Fetch events buffered by the reader thread. Never blocks or takes locks.
+ * Must only be called from one thread at a time.
+ *
+ * @param pDevice         Device with a running reader thread.
+ * @param pEvents         Where to store the events, oldest first.
+ * @param maxEvents       Number of events pEvents can hold.
+ * @param pOverflowCount  If not NULL, receives the number of events dropped since the last call
+ *                        because the ring was full.
+ * @return Number of events stored in pEvents.
+ */
+size_t SCAPI SteamController_DrainEvents(SteamControllerDevice *pDevice, SteamControllerTimedEvent *pEvents, size_t maxEvents, uint32_t *pOverflowCount) {
+  if (pOverflowCount)
+    *pOverflowCount = 0;
+
+  if (!pDevice || !pDevice->pReader || !pEvents)
+    return 0;
+
+  SteamControllerEventRing *pRing = &pDevice->pReader->ring;
+
+  uint32_t  tail  = SteamController_AtomicLoadRelaxed32(&pRing->tail);
+  uint32_t  head  = SteamController_AtomicLoad32(&pRing->head);
+  size_t    count = head - tail;
+  if (count > maxEvents)
+    count = maxEvents;
+
+  for (size_t i=0; i<count; i++)
+    pEvents[i] = pRing->events[(tail + i) & STEAMCONTROLLER_EVENT_RING_MASK];
+
+  SteamController_AtomicStore32(&pRing->tail, tail + (uint32_t)count);
+
+  if (count && SteamController_IsTrackingLatency(pDevice)) {
+    uint64_t now = SteamController_GetHostTime();
+    for (size_t i=0; i<count; i++)
+      SteamController_RecordLatency(pDevice, STEAMCONTROLLER_LATENCY_DELIVERY, now - pEvents[i].hostTime);
+  }
+
+  if (pOverflowCount)
+    *pOverflowCount = SteamController_AtomicExchange32(&pRing->overflowCount, 0);
+
+  return count;
+}
+
+#endif
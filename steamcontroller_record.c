@@ -0,0 +1,104 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+_Static_assert(sizeof(SteamControllerRecordHeader) == 32, "capture header layout changed");
+_Static_assert(sizeof(SteamControllerRecord) == 96, "capture record layout changed");
+
+struct SteamControllerRecorder {
+  FILE                     *pFile;
+};
+
+/**
+ * Create a capture file. Attach it to devices with SteamController_SetRecorder.
+ * @param pPath   File to create, an existing file is overwritten.
+ * @return New recorder or NULL on failure.
+ */
+SteamControllerRecorder *SteamController_CreateRecorder(const char *pPath) {
+  if (!pPath)
+    return NULL;
+
+  SteamControllerRecorder *pRecorder = malloc(sizeof(SteamControllerRecorder));
+  if (!pRecorder)
+    return NULL;
+
+  pRecorder->pFile = fopen(pPath, "wb");
+  if (!pRecorder->pFile) {
+    SteamController_LogErrno("fopen");
+    free(pRecorder);
+    return NULL;
+  }
+
+  SteamControllerRecordHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, STEAMCONTROLLER_RECORD_MAGIC, sizeof(header.magic));
+  header.version        = STEAMCONTROLLER_RECORD_VERSION;
+  header.recordSize     = sizeof(SteamControllerRecord);
+  header.startHostTime  = SteamController_GetHostTime();
+
+  if (fwrite(&header, sizeof(header), 1, pRecorder->pFile) != 1) {
+    SteamController_LogErrno("fwrite");
+    fclose(pRecorder->pFile);
+    free(pRecorder);
+    return NULL;
+  }
+
+  return pRecorder;
+}
+
+/**
+ * Close a capture file. All devices must be detached from the recorder first.
+ */
+void SCAPI SteamController_DestroyRecorder(SteamControllerRecorder *pRecorder) {
+  if (!pRecorder)
+    return;
+
+  fclose(pRecorder->pFile);
+  free(pRecorder);
+}
+
+/** Write all buffered records to the capture file. */
+void SCAPI SteamController_FlushRecorder(SteamControllerRecorder *pRecorder) {
+  if (!pRecorder)
+    return;
+
+  fflush(pRecorder->pFile);
+}
+
+/**
+ * Capture all reports exchanged with a device. Must not be called while a
+ * reader thread is running on the device.
+ * @param pDevice     Device to capture.
+ * @param pRecorder   Capture file, or NULL to stop capturing.
+ * @param deviceId    Id that identifies the device in the capture file.
+ */
+void SCAPI SteamController_SetRecorder(SteamControllerDevice *pDevice, SteamControllerRecorder *pRecorder, uint32_t deviceId) {
+  if (!pDevice)
+    return;
+
+  pDevice->pRecorder      = pRecorder;
+  pDevice->recordDeviceId = deviceId;
+
+  if (pRecorder) {
+    uint8_t isWireless = pDevice->isWireless ? 1 : 0;
+    SteamController_Record(pDevice, STEAMCONTROLLER_RECORD_DEVICE_INFO, &isWireless, 1);
+  }
+}
+
+/**
+ * Append a record to the capture file of a device. A single fwrite per
+ * record keeps records intact when several threads capture into one file.
+ */
+void SteamController_Record(const SteamControllerDevice *pDevice, uint8_t kind, const uint8_t *pData, size_t len) {
+  if (len > STEAMCONTROLLER_INPUT_REPORT_SIZE)
+    len = STEAMCONTROLLER_INPUT_REPORT_SIZE;
+
+  SteamControllerRecord record;
+  memset(&record, 0, sizeof(record));
+  record.hostTime = SteamController_GetHostTime();
+  record.deviceId = pDevice->recordDeviceId;
+  record.kind     = kind;
+  record.length   = (uint8_t)len;
+  memcpy(record.data, pData, len);
+
+  fwrite(&record, sizeof(record), 1, pDevice->pRecorder->pFile);
+}
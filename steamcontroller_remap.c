@@ -0,0 +1,277 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+#define STEAMCONTROLLER_REMAP_REGIONS       5     /**< Outside of any region, then one per direction. */
+
+/** Lookup tables of one layer. */
+typedef struct {
+  uint64_t                  buttonActions[3][256];    /**< Actions of each byte of the button bits. */
+  uint64_t                  padActions[2][STEAMCONTROLLER_REMAP_REGIONS];
+  uint32_t                  chordButtons[STEAMCONTROLLER_REMAP_MAX_CHORDS];
+  uint64_t                  chordActions[STEAMCONTROLLER_REMAP_MAX_CHORDS];
+  size_t                    chordCount;
+} SteamControllerRemapLayer;
+
+struct SteamControllerRemapTable {
+  uint32_t                  layerButtons[2];
+  uint32_t                  padButtons[2];
+  int64_t                   padDeadzoneSquared;
+  SteamControllerRemapLayer layers[STEAMCONTROLLER_REMAP_LAYERS];
+};
+
+/**
+ * Threads in SteamController_RemapState. New readers count themselves in the
+ * counter the epoch picks, so the other one drains while tables are swapped.
+ */
+typedef struct {
+  SteamControllerAtomicU32  epoch;
+  SteamControllerAtomicU32  readers[2];
+} SteamControllerRemapReaders;
+
+struct SteamControllerRemap {
+  SteamControllerAtomicPtr      pTable;     /**< Current SteamControllerRemapTable. */
+  SteamControllerRemapReaders  *pReaders;
+};
+
+/** Pad region for each STEAMCONTROLLER_REMAP_* direction, see SteamController_RemapPadRegion. */
+static const uint8_t SteamController_RemapDirectionRegions[4] = { 2, 4, 3, 1 };
+
+/**
+ * Region of a pad: 0 if inactive, else 1 + 2 * isHorizontal + isPositive.
+ * Compiles to comparisons and arithmetic, no branches.
+ */
+static inline unsigned SteamController_RemapPadRegion(const SteamControllerRemapTable *pTable, uint32_t buttons, unsigned pad, SteamControllerAxisPair position) {
+  int32_t x = position.x, y = position.y;
+
+  uint32_t  padButtons    = pTable->padButtons[pad];
+  unsigned  isActive      = (padButtons != 0) & ((buttons & padButtons) == padButtons)
+                          & ((int64_t)x*x + (int64_t)y*y > pTable->padDeadzoneSquared);
+  unsigned  isHorizontal  = (x < 0 ? -x : x) > (y < 0 ? -y : y);
+  unsigned  isPositive    = (isHorizontal & (x > 0)) | (!isHorizontal & (y > 0));
+
+  return isActive * (1 + 2 * isHorizontal + isPositive);
+}
+
+/** Bit of an action, 0 for STEAMCONTROLLER_REMAP_NO_ACTION. */
+static inline uint64_t SteamController_RemapActionBit(uint8_t action) {
+  return action < STEAMCONTROLLER_REMAP_MAX_ACTIONS ? (uint64_t)1 << action : 0;
+}
+
+/**
+ * Set up a profile that maps nothing. Pads are off and have a deadzone of a
+ * quarter of their range.
+ */
+void SCAPI SteamController_InitRemapProfile(SteamControllerRemapProfile *pProfile) {
+  memset(pProfile, 0, sizeof(SteamControllerRemapProfile));
+  memset(pProfile->buttonActions, STEAMCONTROLLER_REMAP_NO_ACTION, sizeof(pProfile->buttonActions));
+  memset(pProfile->padActions, STEAMCONTROLLER_REMAP_NO_ACTION, sizeof(pProfile->padActions));
+  pProfile->padDeadzone = 8192;
+}
+
+/**
+ * Compile a profile into lookup tables for SteamController_RemapState.
+ * @return The tables, or NULL if the profile is not valid.
+ */
+SteamControllerRemapTable *SteamController_CompileRemapProfile(const SteamControllerRemapProfile *pProfile) {
+  if (!pProfile)
+    return NULL;
+
+  if (pProfile->chordCount > STEAMCONTROLLER_REMAP_MAX_CHORDS) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "Remap profile has %zu chords, at most %d are supported", pProfile->chordCount, STEAMCONTROLLER_REMAP_MAX_CHORDS);
+    return NULL;
+  }
+
+  for (size_t i=0; i<pProfile->chordCount; i++) {
+    const SteamControllerRemapChord *pChord = &pProfile->chords[i];
+    if (!pChord->buttons || pChord->layer >= STEAMCONTROLLER_REMAP_LAYERS) {
+      SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "Remap profile chord %zu has no buttons or an invalid layer", i);
+      return NULL;
+    }
+  }
+
+  SteamControllerRemapTable *pTable = calloc(1, sizeof(SteamControllerRemapTable));
+  if (!pTable)
+    return NULL;
+
+  memcpy(pTable->layerButtons, pProfile->layerButtons, sizeof(pTable->layerButtons));
+  memcpy(pTable->padButtons, pProfile->padButtons, sizeof(pTable->padButtons));
+  pTable->padDeadzoneSquared = (int64_t)pProfile->padDeadzone * pProfile->padDeadzone;
+
+  for (unsigned layer=0; layer<STEAMCONTROLLER_REMAP_LAYERS; layer++) {
+    SteamControllerRemapLayer *pLayer = &pTable->layers[layer];
+
+    // Every combination of the eight buttons of a byte, built up from the
+    // combination without its highest bit.
+    for (unsigned byte=0; byte<3; byte++) {
+      for (unsigned value=1; value<256; value++) {
+        unsigned bit = 7;
+        while (!(value & (1u << bit)))
+          bit--;
+
+        pLayer->buttonActions[byte][value] = pLayer->buttonActions[byte][value & ~(1u << bit)]
+          | SteamController_RemapActionBit(pProfile->buttonActions[layer][byte * 8 + bit]);
+      }
+    }
+
+    for (unsigned pad=0; pad<2; pad++) {
+      for (unsigned direction=0; direction<4; direction++)
+        pLayer->padActions[pad][SteamController_RemapDirectionRegions[direction]] = SteamController_RemapActionBit(pProfile->padActions[layer][pad][direction]);
+    }
+
+    for (size_t i=0; i<pProfile->chordCount; i++) {
+      const SteamControllerRemapChord *pChord = &pProfile->chords[i];
+      if (pChord->layer != layer)
+        continue;
+
+      pLayer->chordButtons[pLayer->chordCount] = pChord->buttons;
+      pLayer->chordActions[pLayer->chordCount] = SteamController_RemapActionBit(pChord->action);
+      pLayer->chordCount++;
+    }
+  }
+
+  return pTable;
+}
+
+/** Free compiled tables. */
+void SCAPI SteamController_DestroyRemapTable(SteamControllerRemapTable *pTable) {
+  free(pTable);
+}
+
+/**
+ * Get the actions a state triggers. The layer is picked by the layer buttons,
+ * then chords whose buttons are all held fire and hide their buttons from
+ * the single button actions, then pad regions are added. Takes three table
+ * lookups for the buttons, one per pad and a few bitwise operations per chord
+ * of the layer.
+ *
+ * @return Bit n is set if action n is triggered.
+ */
+uint64_t SCAPI SteamController_RemapTableState(const SteamControllerRemapTable *pTable, const SteamControllerState *pState) {
+  if (!pTable || !pState)
+    return 0;
+
+  uint32_t buttons = pState->activeButtons;
+
+  unsigned layer = ((buttons & pTable->layerButtons[0]) != 0) | (((buttons & pTable->layerButtons[1]) != 0) << 1);
+  const SteamControllerRemapLayer *pLayer = &pTable->layers[layer];
+
+  uint64_t actions      = 0;
+  uint32_t chordButtons = 0;
+  for (size_t i=0; i<pLayer->chordCount; i++) {
+    uint32_t  chord = pLayer->chordButtons[i];
+    uint64_t  isHeld = 0 - (uint64_t)((buttons & chord) == chord);
+
+    actions       |= pLayer->chordActions[i] & isHeld;
+    chordButtons  |= chord & (uint32_t)isHeld;
+  }
+
+  uint32_t single = buttons & ~chordButtons;
+  actions |= pLayer->buttonActions[0][single & 0xff]
+          |  pLayer->buttonActions[1][(single >> 8) & 0xff]
+          |  pLayer->buttonActions[2][(single >> 16) & 0xff];
+
+  actions |= pLayer->padActions[0][SteamController_RemapPadRegion(pTable, buttons, 0, pState->leftPad)];
+  actions |= pLayer->padActions[1][SteamController_RemapPadRegion(pTable, buttons, 1, pState->rightPad)];
+
+  return actions;
+}
+
+/**
+ * Create a remapper that uses some tables. The remapper owns the tables
+ * from now on.
+ */
+SteamControllerRemap *SteamController_CreateRemap(SteamControllerRemapTable *pTable) {
+  if (!pTable)
+    return NULL;
+
+  SteamControllerRemap *pRemap = malloc(sizeof(SteamControllerRemap));
+  if (!pRemap)
+    return NULL;
+
+  pRemap->pReaders = calloc(1, sizeof(SteamControllerRemapReaders));
+  if (!pRemap->pReaders) {
+    free(pRemap);
+    return NULL;
+  }
+
+  SteamController_AtomicStorePtr(&pRemap->pTable, pTable);
+  return pRemap;
+}
+
+/** Free a remapper and its tables. */
+void SCAPI SteamController_DestroyRemap(SteamControllerRemap *pRemap) {
+  if (!pRemap)
+    return;
+
+  free(SteamController_AtomicLoadPtr(&pRemap->pTable));
+  free(pRemap->pReaders);
+  free(pRemap);
+}
+
+/**
+ * Wait until no reader counted in one counter is left. The read is an atomic
+ * operation on the counter, so it orders against the increment of a reader.
+ */
+static void SteamController_RemapDrainReaders(SteamControllerAtomicU32 *pReaders) {
+  for (;;) {
+    uint32_t expected = 0;
+    if (SteamController_AtomicCompareExchange32(pReaders, &expected, 0))
+      return;
+
+#if _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+  }
+}
+
+/**
+ * Replace the tables of a remapper, for example when the player switches
+ * profiles. Safe while other threads call SteamController_RemapState, which
+ * sees either the old or the new tables, never a mix. Waits for the calls
+ * that may still use the old tables to return.
+ *
+ * @return The old tables, no longer in use. Free them with
+ *         SteamController_DestroyRemapTable.
+ */
+SteamControllerRemapTable *SteamController_SwapRemapTable(SteamControllerRemap *pRemap, SteamControllerRemapTable *pTable) {
+  if (!pRemap || !pTable)
+    return NULL;
+
+  SteamControllerRemapReaders *pReaders = pRemap->pReaders;
+  SteamControllerRemapTable   *pOld     = SteamController_AtomicExchangePtr(&pRemap->pTable, pTable);
+
+  // A reader may have picked its counter before an earlier swap, so drain
+  // both, each after moving new readers to the other one.
+  for (int i=0; i<2; i++) {
+    uint32_t epoch = SteamController_AtomicAdd32(&pReaders->epoch, 1);
+    SteamController_RemapDrainReaders(&pReaders->readers[epoch & 1]);
+  }
+
+  return pOld;
+}
+
+/**
+ * Get the actions a state triggers with the current tables of a remapper.
+ * Costs two atomic operations on top of SteamController_RemapTableState.
+ */
+uint64_t SCAPI SteamController_RemapState(const SteamControllerRemap *pRemap, const SteamControllerState *pState) {
+  if (!pRemap)
+    return 0;
+
+  SteamControllerRemapReaders *pReaders = pRemap->pReaders;
+  SteamControllerAtomicU32    *pCount   = &pReaders->readers[SteamController_AtomicLoad32(&pReaders->epoch) & 1];
+
+  SteamController_AtomicAdd32(pCount, 1);
+  uint64_t actions = SteamController_RemapTableState(SteamController_AtomicLoadPtr(&pRemap->pTable), pState);
+  SteamController_AtomicAdd32(pCount, (uint32_t)-1);
+
+  return actions;
+}
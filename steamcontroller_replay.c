@@ -0,0 +1,207 @@
+#if _MSC_VER
+#pragma warning(disable: 4206)  // MSC: nonstandard extension used : translation unit is empty
+#endif
+
+#if __linux__
+
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef struct {
+  const uint8_t            *pMapping;
+  size_t                    mappingSize;
+  size_t                    recordSize;
+  size_t                    recordCount;
+  uint64_t                  firstInputTime;     /**< Host time of the first input record of the device. */
+  uint64_t                  replayStartTime;    /**< Host time at which the replay was opened. */
+  uint32_t                  deviceId;
+  bool                      isRealTime;
+
+  size_t                    inputIndex;         /**< Next record to look at for input reports. */
+  size_t                    responseIndex;      /**< Next record to look at for feature responses. */
+} SteamControllerReplay;
+
+static const SteamControllerRecord *SteamController_ReplayRecord(const SteamControllerReplay *pReplay, size_t index) {
+  return (const SteamControllerRecord *)(pReplay->pMapping + sizeof(SteamControllerRecordHeader) + index * pReplay->recordSize);
+}
+
+/** Find the next record of the replayed device with the given kind, starting at *pIndex. */
+static const SteamControllerRecord *SteamController_ReplayFind(const SteamControllerReplay *pReplay, uint8_t kind, size_t *pIndex) {
+  for (size_t i=*pIndex; i<pReplay->recordCount; i++) {
+    const SteamControllerRecord *pRecord = SteamController_ReplayRecord(pReplay, i);
+    if (pRecord->deviceId == pReplay->deviceId && pRecord->kind == kind) {
+      *pIndex = i;
+      return pRecord;
+    }
+  }
+
+  *pIndex = pReplay->recordCount;
+  return NULL;
+}
+
+/** Next input record if it is due, NULL otherwise. */
+static const SteamControllerRecord *SteamController_ReplayNextInput(SteamControllerReplay *pReplay) {
+  const SteamControllerRecord *pRecord = SteamController_ReplayFind(pReplay, STEAMCONTROLLER_RECORD_INPUT, &pReplay->inputIndex);
+  if (!pRecord)
+    return NULL;
+
+  if (pReplay->isRealTime) {
+    uint64_t dueTime = pRecord->hostTime - pReplay->firstInputTime;
+    if (SteamController_GetHostTime() - pReplay->replayStartTime < dueTime)
+      return NULL;
+  }
+
+  return pRecord;
+}
+
+static uint8_t SteamController_ReplayReadRaw(void *pContext, uint8_t *buffer, uint8_t maxLen) {
+  SteamControllerReplay *pReplay = (SteamControllerReplay *)pContext;
+
+  const SteamControllerRecord *pRecord = SteamController_ReplayNextInput(pReplay);
+  if (!pRecord)
+    return 0;
+
+  uint8_t len = pRecord->length < maxLen ? pRecord->length : maxLen;
+  memcpy(buffer, pRecord->data, len);
+  pReplay->inputIndex++;
+  return len;
+}
+
+static bool SteamController_ReplaySetFeatureReport(void *pContext, uint8_t *pReport) {
+  (void)pContext;
+  (void)pReport;
+
+  // Whatever was sent during the capture, the responses are already recorded.
+  return true;
+}
+
+static bool SteamController_ReplayGetFeatureReport(void *pContext, uint8_t *pReport) {
+  SteamControllerReplay *pReplay = (SteamControllerReplay *)pContext;
+
+  // The capture may have started after requests this replay is asked for,
+  // so only answer with a response to the same feature.
+  SteamController_HIDFeatureReport *pRequest = (SteamController_HIDFeatureReport *)pReport;
+  size_t index = pReplay->responseIndex;
+  const SteamControllerRecord *pRecord;
+  while ((pRecord = SteamController_ReplayFind(pReplay, STEAMCONTROLLER_RECORD_FEATURE_GET, &index)) != NULL) {
+    if (pRecord->length > 1 && pRecord->data[1] == pRequest->featureId)
+      break;
+    index++;
+  }
+
+  if (!pRecord)
+    return false;
+
+  memset(pReport, 0, STEAMCONTROLLER_FEATURE_REPORT_SIZE);
+  memcpy(pReport, pRecord->data, pRecord->length);
+  pReplay->responseIndex = index + 1;
+  return true;
+}
+
+static void SteamController_ReplayClose(void *pContext) {
+  SteamControllerReplay *pReplay = (SteamControllerReplay *)pContext;
+
+  munmap((void *)pReplay->pMapping, pReplay->mappingSize);
+  free(pReplay);
+}
+
+static bool SteamController_ReplayHasPendingInput(void *pContext) {
+  return SteamController_ReplayNextInput((SteamControllerReplay *)pContext) != NULL;
+}
+
+static const SteamControllerTransport ReplayTransport = {
+  .readRaw          = SteamController_ReplayReadRaw,
+  .setFeatureReport = SteamController_ReplaySetFeatureReport,
+  .getFeatureReport = SteamController_ReplayGetFeatureReport,
+  .close            = SteamController_ReplayClose,
+  .getPollFd        = NULL,
+  .hasPendingInput  = SteamController_ReplayHasPendingInput,
+};
+
+/**
+ * Open a device that plays back the reports of one device from a capture file.
+ * Feature reports sent to it are accepted and dropped, requests for feature
+ * reports are answered with the next recorded response to the same feature.
+ *
+ * @param pPath       Capture file created by a SteamControllerRecorder.
+ * @param deviceId    Id of the captured device to play back.
+ * @param isRealTime  If set, input reports become available with their original timing,
+ *                    the first one right after opening the replay. Otherwise they are delivered as fast as they are read.
+ * @return New device or NULL on failure.
+ */
+SteamControllerDevice *SteamController_OpenReplay(const char *pPath, uint32_t deviceId, bool isRealTime) {
+  if (!pPath)
+    return NULL;
+
+  int fd = open(pPath, O_RDONLY);
+  if (fd < 0) {
+    SteamController_LogErrno("open");
+    return NULL;
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) < 0 || (size_t)fileStat.st_size < sizeof(SteamControllerRecordHeader)) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "%s is not a capture file.", pPath);
+    close(fd);
+    return NULL;
+  }
+
+  size_t mappingSize = (size_t)fileStat.st_size;
+  void *pMapping = mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (pMapping == MAP_FAILED) {
+    SteamController_LogErrno("mmap");
+    return NULL;
+  }
+
+  const SteamControllerRecordHeader *pHeader = (const SteamControllerRecordHeader *)pMapping;
+  if (memcmp(pHeader->magic, STEAMCONTROLLER_RECORD_MAGIC, sizeof(pHeader->magic)) != 0
+      || pHeader->version != STEAMCONTROLLER_RECORD_VERSION
+      || pHeader->recordSize < sizeof(SteamControllerRecord)) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "%s is not a supported capture file.", pPath);
+    munmap(pMapping, mappingSize);
+    return NULL;
+  }
+
+  SteamControllerReplay *pReplay = malloc(sizeof(SteamControllerReplay));
+  if (!pReplay) {
+    munmap(pMapping, mappingSize);
+    return NULL;
+  }
+
+  memset(pReplay, 0, sizeof(SteamControllerReplay));
+  pReplay->pMapping         = (const uint8_t *)pMapping;
+  pReplay->mappingSize      = mappingSize;
+  pReplay->recordSize       = pHeader->recordSize;
+  pReplay->recordCount      = (mappingSize - sizeof(SteamControllerRecordHeader)) / pHeader->recordSize;
+  pReplay->deviceId         = deviceId;
+  pReplay->isRealTime       = isRealTime;
+
+  // Records are read in file order, so tell the kernel to read ahead.
+  madvise(pMapping, mappingSize, MADV_SEQUENTIAL);
+
+  size_t infoIndex = 0;
+  const SteamControllerRecord *pInfo = SteamController_ReplayFind(pReplay, STEAMCONTROLLER_RECORD_DEVICE_INFO, &infoIndex);
+  bool isWireless = pInfo && pInfo->length > 0 && pInfo->data[0];
+
+  // The capture may have run for a while before the device was attached.
+  size_t firstIndex = 0;
+  const SteamControllerRecord *pFirst = SteamController_ReplayFind(pReplay, STEAMCONTROLLER_RECORD_INPUT, &firstIndex);
+  pReplay->firstInputTime = pFirst ? pFirst->hostTime : 0;
+
+  pReplay->replayStartTime = SteamController_GetHostTime();
+
+  SteamControllerDevice *pDevice = SteamController_OpenTransport(&ReplayTransport, pReplay, isWireless);
+  if (!pDevice)
+    SteamController_ReplayClose(pReplay);
+
+  return pDevice;
+}
+
+#endif
@@ -1,41 +1,29 @@
 #include "steamcontroller.h"
 #include "common.h"
 
-void Debug_DumpHex(const void *pData, size_t count) {
-  const uint8_t *data = (const uint8_t *)pData;
-  const uint8_t *line = data;
-
-  for (size_t i=0; i<count; i++) {
-    fprintf(stderr, "%02x ", data[i]);
-    if ((i % 0x10) == 0xF) {
-      fprintf(stderr, " ");
-      for (size_t j=0; j<16; j++) {
-        if (line[j]>31 && line[j]<0x80)
-          fprintf(stderr, "%c", line[j]);
-        else
-          fprintf(stderr, ".");
-      }
-      fprintf(stderr, "\n");
-      line = data+i+1;
-    }
-  }
-  fprintf(stderr, "\n");
-}
-
-/** Set up the controller to be usable. */
-bool SteamController_Initialize(const SteamControllerDevice *pDevice) {
+/**
+ * Set up the controller to be usable.
+ * @param flags   With STEAMCONTROLLER_OPEN_LAZY only the essential reports are sent.
+ */
+bool SteamController_Initialize(const SteamControllerDevice *pDevice, unsigned flags) {
   assert(pDevice);
 
   if (!pDevice)
     return false;
 
+  SteamController_InvalidateSettings(pDevice);
+
+  bool isLazy = (flags & STEAMCONTROLLER_OPEN_LAZY) != 0;
+
   SteamController_HIDFeatureReport featureReport;
 
   if (SteamController_IsWirelessDongle(pDevice)) {
-    memset(&featureReport, 0, sizeof(featureReport));
-    featureReport.featureId = 0;
+    if (!isLazy) {
+      memset(&featureReport, 0, sizeof(featureReport));
+      featureReport.featureId = 0;
 
-    SteamController_HIDGetFeatureReport(pDevice, &featureReport);
+      SteamController_HIDGetFeatureReport(pDevice, &featureReport);
+    }
 
     // Not really sure why the controller needs entropy. Maybe the it is used
     // to avoid collision of RF transmissions.
@@ -46,7 +34,7 @@ bool SteamController_Initialize(const SteamControllerDevice *pDevice) {
       featureReport.data[i] = (uint8_t)rand(); // FIXME
 
     if (!SteamController_HIDSetFeatureReport(pDevice, &featureReport)) {
-      fprintf(stderr, "SET_PRNG_ENTROPY failed for controller %p\n", pDevice);
+      SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "SET_PRNG_ENTROPY failed for controller %p", pDevice);
       return false;
     }
 
@@ -57,141 +45,225 @@ bool SteamController_Initialize(const SteamControllerDevice *pDevice) {
     SteamController_HIDSetFeatureReport(pDevice, &featureReport);
 
     // TODO: Is this neccessary? The results are not used.
-    memset(&featureReport, 0, sizeof(featureReport));
-    featureReport.featureId   = STEAMCONTROLLER_DONGLE_GET_WIRELESS_STATE;
-    SteamController_HIDGetFeatureReport(pDevice, &featureReport);
+    if (!isLazy) {
+      memset(&featureReport, 0, sizeof(featureReport));
+      featureReport.featureId   = STEAMCONTROLLER_DONGLE_GET_WIRELESS_STATE;
+      SteamController_HIDGetFeatureReport(pDevice, &featureReport);
+    }
   }
 
-  // TODO: Is this neccessary? What could these attributes mean? The only
-  // value ever observed for this is 0.
+  // Attributes and chip id are only informational, a device opened before
+  // has them cached already.
+  bool isCached = SteamController_LoadCachedAttributes(pDevice);
+  if (!isLazy && !isCached && !SteamController_QueryAttributes(pDevice, NULL))
+    return false;
+
   memset(&featureReport, 0, sizeof(featureReport));
-  featureReport.featureId   = STEAMCONTROLLER_GET_ATTRIBUTES;
+  featureReport.featureId   = STEAMCONTROLLER_CLEAR_MAPPINGS;
 
-  if (!SteamController_HIDGetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "Failed to get GET_ATTRIBUTES response for controller %p\n", pDevice);
+  if (!SteamController_HIDSetFeatureReport(pDevice, &featureReport)) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "CLEAR_MAPPINGS failed for controller %p", pDevice);
     return false;
   } 
 
-  if (featureReport.dataLen < 4) {
-    fprintf(stderr, "Bad GET_ATTRIBUTES response for controller %p\n", pDevice);
-    // Don't fail, the controller still works without.
-    // return false;
+  // A lazy or cached open leaves the version to the first SteamController_GetAttributes.
+  if (isLazy || isCached) {
+    SteamController_DeferVersionQuery(pDevice);
+    return true;
   }
 
-  /*
-    example data:
+  return SteamController_QueryVersion(pDevice);
+}
 
-    0000   83 23 00 00 00 00 00 01 02 11 00 00 02 03 00 00
-    0010   00 0a 6d 92 d2 55 04 01 8c c7 56 05 6c 4a 42 56
-    0020   09 0a 00 00 00 00 00 00 00 00 00 00 00 00 00 00
-    0030   00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00
+/** Build the SET_SETTINGS feature report for SteamController_Configure. */
+void SteamController_BuildConfigureReport(SteamController_HIDFeatureReport *pReport, unsigned configFlags) {
+  // observed sequence when changing from desktop to steam: 
+  // 87 15 325802 180000 310200 080700 070700 300000 2e0000 0000000000000000000000000000000000000000000000000000000000000000000000000000000000
 
-    0x0011 or 0x0021?: board revision (=10)
-    0x0012: uint32 = Bootloader revision (unix timestamp)
-    0x0017: uint32 = Controller firmware revision (unix timestamp)
-    0x001b: uint32 = Radio firmware revision (unix timestamp)
-  */
+  memset(pReport, 0, sizeof(SteamController_HIDFeatureReport));
+  pReport->featureId   = STEAMCONTROLLER_SET_SETTINGS;
+
+  SteamController_FeatureReportAddSetting(pReport, 0x32, 300); // 0x012c seconds to controller shutdown
+  //SteamController_FeatureReportAddSetting(pReport, 0x03, 0x2d); // 0x2d, unknown
+  SteamController_FeatureReportAddSetting(pReport, 0x05, (configFlags & STEAMCONTROLLER_CONFIG_RIGHT_PAD_HAPTIC_TOUCH)     ? 1 : 0);
+  SteamController_FeatureReportAddSetting(pReport, 0x07, (configFlags & STEAMCONTROLLER_CONFIG_STICK_HAPTIC)               ? 0 : 7);
+  SteamController_FeatureReportAddSetting(pReport, 0x08, (configFlags & STEAMCONTROLLER_CONFIG_RIGHT_PAD_HAPTIC_TRACKBALL) ? 0 : 7);
+  SteamController_FeatureReportAddSetting(pReport, 0x18, 0x00); // 0x00, unknown
+  SteamController_FeatureReportAddSetting(pReport, 0x2d, 100);  // home button brightness, default to 100
+  SteamController_FeatureReportAddSetting(pReport, 0x2e, 0x00); // 0x00, unknown
+  SteamController_FeatureReportAddSetting(pReport, 0x2f, 0x01); // 0x01, unknown
+  SteamController_FeatureReportAddSetting(pReport, 0x30, (configFlags & 31));
+  SteamController_FeatureReportAddSetting(pReport, 0x31, (configFlags & STEAMCONTROLLER_CONFIG_SEND_BATTERY_STATUS)        ? 2 : 0);
+}
 
-  memset(&featureReport, 0, sizeof(featureReport));
-  featureReport.featureId   = STEAMCONTROLLER_CLEAR_MAPPINGS;
+/** Start a settings transaction with no settings in it. */
+void SCAPI SteamController_BeginSettings(SteamControllerSettings *pSettings) {
+  if (!pSettings)
+    return;
 
-  if (!SteamController_HIDSetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "CLEAR_MAPPINGS failed for controller %p\n", pDevice);
-    return false;
-  } 
+  memset(pSettings, 0, sizeof(SteamControllerSettings));
+}
 
-  // TODO: Find out more about the chip id.
-  memset(&featureReport, 0, sizeof(featureReport));
-  featureReport.featureId   = STEAMCONTROLLER_GET_CHIPID;
+/** Set a setting register in a transaction. Setting it again replaces the value. */
+void SCAPI SteamController_SetSetting(SteamControllerSettings *pSettings, uint8_t setting, uint16_t value) {
+  if (!pSettings)
+    return;
 
-  if (!SteamController_HIDGetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "GET_CHIPID failed for controller %p\n", pDevice);
-    return false;
-  }
+  pSettings->values[setting]       = value;
+  pSettings->isSet[setting >> 3]  |= 1 << (setting & 7);
+}
 
-  // TODO: Neccessary? Maybe remove like the other boot loaded stuff.
-  memset(&featureReport, 0, sizeof(featureReport));
-  featureReport.featureId   = STEAMCONTROLLER_DONGLE_GET_VERSION;
+/** Add the settings that SteamController_Configure derives from configFlags to a transaction. */
+void SCAPI SteamController_SetConfigureSettings(SteamControllerSettings *pSettings, unsigned configFlags) {
+  //SteamController_SetSetting(pSettings, 0x03, 0x2d); // 0x2d, unknown
+  SteamController_SetSetting(pSettings, 0x05, (configFlags & STEAMCONTROLLER_CONFIG_RIGHT_PAD_HAPTIC_TOUCH)     ? 1 : 0);
+  SteamController_SetSetting(pSettings, 0x07, (configFlags & STEAMCONTROLLER_CONFIG_STICK_HAPTIC)               ? 0 : 7);
+  SteamController_SetSetting(pSettings, 0x08, (configFlags & STEAMCONTROLLER_CONFIG_RIGHT_PAD_HAPTIC_TRACKBALL) ? 0 : 7);
+  SteamController_SetSetting(pSettings, 0x18, 0x00); // 0x00, unknown
+  SteamController_SetSetting(pSettings, 0x2e, 0x00); // 0x00, unknown
+  SteamController_SetSetting(pSettings, 0x2f, 0x01); // 0x01, unknown
+  SteamController_SetSetting(pSettings, 0x30, (configFlags & 31));
+  SteamController_SetSetting(pSettings, 0x31, (configFlags & STEAMCONTROLLER_CONFIG_SEND_BATTERY_STATUS)        ? 2 : 0);
+}
 
-  if (!SteamController_HIDGetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "DONGLE_GET_VERSION failed for controller %p\n", pDevice);
-    return false;
-  }
+/**
+ * Forget what the device has been configured to, the next commit sends
+ * everything. Safe from any thread, also while a commit is running.
+ */
+void SteamController_InvalidateSettings(const SteamControllerDevice *pDevice) {
+  if (!pDevice)
+    return;
 
-  return true;
+  SteamController_AtomicAdd32(&pDevice->pSettingsCache->generation, 1);
 }
 
-/** Add a settings parameter and value to an SET_SETTINGS feature report. */
-static inline void SteamController_FeatureReportAddSetting(SteamController_HIDFeatureReport *featureReport, uint8_t setting, uint16_t value) {
-  uint8_t offset = featureReport->dataLen;
-  featureReport->data[offset] = setting;
-  StoreU16(featureReport->data + offset + 1, value);
+/**
+ * Drop the known values if the cache was invalidated since they were learned.
+ * @return Generation the known values belong to now.
+ */
+static uint32_t SteamController_SyncSettingsCache(SteamControllerSettingsCache *pCache) {
+  uint32_t generation = SteamController_AtomicLoad32(&pCache->generation);
+  if (generation != pCache->knownGeneration) {
+    memset(pCache->isKnown, 0, sizeof(pCache->isKnown));
+    pCache->knownGeneration = generation;
+  }
 
-  featureReport->dataLen += 3;
+  return generation;
 }
 
-/** Enable or disable specific controller features. */
-bool SCAPI SteamController_Configure(const SteamControllerDevice *pDevice, unsigned configFlags) {
-  SteamController_HIDFeatureReport featureReport;
-
-  // observed sequence when changing from desktop to steam: 
-  // 87 15 325802 180000 310200 080700 070700 300000 2e0000 0000000000000000000000000000000000000000000000000000000000000000000000000000000000
+/**
+ * Send a SET_SETTINGS report and remember the settings in it as known, unless
+ * the cache was invalidated meanwhile.
+ */
+static bool SteamController_SendSettings(const SteamControllerDevice *pDevice, SteamController_HIDFeatureReport *pReport, uint32_t generation) {
+  if (!SteamController_HIDSetFeatureReport(pDevice, pReport)) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "SET_SETTINGS failed for controller %p", pDevice);
+    return false;
+  }
 
-  memset(&featureReport, 0, sizeof(featureReport));
-  featureReport.featureId   = STEAMCONTROLLER_SET_SETTINGS;
-
-  SteamController_FeatureReportAddSetting(&featureReport, 0x32, 300); // 0x012c seconds to controller shutdown
-  //SteamController_FeatureReportAddSetting(&featureReport, 0x03, 0x2d); // 0x2d, unknown
-  SteamController_FeatureReportAddSetting(&featureReport, 0x05, (configFlags & STEAMCONTROLLER_CONFIG_RIGHT_PAD_HAPTIC_TOUCH)     ? 1 : 0);
-  SteamController_FeatureReportAddSetting(&featureReport, 0x07, (configFlags & STEAMCONTROLLER_CONFIG_STICK_HAPTIC)               ? 0 : 7);
-  SteamController_FeatureReportAddSetting(&featureReport, 0x08, (configFlags & STEAMCONTROLLER_CONFIG_RIGHT_PAD_HAPTIC_TRACKBALL) ? 0 : 7);
-  SteamController_FeatureReportAddSetting(&featureReport, 0x18, 0x00); // 0x00, unknown
-  SteamController_FeatureReportAddSetting(&featureReport, 0x2d, 100);  // home button brightness, default to 100
-  SteamController_FeatureReportAddSetting(&featureReport, 0x2e, 0x00); // 0x00, unknown
-  SteamController_FeatureReportAddSetting(&featureReport, 0x2f, 0x01); // 0x01, unknown
-  SteamController_FeatureReportAddSetting(&featureReport, 0x30, (configFlags & 31));
-  SteamController_FeatureReportAddSetting(&featureReport, 0x31, (configFlags & STEAMCONTROLLER_CONFIG_SEND_BATTERY_STATUS)        ? 2 : 0);
+  SteamControllerSettingsCache *pCache = pDevice->pSettingsCache;
+  if (SteamController_AtomicLoad32(&pCache->generation) != generation)
+    return true;
 
-  if (!SteamController_HIDSetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "SET_SETTINGS failed for controller %p\n", pDevice);
-    return false;
+  for (uint8_t offset=0; offset+3<=pReport->dataLen; offset+=3) {
+    uint8_t setting = pReport->data[offset];
+    pCache->values[setting]          = pReport->data[offset + 1] | (pReport->data[offset + 2] << 8);
+    pCache->isKnown[setting >> 3]   |= 1 << (setting & 7);
   }
 
   return true;
 }
 
-/** Set the brightness of the home button in percent (0-100). */
-bool SCAPI SteamController_SetHomeButtonBrightness(const SteamControllerDevice *pDevice, uint8_t brightness) {
-  SteamController_HIDFeatureReport featureReport;
+/**
+ * Send the settings of a transaction that differ from what was last sent to
+ * the device. Changed settings are packed into as few SET_SETTINGS reports as
+ * possible. The cache is reset when the controller connects or disconnects.
+ * Commits to one device must not run at the same time.
+ *
+ * @param pDevice     Device to configure.
+ * @param pSettings   Settings to apply.
+ * @return Number of reports sent, or -1 if sending one failed.
+ */
+int SCAPI SteamController_CommitSettings(const SteamControllerDevice *pDevice, const SteamControllerSettings *pSettings) {
+  if (!pDevice || !pSettings)
+    return -1;
+
+  const SteamControllerSettingsCache *pCache = pDevice->pSettingsCache;
+  uint32_t generation = SteamController_SyncSettingsCache(pDevice->pSettingsCache);
 
+  SteamController_HIDFeatureReport featureReport;
   memset(&featureReport, 0, sizeof(featureReport));
-  featureReport.featureId   = STEAMCONTROLLER_SET_SETTINGS;
+  featureReport.featureId = STEAMCONTROLLER_SET_SETTINGS;
 
-  SteamController_FeatureReportAddSetting(&featureReport, 0x2d, brightness); 
+  int reportCount = 0;
 
-  if (!SteamController_HIDSetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "SET_SETTINGS failed for controller %p\n", pDevice);
-    return false;
+  for (unsigned setting=0; setting<256; setting++) {
+    uint8_t mask = 1 << (setting & 7);
+    if (!(pSettings->isSet[setting >> 3] & mask))
+      continue;
+
+    bool isKnown = pCache->isKnown[setting >> 3] & mask;
+    if (isKnown && pCache->values[setting] == pSettings->values[setting])
+      continue;
+
+    SteamController_FeatureReportAddSetting(&featureReport, (uint8_t)setting, pSettings->values[setting]);
+
+    if (featureReport.dataLen == STEAMCONTROLLER_MAX_SETTINGS_PER_REPORT * 3) {
+      if (!SteamController_SendSettings(pDevice, &featureReport, generation))
+        return -1;
+
+      memset(&featureReport, 0, sizeof(featureReport));
+      featureReport.featureId = STEAMCONTROLLER_SET_SETTINGS;
+      reportCount++;
+    }
   }
 
-  return true;
+  if (featureReport.dataLen) {
+    if (!SteamController_SendSettings(pDevice, &featureReport, generation))
+      return -1;
+    reportCount++;
+  }
+
+  return reportCount;
 }
 
-/** Set the timeout in seconds for turning off automatically when not in use. */
-bool SCAPI SteamController_SetTimeOut(const SteamControllerDevice *pDevice, uint16_t timeout) {
-  SteamController_HIDFeatureReport featureReport;
+/**
+ * Enable or disable specific controller features. Only settings that changed
+ * since the last call are sent. The timeout and home button brightness are
+ * set to their defaults unless they have been set before.
+ */
+bool SCAPI SteamController_Configure(const SteamControllerDevice *pDevice, unsigned configFlags) {
+  if (!pDevice)
+    return false;
 
-  memset(&featureReport, 0, sizeof(featureReport));
-  featureReport.featureId   = STEAMCONTROLLER_SET_SETTINGS;
+  SteamControllerSettings settings;
+  SteamController_BeginSettings(&settings);
 
-  SteamController_FeatureReportAddSetting(&featureReport, 0x32, timeout); 
+  const SteamControllerSettingsCache *pCache = pDevice->pSettingsCache;
+  SteamController_SyncSettingsCache(pDevice->pSettingsCache);
+  if (!(pCache->isKnown[0x32 >> 3] & (1 << (0x32 & 7))))
+    SteamController_SetSetting(&settings, 0x32, STEAMCONTROLLER_DEFAULT_TIMEOUT);
+  if (!(pCache->isKnown[0x2d >> 3] & (1 << (0x2d & 7))))
+    SteamController_SetSetting(&settings, 0x2d, STEAMCONTROLLER_DEFAULT_BRIGHTNESS);
 
-  if (!SteamController_HIDSetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "SET_SETTINGS failed for controller %p\n", pDevice);
-    return false;
-  }
+  SteamController_SetConfigureSettings(&settings, configFlags);
+  return SteamController_CommitSettings(pDevice, &settings) >= 0;
+}
 
-  return true;
+/** Set the brightness of the home button in percent (0-100). */
+bool SCAPI SteamController_SetHomeButtonBrightness(const SteamControllerDevice *pDevice, uint8_t brightness) {
+  SteamControllerSettings settings;
+  SteamController_BeginSettings(&settings);
+  SteamController_SetSetting(&settings, 0x2d, brightness);
+  return SteamController_CommitSettings(pDevice, &settings) >= 0;
+}
+
+/** Set the timeout in seconds for turning off automatically when not in use. */
+bool SCAPI SteamController_SetTimeOut(const SteamControllerDevice *pDevice, uint16_t timeout) {
+  SteamControllerSettings settings;
+  SteamController_BeginSettings(&settings);
+  SteamController_SetSetting(&settings, 0x32, timeout);
+  return SteamController_CommitSettings(pDevice, &settings) >= 0;
 }
 
 /** Turn off the controller (the configured melody will be played). */ 
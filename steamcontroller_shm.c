@@ -0,0 +1,484 @@
+#if _MSC_VER
+#pragma warning(disable: 4206)  // MSC: nonstandard extension used : translation unit is empty
+#endif
+
+#if __linux__
+
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define STEAMCONTROLLER_SHM_MAGIC         0x4d485343  // "SCHM"
+#define STEAMCONTROLLER_SHM_VERSION       1
+#define STEAMCONTROLLER_SHM_RING_MASK     (STEAMCONTROLLER_SHM_EVENT_RING_SIZE - 1)
+
+_Static_assert((STEAMCONTROLLER_SHM_EVENT_RING_SIZE & STEAMCONTROLLER_SHM_RING_MASK) == 0, "shared event ring size must be a power of two");
+
+/** Event as published in the ring, tagged with its position so readers can detect overwrites. */
+typedef struct {
+  uint32_t                    index;
+  uint32_t                    reserved;
+  SteamControllerTimedEvent   timedEvent;
+} SteamControllerShmEvent;
+
+_Static_assert(sizeof(SteamControllerShmEvent) % 4 == 0, "shared events are copied in 32 bit words");
+
+#define STEAMCONTROLLER_SHM_EVENT_WORDS   (sizeof(SteamControllerShmEvent) / 4)
+
+typedef struct {
+  SteamControllerAtomicU32    sequence;
+  SteamControllerAtomicU32    words[STEAMCONTROLLER_SHM_EVENT_WORDS];
+} SteamControllerShmEventSlot;
+
+/** Everything published for one controller. Written by the server only. */
+typedef struct {
+  _Alignas(64) SteamControllerAtomicU32 generation;  /**< Odd while a device is attached, bumped on every change. */
+  SteamControllerAtomicU32    eventHead;      /**< Index of the next event to publish. */
+  SteamControllerAtomicU32    stateSequence;
+  SteamControllerAtomicU32    stateWords[STEAMCONTROLLER_STATE_WORDS];
+  _Alignas(64) SteamControllerShmEventSlot events[STEAMCONTROLLER_SHM_EVENT_RING_SIZE];
+} SteamControllerShmController;
+
+typedef struct {
+  uint32_t                    magic;
+  uint32_t                    version;
+  uint32_t                    maxControllers;
+  uint32_t                    ringSize;
+  uint32_t                    regionSize;
+  _Alignas(64) SteamControllerShmController controllers[STEAMCONTROLLER_SHM_MAX_CONTROLLERS];
+} SteamControllerShmRegion;
+
+typedef struct {
+  SteamControllerShmServer   *pServer;
+  SteamControllerDevice      *pDevice;
+  SteamControllerState        state;          /**< Private copy the published state is built from. */
+  unsigned                    slot;
+} SteamControllerShmServerSlot;
+
+struct SteamControllerShmServer {
+  SteamControllerShmRegion     *pRegion;
+  int                           fd;             /**< Kept open to hold the lock that marks the region as owned. */
+  char                         *pName;
+  SteamControllerPoller        *pPoller;
+  SteamControllerShmServerSlot  slots[STEAMCONTROLLER_SHM_MAX_CONTROLLERS];
+};
+
+struct SteamControllerShmClient {
+  const SteamControllerShmRegion *pRegion;
+  uint32_t                        cursors[STEAMCONTROLLER_SHM_MAX_CONTROLLERS];   /**< Next event to read per slot. */
+};
+
+/**
+ * Create a region exclusively and lock it for the lifetime of the server. A
+ * region that exists but is not locked was left behind by a server that
+ * died and is replaced. The kernel drops the lock with the last descriptor,
+ * so a crashed owner never keeps it.
+ * @return Descriptor of the locked region or -1 on failure.
+ */
+static int SteamController_ShmCreateOwned(const char *pName) {
+  for (int attempt=0; attempt<2; attempt++) {
+    int fd = shm_open(pName, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd >= 0) {
+      if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+        return fd;
+
+      // Someone found the new region and took it for a stale one.
+      SteamController_LogErrno("flock");
+      close(fd);
+      return -1;
+    }
+
+    if (errno != EEXIST) {
+      SteamController_LogErrno("shm_open");
+      return -1;
+    }
+
+    fd = shm_open(pName, O_RDWR, 0);
+    if (fd < 0) {
+      if (errno == ENOENT)
+        continue;
+      SteamController_LogErrno("shm_open");
+      return -1;
+    }
+
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+      if (errno == EWOULDBLOCK)
+        SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "Shared memory region %s is in use by another server.", pName);
+      else
+        SteamController_LogErrno("flock");
+      close(fd);
+      return -1;
+    }
+
+    SteamController_Log(STEAMCONTROLLER_LOG_WARNING, "Replacing stale shared memory region %s.", pName);
+    shm_unlink(pName);
+    close(fd);
+  }
+
+  return -1;
+}
+
+/**
+ * Create a shared memory region and publish controllers through it.
+ * A region with the same name that was left behind by a server that died
+ * is replaced, creating fails while another server is running. Other users
+ * can map the region but not write to it.
+ *
+ * @param pName   POSIX shared memory name, like STEAMCONTROLLER_SHM_DEFAULT_NAME.
+ * @return New server or NULL on failure.
+ */
+SteamControllerShmServer *SteamController_CreateShmServer(const char *pName) {
+  if (!pName)
+    return NULL;
+
+  SteamControllerShmServer *pServer = malloc(sizeof(SteamControllerShmServer));
+  if (!pServer)
+    return NULL;
+
+  memset(pServer, 0, sizeof(SteamControllerShmServer));
+  for (unsigned i=0; i<STEAMCONTROLLER_SHM_MAX_CONTROLLERS; i++) {
+    pServer->slots[i].pServer = pServer;
+    pServer->slots[i].slot    = i;
+  }
+
+  pServer->pName = strdup(pName);
+  pServer->pPoller = SteamController_CreatePoller();
+  if (!pServer->pName || !pServer->pPoller) {
+    SteamController_DestroyPoller(pServer->pPoller);
+    free(pServer->pName);
+    free(pServer);
+    return NULL;
+  }
+
+  int fd = SteamController_ShmCreateOwned(pName);
+  if (fd < 0) {
+    SteamController_DestroyPoller(pServer->pPoller);
+    free(pServer->pName);
+    free(pServer);
+    return NULL;
+  }
+
+  // A fresh region is zero filled, which is a valid empty state.
+  void *pMapping = MAP_FAILED;
+  if (ftruncate(fd, sizeof(SteamControllerShmRegion)) < 0)
+    SteamController_LogErrno("ftruncate");
+  else
+    pMapping = mmap(NULL, sizeof(SteamControllerShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (pMapping == MAP_FAILED) {
+    SteamController_LogErrno("mmap");
+    shm_unlink(pName);
+    close(fd);
+    SteamController_DestroyPoller(pServer->pPoller);
+    free(pServer->pName);
+    free(pServer);
+    return NULL;
+  }
+
+  pServer->fd      = fd;
+  pServer->pRegion = (SteamControllerShmRegion *)pMapping;
+  pServer->pRegion->version         = STEAMCONTROLLER_SHM_VERSION;
+  pServer->pRegion->maxControllers  = STEAMCONTROLLER_SHM_MAX_CONTROLLERS;
+  pServer->pRegion->ringSize        = STEAMCONTROLLER_SHM_EVENT_RING_SIZE;
+  pServer->pRegion->regionSize      = sizeof(SteamControllerShmRegion);
+  SteamController_AtomicFenceRelease();
+  pServer->pRegion->magic           = STEAMCONTROLLER_SHM_MAGIC;
+
+  return pServer;
+}
+
+/** Close all devices of a server and remove its shared memory region. */
+void SCAPI SteamController_DestroyShmServer(SteamControllerShmServer *pServer) {
+  if (!pServer)
+    return;
+
+  for (unsigned i=0; i<STEAMCONTROLLER_SHM_MAX_CONTROLLERS; i++)
+    SteamController_ShmServerRemoveDevice(pServer, i);
+
+  SteamController_DestroyPoller(pServer->pPoller);
+  munmap(pServer->pRegion, sizeof(SteamControllerShmRegion));
+  shm_unlink(pServer->pName);
+  close(pServer->fd);
+  free(pServer->pName);
+  free(pServer);
+}
+
+/**
+ * Publish an event for a controller slot. The published state of the slot is
+ * updated from the event, then the event is appended to the ring of the slot.
+ * Use this to publish events from devices that are not read by the server.
+ */
+void SCAPI SteamController_ShmServerPublish(SteamControllerShmServer *pServer, unsigned slot, const SteamControllerTimedEvent *pEvent) {
+  if (!pServer || !pEvent || slot >= STEAMCONTROLLER_SHM_MAX_CONTROLLERS)
+    return;
+
+  SteamControllerShmServerSlot *pSlot = pServer->slots + slot;
+  SteamControllerShmController *pController = pServer->pRegion->controllers + slot;
+
+  SteamController_UpdateState(&pSlot->state, &pEvent->event);
+  SteamController_SeqlockWrite(&pController->stateSequence, pController->stateWords, &pSlot->state, STEAMCONTROLLER_STATE_WORDS);
+
+  SteamControllerShmEvent shmEvent;
+  memset(&shmEvent, 0, sizeof(shmEvent));
+  shmEvent.index      = SteamController_AtomicLoadRelaxed32(&pController->eventHead);
+  shmEvent.timedEvent = *pEvent;
+
+  SteamControllerShmEventSlot *pEventSlot = pController->events + (shmEvent.index & STEAMCONTROLLER_SHM_RING_MASK);
+  SteamController_SeqlockWrite(&pEventSlot->sequence, pEventSlot->words, &shmEvent, STEAMCONTROLLER_SHM_EVENT_WORDS);
+
+  SteamController_AtomicStore32(&pController->eventHead, shmEvent.index + 1);
+}
+
+static void SteamController_ShmServerHandleDevice(SteamControllerDevice *pDevice, bool isHangup, void *pUserData) {
+  SteamControllerShmServerSlot *pSlot = (SteamControllerShmServerSlot *)pUserData;
+
+  if (isHangup) {
+    SteamController_ShmServerRemoveDevice(pSlot->pServer, pSlot->slot);
+    return;
+  }
+
+  uint8_t eventDataBuf[STEAMCONTROLLER_INPUT_REPORT_SIZE];
+
+  // Bounded, so one busy device can't starve the others.
+  for (size_t i=0; i<STEAMCONTROLLER_SHM_EVENT_RING_SIZE; i++) {
+    uint16_t len = SteamController_ReadRaw(pDevice, eventDataBuf, sizeof(eventDataBuf));
+    if (!len)
+      break;
+
+    SteamControllerTimedEvent timedEvent;
+    timedEvent.hostTime = SteamController_GetHostTime();
+    if (SteamController_DecodeDeviceEvent(pDevice, eventDataBuf, len, &timedEvent.event)) {
+      SteamController_UpdateStateSnapshot(pDevice, &timedEvent.event);
+      SteamController_ShmServerPublish(pSlot->pServer, pSlot->slot, &timedEvent);
+    }
+  }
+}
+
+/**
+ * Publish a device through the server. The server takes ownership of the
+ * device and closes it when it is unplugged or removed.
+ * @return Slot of the device, or -1 if all slots are taken.
+ */
+int SCAPI SteamController_ShmServerAddDevice(SteamControllerShmServer *pServer, SteamControllerDevice *pDevice) {
+  if (!pServer || !pDevice)
+    return -1;
+
+  for (unsigned i=0; i<STEAMCONTROLLER_SHM_MAX_CONTROLLERS; i++) {
+    SteamControllerShmServerSlot *pSlot = pServer->slots + i;
+    if (pSlot->pDevice)
+      continue;
+
+    if (!SteamController_PollerAdd(pServer->pPoller, pDevice, pSlot))
+      return -1;
+
+    pSlot->pDevice = pDevice;
+    memset(&pSlot->state, 0, sizeof(SteamControllerState));
+
+    SteamControllerShmController *pController = pServer->pRegion->controllers + i;
+    SteamController_SeqlockWrite(&pController->stateSequence, pController->stateWords, &pSlot->state, STEAMCONTROLLER_STATE_WORDS);
+    SteamController_AtomicAdd32(&pController->generation, 1);
+    return (int)i;
+  }
+
+  return -1;
+}
+
+/** Stop publishing a controller slot and close its device. */
+void SCAPI SteamController_ShmServerRemoveDevice(SteamControllerShmServer *pServer, unsigned slot) {
+  if (!pServer || slot >= STEAMCONTROLLER_SHM_MAX_CONTROLLERS)
+    return;
+
+  SteamControllerShmServerSlot *pSlot = pServer->slots + slot;
+  if (!pSlot->pDevice)
+    return;
+
+  SteamController_PollerRemove(pServer->pPoller, pSlot->pDevice);
+  SteamController_Close(pSlot->pDevice);
+  pSlot->pDevice = NULL;
+
+  SteamController_AtomicAdd32(&pServer->pRegion->controllers[slot].generation, 1);
+}
+
+/**
+ * Open every controller and dongle slot and publish it. Meant to be called
+ * once when the server starts.
+ * @return Number of devices added.
+ */
+size_t SCAPI SteamController_ShmServerAddAll(SteamControllerShmServer *pServer) {
+  if (!pServer)
+    return 0;
+
+  size_t count = 0;
+  SteamControllerDeviceEnum *pEnum = SteamController_EnumControllerDevices();
+  while (pEnum) {
+    SteamControllerDevice *pDevice = SteamController_Open(pEnum);
+    if (pDevice) {
+      if (SteamController_ShmServerAddDevice(pServer, pDevice) >= 0)
+        count++;
+      else
+        SteamController_Close(pDevice);
+    }
+
+    pEnum = SteamController_NextControllerDevice(pEnum);
+  }
+
+  return count;
+}
+
+/**
+ * Wait for input on all published devices and publish it.
+ * Call this in a loop to run the server.
+ * @return Number of devices that had input, or -1 on error.
+ */
+int SCAPI SteamController_ShmServerWait(SteamControllerShmServer *pServer, int timeoutMs) {
+  if (!pServer)
+    return -1;
+
+  return SteamController_PollerWait(pServer->pPoller, timeoutMs, SteamController_ShmServerHandleDevice);
+}
+
+/**
+ * Map the region of a running server read only.
+ * @param pName   Name the server was created with.
+ * @return New client or NULL if there is no compatible server.
+ */
+SteamControllerShmClient *SteamController_OpenShmClient(const char *pName) {
+  if (!pName)
+    return NULL;
+
+  int fd = shm_open(pName, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+
+  struct stat regionStat;
+  if (fstat(fd, &regionStat) < 0 || (size_t)regionStat.st_size < sizeof(SteamControllerShmRegion)) {
+    close(fd);
+    return NULL;
+  }
+
+  void *pMapping = mmap(NULL, sizeof(SteamControllerShmRegion), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (pMapping == MAP_FAILED) {
+    SteamController_LogErrno("mmap");
+    return NULL;
+  }
+
+  const SteamControllerShmRegion *pRegion = (const SteamControllerShmRegion *)pMapping;
+  if (pRegion->magic != STEAMCONTROLLER_SHM_MAGIC) {
+    munmap(pMapping, sizeof(SteamControllerShmRegion));
+    return NULL;
+  }
+
+  SteamController_AtomicFenceAcquire();
+  if (pRegion->version != STEAMCONTROLLER_SHM_VERSION
+      || pRegion->maxControllers != STEAMCONTROLLER_SHM_MAX_CONTROLLERS
+      || pRegion->ringSize != STEAMCONTROLLER_SHM_EVENT_RING_SIZE
+      || pRegion->regionSize != sizeof(SteamControllerShmRegion)) {
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "Shared memory region %s has an incompatible layout.", pName);
+    munmap(pMapping, sizeof(SteamControllerShmRegion));
+    return NULL;
+  }
+
+  SteamControllerShmClient *pClient = malloc(sizeof(SteamControllerShmClient));
+  if (!pClient) {
+    munmap(pMapping, sizeof(SteamControllerShmRegion));
+    return NULL;
+  }
+
+  // Only events published from now on are read.
+  pClient->pRegion = pRegion;
+  for (unsigned i=0; i<STEAMCONTROLLER_SHM_MAX_CONTROLLERS; i++)
+    pClient->cursors[i] = SteamController_AtomicLoad32(&pRegion->controllers[i].eventHead);
+
+  return pClient;
+}
+
+void SCAPI SteamController_CloseShmClient(SteamControllerShmClient *pClient) {
+  if (!pClient)
+    return;
+
+  munmap((void *)pClient->pRegion, sizeof(SteamControllerShmRegion));
+  free(pClient);
+}
+
+/**
+ * Get the latest published state of a controller slot. Takes no locks and
+ * makes no system calls.
+ * @return true if a device is attached to the slot.
+ */
+bool SCAPI SteamController_ShmClientGetState(const SteamControllerShmClient *pClient, unsigned slot, SteamControllerState *pState) {
+  if (!pClient || !pState || slot >= STEAMCONTROLLER_SHM_MAX_CONTROLLERS)
+    return false;
+
+  const SteamControllerShmController *pController = pClient->pRegion->controllers + slot;
+
+  uint32_t words[STEAMCONTROLLER_STATE_WORDS];
+  SteamController_SeqlockRead(&pController->stateSequence, pController->stateWords, words, STEAMCONTROLLER_STATE_WORDS);
+  memcpy(pState, words, sizeof(SteamControllerState));
+
+  return SteamController_AtomicLoad32(&pController->generation) & 1;
+}
+
+/**
+ * Fetch events published for a controller slot since the last call.
+ * Events are not consumed, every client sees all of them.
+ *
+ * @param pClient     Client to read with.
+ * @param slot        Controller slot.
+ * @param pEvents     Where to store the events, oldest first.
+ * @param maxEvents   Number of events pEvents can hold.
+ * @param pLostCount  If not NULL, receives the number of events that were overwritten before they were read.
+ * @return Number of events stored in pEvents.
+ */
+size_t SCAPI SteamController_ShmClientReadEvents(SteamControllerShmClient *pClient, unsigned slot, SteamControllerTimedEvent *pEvents, size_t maxEvents, uint32_t *pLostCount) {
+  if (pLostCount)
+    *pLostCount = 0;
+
+  if (!pClient || !pEvents || slot >= STEAMCONTROLLER_SHM_MAX_CONTROLLERS)
+    return 0;
+
+  const SteamControllerShmController *pController = pClient->pRegion->controllers + slot;
+  uint32_t lostCount = 0;
+  size_t   count     = 0;
+
+  while (count < maxEvents) {
+    uint32_t head   = SteamController_AtomicLoad32(&pController->eventHead);
+    uint32_t cursor = pClient->cursors[slot];
+    if (cursor == head)
+      break;
+
+    if (head - cursor > STEAMCONTROLLER_SHM_EVENT_RING_SIZE) {
+      lostCount += head - cursor - STEAMCONTROLLER_SHM_EVENT_RING_SIZE;
+      cursor = head - STEAMCONTROLLER_SHM_EVENT_RING_SIZE;
+    }
+
+    const SteamControllerShmEventSlot *pEventSlot = pController->events + (cursor & STEAMCONTROLLER_SHM_RING_MASK);
+
+    SteamControllerShmEvent shmEvent;
+    SteamController_SeqlockRead(&pEventSlot->sequence, pEventSlot->words, &shmEvent, STEAMCONTROLLER_SHM_EVENT_WORDS);
+
+    if (shmEvent.index != cursor) {
+      // The server lapped us while we were reading, skip ahead.
+      lostCount++;
+      pClient->cursors[slot] = cursor + 1;
+      continue;
+    }
+
+    pEvents[count++] = shmEvent.timedEvent;
+    pClient->cursors[slot] = cursor + 1;
+  }
+
+  if (pLostCount)
+    *pLostCount = lostCount;
+
+  return count;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+_Static_assert(sizeof(SteamControllerState) % 4 == 0, "state snapshot is copied in 32 bit words");
+
+/**
+ * Publish data through a seqlock. Only one writer may use a seqlock at a time.
+ * The writer never waits for readers.
+ * 
+ * @param pSequence   Sequence counter of the seqlock.
+ * @param pWords      Published copy of the data.
+ * @param pData       Data to publish.
+ * @param wordCount   Size of the data in 32 bit words.
+ */
+void SteamController_SeqlockWrite(SteamControllerAtomicU32 *pSequence, SteamControllerAtomicU32 *pWords, const void *pData, size_t wordCount) {
+  uint32_t sequence = SteamController_AtomicLoadRelaxed32(pSequence);
+
+  SteamController_AtomicStoreRelaxed32(pSequence, sequence + 1);
+  SteamController_AtomicFenceRelease();
+
+  for (size_t i=0; i<wordCount; i++) {
+    uint32_t word;
+    memcpy(&word, (const uint32_t *)pData + i, sizeof(word));
+    SteamController_AtomicStoreRelaxed32(pWords + i, word);
+  }
+
+  SteamController_AtomicStore32(pSequence, sequence + 2);
+}
+
+/**
+ * Take a consistent copy of data published through a seqlock. 
+ * Retries while the writer is busy, never takes a lock.
+ */
+void SteamController_SeqlockRead(const SteamControllerAtomicU32 *pSequence, const SteamControllerAtomicU32 *pWords, void *pData, size_t wordCount) {
+  for (;;) {
+    uint32_t sequence = SteamController_AtomicLoad32(pSequence);
+    if (sequence & 1)
+      continue;
+
+    for (size_t i=0; i<wordCount; i++) {
+      uint32_t word = SteamController_AtomicLoadRelaxed32(pWords + i);
+      memcpy((uint32_t *)pData + i, &word, sizeof(word));
+    }
+
+    SteamController_AtomicFenceAcquire();
+    if (SteamController_AtomicLoadRelaxed32(pSequence) == sequence)
+      return;
+  }
+}
+
+/**
+ * Apply an event to the state snapshot of a device and publish the result.
+ * Only one thread may update the snapshot of a device. If a reader thread is
+ * running, it is that thread.
+ * 
+ * @param pDevice   Device whose snapshot to update.
+ * @param pEvent    Event to apply.
+ */
+void SCAPI SteamController_UpdateStateSnapshot(SteamControllerDevice *pDevice, const SteamControllerEvent *pEvent) {
+  if (!pDevice || !pEvent)
+    return;
+
+  SteamControllerStateBlock *pBlock = &pDevice->stateBlock;
+  SteamController_UpdateState(&pBlock->state, pEvent);
+  SteamController_SeqlockWrite(&pBlock->sequence, pBlock->words, &pBlock->state, STEAMCONTROLLER_STATE_WORDS);
+
+  if (SteamController_IsTrackingLatency(pDevice))
+    SteamController_AtomicStore64(&pBlock->publishTime, SteamController_GetHostTime());
+}
+
+/**
+ * Get a copy of the latest state of a device. Safe to call from any number 
+ * of threads at once, takes no locks and makes no system calls.
+ * 
+ * @param pDevice   Device to query.
+ * @param pState    Where to store the state.
+ */
+void SCAPI SteamController_GetStateSnapshot(const SteamControllerDevice *pDevice, SteamControllerState *pState) {
+  if (!pDevice || !pState)
+    return;
+
+  const SteamControllerStateBlock *pBlock = &pDevice->stateBlock;
+
+  uint32_t words[STEAMCONTROLLER_STATE_WORDS];
+  SteamController_SeqlockRead(&pBlock->sequence, pBlock->words, words, STEAMCONTROLLER_STATE_WORDS);
+  memcpy(pState, words, sizeof(SteamControllerState));
+
+  // Age of the snapshot. Updates published before tracking started do not count.
+  if (SteamController_IsTrackingLatency(pDevice)) {
+    uint64_t publishTime = SteamController_AtomicLoad64(&pBlock->publishTime);
+    if (publishTime)
+      SteamController_RecordLatency(pDevice, STEAMCONTROLLER_LATENCY_DELIVERY, SteamController_GetHostTime() - publishTime);
+  }
+}
@@ -2,27 +2,19 @@
 #include "common.h"
 
 /**
- * Read the next event from the device.
+ * Decode a raw input report into an event.
  * 
- * @param pController   Device to use.
+ * @param pData         Report data as read from the device.
+ * @param len           Length of the report data.
  * @param pEvent        Where to store event data.
  * 
- * @return The type of the received event. If no event was received this is 0.
+ * @return The type of the decoded event. If the report was not understood this is 0.
  */
-uint8_t SCAPI SteamController_ReadEvent(const SteamControllerDevice *pDevice, SteamControllerEvent *pEvent) {
-  if (!pDevice)
-    return 0;
-
-  if (!pEvent)
-    return 0;
-
-  uint8_t   eventDataBuf[65];
-  uint16_t  len = SteamController_ReadRaw(pDevice, eventDataBuf, 65);
-
+uint8_t SteamController_DecodeEvent(const uint8_t *pData, uint16_t len, SteamControllerEvent *pEvent) {
   if (!len)
     return 0;
 
-  uint8_t *eventData = eventDataBuf;
+  const uint8_t *eventData = pData;
   if (!*eventData) {
     eventData++;
     len--;
@@ -110,23 +102,142 @@ uint8_t SCAPI SteamController_ReadEvent(const SteamControllerDevice *pDevice, St
       break;
 
     default:
-      fprintf(stderr, "Received unknown event type %02x:\n", eventType);
-      Debug_DumpHex(eventData, len);
+      SteamController_LogHex(STEAMCONTROLLER_LOG_DEBUG, eventData, len, "Received unknown event type %02x:", eventType);
       return 0;
   }
   return eventType;
 }
 
+/**
+ * Decode a report read from a device and track what it means for the device.
+ * A controller that connects or disconnects has lost its settings.
+ */
+uint8_t SteamController_DecodeDeviceEvent(const SteamControllerDevice *pDevice, const uint8_t *pData, uint16_t len, SteamControllerEvent *pEvent) {
+  bool      isTracking  = pDevice && SteamController_IsTrackingLatency(pDevice);
+  uint64_t  startTime   = isTracking ? SteamController_GetHostTime() : 0;
+
+  uint8_t eventType = SteamController_DecodeEvent(pData, len, pEvent);
+
+  if (isTracking)
+    SteamController_RecordLatency(pDevice, STEAMCONTROLLER_LATENCY_DECODE, SteamController_GetHostTime() - startTime);
+
+  if (eventType && pDevice && SteamController_IsTrackingLink(pDevice))
+    SteamController_LinkUpdate(pDevice, pEvent, isTracking ? startTime : SteamController_GetHostTime());
+
+  if (eventType == STEAMCONTROLLER_EVENT_CONNECTION && pDevice
+      && (pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_CONNECTED
+          || pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED)) {
+    SteamController_InvalidateSettings(pDevice);
+
+    // A dongle slot may be talking to a different controller now.
+    if (pDevice->isWireless)
+      SteamController_InvalidateAttributes(pDevice);
+  }
+
+  return eventType;
+}
+
+/**
+ * Read the next event from the device.
+ * 
+ * @param pController   Device to use.
+ * @param pEvent        Where to store event data.
+ * 
+ * @return The type of the received event. If no event was received this is 0.
+ */
+uint8_t SCAPI SteamController_ReadEvent(const SteamControllerDevice *pDevice, SteamControllerEvent *pEvent) {
+  if (!pDevice)
+    return 0;
+
+  if (!pEvent)
+    return 0;
+
+  uint8_t   eventDataBuf[STEAMCONTROLLER_INPUT_REPORT_SIZE];
+  uint16_t  len = SteamController_ReadRaw(pDevice, eventDataBuf, sizeof(eventDataBuf));
+
+  return SteamController_DecodeDeviceEvent(pDevice, eventDataBuf, len, pEvent);
+}
+
+/**
+ * Read all pending events from the device in one go.
+ * Reports that can not be decoded are skipped.
+ * 
+ * @param pDevice       Device to use.
+ * @param pEvents       Where to store the events.
+ * @param maxEvents     Number of events pEvents can hold.
+ * @param pMorePending  If not NULL, set to true if reading stopped because pEvents is full
+ *                      and the device has more reports pending, false otherwise.
+ * 
+ * @return The number of events stored in pEvents.
+ */
+size_t SCAPI SteamController_ReadEvents(const SteamControllerDevice *pDevice, SteamControllerEvent *pEvents, size_t maxEvents, bool *pMorePending) {
+  size_t  count       = 0;
+  bool    morePending = false;
+
+  if (pDevice && pEvents) {
+    uint8_t eventDataBuf[STEAMCONTROLLER_INPUT_REPORT_SIZE];
+
+    while (count < maxEvents) {
+      uint16_t len = SteamController_ReadRaw(pDevice, eventDataBuf, sizeof(eventDataBuf));
+      if (!len)
+        break;
+
+      if (SteamController_DecodeDeviceEvent(pDevice, eventDataBuf, len, pEvents + count))
+        count++;
+    }
+
+    morePending = maxEvents && count == maxEvents && SteamController_HasPendingInput(pDevice);
+  }
+
+  if (pMorePending)
+    *pMorePending = morePending;
+
+  return count;
+}
+
+
+/** field if the condition holds, 0 otherwise. */
+static inline uint32_t SteamController_FieldIf(bool condition, uint32_t field) {
+  return (0u - (uint32_t)condition) & field;
+}
+
+static inline bool SteamController_PairDiffers(SteamControllerAxisPair a, SteamControllerAxisPair b) {
+  return ((a.x ^ b.x) | (a.y ^ b.y)) != 0;
+}
+
+static inline bool SteamController_VectorDiffers(SteamControllerVector a, SteamControllerVector b) {
+  return ((a.x ^ b.x) | (a.y ^ b.y) | (a.z ^ b.z)) != 0;
+}
 
 /**
  * Updates the state of a controller from an event.
  * Automatically disambiguates betwee left pad coordinates and stick position.
+ * Also records which buttons went down or up and which fields changed with
+ * this event, in pressedButtons, releasedButtons and changedFields.
  * @param pState State to update.
  * @param pEvent Event to use.
  */
 void SCAPI SteamController_UpdateState(SteamControllerState *pState, const SteamControllerEvent *pEvent) { 
+  uint32_t changedFields = 0;
+  pState->pressedButtons  = 0;
+  pState->releasedButtons = 0;
+
   switch(pEvent->eventType) {
-    case STEAMCONTROLLER_EVENT_UPDATE:
+    case STEAMCONTROLLER_EVENT_UPDATE: {
+      SteamControllerAxisPair leftPad = pState->leftPad;
+      SteamControllerAxisPair stick   = pState->stick;
+
+      pState->pressedButtons  = pEvent->update.buttons & ~pState->activeButtons;
+      pState->releasedButtons = pState->activeButtons & ~pEvent->update.buttons;
+
+      changedFields = SteamController_FieldIf(pState->activeButtons != pEvent->update.buttons, STEAMCONTROLLER_FIELD_BUTTONS)
+                    | SteamController_FieldIf(pState->leftTrigger   != pEvent->update.leftTrigger, STEAMCONTROLLER_FIELD_LEFT_TRIGGER)
+                    | SteamController_FieldIf(pState->rightTrigger  != pEvent->update.rightTrigger, STEAMCONTROLLER_FIELD_RIGHT_TRIGGER)
+                    | SteamController_FieldIf(SteamController_PairDiffers(pState->rightPad, pEvent->update.rightXY), STEAMCONTROLLER_FIELD_RIGHT_PAD)
+                    | SteamController_FieldIf(SteamController_VectorDiffers(pState->orientation,     pEvent->update.orientation), STEAMCONTROLLER_FIELD_ORIENTATION)
+                    | SteamController_FieldIf(SteamController_VectorDiffers(pState->acceleration,    pEvent->update.acceleration), STEAMCONTROLLER_FIELD_ACCELERATION)
+                    | SteamController_FieldIf(SteamController_VectorDiffers(pState->angularVelocity, pEvent->update.angularVelocity), STEAMCONTROLLER_FIELD_ANGULAR_VELOCITY);
+
       pState->timeStamp       = pEvent->update.timeStamp;
       pState->activeButtons   = pEvent->update.buttons;
 
@@ -143,14 +254,21 @@ void SCAPI SteamController_UpdateState(SteamControllerState *pState, const Steam
         }
       }
 
+      changedFields |= SteamController_FieldIf(SteamController_PairDiffers(leftPad, pState->leftPad), STEAMCONTROLLER_FIELD_LEFT_PAD)
+                     | SteamController_FieldIf(SteamController_PairDiffers(stick,   pState->stick), STEAMCONTROLLER_FIELD_STICK);
+
       pState->rightPad        = pEvent->update.rightXY;
 
       pState->acceleration    = pEvent->update.acceleration;
       pState->angularVelocity = pEvent->update.angularVelocity;
       pState->orientation     = pEvent->update.orientation;
       break;
+    }
+
+    case STEAMCONTROLLER_EVENT_CONNECTION: {
+      bool isConnected        = pState->isConnected;
+      bool hasPairingRequest  = pState->hasPairingRequest;
 
-    case STEAMCONTROLLER_EVENT_CONNECTION:
       if (pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED) {
         pState->isConnected = false;
         pState->hasPairingRequest = false;
@@ -160,18 +278,69 @@ void SCAPI SteamController_UpdateState(SteamControllerState *pState, const Steam
       } else if (pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_PAIRING_REQUESTED) {
         pState->hasPairingRequest =  true;
       } else {
-        fprintf(stderr, "Unknown detail id for connection event: %02x\n", pEvent->connection.details);
+        SteamController_Log(STEAMCONTROLLER_LOG_WARNING, "Unknown detail id for connection event: %02x", pEvent->connection.details);
       }
+
+      changedFields = SteamController_FieldIf(isConnected != pState->isConnected || hasPairingRequest != pState->hasPairingRequest, STEAMCONTROLLER_FIELD_CONNECTION);
       break;
+    }
 
     case STEAMCONTROLLER_EVENT_BATTERY:
+      changedFields = SteamController_FieldIf(pState->batteryVoltage != pEvent->battery.voltage, STEAMCONTROLLER_FIELD_BATTERY);
       pState->batteryVoltage = pEvent->battery.voltage;
       break;
 
     default:
-      fprintf(stderr, "Unknown event type: %02x\n", pEvent->eventType);
+      SteamController_Log(STEAMCONTROLLER_LOG_DEBUG, "Unknown event type: %02x", pEvent->eventType);
       break;
   }
+
+  pState->changedFields = changedFields;
 }
 
+/**
+ * Read pending events from the device into a state, and tell whether
+ * anything of interest changed. Lets consumers that only care about some
+ * fields skip all other updates cheaply. Reads at most
+ * STEAMCONTROLLER_READ_CHANGES_MAX_EVENTS reports, so a device that always
+ * has input can not keep the caller here.
+ *
+ * @param pDevice     Device to use.
+ * @param pState      State to update.
+ * @param fieldMask   STEAMCONTROLLER_FIELD_* bits of the fields of interest.
+ * @param pChanges    If not NULL, receives everything that changed, including fields outside the mask.
+ *
+ * @return true if a field of interest changed.
+ */
+bool SCAPI SteamController_ReadChanges(const SteamControllerDevice *pDevice, SteamControllerState *pState, uint32_t fieldMask, SteamControllerChanges *pChanges) {
+  SteamControllerChanges changes;
+  memset(&changes, 0, sizeof(changes));
+
+  if (pDevice && pState) {
+    uint8_t eventDataBuf[STEAMCONTROLLER_INPUT_REPORT_SIZE];
+    SteamControllerEvent event;
+
+    size_t readCount;
+    for (readCount=0; readCount<STEAMCONTROLLER_READ_CHANGES_MAX_EVENTS; readCount++) {
+      uint16_t len = SteamController_ReadRaw(pDevice, eventDataBuf, sizeof(eventDataBuf));
+      if (!len)
+        break;
+
+      if (!SteamController_DecodeDeviceEvent(pDevice, eventDataBuf, len, &event))
+        continue;
 
+      SteamController_UpdateState(pState, &event);
+      changes.changedFields   |= pState->changedFields;
+      changes.pressedButtons  |= pState->pressedButtons;
+      changes.releasedButtons |= pState->releasedButtons;
+      changes.eventCount++;
+    }
+
+    changes.morePending = readCount == STEAMCONTROLLER_READ_CHANGES_MAX_EVENTS && SteamController_HasPendingInput(pDevice);
+  }
+
+  if (pChanges)
+    *pChanges = changes;
+
+  return (changes.changedFields & fieldMask) != 0;
+}
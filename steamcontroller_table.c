@@ -0,0 +1,311 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#define STEAMCONTROLLER_TABLE_ALIGNMENT   64
+
+#if _MSC_VER
+#include <malloc.h>
+#define SteamController_AlignedAlloc(alignment, size)   _aligned_malloc(size, alignment)
+#define SteamController_AlignedFree(pMemory)            _aligned_free(pMemory)
+#else
+#define SteamController_AlignedAlloc(alignment, size)   aligned_alloc(alignment, size)
+#define SteamController_AlignedFree(pMemory)            free(pMemory)
+#endif
+
+struct SteamControllerStateTable {
+  size_t                      controllersPerRegion;
+  size_t                      regionCount;
+  size_t                      regionStride;   /**< Slots per region including padding. */
+  void                       *pMemory;
+  SteamControllerStateArrays  arrays;
+};
+
+/** Carve an array of length elements out of the table memory. */
+static void *SteamController_StateTableCarve(uint8_t **ppMemory, size_t length, size_t elementSize) {
+  void *pArray = *ppMemory;
+  *ppMemory += length * elementSize;
+  return pArray;
+}
+
+/**
+ * Create a table holding the state of many controllers, one array per field.
+ * Controllers are grouped in regions. Each region is padded to whole cache
+ * lines in every array, so threads updating different regions never write
+ * to the same cache line. Padding slots stay zero.
+ *
+ * @param controllersPerRegion  Number of controllers a single writer is responsible for.
+ * @param regionCount           Number of writers.
+ * @return New table or NULL on failure.
+ */
+SteamControllerStateTable *SteamController_CreateStateTable(size_t controllersPerRegion, size_t regionCount) {
+  if (!controllersPerRegion || !regionCount)
+    return NULL;
+
+  SteamControllerStateTable *pTable = malloc(sizeof(SteamControllerStateTable));
+  if (!pTable)
+    return NULL;
+
+  // Byte arrays need the most padding to fill a cache line.
+  size_t regionStride = (controllersPerRegion + STEAMCONTROLLER_TABLE_ALIGNMENT - 1) & ~(size_t)(STEAMCONTROLLER_TABLE_ALIGNMENT - 1);
+  size_t length       = regionStride * regionCount;
+
+  size_t bytesPerSlot =
+    sizeof(uint32_t) * 2 +    // timeStamp, activeButtons
+    sizeof(uint8_t)  * 2 +    // triggers
+    sizeof(int16_t)  * 15 +   // pads, stick, vectors
+    sizeof(uint16_t) +        // batteryVoltage
+    sizeof(uint8_t)  * 2;     // connection flags
+
+  pTable->pMemory = SteamController_AlignedAlloc(STEAMCONTROLLER_TABLE_ALIGNMENT, length * bytesPerSlot);
+  if (!pTable->pMemory) {
+    free(pTable);
+    return NULL;
+  }
+  memset(pTable->pMemory, 0, length * bytesPerSlot);
+
+  pTable->controllersPerRegion  = controllersPerRegion;
+  pTable->regionCount           = regionCount;
+  pTable->regionStride          = regionStride;
+
+  // Every array size is a multiple of the cache line size, so each array is aligned.
+  uint8_t *pMemory = (uint8_t *)pTable->pMemory;
+  SteamControllerStateArrays *pArrays = &pTable->arrays;
+  pArrays->length             = length;
+  pArrays->activeButtons      = SteamController_StateTableCarve(&pMemory, length, sizeof(uint32_t));
+  pArrays->leftTrigger        = SteamController_StateTableCarve(&pMemory, length, sizeof(uint8_t));
+  pArrays->rightTrigger       = SteamController_StateTableCarve(&pMemory, length, sizeof(uint8_t));
+  pArrays->leftPadX           = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->leftPadY           = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->rightPadX          = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->rightPadY          = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->stickX             = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->stickY             = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->accelerationX      = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->accelerationY      = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->accelerationZ      = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->angularVelocityX   = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->angularVelocityY   = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->angularVelocityZ   = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->orientationX       = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->orientationY       = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+  pArrays->orientationZ       = SteamController_StateTableCarve(&pMemory, length, sizeof(int16_t));
+
+  // Cold fields last.
+  pArrays->timeStamp          = SteamController_StateTableCarve(&pMemory, length, sizeof(uint32_t));
+  pArrays->batteryVoltage     = SteamController_StateTableCarve(&pMemory, length, sizeof(uint16_t));
+  pArrays->isConnected        = SteamController_StateTableCarve(&pMemory, length, sizeof(uint8_t));
+  pArrays->hasPairingRequest  = SteamController_StateTableCarve(&pMemory, length, sizeof(uint8_t));
+
+  return pTable;
+}
+
+void SCAPI SteamController_DestroyStateTable(SteamControllerStateTable *pTable) {
+  if (!pTable)
+    return;
+
+  SteamController_AlignedFree(pTable->pMemory);
+  free(pTable);
+}
+
+/** Get the field arrays of a table. They stay valid until the table is destroyed. */
+void SCAPI SteamController_StateTableGetArrays(const SteamControllerStateTable *pTable, SteamControllerStateArrays *pArrays) {
+  if (!pTable || !pArrays)
+    return;
+
+  *pArrays = pTable->arrays;
+}
+
+/** Index into the field arrays for a controller. */
+size_t SCAPI SteamController_StateTableSlot(const SteamControllerStateTable *pTable, size_t controller) {
+  size_t region = controller / pTable->controllersPerRegion;
+  return region * pTable->regionStride + controller % pTable->controllersPerRegion;
+}
+
+/** Controller for an index into the field arrays, or (size_t)-1 for padding. */
+static size_t SteamController_StateTableController(const SteamControllerStateTable *pTable, size_t slot) {
+  size_t region = slot / pTable->regionStride;
+  size_t offset = slot % pTable->regionStride;
+  if (offset >= pTable->controllersPerRegion)
+    return (size_t)-1;
+  return region * pTable->controllersPerRegion + offset;
+}
+
+/**
+ * Apply events to the controllers of a table, the same way SteamController_UpdateState does.
+ *
+ * @param pTable        Table to update.
+ * @param pControllers  Controller index for each event.
+ * @param pEvents       Events to apply, in order.
+ * @param count         Number of events.
+ */
+void SCAPI SteamController_StateTableUpdate(SteamControllerStateTable *pTable, const size_t *pControllers, const SteamControllerEvent *pEvents, size_t count) {
+  if (!pTable || !pControllers || !pEvents)
+    return;
+
+  SteamControllerStateArrays *pArrays = &pTable->arrays;
+  size_t controllerCount = pTable->controllersPerRegion * pTable->regionCount;
+
+  for (size_t i=0; i<count; i++) {
+    if (pControllers[i] >= controllerCount)
+      continue;
+
+    size_t slot = SteamController_StateTableSlot(pTable, pControllers[i]);
+    const SteamControllerEvent *pEvent = pEvents + i;
+
+    switch(pEvent->eventType) {
+      case STEAMCONTROLLER_EVENT_UPDATE:
+        pArrays->timeStamp[slot]        = pEvent->update.timeStamp;
+        pArrays->activeButtons[slot]    = pEvent->update.buttons;
+
+        pArrays->leftTrigger[slot]      = pEvent->update.leftTrigger;
+        pArrays->rightTrigger[slot]     = pEvent->update.rightTrigger;
+
+        if (pEvent->update.buttons & STEAMCONTROLLER_BUTTON_LFINGER) {
+          pArrays->leftPadX[slot]       = pEvent->update.leftXY.x;
+          pArrays->leftPadY[slot]       = pEvent->update.leftXY.y;
+        } else {
+          pArrays->stickX[slot]         = pEvent->update.leftXY.x;
+          pArrays->stickY[slot]         = pEvent->update.leftXY.y;
+          if ((pEvent->update.buttons & STEAMCONTROLLER_FLAG_PAD_STICK) == 0) {
+            pArrays->leftPadX[slot]     = 0;
+            pArrays->leftPadY[slot]     = 0;
+          }
+        }
+
+        pArrays->rightPadX[slot]        = pEvent->update.rightXY.x;
+        pArrays->rightPadY[slot]        = pEvent->update.rightXY.y;
+
+        pArrays->accelerationX[slot]    = pEvent->update.acceleration.x;
+        pArrays->accelerationY[slot]    = pEvent->update.acceleration.y;
+        pArrays->accelerationZ[slot]    = pEvent->update.acceleration.z;
+        pArrays->angularVelocityX[slot] = pEvent->update.angularVelocity.x;
+        pArrays->angularVelocityY[slot] = pEvent->update.angularVelocity.y;
+        pArrays->angularVelocityZ[slot] = pEvent->update.angularVelocity.z;
+        pArrays->orientationX[slot]     = pEvent->update.orientation.x;
+        pArrays->orientationY[slot]     = pEvent->update.orientation.y;
+        pArrays->orientationZ[slot]     = pEvent->update.orientation.z;
+        break;
+
+      case STEAMCONTROLLER_EVENT_CONNECTION:
+        if (pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED) {
+          pArrays->isConnected[slot]        = false;
+          pArrays->hasPairingRequest[slot]  = false;
+        } else if (pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_CONNECTED) {
+          pArrays->isConnected[slot]        = true;
+          pArrays->hasPairingRequest[slot]  = false;
+        } else if (pEvent->connection.details == STEAMCONTROLLER_CONNECTION_EVENT_PAIRING_REQUESTED) {
+          pArrays->hasPairingRequest[slot]  = true;
+        }
+        break;
+
+      case STEAMCONTROLLER_EVENT_BATTERY:
+        pArrays->batteryVoltage[slot] = pEvent->battery.voltage;
+        break;
+    }
+  }
+}
+
+/** Gather the state of one controller of a table. */
+void SCAPI SteamController_StateTableGetState(const SteamControllerStateTable *pTable, size_t controller, SteamControllerState *pState) {
+  if (!pTable || !pState)
+    return;
+
+  const SteamControllerStateArrays *pArrays = &pTable->arrays;
+  size_t slot = SteamController_StateTableSlot(pTable, controller);
+  if (slot >= pArrays->length)
+    return;
+
+  memset(pState, 0, sizeof(SteamControllerState));
+  pState->timeStamp           = pArrays->timeStamp[slot];
+  pState->activeButtons       = pArrays->activeButtons[slot];
+  pState->leftTrigger         = pArrays->leftTrigger[slot];
+  pState->rightTrigger        = pArrays->rightTrigger[slot];
+  pState->leftPad.x           = pArrays->leftPadX[slot];
+  pState->leftPad.y           = pArrays->leftPadY[slot];
+  pState->rightPad.x          = pArrays->rightPadX[slot];
+  pState->rightPad.y          = pArrays->rightPadY[slot];
+  pState->stick.x             = pArrays->stickX[slot];
+  pState->stick.y             = pArrays->stickY[slot];
+  pState->acceleration.x      = pArrays->accelerationX[slot];
+  pState->acceleration.y      = pArrays->accelerationY[slot];
+  pState->acceleration.z      = pArrays->accelerationZ[slot];
+  pState->angularVelocity.x   = pArrays->angularVelocityX[slot];
+  pState->angularVelocity.y   = pArrays->angularVelocityY[slot];
+  pState->angularVelocity.z   = pArrays->angularVelocityZ[slot];
+  pState->orientation.x       = pArrays->orientationX[slot];
+  pState->orientation.y       = pArrays->orientationY[slot];
+  pState->orientation.z       = pArrays->orientationZ[slot];
+  pState->batteryVoltage      = pArrays->batteryVoltage[slot];
+  pState->isConnected         = pArrays->isConnected[slot];
+  pState->hasPairingRequest   = pArrays->hasPairingRequest[slot];
+}
+
+/**
+ * Find all controllers that have any of the given buttons pressed.
+ * @param pControllers    Where to store the controller indices.
+ * @param maxControllers  Number of indices pControllers can hold.
+ * @return Number of controllers found.
+ */
+size_t SCAPI SteamController_StateTableFindButtons(const SteamControllerStateTable *pTable, uint32_t buttons, size_t *pControllers, size_t maxControllers) {
+  if (!pTable || !pControllers)
+    return 0;
+
+  const uint32_t *pActiveButtons = pTable->arrays.activeButtons;
+  size_t length = pTable->arrays.length;
+  size_t count  = 0;
+
+  // Check a cache line worth of controllers at once, padding slots never match.
+  for (size_t base=0; base<length && count<maxControllers; base+=16) {
+    uint32_t any = 0;
+    for (size_t i=0; i<16; i++)
+      any |= pActiveButtons[base + i] & buttons;
+
+    if (!any)
+      continue;
+
+    for (size_t i=0; i<16 && count<maxControllers; i++) {
+      if (pActiveButtons[base + i] & buttons)
+        pControllers[count++] = SteamController_StateTableController(pTable, base + i);
+    }
+  }
+
+  return count;
+}
+
+static inline uint32_t SteamController_StateTableStickMagnitude(int16_t x, int16_t y) {
+  return (uint32_t)((int32_t)x * x) + (uint32_t)((int32_t)y * y);
+}
+
+/**
+ * Find the largest squared stick deflection of all controllers.
+ * @param pController   If not NULL, receives the index of the controller with that deflection.
+ * @return Squared magnitude of the stick vector.
+ */
+uint32_t SCAPI SteamController_StateTableMaxStickMagnitude(const SteamControllerStateTable *pTable, size_t *pController) {
+  if (!pTable)
+    return 0;
+
+  const int16_t *pStickX = pTable->arrays.stickX;
+  const int16_t *pStickY = pTable->arrays.stickY;
+  size_t length = pTable->arrays.length;
+
+  // Each square fits in 31 bits, their sum reaches 2^31 at -32768, -32768
+  // and needs unsigned 32 bits. A plain maximum loop vectorizes.
+  uint32_t maxMagnitude = 0;
+  for (size_t i=0; i<length; i++) {
+    uint32_t magnitude = SteamController_StateTableStickMagnitude(pStickX[i], pStickY[i]);
+    maxMagnitude = magnitude > maxMagnitude ? magnitude : maxMagnitude;
+  }
+
+  if (pController) {
+    *pController = 0;
+    for (size_t i=0; i<length; i++) {
+      if (SteamController_StateTableStickMagnitude(pStickX[i], pStickY[i]) == maxMagnitude) {
+        *pController = SteamController_StateTableController(pTable, i);
+        break;
+      }
+    }
+  }
+
+  return maxMagnitude;
+}
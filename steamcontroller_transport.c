@@ -0,0 +1,177 @@
+#include "steamcontroller.h"
+#include "common.h"
+
+#if __linux__
+#include <poll.h>
+#endif
+
+/**
+ * Create a device on top of a transport and set up the controller.
+ * @param pTransport    Backend functions. Must stay valid until the device is closed.
+ * @param pContext      Passed to every backend function, released by its close function.
+ * @param isWireless    Whether the device should be treated as a wireless dongle.
+ * @return New device or NULL on failure.
+ */
+SteamControllerDevice *SteamController_OpenTransport(const SteamControllerTransport *pTransport, void *pContext, bool isWireless) {
+  return SteamController_OpenTransportEx(pTransport, pContext, isWireless, NULL, 0);
+}
+
+/**
+ * Create a device on top of a transport, see SteamController_OpenTransport.
+ * @param pIdentity   Stable name of the physical device used to cache its attributes, or NULL.
+ * @param flags       STEAMCONTROLLER_OPEN_* flags.
+ */
+SteamControllerDevice *SteamController_OpenTransportEx(const SteamControllerTransport *pTransport, void *pContext, bool isWireless, const char *pIdentity, unsigned flags) {
+  if (!pTransport)
+    return NULL;
+
+  if (!pTransport->readRaw || !pTransport->setFeatureReport || !pTransport->getFeatureReport)
+    return NULL;
+
+  SteamControllerDevice *pDevice = malloc(sizeof(SteamControllerDevice));
+  if (!pDevice)
+    return NULL;
+
+  memset(pDevice, 0, sizeof(SteamControllerDevice));
+  pDevice->pSettingsCache   = calloc(1, sizeof(SteamControllerSettingsCache));
+  pDevice->pAttributeState  = calloc(1, sizeof(SteamControllerAttributeState));
+  if (!pDevice->pSettingsCache || !pDevice->pAttributeState) {
+    free(pDevice->pAttributeState);
+    free(pDevice->pSettingsCache);
+    free(pDevice);
+    return NULL;
+  }
+
+  pDevice->pTransport         = pTransport;
+  pDevice->pTransportContext  = pContext;
+  pDevice->isWireless         = isWireless;
+
+  if (pIdentity)
+    snprintf(pDevice->identity, sizeof(pDevice->identity), "%s", pIdentity);
+
+  SteamController_Initialize(pDevice, flags);
+  return pDevice;
+}
+
+/**
+ * Close a controller device.
+ * @note This only closes the device. It does not unpair, disconnect or turn off
+ *       any controller.
+ * @param pDevice   Device to close.
+ */
+void SteamController_Close(SteamControllerDevice *pDevice) {
+  if (!pDevice)
+    return;
+
+#if __linux__
+  SteamController_StopHaptics(pDevice);
+  SteamController_StopCommandQueue(pDevice);
+  SteamController_StopReaderThread(pDevice);
+#endif
+
+  if (pDevice->pTransport->close)
+    pDevice->pTransport->close(pDevice->pTransportContext);
+
+  SteamController_ForgetCachedAttributes(pDevice);
+  free(SteamController_AtomicLoadPtr(&pDevice->pLatency));
+  free(SteamController_AtomicLoadPtr(&pDevice->pLink));
+  free(pDevice->pAttributeState);
+  free(pDevice->pSettingsCache);
+  free(pDevice);
+}
+
+bool SteamController_IsWirelessDongle(const SteamControllerDevice *pDevice) {
+  if (!pDevice)
+    return false;
+  return pDevice->isWireless;
+}
+
+/** Send a feature report to the device. */
+bool SteamController_HIDSetFeatureReport(const SteamControllerDevice *pDevice, SteamController_HIDFeatureReport *pReport) {
+  if (!pDevice)
+    return false;
+
+  if (!pReport)
+    return false;
+
+  if (pDevice->pRecorder)
+    SteamController_Record(pDevice, STEAMCONTROLLER_RECORD_FEATURE_SET, (const uint8_t*)pReport, sizeof(SteamController_HIDFeatureReport));
+
+  return pDevice->pTransport->setFeatureReport(pDevice->pTransportContext, (uint8_t*)pReport);
+}
+
+/** Get a specific feature report back from the device. */
+bool SteamController_HIDGetFeatureReport(const SteamControllerDevice *pDevice, SteamController_HIDFeatureReport *pReport) {
+  if (!pDevice)
+    return false;
+
+  if (!pReport)
+    return false;
+
+  bool success = pDevice->pTransport->getFeatureReport(pDevice->pTransportContext, (uint8_t*)pReport);
+
+  if (success && pDevice->pRecorder)
+    SteamController_Record(pDevice, STEAMCONTROLLER_RECORD_FEATURE_GET, (const uint8_t*)pReport, sizeof(SteamController_HIDFeatureReport));
+
+  return success;
+}
+
+/**
+ * Account for an input report read from a device: sample the read latency
+ * and capture the report. Every way of reading reports must call this.
+ * @param startTime   Host time the read started, 0 if latencies are not tracked.
+ */
+void SteamController_RawReportRead(const SteamControllerDevice *pDevice, const uint8_t *pReport, uint8_t len, uint64_t startTime) {
+  if (startTime)
+    SteamController_RecordLatency(pDevice, STEAMCONTROLLER_LATENCY_READ, SteamController_GetHostTime() - startTime);
+
+  if (pDevice->pRecorder)
+    SteamController_Record(pDevice, STEAMCONTROLLER_RECORD_INPUT, pReport, len);
+}
+
+uint8_t SteamController_ReadRaw(const SteamControllerDevice *pDevice, uint8_t *buffer, uint8_t maxLen) {
+  if (!pDevice)
+    return 0;
+
+  uint64_t startTime = SteamController_IsTrackingLatency(pDevice) ? SteamController_GetHostTime() : 0;
+
+  uint8_t len = pDevice->pTransport->readRaw(pDevice->pTransportContext, buffer, maxLen);
+
+  if (len)
+    SteamController_RawReportRead(pDevice, buffer, len, startTime);
+
+  return len;
+}
+
+/** File descriptor to wait on for input, or -1 if the transport has none. */
+int SteamController_GetPollFd(const SteamControllerDevice *pDevice) {
+  if (!pDevice)
+    return -1;
+
+  if (!pDevice->pTransport->getPollFd)
+    return -1;
+
+  return pDevice->pTransport->getPollFd(pDevice->pTransportContext);
+}
+
+/**
+ * Whether an input report can be read without waiting. Transports that can
+ * not tell are assumed to have input pending.
+ */
+bool SteamController_HasPendingInput(const SteamControllerDevice *pDevice) {
+  if (!pDevice)
+    return false;
+
+  if (pDevice->pTransport->hasPendingInput)
+    return pDevice->pTransport->hasPendingInput(pDevice->pTransportContext);
+
+#if __linux__
+  int fd = SteamController_GetPollFd(pDevice);
+  if (fd >= 0) {
+    struct pollfd pollFd = { .fd = fd, .events = POLLIN };
+    return poll(&pollFd, 1, 0) > 0 && (pollFd.revents & POLLIN);
+  }
+#endif
+
+  return true;
+}
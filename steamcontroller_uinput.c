@@ -0,0 +1,382 @@
+#if _MSC_VER
+#pragma warning(disable: 4206)  // MSC: nonstandard extension used : translation unit is empty
+#endif
+
+#if __linux__
+
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#define USB_PID_STEAMCONTROLLER_VIRTUAL_GAMEPAD   0x11ff
+
+#define STEAMCONTROLLER_UINPUT_MAX_EVENTS         48      /**< More than all keys and axes changing at once, plus EV_SYN. */
+#define STEAMCONTROLLER_UINPUT_MOUSE_SCALE        (1.0f / 32.0f)  /**< Pointer pixels per unit of right pad movement. */
+
+/** Gamepad button for each controller button. */
+static const struct {
+  uint32_t  button;
+  uint16_t  code;
+} SteamController_UinputButtons[] = {
+  { STEAMCONTROLLER_BUTTON_A,           BTN_A },
+  { STEAMCONTROLLER_BUTTON_B,           BTN_B },
+  { STEAMCONTROLLER_BUTTON_X,           BTN_X },
+  { STEAMCONTROLLER_BUTTON_Y,           BTN_Y },
+  { STEAMCONTROLLER_BUTTON_LS,          BTN_TL },
+  { STEAMCONTROLLER_BUTTON_RS,          BTN_TR },
+  { STEAMCONTROLLER_BUTTON_LT,          BTN_TL2 },
+  { STEAMCONTROLLER_BUTTON_RT,          BTN_TR2 },
+  { STEAMCONTROLLER_BUTTON_PREV,        BTN_SELECT },
+  { STEAMCONTROLLER_BUTTON_NEXT,        BTN_START },
+  { STEAMCONTROLLER_BUTTON_HOME,        BTN_MODE },
+  { STEAMCONTROLLER_BUTTON_STICK,       BTN_THUMBL },
+  { STEAMCONTROLLER_BUTTON_RPAD,        BTN_THUMBR },
+  { STEAMCONTROLLER_BUTTON_LG,          BTN_GEAR_DOWN },
+  { STEAMCONTROLLER_BUTTON_RG,          BTN_GEAR_UP },
+  { STEAMCONTROLLER_BUTTON_DPAD_UP,     BTN_DPAD_UP },
+  { STEAMCONTROLLER_BUTTON_DPAD_DOWN,   BTN_DPAD_DOWN },
+  { STEAMCONTROLLER_BUTTON_DPAD_LEFT,   BTN_DPAD_LEFT },
+  { STEAMCONTROLLER_BUTTON_DPAD_RIGHT,  BTN_DPAD_RIGHT },
+};
+
+#define STEAMCONTROLLER_UINPUT_BUTTON_COUNT  (sizeof(SteamController_UinputButtons) / sizeof(SteamController_UinputButtons[0]))
+
+#define STEAMCONTROLLER_UINPUT_AXIS_X         0
+#define STEAMCONTROLLER_UINPUT_AXIS_Y         1
+#define STEAMCONTROLLER_UINPUT_AXIS_RX        2
+#define STEAMCONTROLLER_UINPUT_AXIS_RY        3
+#define STEAMCONTROLLER_UINPUT_AXIS_HAT0X     4
+#define STEAMCONTROLLER_UINPUT_AXIS_HAT0Y     5
+#define STEAMCONTROLLER_UINPUT_AXIS_Z         6
+#define STEAMCONTROLLER_UINPUT_AXIS_RZ        7
+#define STEAMCONTROLLER_UINPUT_AXIS_COUNT     8
+
+static const uint16_t SteamController_UinputAxes[STEAMCONTROLLER_UINPUT_AXIS_COUNT] = {
+  ABS_X, ABS_Y, ABS_RX, ABS_RY, ABS_HAT0X, ABS_HAT0Y, ABS_Z, ABS_RZ
+};
+
+/** What the mouse was last told, and where the pointer movement left off. */
+typedef struct {
+  bool                      isButtonDown;
+  bool                      isTouchingPad;
+  SteamControllerAxisPair   lastPad;
+  float                     remainder[2];
+} SteamControllerUinputPointer;
+
+struct SteamControllerUinput {
+  int                       gamepadFd;
+  int                       mouseFd;          /**< -1 without a mouse. */
+  bool                      ownsDevices;      /**< Created the devices, as opposed to writing to a sink. */
+
+  // What the devices were last told, their state as far as the kernel knows.
+  // Only updated once a write went through, so a failed one is repeated.
+  uint32_t                  buttons;
+  int32_t                   axes[STEAMCONTROLLER_UINPUT_AXIS_COUNT];
+  SteamControllerUinputPointer pointer;
+
+  SteamControllerHistogram  latency;
+};
+
+/** Controllers count up, evdev counts down. */
+static inline int32_t SteamController_UinputFlipY(int16_t y) {
+  return y == INT16_MIN ? INT16_MAX : -y;
+}
+
+static bool SteamController_UinputSetupAxis(int fd, uint16_t code, int32_t minimum, int32_t maximum) {
+  struct uinput_abs_setup absSetup;
+  memset(&absSetup, 0, sizeof(absSetup));
+  absSetup.code               = code;
+  absSetup.absinfo.minimum    = minimum;
+  absSetup.absinfo.maximum    = maximum;
+
+  return ioctl(fd, UI_SET_ABSBIT, code) == 0 && ioctl(fd, UI_ABS_SETUP, &absSetup) == 0;
+}
+
+/**
+ * Create a uinput device, a gamepad or a mouse.
+ * @return The file descriptor of the device, or -1.
+ */
+static int SteamController_UinputCreateDevice(const char *pName, bool isMouse) {
+  int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    SteamController_LogErrno("open /dev/uinput");
+    return -1;
+  }
+
+  bool success = ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0;
+
+  if (isMouse) {
+    success = success
+      && ioctl(fd, UI_SET_EVBIT, EV_REL) == 0
+      && ioctl(fd, UI_SET_RELBIT, REL_X) == 0
+      && ioctl(fd, UI_SET_RELBIT, REL_Y) == 0
+      && ioctl(fd, UI_SET_KEYBIT, BTN_LEFT) == 0;
+  } else {
+    success = success && ioctl(fd, UI_SET_EVBIT, EV_ABS) == 0;
+
+    for (size_t i=0; i<STEAMCONTROLLER_UINPUT_BUTTON_COUNT && success; i++)
+      success = ioctl(fd, UI_SET_KEYBIT, SteamController_UinputButtons[i].code) == 0;
+
+    for (int axis=0; axis<STEAMCONTROLLER_UINPUT_AXIS_COUNT && success; axis++) {
+      bool isTrigger = axis == STEAMCONTROLLER_UINPUT_AXIS_Z || axis == STEAMCONTROLLER_UINPUT_AXIS_RZ;
+      success = SteamController_UinputSetupAxis(fd, SteamController_UinputAxes[axis], isTrigger ? 0 : INT16_MIN, isTrigger ? UINT8_MAX : INT16_MAX);
+    }
+  }
+
+  struct uinput_setup setup;
+  memset(&setup, 0, sizeof(setup));
+  setup.id.bustype  = BUS_VIRTUAL;
+  setup.id.vendor   = USB_VID_VALVE;
+  setup.id.product  = USB_PID_STEAMCONTROLLER_VIRTUAL_GAMEPAD;
+  setup.id.version  = 1;
+  snprintf(setup.name, sizeof(setup.name), "%s%s", pName, isMouse ? " Mouse" : "");
+
+  success = success
+    && ioctl(fd, UI_DEV_SETUP, &setup) == 0
+    && ioctl(fd, UI_DEV_CREATE) == 0;
+
+  if (!success) {
+    SteamController_LogErrno("uinput setup");
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/** Remove uinput devices, -1 is skipped. */
+static void SteamController_UinputRemoveDevices(int gamepadFd, int mouseFd) {
+  int fds[] = { gamepadFd, mouseFd };
+  for (int i=0; i<2; i++) {
+    if (fds[i] < 0)
+      continue;
+    ioctl(fds[i], UI_DEV_DESTROY);
+    close(fds[i]);
+  }
+}
+
+static SteamControllerUinput *SteamController_UinputAlloc(int gamepadFd, int mouseFd, bool ownsDevices) {
+  SteamControllerUinput *pUinput = calloc(1, sizeof(SteamControllerUinput));
+  if (!pUinput)
+    return NULL;
+
+  pUinput->gamepadFd    = gamepadFd;
+  pUinput->mouseFd      = mouseFd;
+  pUinput->ownsDevices  = ownsDevices;
+  return pUinput;
+}
+
+/**
+ * Create a virtual gamepad through uinput that mirrors a controller. Needs
+ * write access to /dev/uinput.
+ *
+ * @param pName   Name of the input device, NULL for a default.
+ * @param flags   STEAMCONTROLLER_UINPUT_* flags.
+ * @return The bridge, or NULL if the devices could not be created.
+ */
+SteamControllerUinput *SteamController_CreateUinput(const char *pName, unsigned flags) {
+  if (!pName)
+    pName = "Steam Controller";
+
+  int gamepadFd = SteamController_UinputCreateDevice(pName, false);
+  if (gamepadFd < 0)
+    return NULL;
+
+  int mouseFd = -1;
+  if (flags & STEAMCONTROLLER_UINPUT_MOUSE)
+    mouseFd = SteamController_UinputCreateDevice(pName, true);
+
+  SteamControllerUinput *pUinput = NULL;
+  if (mouseFd >= 0 || !(flags & STEAMCONTROLLER_UINPUT_MOUSE))
+    pUinput = SteamController_UinputAlloc(gamepadFd, mouseFd, true);
+
+  if (!pUinput)
+    SteamController_UinputRemoveDevices(gamepadFd, mouseFd);
+
+  return pUinput;
+}
+
+/**
+ * Create a bridge that writes its input_event batches to file descriptors
+ * instead of uinput devices, for example to a pipe in tests. The descriptors
+ * are not set up and not closed by the bridge.
+ *
+ * @param gamepadFd   Receives the gamepad events.
+ * @param mouseFd     Receives the mouse events, -1 to use the right pad as a stick.
+ */
+SteamControllerUinput *SteamController_CreateUinputSink(int gamepadFd, int mouseFd) {
+  if (gamepadFd < 0)
+    return NULL;
+
+  return SteamController_UinputAlloc(gamepadFd, mouseFd, false);
+}
+
+/** Remove the virtual devices of a bridge. */
+void SCAPI SteamController_DestroyUinput(SteamControllerUinput *pUinput) {
+  if (!pUinput)
+    return;
+
+  if (pUinput->ownsDevices)
+    SteamController_UinputRemoveDevices(pUinput->gamepadFd, pUinput->mouseFd);
+
+  free(pUinput);
+}
+
+static inline void SteamController_UinputAddEvent(struct input_event *pEvents, size_t *pCount, uint16_t type, uint16_t code, int32_t value) {
+  struct input_event *pEvent = pEvents + (*pCount)++;
+  memset(pEvent, 0, sizeof(struct input_event));
+  pEvent->type  = type;
+  pEvent->code  = code;
+  pEvent->value = value;
+}
+
+/**
+ * Finish a batch with EV_SYN and write it at once. An empty batch is not written.
+ * The devices are non-blocking, a full buffer fails with EAGAIN.
+ */
+static bool SteamController_UinputFlush(int fd, struct input_event *pEvents, size_t count) {
+  if (!count)
+    return true;
+
+  SteamController_UinputAddEvent(pEvents, &count, EV_SYN, SYN_REPORT, 0);
+
+  ssize_t len = write(fd, pEvents, count * sizeof(struct input_event));
+  if (len != (ssize_t)(count * sizeof(struct input_event))) {
+    SteamController_LogErrno("write uinput");
+    return false;
+  }
+
+  return true;
+}
+
+/** Turn right pad movement into pointer movement, advancing pPointer past it. */
+static void SteamController_UinputMouse(SteamControllerUinputPointer *pPointer, const SteamControllerState *pState, struct input_event *pEvents, size_t *pCount) {
+  bool isTouching = (pState->activeButtons & STEAMCONTROLLER_BUTTON_RFINGER) != 0;
+
+  if (isTouching && pPointer->isTouchingPad) {
+    float dx = (pState->rightPad.x - pPointer->lastPad.x) * STEAMCONTROLLER_UINPUT_MOUSE_SCALE + pPointer->remainder[0];
+    float dy = (pPointer->lastPad.y - pState->rightPad.y) * STEAMCONTROLLER_UINPUT_MOUSE_SCALE + pPointer->remainder[1];
+
+    // Keep the fractions, so slow movement is not lost.
+    int32_t moveX = (int32_t)dx, moveY = (int32_t)dy;
+    pPointer->remainder[0] = dx - moveX;
+    pPointer->remainder[1] = dy - moveY;
+
+    if (moveX)
+      SteamController_UinputAddEvent(pEvents, pCount, EV_REL, REL_X, moveX);
+    if (moveY)
+      SteamController_UinputAddEvent(pEvents, pCount, EV_REL, REL_Y, moveY);
+  } else {
+    pPointer->remainder[0] = pPointer->remainder[1] = 0.0f;
+  }
+
+  pPointer->isTouchingPad = isTouching;
+  pPointer->lastPad       = pState->rightPad;
+
+  bool isButtonDown = (pState->activeButtons & STEAMCONTROLLER_BUTTON_RPAD) != 0;
+  if (isButtonDown != pPointer->isButtonDown) {
+    SteamController_UinputAddEvent(pEvents, pCount, EV_KEY, BTN_LEFT, isButtonDown);
+    pPointer->isButtonDown = isButtonDown;
+  }
+}
+
+/**
+ * Bring the virtual devices up to date with the state of the controller.
+ * Only keys and axes that differ from what was written before are sent, as
+ * one write() per device ending in a single EV_SYN. Nothing is written if
+ * nothing changed. After a failed write, the next call sends the changes
+ * again, and the pointer movement that was not written. With a mouse, the
+ * right pad moves the pointer and its click is the left mouse button,
+ * instead of being a stick and BTN_THUMBR.
+ *
+ * Call it after every event applied to the state, e.g. from the events of
+ * SteamController_DrainEvents.
+ *
+ * @param pUinput     Bridge to update.
+ * @param pState      State of the controller.
+ * @param readTime    Host time the report of the latest event was read at, see
+ *                    SteamControllerTimedEvent. 0 if unknown, no latency is counted then.
+ * @return false if writing failed.
+ */
+bool SCAPI SteamController_UinputWriteState(SteamControllerUinput *pUinput, const SteamControllerState *pState, uint64_t readTime) {
+  if (!pUinput || !pState)
+    return false;
+
+  bool hasMouse = pUinput->mouseFd >= 0;
+
+  struct input_event  events[STEAMCONTROLLER_UINPUT_MAX_EVENTS];
+  size_t              count = 0;
+
+  int32_t axes[STEAMCONTROLLER_UINPUT_AXIS_COUNT] = {
+    [STEAMCONTROLLER_UINPUT_AXIS_X]     = pState->stick.x,
+    [STEAMCONTROLLER_UINPUT_AXIS_Y]     = SteamController_UinputFlipY(pState->stick.y),
+    [STEAMCONTROLLER_UINPUT_AXIS_RX]    = hasMouse ? 0 : pState->rightPad.x,
+    [STEAMCONTROLLER_UINPUT_AXIS_RY]    = hasMouse ? 0 : SteamController_UinputFlipY(pState->rightPad.y),
+    [STEAMCONTROLLER_UINPUT_AXIS_HAT0X] = pState->leftPad.x,
+    [STEAMCONTROLLER_UINPUT_AXIS_HAT0Y] = SteamController_UinputFlipY(pState->leftPad.y),
+    [STEAMCONTROLLER_UINPUT_AXIS_Z]     = pState->leftTrigger,
+    [STEAMCONTROLLER_UINPUT_AXIS_RZ]    = pState->rightTrigger,
+  };
+
+  for (int axis=0; axis<STEAMCONTROLLER_UINPUT_AXIS_COUNT; axis++) {
+    if (axes[axis] != pUinput->axes[axis])
+      SteamController_UinputAddEvent(events, &count, EV_ABS, SteamController_UinputAxes[axis], axes[axis]);
+  }
+
+  uint32_t buttons = pState->activeButtons;
+  if (hasMouse)
+    buttons &= ~STEAMCONTROLLER_BUTTON_RPAD;
+
+  uint32_t changed = buttons ^ pUinput->buttons;
+  for (size_t i=0; i<STEAMCONTROLLER_UINPUT_BUTTON_COUNT && changed; i++) {
+    uint32_t button = SteamController_UinputButtons[i].button;
+    if (changed & button)
+      SteamController_UinputAddEvent(events, &count, EV_KEY, SteamController_UinputButtons[i].code, (buttons & button) != 0);
+  }
+
+  bool hasWritten = count > 0;
+  bool success    = SteamController_UinputFlush(pUinput->gamepadFd, events, count);
+  if (success) {
+    memcpy(pUinput->axes, axes, sizeof(axes));
+    pUinput->buttons = buttons;
+  }
+
+  if (hasMouse) {
+    SteamControllerUinputPointer pointer = pUinput->pointer;
+    count = 0;
+    SteamController_UinputMouse(&pointer, pState, events, &count);
+
+    hasWritten = hasWritten || count > 0;
+    if (SteamController_UinputFlush(pUinput->mouseFd, events, count))
+      pUinput->pointer = pointer;
+    else
+      success = false;
+  }
+
+  if (hasWritten && readTime)
+    SteamController_HistogramRecord(&pUinput->latency, SteamController_GetHostTime() - readTime);
+
+  return success;
+}
+
+/**
+ * Get statistics of the time from reading a report to writing its events,
+ * for updates that wrote something and had a read time.
+ */
+void SCAPI SteamController_UinputGetLatency(const SteamControllerUinput *pUinput, SteamControllerLatencyStats *pStats) {
+  if (!pStats)
+    return;
+
+  if (!pUinput) {
+    memset(pStats, 0, sizeof(SteamControllerLatencyStats));
+    return;
+  }
+
+  SteamController_HistogramGetStats(&pUinput->latency, pStats);
+}
+
+#endif
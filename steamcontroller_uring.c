@@ -0,0 +1,540 @@
+#if _MSC_VER
+#pragma warning(disable: 4206)  // MSC: nonstandard extension used : translation unit is empty
+#endif
+
+#if __linux__
+
+#include "steamcontroller.h"
+#include "common.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define STEAMCONTROLLER_HAVE_IO_URING 1
+#endif
+#endif
+
+#define STEAMCONTROLLER_URING_BUFFER_SIZE   128   /**< Buffer stride per source, large enough for one input report. */
+#define STEAMCONTROLLER_URING_FILE_REPORT   STEAMCONTROLLER_RAW_REPORT_SIZE   /**< Size of one report in a capture file. */
+#define STEAMCONTROLLER_URING_CANCEL        UINT64_MAX  /**< user_data of cancel requests, slots are small. */
+
+typedef struct {
+  SteamControllerDevice  *pDevice;            /**< Device the reports belong to, NULL for files. */
+  void                   *pUserData;
+  int                     fd;
+  bool                    isFile;             /**< Files are owned by the reader and read at explicit offsets. */
+  bool                    isActive;
+  bool                    wasNonBlocking;     /**< O_NONBLOCK has to be restored when the reader is destroyed. */
+  bool                    isReading;          /**< A read was queued and its completion was not reaped yet. */
+  uint64_t                offset;
+} SteamControllerUringSource;
+
+struct SteamControllerUring {
+  int                         ringFd;         /**< io_uring instance, -1 when falling back to poll(). */
+
+#if STEAMCONTROLLER_HAVE_IO_URING
+  void                       *pRing;
+  size_t                      ringSize;
+  struct io_uring_sqe        *pSqes;
+  size_t                      sqesSize;
+
+  _Atomic unsigned           *pSqTail;
+  unsigned                   *pSqRingMask;
+  unsigned                   *pSqArray;
+  _Atomic unsigned           *pCqHead;
+  _Atomic unsigned           *pCqTail;
+  unsigned                   *pCqRingMask;
+  struct io_uring_cqe        *pCqes;
+
+  unsigned                    pendingSubmits;
+#endif
+
+  uint8_t                    *pBuffers;
+  SteamControllerUringSource  sources[STEAMCONTROLLER_URING_MAX_SOURCES];
+  size_t                      sourceCount;
+};
+
+#if STEAMCONTROLLER_HAVE_IO_URING
+
+/** Set up the ring and register one buffer per source slot. */
+static bool SteamController_UringSetup(SteamControllerUring *pUring) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  int ringFd = syscall(__NR_io_uring_setup, STEAMCONTROLLER_URING_MAX_SOURCES, &params);
+  if (ringFd < 0)
+    return false;
+
+  // Reads at the current position and waiting with a timeout need a 5.11+ kernel.
+  if (!(params.features & IORING_FEAT_RW_CUR_POS) || !(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    close(ringFd);
+    return false;
+  }
+
+  // Submission and completion ring share one mapping.
+  size_t sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  pUring->ringSize  = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+
+  pUring->pRing = mmap(NULL, pUring->ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if (pUring->pRing == MAP_FAILED) {
+    close(ringFd);
+    return false;
+  }
+
+  pUring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  pUring->pSqes = mmap(NULL, pUring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (pUring->pSqes == MAP_FAILED) {
+    munmap(pUring->pRing, pUring->ringSize);
+    close(ringFd);
+    return false;
+  }
+
+  uint8_t *pRing = (uint8_t *)pUring->pRing;
+  pUring->pSqTail     = (_Atomic unsigned *)(pRing + params.sq_off.tail);
+  pUring->pSqRingMask = (unsigned *)(pRing + params.sq_off.ring_mask);
+  pUring->pSqArray    = (unsigned *)(pRing + params.sq_off.array);
+  pUring->pCqHead     = (_Atomic unsigned *)(pRing + params.cq_off.head);
+  pUring->pCqTail     = (_Atomic unsigned *)(pRing + params.cq_off.tail);
+  pUring->pCqRingMask = (unsigned *)(pRing + params.cq_off.ring_mask);
+  pUring->pCqes       = (struct io_uring_cqe *)(pRing + params.cq_off.cqes);
+
+  struct iovec iovecs[STEAMCONTROLLER_URING_MAX_SOURCES];
+  for (size_t i=0; i<STEAMCONTROLLER_URING_MAX_SOURCES; i++) {
+    iovecs[i].iov_base  = pUring->pBuffers + i * STEAMCONTROLLER_URING_BUFFER_SIZE;
+    iovecs[i].iov_len   = STEAMCONTROLLER_URING_BUFFER_SIZE;
+  }
+
+  if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, iovecs, STEAMCONTROLLER_URING_MAX_SOURCES) < 0) {
+    munmap(pUring->pSqes, pUring->sqesSize);
+    munmap(pUring->pRing, pUring->ringSize);
+    close(ringFd);
+    return false;
+  }
+
+  pUring->ringFd = ringFd;
+  return true;
+}
+
+/** Put a read for a source into the submission queue. It is submitted with the next wait. */
+static void SteamController_UringQueueRead(SteamControllerUring *pUring, size_t slot) {
+  SteamControllerUringSource *pSource = &pUring->sources[slot];
+
+  unsigned tail   = atomic_load_explicit(pUring->pSqTail, memory_order_relaxed);
+  unsigned index  = tail & *pUring->pSqRingMask;
+
+  struct io_uring_sqe *pSqe = &pUring->pSqes[index];
+  memset(pSqe, 0, sizeof(*pSqe));
+  pSqe->opcode    = IORING_OP_READ_FIXED;
+  pSqe->fd        = pSource->fd;
+  pSqe->addr      = (uint64_t)(uintptr_t)(pUring->pBuffers + slot * STEAMCONTROLLER_URING_BUFFER_SIZE);
+  pSqe->len       = pSource->isFile ? STEAMCONTROLLER_URING_FILE_REPORT : STEAMCONTROLLER_INPUT_REPORT_SIZE;
+  pSqe->off       = pSource->isFile ? pSource->offset : (uint64_t)-1;
+  pSqe->buf_index = slot;
+  pSqe->user_data = slot;
+
+  pUring->pSqArray[index] = index;
+  atomic_store_explicit(pUring->pSqTail, tail + 1, memory_order_release);
+  pUring->pendingSubmits++;
+  pSource->isReading = true;
+}
+
+/** Put a cancel request for the read of a source into the submission queue. */
+static void SteamController_UringQueueCancel(SteamControllerUring *pUring, size_t slot) {
+  unsigned tail   = atomic_load_explicit(pUring->pSqTail, memory_order_relaxed);
+  unsigned index  = tail & *pUring->pSqRingMask;
+
+  struct io_uring_sqe *pSqe = &pUring->pSqes[index];
+  memset(pSqe, 0, sizeof(*pSqe));
+  pSqe->opcode    = IORING_OP_ASYNC_CANCEL;
+  pSqe->fd        = -1;
+  pSqe->addr      = slot;
+  pSqe->user_data = STEAMCONTROLLER_URING_CANCEL;
+
+  pUring->pSqArray[index] = index;
+  atomic_store_explicit(pUring->pSqTail, tail + 1, memory_order_release);
+  pUring->pendingSubmits++;
+}
+
+/**
+ * Cancel every read in flight and wait until the kernel is done with them,
+ * so neither the descriptors nor the buffers are used after they are gone.
+ */
+static void SteamController_UringCancelReads(SteamControllerUring *pUring) {
+  // The submission queue has one entry per source, make room for the cancels.
+  if (pUring->pendingSubmits) {
+    if (syscall(__NR_io_uring_enter, pUring->ringFd, pUring->pendingSubmits, 0, 0, NULL, 0) < 0) {
+      SteamController_LogErrno("io_uring_enter");
+      return;
+    }
+    pUring->pendingSubmits = 0;
+  }
+
+  unsigned readingCount = 0;
+  for (size_t i=0; i<pUring->sourceCount; i++) {
+    if (pUring->sources[i].isReading) {
+      SteamController_UringQueueCancel(pUring, i);
+      readingCount++;
+    }
+  }
+
+  while (readingCount) {
+    int res = syscall(__NR_io_uring_enter, pUring->ringFd, pUring->pendingSubmits, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (res < 0 && errno != EINTR) {
+      SteamController_LogErrno("io_uring_enter");
+      return;
+    }
+
+    if (res >= 0)
+      pUring->pendingSubmits -= (unsigned)res < pUring->pendingSubmits ? (unsigned)res : pUring->pendingSubmits;
+
+    unsigned head = atomic_load_explicit(pUring->pCqHead, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(pUring->pCqTail, memory_order_acquire);
+
+    for (; head != tail; head++) {
+      const struct io_uring_cqe *pCqe = &pUring->pCqes[head & *pUring->pCqRingMask];
+      if (pCqe->user_data == STEAMCONTROLLER_URING_CANCEL)
+        continue;
+
+      pUring->sources[pCqe->user_data].isReading = false;
+      readingCount--;
+    }
+
+    atomic_store_explicit(pUring->pCqHead, head, memory_order_release);
+  }
+}
+
+#endif
+
+/** Mark a source as finished, tell the callback and release what the reader owns. */
+static void SteamController_UringEndSource(SteamControllerUringSource *pSource, SteamControllerUringCallback callback) {
+  pSource->isActive = false;
+  callback(pSource->pDevice, NULL, pSource->pUserData);
+
+  if (pSource->isFile) {
+    close(pSource->fd);
+    pSource->fd = -1;
+  }
+}
+
+/**
+ * Check a report read by the reader itself, and pass reports of devices to
+ * the same latency sampling and capture as SteamController_ReadRaw does.
+ * @return false if the report is too short to be decoded.
+ */
+static bool SteamController_UringAccept(SteamControllerUringSource *pSource, const uint8_t *pData, uint16_t len, uint64_t readTime) {
+  if (len < STEAMCONTROLLER_RAW_REPORT_SIZE) {
+    SteamController_Log(STEAMCONTROLLER_LOG_DEBUG, "Dropped short report of %u bytes", (unsigned)len);
+    return false;
+  }
+
+  if (pSource->pDevice)
+    SteamController_RawReportRead(pSource->pDevice, pData, (uint8_t)len, SteamController_IsTrackingLatency(pSource->pDevice) ? readTime : 0);
+
+  return true;
+}
+
+/** Decode a report and hand it to the callback. */
+static void SteamController_UringDispatch(SteamControllerUringSource *pSource, const uint8_t *pData, uint16_t len, SteamControllerUringCallback callback) {
+  SteamControllerTimedEvent timedEvent;
+  timedEvent.hostTime = SteamController_GetHostTime();
+
+  if (!SteamController_DecodeDeviceEvent(pSource->pDevice, pData, len, &timedEvent.event))
+    return;
+
+  if (pSource->pDevice)
+    SteamController_UpdateStateSnapshot(pSource->pDevice, &timedEvent.event);
+
+  callback(pSource->pDevice, &timedEvent, pSource->pUserData);
+}
+
+/**
+ * Create a reader that keeps a read in flight for every added source using
+ * io_uring. Reports land in registered buffers and are decoded in place.
+ * If io_uring is not available, poll() and read() are used instead.
+ *
+ * @param forceFallback   Don't even try io_uring.
+ * @return New reader or NULL on failure.
+ */
+SteamControllerUring *SteamController_CreateUring(bool forceFallback) {
+  SteamControllerUring *pUring = malloc(sizeof(SteamControllerUring));
+  if (!pUring)
+    return NULL;
+
+  memset(pUring, 0, sizeof(SteamControllerUring));
+  pUring->ringFd = -1;
+
+  pUring->pBuffers = aligned_alloc(4096, STEAMCONTROLLER_URING_MAX_SOURCES * STEAMCONTROLLER_URING_BUFFER_SIZE);
+  if (!pUring->pBuffers) {
+    free(pUring);
+    return NULL;
+  }
+
+#if STEAMCONTROLLER_HAVE_IO_URING
+  if (!forceFallback)
+    SteamController_UringSetup(pUring);
+#else
+  (void)forceFallback;
+#endif
+
+  return pUring;
+}
+
+/**
+ * Destroy a reader. Pending reads are cancelled.
+ * @note Devices that were added are not closed.
+ */
+void SteamController_DestroyUring(SteamControllerUring *pUring) {
+  if (!pUring)
+    return;
+
+#if STEAMCONTROLLER_HAVE_IO_URING
+  if (pUring->ringFd >= 0) {
+    SteamController_UringCancelReads(pUring);
+    close(pUring->ringFd);
+    munmap(pUring->pSqes, pUring->sqesSize);
+    munmap(pUring->pRing, pUring->ringSize);
+  }
+#endif
+
+  for (size_t i=0; i<pUring->sourceCount; i++) {
+    SteamControllerUringSource *pSource = &pUring->sources[i];
+    if (pSource->isFile) {
+      if (pSource->fd >= 0)
+        close(pSource->fd);
+    }
+    else if (pSource->wasNonBlocking) {
+      fcntl(pSource->fd, F_SETFL, fcntl(pSource->fd, F_GETFL) | O_NONBLOCK);
+    }
+  }
+
+  free(pUring->pBuffers);
+  free(pUring);
+}
+
+/** Whether the reader really uses io_uring or had to fall back to poll(). */
+bool SteamController_UringIsAvailable(const SteamControllerUring *pUring) {
+  return pUring && pUring->ringFd >= 0;
+}
+
+static bool SteamController_UringAddSource(SteamControllerUring *pUring, SteamControllerDevice *pDevice, int fd, bool isFile, void *pUserData) {
+  if (pUring->sourceCount >= STEAMCONTROLLER_URING_MAX_SOURCES)
+    return false;
+
+  size_t slot = pUring->sourceCount++;
+  SteamControllerUringSource *pSource = &pUring->sources[slot];
+  pSource->pDevice        = pDevice;
+  pSource->pUserData      = pUserData;
+  pSource->fd             = fd;
+  pSource->isFile         = isFile;
+  pSource->isActive       = true;
+  pSource->wasNonBlocking = false;
+  pSource->isReading      = false;
+  pSource->offset         = 0;
+
+#if STEAMCONTROLLER_HAVE_IO_URING
+  if (pUring->ringFd >= 0) {
+    // A read on a non-blocking fd would complete right away with -EAGAIN
+    // instead of waiting for the next report.
+    int flags = fcntl(fd, F_GETFL);
+    if (!isFile && flags >= 0 && (flags & O_NONBLOCK)) {
+      fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+      pSource->wasNonBlocking = true;
+    }
+
+    SteamController_UringQueueRead(pUring, slot);
+  }
+#endif
+
+  return true;
+}
+
+/**
+ * Start reading from a device. Its transport must provide a file descriptor.
+ * While the reader is alive, the device must not be read any other way.
+ * @return true if successful.
+ */
+bool SteamController_UringAddDevice(SteamControllerUring *pUring, SteamControllerDevice *pDevice, void *pUserData) {
+  if (!pUring || !pDevice)
+    return false;
+
+  int fd = SteamController_GetPollFd(pDevice);
+  if (fd < 0)
+    return false;
+
+  return SteamController_UringAddSource(pUring, pDevice, fd, false, pUserData);
+}
+
+/**
+ * Read reports from a file of consecutive 64 byte input reports instead of a
+ * device, for testing without hardware. The callback gets a NULL device.
+ * @return true if successful.
+ */
+bool SteamController_UringAddFile(SteamControllerUring *pUring, const char *pPath, void *pUserData) {
+  if (!pUring || !pPath)
+    return false;
+
+  int fd = open(pPath, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    SteamController_LogErrno(pPath);
+    return false;
+  }
+
+  if (!SteamController_UringAddSource(pUring, NULL, fd, true, pUserData)) {
+    close(fd);
+    return false;
+  }
+
+  return true;
+}
+
+#if STEAMCONTROLLER_HAVE_IO_URING
+
+static int SteamController_UringWaitRing(SteamControllerUring *pUring, int timeoutMs, SteamControllerUringCallback callback) {
+  struct __kernel_timespec timeout = {
+    .tv_sec   = timeoutMs / 1000,
+    .tv_nsec  = (timeoutMs % 1000) * 1000000ll
+  };
+
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = timeoutMs < 0 ? 0 : (uint64_t)(uintptr_t)&timeout;
+
+  // Submitting the reads queued by the last harvest and waiting for new
+  // completions takes a single system call.
+  int res = syscall(__NR_io_uring_enter, pUring->ringFd, pUring->pendingSubmits, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+  if (res < 0 && errno != ETIME && errno != EINTR) {
+    SteamController_LogErrno("io_uring_enter");
+    return -1;
+  }
+
+  if (res >= 0)
+    pUring->pendingSubmits -= (unsigned)res < pUring->pendingSubmits ? (unsigned)res : pUring->pendingSubmits;
+
+  int       count = 0;
+  unsigned  head  = atomic_load_explicit(pUring->pCqHead, memory_order_relaxed);
+  unsigned  tail  = atomic_load_explicit(pUring->pCqTail, memory_order_acquire);
+
+  // The reports are already in the buffers, the read latency is the time it
+  // takes to hand them on from here.
+  uint64_t  readTime  = SteamController_GetHostTime();
+
+  for (; head != tail; head++) {
+    const struct io_uring_cqe *pCqe = &pUring->pCqes[head & *pUring->pCqRingMask];
+    size_t slot = (size_t)pCqe->user_data;
+    SteamControllerUringSource *pSource = &pUring->sources[slot];
+    pSource->isReading = false;
+
+    if (pCqe->res <= 0 || (pSource->isFile && pCqe->res < STEAMCONTROLLER_URING_FILE_REPORT)) {
+      SteamController_UringEndSource(pSource, callback);
+      continue;
+    }
+
+    if (SteamController_UringAccept(pSource, pUring->pBuffers + slot * STEAMCONTROLLER_URING_BUFFER_SIZE, (uint16_t)pCqe->res, readTime)) {
+      SteamController_UringDispatch(pSource, pUring->pBuffers + slot * STEAMCONTROLLER_URING_BUFFER_SIZE, (uint16_t)pCqe->res, callback);
+      count++;
+    }
+
+    pSource->offset += (uint64_t)pCqe->res;
+    SteamController_UringQueueRead(pUring, slot);
+  }
+
+  atomic_store_explicit(pUring->pCqHead, head, memory_order_release);
+  return count;
+}
+
+#endif
+
+static int SteamController_UringWaitFallback(SteamControllerUring *pUring, int timeoutMs, SteamControllerUringCallback callback) {
+  struct pollfd pollFds[STEAMCONTROLLER_URING_MAX_SOURCES];
+  size_t        slots[STEAMCONTROLLER_URING_MAX_SOURCES];
+  nfds_t        pollCount = 0;
+
+  for (size_t i=0; i<pUring->sourceCount; i++) {
+    if (!pUring->sources[i].isActive)
+      continue;
+
+    pollFds[pollCount].fd      = pUring->sources[i].fd;
+    pollFds[pollCount].events  = POLLIN;
+    pollFds[pollCount].revents = 0;
+    slots[pollCount++] = i;
+  }
+
+  int res = poll(pollFds, pollCount, timeoutMs);
+  if (res < 0) {
+    if (errno == EINTR)
+      return 0;
+    SteamController_LogErrno("poll");
+    return -1;
+  }
+
+  int count = 0;
+  for (nfds_t i=0; i<pollCount; i++) {
+    if (!pollFds[i].revents)
+      continue;
+
+    SteamControllerUringSource *pSource = &pUring->sources[slots[i]];
+    uint8_t *pBuffer = pUring->pBuffers + slots[i] * STEAMCONTROLLER_URING_BUFFER_SIZE;
+
+    if (pSource->isFile) {
+      ssize_t len = read(pSource->fd, pBuffer, STEAMCONTROLLER_URING_FILE_REPORT);
+      if (len < STEAMCONTROLLER_URING_FILE_REPORT) {
+        SteamController_UringEndSource(pSource, callback);
+        continue;
+      }
+
+      SteamController_UringDispatch(pSource, pBuffer, (uint16_t)len, callback);
+      count++;
+      continue;
+    }
+
+    if (pollFds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+      SteamController_UringEndSource(pSource, callback);
+      continue;
+    }
+
+    for (;;) {
+      uint16_t len = SteamController_ReadRaw(pSource->pDevice, pBuffer, STEAMCONTROLLER_INPUT_REPORT_SIZE);
+      if (!len)
+        break;
+
+      SteamController_UringDispatch(pSource, pBuffer, len, callback);
+      count++;
+    }
+  }
+
+  return count;
+}
+
+/**
+ * Wait for reports from any source and decode them. The callback is called
+ * for every event and once with a NULL event when a source ends (the device
+ * was unplugged or the end of a file was reached).
+ *
+ * @param pUring      Reader to use.
+ * @param timeoutMs   Maximum time to wait in milliseconds, -1 to wait forever.
+ * @param callback    Function to call for every event.
+ * @return Number of events dispatched, 0 on timeout or -1 on error.
+ */
+int SteamController_UringWait(SteamControllerUring *pUring, int timeoutMs, SteamControllerUringCallback callback) {
+  if (!pUring || !callback)
+    return -1;
+
+#if STEAMCONTROLLER_HAVE_IO_URING
+  if (pUring->ringFd >= 0)
+    return SteamController_UringWaitRing(pUring, timeoutMs, callback);
+#endif
+
+  return SteamController_UringWaitFallback(pUring, timeoutMs, callback);
+}
+
+#endif
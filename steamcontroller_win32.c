@@ -10,13 +10,6 @@
 
 #include <stdio.h>
 
-struct SteamControllerDevice {
-  HANDLE      devHandle;
-  HANDLE      reportEvent;
-  OVERLAPPED  overlapped;
-  bool    isWireless;
-};
-
 struct SteamControllerDeviceEnum {
   struct SteamControllerDeviceEnum *next;
   SP_DEVICE_INTERFACE_DETAIL_DATA *pDevIntfDetailData;
@@ -45,7 +38,7 @@ SCAPI SteamControllerDeviceEnum * SteamController_EnumControllerDevices() {
     pDevIntfDetailData->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA);
 
     if (!SetupDiGetDeviceInterfaceDetail(devInfo, &devIntfData, pDevIntfDetailData, reqSize, &reqSize, NULL)) {
-      fprintf(stderr, "SetupDiGetDeviceInterfaceDetail failed. Last error: %08lx\n", GetLastError());
+      SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "SetupDiGetDeviceInterfaceDetail failed. Last error: %08lx", GetLastError());
       free(pDevIntfDetailData);
       continue;
     }
@@ -103,98 +96,211 @@ SCAPI SteamControllerDeviceEnum * SteamController_NextControllerDevice(SteamCont
   return pNext;
 }
 
-SCAPI SteamControllerDevice * SteamController_Open(const SteamControllerDeviceEnum *pEnum) {
-  if (!pEnum)  
-    return NULL;
-
-  SteamControllerDevice *pDevice = malloc(sizeof(SteamControllerDevice));
-  pDevice->isWireless = pEnum->hidAttribs.ProductID == USB_PID_STEAMCONTROLLER_WIRELESS;
-  pDevice->devHandle  = CreateFile(
-    pEnum->pDevIntfDetailData->DevicePath, 
-    GENERIC_READ | GENERIC_WRITE,
-    FILE_SHARE_READ | FILE_SHARE_WRITE,
-    0,
-    OPEN_EXISTING,
-    0,
-    NULL
-  );
-
-  pDevice->reportEvent = CreateEvent(NULL, true, false, NULL);
-  pDevice->overlapped.hEvent = pDevice->reportEvent;
-  pDevice->overlapped.Offset = 0;
-  pDevice->overlapped.OffsetHigh = 0;
-
-  SteamController_Initialize(pDevice);
-  return pDevice;
-}
-
-SCAPI void SteamController_Close(SteamControllerDevice *pDevice) {
-  if (!pDevice)
-    return;
-
-  CloseHandle(pDevice->reportEvent);
-  CloseHandle(pDevice->devHandle);
-  free(pDevice);
-}
+/** Transport context of a windows HID device. */
+typedef struct {
+  HANDLE      devHandle;
+  HANDLE      reportEvent;
+  OVERLAPPED  overlapped;
+} SteamControllerWin32;
 
-bool SteamController_HIDSetFeatureReport(const SteamControllerDevice *pDevice, SteamController_HIDFeatureReport *pReport) {
-  if (!pDevice || !pReport || !pDevice->devHandle)
+static bool SteamController_Win32SetFeatureReport(void *pContext, uint8_t *pReport) {
+  SteamControllerWin32 *pWin32 = (SteamControllerWin32 *)pContext;
+  if (!pWin32->devHandle)
     return false;
 
-  fprintf(stderr, "SteamController_HIDSetFeatureReport %02x\n", pReport->featureId);
+  SteamController_Log(STEAMCONTROLLER_LOG_DEBUG, "SteamController_HIDSetFeatureReport %02x", ((SteamController_HIDFeatureReport *)pReport)->featureId);
 
   for (int i=0; i<50; i++) {
-    bool ok = HidD_SetFeature(pDevice->devHandle, pReport, sizeof(SteamController_HIDFeatureReport));
+    bool ok = HidD_SetFeature(pWin32->devHandle, pReport, STEAMCONTROLLER_FEATURE_REPORT_SIZE);
     if (ok)
       return true;
 
-    fprintf(stderr, "HidD_SetFeature failed. Last error: %08lx\n", GetLastError());
+    SteamController_Log(STEAMCONTROLLER_LOG_WARNING, "HidD_SetFeature failed. Last error: %08lx", GetLastError());
     Sleep(1);
   }
 
   return false;
 }
 
-bool SteamController_HIDGetFeatureReport(const SteamControllerDevice *pDevice, SteamController_HIDFeatureReport *pReport) {
-  if (!pDevice || !pReport || !pDevice->devHandle)
+static bool SteamController_Win32GetFeatureReport(void *pContext, uint8_t *pReport) {
+  SteamControllerWin32 *pWin32 = (SteamControllerWin32 *)pContext;
+  SteamController_HIDFeatureReport *pFeatureReport = (SteamController_HIDFeatureReport *)pReport;
+  if (!pWin32->devHandle)
     return false;
 
-  uint8_t featureId   = pReport->featureId;
+  uint8_t featureId   = pFeatureReport->featureId;
 
-  SteamController_HIDSetFeatureReport(pDevice, pReport);
+  SteamController_Win32SetFeatureReport(pContext, pReport);
 
-  fprintf(stderr, "SteamController_HIDGetFeatureReport %02x\n", pReport->featureId);
+  SteamController_Log(STEAMCONTROLLER_LOG_DEBUG, "SteamController_HIDGetFeatureReport %02x", pFeatureReport->featureId);
 
   for (int i=0; i<50; i++) {
-    bool ok = HidD_GetFeature(pDevice->devHandle, pReport, sizeof(SteamController_HIDFeatureReport));
+    bool ok = HidD_GetFeature(pWin32->devHandle, pReport, STEAMCONTROLLER_FEATURE_REPORT_SIZE);
     if (ok) {
-      if (featureId == pReport->featureId)
+      if (featureId == pFeatureReport->featureId)
         return true;
       continue;
     }
 
-    fprintf(stderr, "HidD_SetFeature failed. Last error: %08lx\n", GetLastError());
+    SteamController_Log(STEAMCONTROLLER_LOG_WARNING, "HidD_GetFeature failed. Last error: %08lx", GetLastError());
     Sleep(1);
   }
 
   return false;
 }
 
-bool SCAPI SteamController_IsWirelessDongle(const SteamControllerDevice *pDevice) {
-  if (!pDevice)
-    return false;
-  return pDevice->isWireless;
+static uint8_t SteamController_Win32ReadRaw(void *pContext, uint8_t *buffer, uint8_t maxLen) {
+  SteamControllerWin32 *pWin32 = (SteamControllerWin32 *)pContext;
+
+  DWORD bytesRead = 0;
+  ReadFile(pWin32->devHandle, buffer, maxLen, &bytesRead, &pWin32->overlapped);
+  WaitForSingleObject(pWin32->reportEvent, 0);
+
+  return bytesRead & 0xff;
+}
+
+static void SteamController_Win32Close(void *pContext) {
+  SteamControllerWin32 *pWin32 = (SteamControllerWin32 *)pContext;
+
+  CloseHandle(pWin32->reportEvent);
+  CloseHandle(pWin32->devHandle);
+  free(pWin32);
 }
 
-uint8_t SteamController_ReadRaw(const SteamControllerDevice *pDevice, uint8_t *buffer, uint8_t maxLen) {
+static const SteamControllerTransport Win32Transport = {
+  .readRaw          = SteamController_Win32ReadRaw,
+  .setFeatureReport = SteamController_Win32SetFeatureReport,
+  .getFeatureReport = SteamController_Win32GetFeatureReport,
+  .close            = SteamController_Win32Close,
+  .getPollFd        = NULL,
+  .hasPendingInput  = NULL,
+};
+
+/**
+ * Build a name for the physical device that stays the same when it is
+ * reopened, on any port: USB ids plus the serial number and the interface
+ * from the device path, which tells dongle slots apart. Devices without a
+ * serial number get no name.
+ */
+static void SteamController_Win32GetIdentity(const SteamControllerDeviceEnum *pEnum, HANDLE devHandle, char *pIdentity, size_t size) {
+  WCHAR serial[64];
+
+  pIdentity[0] = 0;
+
+  memset(serial, 0, sizeof(serial));
+  if (!HidD_GetSerialNumberString(devHandle, serial, sizeof(serial) - sizeof(WCHAR)) || !serial[0])
+    return;
+
+  // Interfaces of composite devices have paths like \\?\hid#vid_28de&pid_1142&mi_01#...
+  unsigned      interfaceNumber = 0;
+  const TCHAR  *pPath           = pEnum->pDevIntfDetailData->DevicePath;
+  for (size_t i=0; pPath[i]; i++) {
+    if (pPath[i] == '&' && (pPath[i + 1] | 0x20) == 'm' && (pPath[i + 2] | 0x20) == 'i' && pPath[i + 3] == '_') {
+      for (size_t digit=i+4; pPath[digit] >= '0' && pPath[digit] <= '9'; digit++)
+        interfaceNumber = interfaceNumber * 10 + (unsigned)(pPath[digit] - '0');
+      break;
+    }
+  }
+
+  snprintf(pIdentity, size, "%04hx:%04hx:%ls/input%u", (unsigned short)pEnum->hidAttribs.VendorID, (unsigned short)pEnum->hidAttribs.ProductID, serial, interfaceNumber);
+}
+
+SCAPI SteamControllerDevice * SteamController_Open(const SteamControllerDeviceEnum *pEnum) {
+  return SteamController_OpenEx(pEnum, 0);
+}
+
+SCAPI SteamControllerDevice * SteamController_OpenEx(const SteamControllerDeviceEnum *pEnum, unsigned flags) {
+  if (!pEnum)  
+    return NULL;
+
+  SteamControllerWin32 *pWin32 = malloc(sizeof(SteamControllerWin32));
+  pWin32->devHandle  = CreateFile(
+    pEnum->pDevIntfDetailData->DevicePath, 
+    GENERIC_READ | GENERIC_WRITE,
+    FILE_SHARE_READ | FILE_SHARE_WRITE,
+    0,
+    OPEN_EXISTING,
+    0,
+    NULL
+  );
+
+  pWin32->reportEvent = CreateEvent(NULL, true, false, NULL);
+  pWin32->overlapped.hEvent = pWin32->reportEvent;
+  pWin32->overlapped.Offset = 0;
+  pWin32->overlapped.OffsetHigh = 0;
+
+  bool isWireless = pEnum->hidAttribs.ProductID == USB_PID_STEAMCONTROLLER_WIRELESS;
+
+  char identity[STEAMCONTROLLER_IDENTITY_SIZE];
+  SteamController_Win32GetIdentity(pEnum, pWin32->devHandle, identity, sizeof(identity));
+
+  SteamControllerDevice *pDevice = SteamController_OpenTransportEx(&Win32Transport, pWin32, isWireless, identity, flags);
   if (!pDevice)
+    SteamController_Win32Close(pWin32);
+
+  return pDevice;
+}
+
+typedef struct {
+  const SteamControllerDeviceEnum  *pEnum;
+  unsigned                          flags;
+  SteamControllerDevice            *pDevice;
+  HANDLE                            thread;
+} SteamControllerOpenJob;
+
+static DWORD WINAPI SteamController_OpenThread(LPVOID pArg) {
+  SteamControllerOpenJob *pJob = (SteamControllerOpenJob *)pArg;
+  pJob->pDevice = SteamController_OpenEx(pJob->pEnum, pJob->flags);
+  return 0;
+}
+
+/** Open all steam controllers and wireless dongle slots, each initialized on its own thread. */
+SCAPI size_t SteamController_OpenAll(SteamControllerDevice **ppDevices, size_t maxDevices, unsigned flags) {
+  if (!ppDevices || !maxDevices)
     return 0;
 
-  DWORD bytesRead = 0;
-  ReadFile(pDevice->devHandle, buffer, maxLen, &bytesRead, (OVERLAPPED*)&pDevice->overlapped);
-  WaitForSingleObject(pDevice->reportEvent, 0);
+  SteamControllerOpenJob *pJobs = calloc(maxDevices, sizeof(SteamControllerOpenJob));
+  if (!pJobs)
+    return 0;
 
-  return bytesRead & 0xff;
+  SteamControllerDeviceEnum *pFirstEnum = SteamController_EnumControllerDevices();
+
+  size_t jobCount = 0;
+  for (const SteamControllerDeviceEnum *pEnum = pFirstEnum; pEnum && jobCount < maxDevices; pEnum = pEnum->next) {
+    SteamControllerOpenJob *pJob = pJobs + jobCount++;
+    pJob->pEnum = pEnum;
+    pJob->flags = flags;
+    pJob->thread = CreateThread(NULL, 0, SteamController_OpenThread, pJob, 0, NULL);
+
+    if (!pJob->thread)
+      SteamController_OpenThread(pJob);
+  }
+
+  size_t count = 0;
+  for (size_t i=0; i<jobCount; i++) {
+    if (pJobs[i].thread) {
+      WaitForSingleObject(pJobs[i].thread, INFINITE);
+      CloseHandle(pJobs[i].thread);
+    }
+
+    if (pJobs[i].pDevice)
+      ppDevices[count++] = pJobs[i].pDevice;
+  }
+
+  while (pFirstEnum)
+    pFirstEnum = SteamController_NextControllerDevice(pFirstEnum);
+
+  free(pJobs);
+  return count;
+}
+
+/** Current performance counter time in nanoseconds. */
+SCAPI uint64_t SteamController_GetHostTime() {
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ull +
+         (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart;
 }
 
 #endif
@@ -11,7 +11,7 @@ bool SCAPI SteamController_QueryWirelessState(const SteamControllerDevice *pDevi
   featureReport.featureId   = STEAMCONTROLLER_DONGLE_GET_WIRELESS_STATE;
 
   if (!SteamController_HIDGetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "DONGLE_GET_WIRELESS_STATE (get) failed for controller %p\n", pDevice);
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "DONGLE_GET_WIRELESS_STATE (get) failed for controller %p", pDevice);
     return false;
   }
 
@@ -37,7 +37,7 @@ bool SCAPI SteamController_EnablePairing(const SteamControllerDevice *pDevice, b
   featureReport.data[1]     = enable ? (deviceType ? deviceType : 0x3c) : 0;
 
   if (!SteamController_HIDSetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "ENABLE_PAIRING failed for controller %p\n", pDevice);
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "ENABLE_PAIRING failed for controller %p", pDevice);
     return false;
   }
   return true;
@@ -56,7 +56,7 @@ bool SCAPI SteamController_CommitPairing(const SteamControllerDevice *pDevice, b
                               STEAMCONTROLLER_DISCONNECT_DEVICE;
 
   if (!SteamController_HIDSetFeatureReport(pDevice, &featureReport)) {
-    fprintf(stderr, "COMMIT_DEVICE/DISCONNECT_DEVICE failed for controller %p\n", pDevice);
+    SteamController_Log(STEAMCONTROLLER_LOG_ERROR, "COMMIT_DEVICE/DISCONNECT_DEVICE failed for controller %p", pDevice);
     return false;
   }
   return true;
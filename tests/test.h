@@ -0,0 +1,83 @@
+#pragma once
+
+#include "steamcontroller.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Minimal checks for the tests. A failed check is reported and counted, the
+ * test goes on. Return Test_Result() from main.
+ */
+static int Test_FailureCount;
+
+#define CHECK(condition) do {                                                     \
+    if (!(condition)) {                                                           \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      Test_FailureCount++;                                                        \
+    }                                                                             \
+  } while (0)
+
+static inline int Test_Result() {
+  if (Test_FailureCount)
+    fprintf(stderr, "%d checks failed\n", Test_FailureCount);
+  return Test_FailureCount ? 1 : 0;
+}
+
+static inline void Test_StoreU16(uint8_t *pDestination, int16_t value) {
+  pDestination[0] = (uint16_t)value & 0xff;
+  pDestination[1] = ((uint16_t)value >> 8) & 0xff;
+}
+
+/** Encode an update event into a 64 byte input report as the device sends it. */
+static inline void Test_BuildUpdateReport(uint8_t *pReport, const SteamControllerUpdateEvent *pUpdate) {
+  memset(pReport, 0, 64);
+  pReport[0x00] = 0x01;
+  pReport[0x02] = STEAMCONTROLLER_EVENT_UPDATE;
+  pReport[0x03] = 0x3c;
+  for (int i=0; i<4; i++)
+    pReport[0x04 + i] = (pUpdate->timeStamp >> (8 * i)) & 0xff;
+  for (int i=0; i<3; i++)
+    pReport[0x08 + i] = (pUpdate->buttons >> (8 * i)) & 0xff;
+
+  pReport[0x0b] = pUpdate->leftTrigger;
+  pReport[0x0c] = pUpdate->rightTrigger;
+
+  Test_StoreU16(pReport + 0x10, pUpdate->leftXY.x);
+  Test_StoreU16(pReport + 0x12, pUpdate->leftXY.y);
+  Test_StoreU16(pReport + 0x14, pUpdate->rightXY.x);
+  Test_StoreU16(pReport + 0x16, pUpdate->rightXY.y);
+
+  Test_StoreU16(pReport + 0x1c, pUpdate->acceleration.x);
+  Test_StoreU16(pReport + 0x1e, pUpdate->acceleration.y);
+  Test_StoreU16(pReport + 0x20, pUpdate->acceleration.z);
+  Test_StoreU16(pReport + 0x22, pUpdate->angularVelocity.x);
+  Test_StoreU16(pReport + 0x24, pUpdate->angularVelocity.y);
+  Test_StoreU16(pReport + 0x26, pUpdate->angularVelocity.z);
+  Test_StoreU16(pReport + 0x28, pUpdate->orientation.x);
+  Test_StoreU16(pReport + 0x2a, pUpdate->orientation.y);
+  Test_StoreU16(pReport + 0x2c, pUpdate->orientation.z);
+}
+
+/** Queue an update report with a time stamp and buttons, everything else zero. */
+static inline void Test_QueueUpdate(SteamControllerLoopback *pLoopback, uint32_t timeStamp, uint32_t buttons) {
+  SteamControllerUpdateEvent update;
+  memset(&update, 0, sizeof(update));
+  update.timeStamp  = timeStamp;
+  update.buttons    = buttons;
+
+  uint8_t report[64];
+  Test_BuildUpdateReport(report, &update);
+  SteamController_LoopbackQueueReport(pLoopback, report, sizeof(report));
+}
+
+static inline void Test_QueueBattery(SteamControllerLoopback *pLoopback, uint16_t voltage) {
+  uint8_t report[64] = { 0x01, 0x00, STEAMCONTROLLER_EVENT_BATTERY, 0x0b };
+  Test_StoreU16(report + 0x0c, (int16_t)voltage);
+  SteamController_LoopbackQueueReport(pLoopback, report, sizeof(report));
+}
+
+static inline void Test_QueueConnection(SteamControllerLoopback *pLoopback, uint8_t details) {
+  uint8_t report[64] = { 0x01, 0x00, STEAMCONTROLLER_EVENT_CONNECTION, 0x01, details };
+  SteamController_LoopbackQueueReport(pLoopback, report, sizeof(report));
+}
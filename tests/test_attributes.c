@@ -0,0 +1,126 @@
+#include "test.h"
+
+#define TEST_GET_ATTRIBUTES       0x83
+#define TEST_DONGLE_GET_VERSION   0xa1
+
+static size_t Test_CountFeatureReports(const SteamControllerLoopback *pLoopback, uint8_t featureId) {
+  size_t count = 0;
+  for (size_t i=0; i<SteamController_LoopbackGetFeatureReportCount(pLoopback); i++)
+    count += SteamController_LoopbackGetFeatureReport(pLoopback, i)[1] == featureId;
+  return count;
+}
+
+static void Test_QueueAttributes(SteamControllerLoopback *pLoopback) {
+  // Product id 0x1102 and board revision 10.
+  uint8_t response[STEAMCONTROLLER_FEATURE_REPORT_SIZE] = { 0x00, TEST_GET_ATTRIBUTES, 10, 0x01, 0x02, 0x11, 0x00, 0x00, 0x09, 0x0a, 0x00, 0x00, 0x00 };
+  SteamController_LoopbackSetFeatureResponse(pLoopback, response);
+}
+
+/** A lazy open queries nothing, the first call sends what it left out. */
+static void Test_LazyOpenDefersQueries() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  Test_QueueAttributes(pLoopback);
+
+  SteamControllerDevice *pDevice = SteamController_OpenLoopbackEx(pLoopback, false, STEAMCONTROLLER_OPEN_LAZY);
+  CHECK(pDevice != NULL);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 0);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_DONGLE_GET_VERSION) == 0);
+
+  SteamControllerAttributes attributes;
+  CHECK(SteamController_GetAttributes(pDevice, &attributes));
+  CHECK(attributes.isValid);
+  CHECK(attributes.productId == 0x1102);
+  CHECK(attributes.boardRevision == 10);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 1);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_DONGLE_GET_VERSION) == 1);
+
+  // Both are sent only once.
+  CHECK(SteamController_GetAttributes(pDevice, &attributes));
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 1);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_DONGLE_GET_VERSION) == 1);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** Another controller connecting to a dongle slot makes the attributes unknown. */
+static void Test_ConnectionInvalidatesAttributes() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  Test_QueueAttributes(pLoopback);
+
+  SteamControllerDevice *pDevice = SteamController_OpenLoopback(pLoopback, true);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 1);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_DONGLE_GET_VERSION) == 1);
+
+  Test_QueueConnection(pLoopback, STEAMCONTROLLER_CONNECTION_EVENT_CONNECTED);
+  SteamControllerEvent event;
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_CONNECTION);
+
+  SteamControllerAttributes attributes;
+  CHECK(SteamController_GetAttributes(pDevice, &attributes));
+  CHECK(attributes.productId == 0x1102);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 2);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** Reopening a device with the same identity uses the cached attributes. */
+static void Test_ReopenUsesCache() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamController_LoopbackSetIdentity(pLoopback, "28de:1102:test-wired/input0");
+  Test_QueueAttributes(pLoopback);
+
+  SteamControllerDevice *pDevice = SteamController_OpenLoopback(pLoopback, false);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 1);
+  SteamController_Close(pDevice);
+
+  pDevice = SteamController_OpenLoopback(pLoopback, false);
+  CHECK(pDevice != NULL);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 1);
+
+  SteamControllerAttributes attributes;
+  CHECK(SteamController_GetAttributes(pDevice, &attributes));
+  CHECK(attributes.productId == 0x1102);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 1);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/**
+ * Another controller can be paired to a dongle slot while it is closed, or
+ * connect while it is open. Neither gets the attributes of the one before.
+ */
+static void Test_DongleSlotIsQueriedAgain() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamController_LoopbackSetIdentity(pLoopback, "28de:1142:test-dongle/input1");
+  Test_QueueAttributes(pLoopback);
+
+  SteamControllerDevice *pDevice = SteamController_OpenLoopback(pLoopback, true);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 1);
+  SteamController_Close(pDevice);
+
+  pDevice = SteamController_OpenLoopback(pLoopback, true);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 2);
+
+  // A disconnect while it is open drops them too, the next open asks again.
+  Test_QueueConnection(pLoopback, STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED);
+  SteamControllerEvent event;
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_CONNECTION);
+
+  SteamControllerDevice *pOther = SteamController_OpenLoopback(pLoopback, true);
+  CHECK(Test_CountFeatureReports(pLoopback, TEST_GET_ATTRIBUTES) == 3);
+
+  SteamController_Close(pOther);
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+int main() {
+  Test_LazyOpenDefersQueries();
+  Test_ConnectionInvalidatesAttributes();
+  Test_ReopenUsesCache();
+  Test_DongleSlotIsQueriedAgain();
+  return Test_Result();
+}
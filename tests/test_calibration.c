@@ -0,0 +1,158 @@
+#include "test.h"
+
+#define TEST_SAMPLE_COUNT   13    /**< Three blocks of four and one sample left over. */
+#define TEST_CALIBRATION    "test_calibration.bin"
+
+static float Test_Abs(float value) {
+  return value < 0.0f ? -value : value;
+}
+
+static SteamControllerUpdateEvent Test_Motion(int16_t gx, int16_t gy, int16_t gz, int16_t ax, int16_t ay, int16_t az) {
+  SteamControllerUpdateEvent update;
+  memset(&update, 0, sizeof(update));
+  update.angularVelocity.x  = gx;
+  update.angularVelocity.y  = gy;
+  update.angularVelocity.z  = gz;
+  update.acceleration.x     = ax;
+  update.acceleration.y     = ay;
+  update.acceleration.z     = az;
+  return update;
+}
+
+/** A saved bias loads back exactly, from a file of 32 bytes. */
+static void Test_CalibrationSaveLoad() {
+  SteamControllerCalibration calibration;
+  SteamController_InitCalibration(&calibration);
+  calibration.gyroBias[0] = 12.5f;
+  calibration.gyroBias[1] = -3.25f;
+  calibration.gyroBias[2] = 7.0f;
+  calibration.biasSamples = 300;
+  calibration.stillCount  = 20;
+  CHECK(SteamController_SaveCalibration(&calibration, TEST_CALIBRATION));
+
+  FILE *pFile = fopen(TEST_CALIBRATION, "rb");
+  CHECK(pFile != NULL);
+  if (pFile) {
+    uint8_t bytes[64];
+    CHECK(fread(bytes, 1, sizeof(bytes), pFile) == 32);
+    CHECK(memcmp(bytes, STEAMCONTROLLER_CALIBRATION_MAGIC, 8) == 0);
+    fclose(pFile);
+  }
+
+  SteamControllerCalibration loaded;
+  CHECK(SteamController_LoadCalibration(&loaded, TEST_CALIBRATION));
+  CHECK(memcmp(loaded.gyroBias, calibration.gyroBias, sizeof(loaded.gyroBias)) == 0);
+  CHECK(loaded.biasSamples == 300);
+  CHECK(loaded.stillCount == 0);
+
+  // Anything else is refused and leaves no bias.
+  pFile = fopen(TEST_CALIBRATION, "wb");
+  CHECK(pFile != NULL);
+  if (pFile) {
+    fputs("not a calibration file, but long enough", pFile);
+    fclose(pFile);
+  }
+
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  CHECK(!SteamController_LoadCalibration(&loaded, TEST_CALIBRATION));
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_WARNING);
+  CHECK(loaded.biasSamples == 0);
+  CHECK(loaded.gyroBias[0] == 0.0f && loaded.gyroBias[1] == 0.0f && loaded.gyroBias[2] == 0.0f);
+
+  remove(TEST_CALIBRATION);
+}
+
+/** The bias converges to the rate of a controller lying still, and keeps it while it moves. */
+static void Test_CalibrationBias() {
+  SteamControllerCalibration  calibration;
+  SteamControllerMotion       motion;
+  SteamController_InitCalibration(&calibration);
+
+  // Still with a bias and a little noise.
+  for (int i=0; i<2000; i++) {
+    int16_t noise = (int16_t)((i % 3) - 1);
+    SteamControllerUpdateEvent update = Test_Motion(30 + noise, -20 - noise, 10 + noise, 0, 0, 16384);
+    SteamController_CalibrationUpdate(&calibration, &update, &motion);
+  }
+
+  CHECK(motion.isStill);
+  CHECK(Test_Abs(calibration.gyroBias[0] - 30.0f) < 0.5f);
+  CHECK(Test_Abs(calibration.gyroBias[1] + 20.0f) < 0.5f);
+  CHECK(Test_Abs(calibration.gyroBias[2] - 10.0f) < 0.5f);
+  CHECK(Test_Abs(motion.angularVelocity[0]) < 1e-3f);
+  CHECK(Test_Abs(motion.acceleration[2] - STEAMCONTROLLER_STANDARD_GRAVITY) < 1e-3f);
+
+  float bias[3] = { calibration.gyroBias[0], calibration.gyroBias[1], calibration.gyroBias[2] };
+
+  // Shaken.
+  for (int i=0; i<500; i++) {
+    int16_t rate = (i & 1) ? 3000 : -3000;
+    SteamControllerUpdateEvent update = Test_Motion(rate, rate / 2, -rate, 4000, 0, 16384);
+    SteamController_CalibrationUpdate(&calibration, &update, &motion);
+    CHECK(!motion.isStill);
+  }
+
+  // Turning slowly and steadily is quiet, but far from the bias.
+  for (int i=0; i<500; i++) {
+    SteamControllerUpdateEvent update = Test_Motion(500, -20, 10, 0, 0, 16384);
+    SteamController_CalibrationUpdate(&calibration, &update, &motion);
+    CHECK(!motion.isStill);
+  }
+
+  CHECK(memcmp(bias, calibration.gyroBias, sizeof(bias)) == 0);
+}
+
+/** Converting a batch gives what converting each update does. */
+static void Test_CalibrationBatchMatchesUpdates() {
+  SteamControllerCalibration calibration;
+  SteamController_InitCalibration(&calibration);
+  calibration.gyroBias[0] = 12.5f;
+  calibration.gyroBias[1] = -3.25f;
+  calibration.gyroBias[2] = 7.0f;
+  calibration.biasSamples = 1024;
+
+  int16_t fields[13][TEST_SAMPLE_COUNT];
+  uint8_t eventType[TEST_SAMPLE_COUNT];
+  for (int i=0; i<TEST_SAMPLE_COUNT; i++) {
+    eventType[i] = STEAMCONTROLLER_EVENT_UPDATE;
+    for (int field=0; field<13; field++)
+      fields[field][i] = (int16_t)(i * 4999 - field * 1777 - 30000);
+  }
+  fields[7][0] = INT16_MIN;
+  fields[8][1] = INT16_MAX;
+
+  SteamControllerUpdateBatch batch = {
+    eventType, NULL, NULL, NULL, NULL,
+    fields[0], fields[1], fields[2], fields[3],
+    fields[4], fields[5], fields[6],
+    fields[7], fields[8], fields[9],
+    fields[10], fields[11], fields[12],
+  };
+
+  float converted[6][TEST_SAMPLE_COUNT];
+  SteamControllerMotionBatch motionBatch = {
+    converted[0], converted[1], converted[2],
+    converted[3], converted[4], converted[5],
+  };
+  SteamController_ConvertMotionBatch(&calibration, &batch, TEST_SAMPLE_COUNT, &motionBatch);
+
+  for (int i=0; i<TEST_SAMPLE_COUNT; i++) {
+    // A single update is never still, so the bias stays.
+    SteamControllerCalibration single = calibration;
+    SteamControllerMotion motion;
+    SteamControllerUpdateEvent update = Test_Motion(fields[7][i], fields[8][i], fields[9][i], fields[4][i], fields[5][i], fields[6][i]);
+    SteamController_CalibrationUpdate(&single, &update, &motion);
+
+    for (int axis=0; axis<3; axis++) {
+      CHECK(Test_Abs(converted[axis][i] - motion.acceleration[axis]) <= 1e-6f * (1.0f + Test_Abs(motion.acceleration[axis])));
+      CHECK(Test_Abs(converted[3 + axis][i] - motion.angularVelocity[axis]) <= 1e-6f * (1.0f + Test_Abs(motion.angularVelocity[axis])));
+    }
+  }
+}
+
+int main() {
+  Test_CalibrationSaveLoad();
+  Test_CalibrationBias();
+  Test_CalibrationBatchMatchesUpdates();
+  return Test_Result();
+}
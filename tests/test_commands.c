@@ -0,0 +1,135 @@
+#include "test.h"
+
+#if __linux__
+
+#include <pthread.h>
+
+#define TEST_TRIGGER_HAPTIC_PULSE   0x8f
+#define TEST_MAX_COMPLETIONS        16
+
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t  condition;
+  bool            isHeld;             /**< The command thread is in the callback of the first command. */
+  bool            isOpen;             /**< The first command may complete. */
+
+  uint8_t         featureIds[TEST_MAX_COMPLETIONS];
+  bool            successes[TEST_MAX_COMPLETIONS];
+  uint8_t         responses[TEST_MAX_COMPLETIONS];   /**< First data byte of the response, 0 without one. */
+  size_t          count;
+} TestCommandLog;
+
+typedef struct {
+  TestCommandLog *pLog;
+  uint8_t         featureId;
+} TestCommand;
+
+static void Test_CommandCallback(SteamControllerDevice *pDevice, bool success, const uint8_t *pResponse, void *pUserData) {
+  (void)pDevice;
+  TestCommand    *pCommand  = (TestCommand *)pUserData;
+  TestCommandLog *pLog      = pCommand->pLog;
+
+  pthread_mutex_lock(&pLog->mutex);
+  if (pLog->count < TEST_MAX_COMPLETIONS) {
+    pLog->featureIds[pLog->count] = pCommand->featureId;
+    pLog->successes[pLog->count]  = success;
+    pLog->responses[pLog->count]  = pResponse ? pResponse[3] : 0;
+  }
+  pLog->count++;
+  pthread_mutex_unlock(&pLog->mutex);
+}
+
+/** Holds the command thread until the test has queued everything else. */
+static void Test_GateCallback(SteamControllerDevice *pDevice, bool success, const uint8_t *pResponse, void *pUserData) {
+  TestCommand    *pCommand  = (TestCommand *)pUserData;
+  TestCommandLog *pLog      = pCommand->pLog;
+
+  pthread_mutex_lock(&pLog->mutex);
+  pLog->isHeld = true;
+  pthread_cond_broadcast(&pLog->condition);
+  while (!pLog->isOpen)
+    pthread_cond_wait(&pLog->condition, &pLog->mutex);
+  pthread_mutex_unlock(&pLog->mutex);
+
+  Test_CommandCallback(pDevice, success, pResponse, pUserData);
+}
+
+static bool Test_Submit(SteamControllerDevice *pDevice, TestCommand *pCommand, bool isRequest, unsigned priority) {
+  uint8_t report[STEAMCONTROLLER_FEATURE_REPORT_SIZE] = { 0x00, pCommand->featureId, 1, 0x00 };
+  return SteamController_SubmitFeatureReport(pDevice, report, isRequest, priority, Test_CommandCallback, pCommand);
+}
+
+/** Queued commands go out by priority, then in order, and each completes once. */
+static void Test_CommandPriorities() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  SteamController_LoopbackClearFeatureReports(pLoopback);
+
+  uint8_t response[STEAMCONTROLLER_FEATURE_REPORT_SIZE] = { 0x00, 0x02, 1, 0x5a };
+  SteamController_LoopbackSetFeatureResponse(pLoopback, response);
+
+  TestCommandLog log;
+  memset(&log, 0, sizeof(log));
+  pthread_mutex_init(&log.mutex, NULL);
+  pthread_cond_init(&log.condition, NULL);
+
+  TestCommand gate = { &log, 0x01 };
+  uint8_t gateReport[STEAMCONTROLLER_FEATURE_REPORT_SIZE] = { 0x00, gate.featureId, 0 };
+  CHECK(SteamController_SubmitFeatureReport(pDevice, gateReport, false, STEAMCONTROLLER_PRIORITY_NORMAL, Test_GateCallback, &gate));
+
+  pthread_mutex_lock(&log.mutex);
+  while (!log.isHeld)
+    pthread_cond_wait(&log.condition, &log.mutex);
+  pthread_mutex_unlock(&log.mutex);
+
+  TestCommand commands[] = {
+    { &log, 0x20 }, { &log, 0x21 }, { &log, 0x10 }, { &log, TEST_TRIGGER_HAPTIC_PULSE }, { &log, 0x11 }, { &log, 0x02 },
+  };
+  CHECK(Test_Submit(pDevice, commands + 0, false, STEAMCONTROLLER_PRIORITY_LOW));
+  CHECK(Test_Submit(pDevice, commands + 1, false, STEAMCONTROLLER_PRIORITY_LOW));
+  CHECK(Test_Submit(pDevice, commands + 2, false, STEAMCONTROLLER_PRIORITY_NORMAL));
+  CHECK(SteamController_TriggerHapticAsync(pDevice, 0, 100, 200, 3, Test_CommandCallback, commands + 3));
+  CHECK(Test_Submit(pDevice, commands + 4, false, STEAMCONTROLLER_PRIORITY_NORMAL));
+  CHECK(Test_Submit(pDevice, commands + 5, true, STEAMCONTROLLER_PRIORITY_HIGH));
+  CHECK(!Test_Submit(pDevice, commands + 5, true, STEAMCONTROLLER_PRIORITY_COUNT));
+
+  pthread_mutex_lock(&log.mutex);
+  log.isOpen = true;
+  pthread_cond_broadcast(&log.condition);
+  pthread_mutex_unlock(&log.mutex);
+
+  SteamController_FlushCommands(pDevice);
+
+  static const uint8_t Expected[] = { 0x01, TEST_TRIGGER_HAPTIC_PULSE, 0x02, 0x10, 0x11, 0x20, 0x21 };
+  CHECK(log.count == sizeof(Expected));
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) == sizeof(Expected));
+
+  for (size_t i=0; i<sizeof(Expected) && i<log.count; i++) {
+    CHECK(log.featureIds[i] == Expected[i]);
+    CHECK(log.successes[i]);
+    CHECK(SteamController_LoopbackGetFeatureReport(pLoopback, i)[1] == Expected[i]);
+
+    // Only the request gets the response of the device.
+    CHECK(log.responses[i] == (Expected[i] == 0x02 ? 0x5a : 0));
+  }
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+  pthread_cond_destroy(&log.condition);
+  pthread_mutex_destroy(&log.mutex);
+}
+
+int main() {
+  // The loopback has no response for the queries made when opening it.
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  Test_CommandPriorities();
+  return Test_Result();
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "test.h"
+
+#define TEST_REPORT_COUNT   37    /**< Covers blocks of 16 and 8 and the reports left over. */
+
+static int16_t Test_FieldValue(size_t report, int field) {
+  return (int16_t)(report * 97 + field * 1031 - 16000);
+}
+
+static SteamControllerUpdateEvent Test_BuildUpdate(size_t report) {
+  SteamControllerUpdateEvent update;
+  memset(&update, 0, sizeof(update));
+  update.timeStamp          = (uint32_t)(1000 + report);
+  update.buttons            = (uint32_t)(report * 0x010203) & 0xffffff;
+  update.leftTrigger        = (uint8_t)report;
+  update.rightTrigger       = (uint8_t)(255 - report);
+  update.leftXY.x           = Test_FieldValue(report, 0);
+  update.leftXY.y           = Test_FieldValue(report, 1);
+  update.rightXY.x          = Test_FieldValue(report, 2);
+  update.rightXY.y          = Test_FieldValue(report, 3);
+  update.acceleration.x     = Test_FieldValue(report, 4);
+  update.acceleration.y     = Test_FieldValue(report, 5);
+  update.acceleration.z     = Test_FieldValue(report, 6);
+  update.angularVelocity.x  = Test_FieldValue(report, 7);
+  update.angularVelocity.y  = Test_FieldValue(report, 8);
+  update.angularVelocity.z  = Test_FieldValue(report, 9);
+  update.orientation.x      = Test_FieldValue(report, 10);
+  update.orientation.y      = Test_FieldValue(report, 11);
+  update.orientation.z      = Test_FieldValue(report, 12);
+  return update;
+}
+
+/** Every field of every report ends up in its own array at the index of the report. */
+static void Test_DecodeUpdateBatch() {
+  static uint8_t reports[TEST_REPORT_COUNT][STEAMCONTROLLER_RAW_REPORT_SIZE];
+
+  for (size_t i=0; i<TEST_REPORT_COUNT; i++) {
+    SteamControllerUpdateEvent update = Test_BuildUpdate(i);
+    Test_BuildUpdateReport(reports[i], &update);
+  }
+
+  // Not an update, in the middle of a block.
+  memset(reports[5], 0, STEAMCONTROLLER_RAW_REPORT_SIZE);
+  reports[5][0x00] = 0x01;
+  reports[5][0x02] = STEAMCONTROLLER_EVENT_BATTERY;
+  reports[5][0x03] = 0x0b;
+
+  uint8_t   eventType[TEST_REPORT_COUNT];
+  uint32_t  timeStamp[TEST_REPORT_COUNT], buttons[TEST_REPORT_COUNT];
+  uint8_t   leftTrigger[TEST_REPORT_COUNT], rightTrigger[TEST_REPORT_COUNT];
+  int16_t   fields[13][TEST_REPORT_COUNT];
+
+  SteamControllerUpdateBatch batch = {
+    eventType, timeStamp, buttons, leftTrigger, rightTrigger,
+    fields[0], fields[1], fields[2], fields[3],
+    fields[4], fields[5], fields[6],
+    fields[7], fields[8], fields[9],
+    fields[10], fields[11], fields[12],
+  };
+
+  SteamController_DecodeUpdateBatch(&reports[0][0], TEST_REPORT_COUNT, &batch);
+
+  CHECK(eventType[5] == STEAMCONTROLLER_EVENT_BATTERY);
+
+  for (size_t i=0; i<TEST_REPORT_COUNT; i++) {
+    if (i == 5)
+      continue;
+
+    SteamControllerUpdateEvent update = Test_BuildUpdate(i);
+    CHECK(eventType[i] == STEAMCONTROLLER_EVENT_UPDATE);
+    CHECK(timeStamp[i] == update.timeStamp);
+    CHECK(buttons[i] == update.buttons);
+    CHECK(leftTrigger[i] == update.leftTrigger);
+    CHECK(rightTrigger[i] == update.rightTrigger);
+
+    for (int field=0; field<13; field++) {
+      if (fields[field][i] != Test_FieldValue(i, field)) {
+        fprintf(stderr, "report %zu field %d: %d instead of %d\n", i, field, fields[field][i], Test_FieldValue(i, field));
+        CHECK(fields[field][i] == Test_FieldValue(i, field));
+      }
+    }
+  }
+}
+
+int main() {
+  Test_DecodeUpdateBatch();
+  return Test_Result();
+}
@@ -0,0 +1,197 @@
+#include "test.h"
+
+static void Test_ReadEventsBatches() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  for (uint32_t i=0; i<5; i++)
+    Test_QueueUpdate(pLoopback, i, 0);
+
+  SteamControllerEvent  events[4];
+  bool                  morePending = false;
+
+  CHECK(SteamController_ReadEvents(pDevice, events, 4, &morePending) == 4);
+  CHECK(morePending);
+  CHECK(events[0].update.timeStamp == 0 && events[3].update.timeStamp == 3);
+
+  CHECK(SteamController_ReadEvents(pDevice, events, 4, &morePending) == 1);
+  CHECK(!morePending);
+  CHECK(events[0].update.timeStamp == 4);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** Filling the array exactly does not claim more input that is not there. */
+static void Test_ReadEventsExactFill() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  for (uint32_t i=0; i<4; i++)
+    Test_QueueUpdate(pLoopback, i, 0);
+
+  SteamControllerEvent  events[4];
+  bool                  morePending = true;
+
+  CHECK(SteamController_ReadEvents(pDevice, events, 4, &morePending) == 4);
+  CHECK(!morePending);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+static void Test_ReadEventsNoRoom() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  Test_QueueUpdate(pLoopback, 1, 0);
+
+  SteamControllerEvent  event;
+  bool                  morePending = true;
+
+  CHECK(SteamController_ReadEvents(pDevice, &event, 0, &morePending) == 0);
+  CHECK(!morePending);
+
+  // The report is still there.
+  CHECK(SteamController_ReadEvents(pDevice, &event, 1, &morePending) == 1);
+  CHECK(event.update.timeStamp == 1);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** Reports that do not decode are skipped without ending the batch. */
+static void Test_ReadEventsSkipsUnknown() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  uint8_t unknown[64] = { 0x01, 0x00, 0x05, 0x3c };
+  Test_QueueUpdate(pLoopback, 1, 0);
+  SteamController_LoopbackQueueReport(pLoopback, unknown, sizeof(unknown));
+  Test_QueueBattery(pLoopback, 3000);
+
+  SteamControllerEvent  events[8];
+  bool                  morePending = true;
+
+  CHECK(SteamController_ReadEvents(pDevice, events, 8, &morePending) == 2);
+  CHECK(!morePending);
+  CHECK(events[0].eventType == STEAMCONTROLLER_EVENT_UPDATE);
+  CHECK(events[1].eventType == STEAMCONTROLLER_EVENT_BATTERY);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** Edges are reported with the event that made them, a held button does not fire again. */
+static void Test_UpdateStateEdges() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  Test_QueueUpdate(pLoopback, 1, STEAMCONTROLLER_BUTTON_A);
+  Test_QueueUpdate(pLoopback, 2, STEAMCONTROLLER_BUTTON_A);
+  Test_QueueUpdate(pLoopback, 3, STEAMCONTROLLER_BUTTON_B);
+  Test_QueueBattery(pLoopback, 3000);
+
+  SteamControllerState  state;
+  SteamControllerEvent  event;
+  memset(&state, 0, sizeof(state));
+
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_UPDATE);
+  SteamController_UpdateState(&state, &event);
+  CHECK(state.pressedButtons == STEAMCONTROLLER_BUTTON_A);
+  CHECK(state.releasedButtons == 0);
+  CHECK(state.changedFields == STEAMCONTROLLER_FIELD_BUTTONS);
+
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_UPDATE);
+  SteamController_UpdateState(&state, &event);
+  CHECK(state.pressedButtons == 0);
+  CHECK(state.releasedButtons == 0);
+  CHECK(state.changedFields == 0);
+
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_UPDATE);
+  SteamController_UpdateState(&state, &event);
+  CHECK(state.pressedButtons == STEAMCONTROLLER_BUTTON_B);
+  CHECK(state.releasedButtons == STEAMCONTROLLER_BUTTON_A);
+  CHECK(state.changedFields == STEAMCONTROLLER_FIELD_BUTTONS);
+
+  // Other events clear the edges of the update before.
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_BATTERY);
+  SteamController_UpdateState(&state, &event);
+  CHECK(state.pressedButtons == 0);
+  CHECK(state.releasedButtons == 0);
+  CHECK(state.changedFields == STEAMCONTROLLER_FIELD_BATTERY);
+  CHECK(state.activeButtons == STEAMCONTROLLER_BUTTON_B);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** Changes of all events read are combined, fields outside the mask do not count. */
+static void Test_ReadChanges() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  SteamControllerState    state;
+  SteamControllerChanges  changes;
+  memset(&state, 0, sizeof(state));
+
+  // A tap within one batch is both pressed and released.
+  Test_QueueUpdate(pLoopback, 1, STEAMCONTROLLER_BUTTON_A);
+  Test_QueueUpdate(pLoopback, 2, 0);
+  Test_QueueUpdate(pLoopback, 3, STEAMCONTROLLER_BUTTON_X);
+  Test_QueueBattery(pLoopback, 3000);
+
+  CHECK(SteamController_ReadChanges(pDevice, &state, STEAMCONTROLLER_FIELD_BUTTONS, &changes));
+  CHECK(changes.eventCount == 4);
+  CHECK(!changes.morePending);
+  CHECK(changes.pressedButtons == (STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_X));
+  CHECK(changes.releasedButtons == STEAMCONTROLLER_BUTTON_A);
+  CHECK(changes.changedFields == (STEAMCONTROLLER_FIELD_BUTTONS | STEAMCONTROLLER_FIELD_BATTERY));
+  CHECK(state.activeButtons == STEAMCONTROLLER_BUTTON_X);
+
+  // Holding the button changes nothing.
+  Test_QueueUpdate(pLoopback, 4, STEAMCONTROLLER_BUTTON_X);
+  Test_QueueUpdate(pLoopback, 5, STEAMCONTROLLER_BUTTON_X);
+  Test_QueueBattery(pLoopback, 2900);
+
+  CHECK(!SteamController_ReadChanges(pDevice, &state, STEAMCONTROLLER_FIELD_BUTTONS, &changes));
+  CHECK(changes.eventCount == 3);
+  CHECK(changes.pressedButtons == 0);
+  CHECK(changes.releasedButtons == 0);
+  CHECK(changes.changedFields == STEAMCONTROLLER_FIELD_BATTERY);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** A device that never runs out of reports does not keep the caller forever. */
+static void Test_ReadChangesIsBounded() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  Test_QueueUpdate(pLoopback, 1, STEAMCONTROLLER_BUTTON_A);
+  Test_QueueUpdate(pLoopback, 2, 0);
+  SteamController_LoopbackSetLooping(pLoopback, true);
+
+  SteamControllerState    state;
+  SteamControllerChanges  changes;
+  memset(&state, 0, sizeof(state));
+
+  CHECK(SteamController_ReadChanges(pDevice, &state, STEAMCONTROLLER_FIELD_BUTTONS, &changes));
+  CHECK(changes.eventCount == STEAMCONTROLLER_READ_CHANGES_MAX_EVENTS);
+  CHECK(changes.morePending);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+int main() {
+  Test_ReadEventsBatches();
+  Test_ReadEventsExactFill();
+  Test_ReadEventsNoRoom();
+  Test_ReadEventsSkipsUnknown();
+  Test_UpdateStateEdges();
+  Test_ReadChanges();
+  Test_ReadChangesIsBounded();
+  return Test_Result();
+}
@@ -0,0 +1,90 @@
+#include "test.h"
+
+static SteamControllerEvent Test_UpdateEvent(uint32_t buttons, int16_t leftX, int16_t leftY) {
+  SteamControllerEvent event;
+  memset(&event, 0, sizeof(event));
+  event.eventType         = STEAMCONTROLLER_EVENT_UPDATE;
+  event.update.buttons    = buttons;
+  event.update.leftXY.x   = leftX;
+  event.update.leftXY.y   = leftY;
+  return event;
+}
+
+/** Without settings, values pass through unchanged. */
+static void Test_FilterPassThrough() {
+  SteamControllerFilter filter;
+  SteamController_InitFilter(&filter);
+
+  SteamControllerState state;
+  memset(&state, 0, sizeof(state));
+
+  SteamControllerEvent event = Test_UpdateEvent(0, 12000, -8000);
+  event.update.leftTrigger  = 100;
+  event.update.rightXY.x    = -3000;
+  SteamController_UpdateFilteredState(&filter, &state, &event, 0.004f);
+
+  CHECK(state.stick.x == 12000);
+  CHECK(state.stick.y == -8000);
+  CHECK(state.rightPad.x == -3000);
+  CHECK(state.leftTrigger == 100);
+}
+
+/** A radial deadzone swallows small stick movements and rescales the rest. */
+static void Test_FilterDeadzone() {
+  SteamControllerFilter filter;
+  SteamController_InitFilter(&filter);
+  filter.axes[STEAMCONTROLLER_FILTER_STICK].innerDeadzone = 0.2f;
+
+  SteamControllerState state;
+  memset(&state, 0, sizeof(state));
+
+  SteamControllerEvent event = Test_UpdateEvent(0, 3000, 0);
+  SteamController_UpdateFilteredState(&filter, &state, &event, 0.004f);
+  CHECK(state.stick.x == 0);
+
+  event = Test_UpdateEvent(0, 32767, 0);
+  SteamController_UpdateFilteredState(&filter, &state, &event, 0.004f);
+  CHECK(state.stick.x == 32767);
+}
+
+/**
+ * Send a pad report, a stick report and another pad report.
+ * @return Left pad x after the second pad report.
+ */
+static int16_t Test_FilterPadAcrossStickReport(uint32_t stickFlags) {
+  SteamControllerFilter filter;
+  SteamController_InitFilter(&filter);
+  filter.axes[STEAMCONTROLLER_FILTER_LEFT_PAD].minCutoff = 1.0f;
+
+  SteamControllerState state;
+  memset(&state, 0, sizeof(state));
+
+  SteamControllerEvent event = Test_UpdateEvent(STEAMCONTROLLER_BUTTON_LFINGER | STEAMCONTROLLER_FLAG_PAD_STICK, 10000, 0);
+  SteamController_UpdateFilteredState(&filter, &state, &event, 0.004f);
+  CHECK(state.leftPad.x == 10000);
+
+  event = Test_UpdateEvent(stickFlags, 500, 500);
+  SteamController_UpdateFilteredState(&filter, &state, &event, 0.004f);
+
+  event = Test_UpdateEvent(STEAMCONTROLLER_BUTTON_LFINGER | STEAMCONTROLLER_FLAG_PAD_STICK, 20000, 0);
+  SteamController_UpdateFilteredState(&filter, &state, &event, 0.004f);
+  return state.leftPad.x;
+}
+
+/**
+ * Stick reports in between pad reports don't restart the smoothing of the pad,
+ * lifting the thumb does.
+ */
+static void Test_FilterPadStick() {
+  int16_t x = Test_FilterPadAcrossStickReport(STEAMCONTROLLER_FLAG_PAD_STICK);
+  CHECK(x > 10000 && x < 20000);
+
+  CHECK(Test_FilterPadAcrossStickReport(0) == 20000);
+}
+
+int main() {
+  Test_FilterPassThrough();
+  Test_FilterDeadzone();
+  Test_FilterPadStick();
+  return Test_Result();
+}
@@ -0,0 +1,143 @@
+#include "test.h"
+
+#define TEST_REPORT_COUNT   14    /**< Three blocks of four and two reports left over. */
+#define TEST_EPSILON        1e-5f
+
+static float Test_Abs(float value) {
+  return value < 0.0f ? -value : value;
+}
+
+static bool Test_QuaternionsMatch(const SteamControllerQuaternion *pA, const SteamControllerQuaternion *pB, float epsilon) {
+  return Test_Abs(pA->w - pB->w) <= epsilon && Test_Abs(pA->x - pB->x) <= epsilon
+      && Test_Abs(pA->y - pB->y) <= epsilon && Test_Abs(pA->z - pB->z) <= epsilon;
+}
+
+/** Gravity in sensor coordinates as seen by an orientation estimate. */
+static SteamControllerQuaternion Test_EstimatedGravity(const SteamControllerQuaternion *pQ) {
+  SteamControllerQuaternion gravity;
+  gravity.w = 0.0f;
+  gravity.x = 2.0f * (pQ->x * pQ->z - pQ->w * pQ->y);
+  gravity.y = 2.0f * (pQ->w * pQ->x + pQ->y * pQ->z);
+  gravity.z = pQ->w * pQ->w - pQ->x * pQ->x - pQ->y * pQ->y + pQ->z * pQ->z;
+  return gravity;
+}
+
+/** Device orientations converted four at a time match the conversion of single updates. */
+static void Test_FusionBatchMatchesUpdates() {
+  static const int16_t Orientations[TEST_REPORT_COUNT][3] = {
+    {      0,      0,      0 },
+    {  16000,      0,      0 },
+    {      0, -16000,      0 },
+    {      0,      0,  32767 },
+    {  32767,  32767,  32767 },   // Too long, normalized.
+    { -20000,  10000,  -5000 },
+    {    100,   -200,    300 },
+    { -32768, -32768, -32768 },   // Too long, normalized.
+    {  12345,  -2345,  23456 },
+    {      0,      0,      0 },   // Not an update.
+    {  -1000,  30000,   4000 },
+    {  23169,  23169,      0 },
+    {      1,     -1,      1 },
+    {   9000,   9000,  -9000 },
+  };
+
+  uint8_t   eventType[TEST_REPORT_COUNT];
+  int16_t   fields[13][TEST_REPORT_COUNT];
+  memset(fields, 0, sizeof(fields));
+
+  SteamControllerUpdateBatch batch = {
+    eventType, NULL, NULL, NULL, NULL,
+    fields[0], fields[1], fields[2], fields[3],
+    fields[4], fields[5], fields[6],
+    fields[7], fields[8], fields[9],
+    fields[10], fields[11], fields[12],
+  };
+
+  for (size_t i=0; i<TEST_REPORT_COUNT; i++) {
+    eventType[i]  = i == 9 ? STEAMCONTROLLER_EVENT_BATTERY : STEAMCONTROLLER_EVENT_UPDATE;
+    fields[10][i] = Orientations[i][0];
+    fields[11][i] = Orientations[i][1];
+    fields[12][i] = Orientations[i][2];
+  }
+
+  SteamControllerFusion batchFusion, singleFusion;
+  SteamController_InitFusion(&batchFusion, STEAMCONTROLLER_FUSION_DEVICE, 0.0f);
+  SteamController_InitFusion(&singleFusion, STEAMCONTROLLER_FUSION_DEVICE, 0.0f);
+
+  SteamControllerQuaternion orientations[TEST_REPORT_COUNT];
+  SteamController_FusionUpdateBatch(&batchFusion, &batch, TEST_REPORT_COUNT, 0.01f, orientations);
+
+  for (size_t i=0; i<TEST_REPORT_COUNT; i++) {
+    if (eventType[i] == STEAMCONTROLLER_EVENT_UPDATE) {
+      SteamControllerUpdateEvent update;
+      memset(&update, 0, sizeof(update));
+      update.orientation.x = Orientations[i][0];
+      update.orientation.y = Orientations[i][1];
+      update.orientation.z = Orientations[i][2];
+      SteamController_FusionUpdate(&singleFusion, &update, 0.01f);
+    }
+
+    if (!Test_QuaternionsMatch(&orientations[i], &singleFusion.orientation, TEST_EPSILON)) {
+      fprintf(stderr, "report %zu: %f %f %f %f instead of %f %f %f %f\n", i,
+        orientations[i].w, orientations[i].x, orientations[i].y, orientations[i].z,
+        singleFusion.orientation.w, singleFusion.orientation.x, singleFusion.orientation.y, singleFusion.orientation.z);
+      CHECK(Test_QuaternionsMatch(&orientations[i], &singleFusion.orientation, TEST_EPSILON));
+    }
+  }
+
+  CHECK(batchFusion.updateCount == singleFusion.updateCount);
+  CHECK(Test_QuaternionsMatch(&batchFusion.orientation, &singleFusion.orientation, TEST_EPSILON));
+}
+
+/** The first update starts the filter at the measured gravity. */
+static void Test_FusionGravityInit() {
+  SteamControllerFusion fusion;
+  SteamController_InitFusion(&fusion, STEAMCONTROLLER_FUSION_MADGWICK, 0.0f);
+
+  SteamControllerUpdateEvent update;
+  memset(&update, 0, sizeof(update));
+  update.acceleration.x = 6000;
+  update.acceleration.y = -8000;
+  update.acceleration.z = 12000;    // 6000 * 6000 + 8000 * 8000 + 12000 * 12000 is 15620.5 squared.
+  SteamController_FusionUpdate(&fusion, &update, 0.01f);
+
+  SteamControllerQuaternion gravity = Test_EstimatedGravity(&fusion.orientation);
+  CHECK(Test_Abs(gravity.x -  6000.0f / 15620.5f) < 1e-4f);
+  CHECK(Test_Abs(gravity.y + 8000.0f / 15620.5f) < 1e-4f);
+  CHECK(Test_Abs(gravity.z - 12000.0f / 15620.5f) < 1e-4f);
+}
+
+/** A controller lying still converges to the orientation its gravity gives, and stays there. */
+static void Test_FusionStationaryConverges() {
+  SteamControllerFusion fusion;
+  SteamController_InitFusion(&fusion, STEAMCONTROLLER_FUSION_MADGWICK, 0.0f);
+
+  // Starts flat...
+  SteamControllerUpdateEvent update;
+  memset(&update, 0, sizeof(update));
+  update.acceleration.z = (int16_t)STEAMCONTROLLER_ACCELERATION_PER_G;
+  SteamController_FusionUpdate(&fusion, &update, 0.01f);
+  CHECK(Test_QuaternionsMatch(&fusion.orientation, &(SteamControllerQuaternion){ 1.0f, 0.0f, 0.0f, 0.0f }, TEST_EPSILON));
+
+  // ...then lies still tilted by 30 degrees about x, for a minute.
+  update.acceleration.y = (int16_t)(0.5f * STEAMCONTROLLER_ACCELERATION_PER_G);
+  update.acceleration.z = (int16_t)(0.8660254f * STEAMCONTROLLER_ACCELERATION_PER_G);
+  for (int i=0; i<6000; i++)
+    SteamController_FusionUpdate(&fusion, &update, 0.01f);
+
+  // Rotation by 30 degrees about x: cos(15), sin(15).
+  SteamControllerQuaternion expected = { 0.9659258f, 0.2588190f, 0.0f, 0.0f };
+  CHECK(Test_QuaternionsMatch(&fusion.orientation, &expected, 1e-3f));
+
+  SteamControllerQuaternion gravity = Test_EstimatedGravity(&fusion.orientation);
+  CHECK(Test_Abs(gravity.x) < 1e-3f);
+  CHECK(Test_Abs(gravity.y - 0.5f) < 1e-3f);
+  CHECK(Test_Abs(gravity.z - 0.8660254f) < 1e-3f);
+}
+
+int main() {
+  Test_FusionBatchMatchesUpdates();
+  Test_FusionGravityInit();
+  Test_FusionStationaryConverges();
+  return Test_Result();
+}
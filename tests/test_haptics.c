@@ -0,0 +1,96 @@
+#include "test.h"
+
+#if __linux__
+
+#include <unistd.h>
+
+#define TEST_TRIGGER_HAPTIC_PULSE   0x8f
+
+static uint16_t Test_LoadU16(const uint8_t *pSource) {
+  return (uint16_t)(pSource[0] | (pSource[1] << 8));
+}
+
+/**
+ * Bursts go out in order, one report each, pauses send nothing. Playing the
+ * same pattern again while it runs does not restart it.
+ */
+static void Test_HapticPatternSequence() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  SteamController_LoopbackClearFeatureReports(pLoopback);
+
+  static const SteamControllerHapticSegment Segments[] = {
+    { 100, 200, 10, 50 },
+    {   0,   0,  0, 50 },   // Pause.
+    { 300, 400,  5, 50 },
+    { 500, 600,  1, 50 },
+  };
+
+  CHECK(SteamController_PlayHapticPattern(pDevice, 1, Segments, 4));
+  CHECK(SteamController_PlayHapticPattern(pDevice, 1, Segments, 4));
+  CHECK(!SteamController_PlayHapticPattern(pDevice, 2, Segments, 4));
+  CHECK(!SteamController_PlayHapticPattern(pDevice, 1, Segments, 0));
+
+  // The whole pattern takes 200ms.
+  usleep(500000);
+  CHECK(SteamController_GetHapticDropCount(pDevice) == 0);
+
+  // Closing waits for the sequencer and the command queue, the loopback is
+  // only read once they are gone.
+  SteamController_Close(pDevice);
+
+  static const uint16_t Expected[][3] = { { 100, 200, 10 }, { 300, 400, 5 }, { 500, 600, 1 } };
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) == 3);
+
+  for (size_t i=0; i<3 && i<SteamController_LoopbackGetFeatureReportCount(pLoopback); i++) {
+    const uint8_t *pReport = SteamController_LoopbackGetFeatureReport(pLoopback, i);
+    CHECK(pReport[1] == TEST_TRIGGER_HAPTIC_PULSE);
+    CHECK(pReport[3] == 1);
+    CHECK(Test_LoadU16(pReport + 4) == Expected[i][0]);
+    CHECK(Test_LoadU16(pReport + 6) == Expected[i][1]);
+    CHECK(Test_LoadU16(pReport + 8) == Expected[i][2]);
+  }
+
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** A stopped pattern sends nothing more. */
+static void Test_HapticPatternStop() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  SteamController_LoopbackClearFeatureReports(pLoopback);
+
+  static const SteamControllerHapticSegment Segments[] = {
+    { 100, 200, 10, 200 },
+    { 300, 400,  5, 200 },
+  };
+
+  CHECK(SteamController_PlayHapticPattern(pDevice, 0, Segments, 2));
+  usleep(50000);
+  SteamController_StopHapticPattern(pDevice, 0);
+  usleep(300000);
+
+  SteamController_Close(pDevice);
+
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) == 1);
+  if (SteamController_LoopbackGetFeatureReportCount(pLoopback))
+    CHECK(Test_LoadU16(SteamController_LoopbackGetFeatureReport(pLoopback, 0) + 4) == 100);
+
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+int main() {
+  // The loopback has no response for the queries made when opening it.
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  Test_HapticPatternSequence();
+  Test_HapticPatternStop();
+  return Test_Result();
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,207 @@
+#define _GNU_SOURCE     // nftw
+
+#include "test.h"
+
+#if __linux__
+
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <ftw.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define TEST_HID_PARENT   "/devices/pci0000:00/0000:00:14.0/usb1/1-2/1-2:1.1"
+
+typedef struct {
+  uint32_t  deviceId;
+  unsigned  action;
+  char      devicePath[64];
+} TestHotplugNotification;
+
+static TestHotplugNotification  Test_Notifications[16];
+static size_t                   Test_NotificationCount;
+
+static void Test_HotplugCallback(uint32_t deviceId, unsigned action, const char *pDevicePath, void *pUserData) {
+  (void)pUserData;
+  if (Test_NotificationCount == sizeof(Test_Notifications) / sizeof(Test_Notifications[0]))
+    return;
+
+  TestHotplugNotification *pNotification = Test_Notifications + Test_NotificationCount++;
+  pNotification->deviceId = deviceId;
+  pNotification->action   = action;
+  snprintf(pNotification->devicePath, sizeof(pNotification->devicePath), "%s", pDevicePath);
+}
+
+static void Test_MakeDirs(const char *pPath) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s", pPath);
+  for (char *p=path + 1; *p; p++) {
+    if (*p == '/') {
+      *p = 0;
+      mkdir(path, 0755);
+      *p = '/';
+    }
+  }
+  mkdir(path, 0755);
+}
+
+/**
+ * Create a hid device with one hidraw node below the fake sysfs root, the way
+ * the kernel lays it out, and link it from the hid bus.
+ */
+static void Test_AddHidDevice(const char *pRoot, const char *pHidName, int hidrawNumber, bool isVendorPage) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s" TEST_HID_PARENT "/%s/hidraw/hidraw%d", pRoot, pHidName, hidrawNumber);
+  Test_MakeDirs(path);
+
+  snprintf(path, sizeof(path), "%s" TEST_HID_PARENT "/%s/report_descriptor", pRoot, pHidName);
+  FILE *pFile = fopen(path, "wb");
+  CHECK(pFile != NULL);
+  if (pFile) {
+    static const uint8_t VendorPage[] = { 0x06, 0x00, 0xff, 0x09, 0x01 };
+    static const uint8_t GenericPage[] = { 0x05, 0x01, 0x09, 0x02, 0xa1 };
+    fwrite(isVendorPage ? VendorPage : GenericPage, 1, 5, pFile);
+    fclose(pFile);
+  }
+
+  char busPath[4096];
+  snprintf(busPath, sizeof(busPath), "%s/bus/hid/devices", pRoot);
+  Test_MakeDirs(busPath);
+
+  snprintf(path, sizeof(path), "../../../devices/pci0000:00/0000:00:14.0/usb1/1-2/1-2:1.1/%s", pHidName);
+  snprintf(busPath, sizeof(busPath), "%s/bus/hid/devices/%s", pRoot, pHidName);
+  CHECK(symlink(path, busPath) == 0);
+}
+
+static void Test_RemoveHidDevice(const char *pRoot, const char *pHidName, int hidrawNumber) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/bus/hid/devices/%s", pRoot, pHidName);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s" TEST_HID_PARENT "/%s/hidraw/hidraw%d", pRoot, pHidName, hidrawNumber);
+  rmdir(path);
+}
+
+/** Build a uevent in the kernel format. @return Its length. */
+static size_t Test_BuildUevent(char *pBuffer, size_t size, const char *pAction, const char *pHidName, int hidrawNumber) {
+  char devPath[512];
+  snprintf(devPath, sizeof(devPath), TEST_HID_PARENT "/%s/hidraw/hidraw%d", pHidName, hidrawNumber);
+
+  int len = snprintf(pBuffer, size, "%s@%s", pAction, devPath) + 1;
+  len += snprintf(pBuffer + len, size - len, "ACTION=%s", pAction) + 1;
+  len += snprintf(pBuffer + len, size - len, "DEVPATH=%s", devPath) + 1;
+  len += snprintf(pBuffer + len, size - len, "SUBSYSTEM=hidraw") + 1;
+  len += snprintf(pBuffer + len, size - len, "DEVNAME=hidraw%d", hidrawNumber) + 1;
+  return (size_t)len;
+}
+
+/** Rewrite a kernel uevent in the format udev rebroadcasts it. @return Its length. */
+static size_t Test_BuildUdevEvent(char *pBuffer, const char *pUevent, size_t len) {
+  size_t headerLen  = strlen(pUevent) + 1;
+  uint32_t header[10];
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, "libudev", 8);
+  header[2] = htonl(0xfeedcafe);
+  header[3] = sizeof(header);
+  header[4] = sizeof(header);
+  header[5] = (uint32_t)(len - headerLen);
+
+  memcpy(pBuffer, header, sizeof(header));
+  memcpy(pBuffer + sizeof(header), pUevent + headerLen, len - headerLen);
+  return sizeof(header) + len - headerLen;
+}
+
+static int Test_RemoveFile(const char *pPath, const struct stat *pStat, int type, struct FTW *pFtw) {
+  (void)pStat; (void)type; (void)pFtw;
+  return remove(pPath);
+}
+
+/** Devices come and go through uevents against a fake sysfs tree. */
+static void Test_HotplugUevents(const char *pRoot) {
+  Test_AddHidDevice(pRoot, "0003:28DE:1142.0001", 1, true);
+
+  SteamControllerRegistry *pRegistry = SteamController_CreateRegistry(pRoot, 0, Test_HotplugCallback, NULL);
+  CHECK(pRegistry != NULL);
+  if (!pRegistry)
+    return;
+
+  // Found by the initial scan.
+  CHECK(SteamController_RegistryDispatch(pRegistry) == 1);
+  CHECK(Test_NotificationCount == 1);
+  CHECK(Test_Notifications[0].deviceId == 1);
+  CHECK(Test_Notifications[0].action == STEAMCONTROLLER_HOTPLUG_ADD);
+  CHECK(!strcmp(Test_Notifications[0].devicePath, "/dev/hidraw1"));
+
+  char uevent[1024];
+  char udevEvent[1024];
+  size_t len;
+
+  // A dongle in bootloader mode.
+  Test_NotificationCount = 0;
+  Test_AddHidDevice(pRoot, "0003:28DE:1042.0002", 2, true);
+  len = Test_BuildUevent(uevent, sizeof(uevent), "add", "0003:28DE:1042.0002", 2);
+  CHECK(SteamController_RegistryInjectUevent(pRegistry, uevent, len));
+  CHECK(Test_NotificationCount == 1);
+  CHECK(Test_Notifications[0].deviceId == 2);
+  CHECK(Test_Notifications[0].action == STEAMCONTROLLER_HOTPLUG_ADD);
+  CHECK(!strcmp(Test_Notifications[0].devicePath, "/dev/hidraw2"));
+
+  // Other devices are ignored.
+  Test_NotificationCount = 0;
+  Test_AddHidDevice(pRoot, "0003:046D:C52B.0003", 3, false);
+  len = Test_BuildUevent(uevent, sizeof(uevent), "add", "0003:046D:C52B.0003", 3);
+  CHECK(!SteamController_RegistryInjectUevent(pRegistry, uevent, len));
+  CHECK(Test_NotificationCount == 0);
+
+  // Removed, its sysfs entries are gone by the time the uevent arrives.
+  Test_RemoveHidDevice(pRoot, "0003:28DE:1142.0001", 1);
+  len = Test_BuildUevent(uevent, sizeof(uevent), "remove", "0003:28DE:1142.0001", 1);
+  CHECK(SteamController_RegistryInjectUevent(pRegistry, uevent, len));
+  CHECK(Test_NotificationCount == 1);
+  CHECK(Test_Notifications[0].deviceId == 1);
+  CHECK(Test_Notifications[0].action == STEAMCONTROLLER_HOTPLUG_REMOVE);
+  CHECK(!strcmp(Test_Notifications[0].devicePath, "/dev/hidraw1"));
+
+  // Plugged in again, as udev passes it on. It keeps its id.
+  Test_NotificationCount = 0;
+  Test_AddHidDevice(pRoot, "0003:28DE:1142.0001", 1, true);
+  len = Test_BuildUevent(uevent, sizeof(uevent), "add", "0003:28DE:1142.0001", 1);
+  len = Test_BuildUdevEvent(udevEvent, uevent, len);
+  CHECK(SteamController_RegistryInjectUevent(pRegistry, udevEvent, len));
+  CHECK(Test_NotificationCount == 1);
+  CHECK(Test_Notifications[0].deviceId == 1);
+  CHECK(Test_Notifications[0].action == STEAMCONTROLLER_HOTPLUG_ADD);
+
+  // A udev header that claims more than there is.
+  Test_NotificationCount = 0;
+  ((uint32_t *)udevEvent)[5] = 4096;
+  CHECK(!SteamController_RegistryInjectUevent(pRegistry, udevEvent, len));
+  CHECK(Test_NotificationCount == 0);
+
+  uint32_t deviceIds[4];
+  CHECK(SteamController_RegistryGetDevices(pRegistry, deviceIds, 4) == 2);
+
+  SteamController_DestroyRegistry(pRegistry);
+}
+
+int main() {
+  char root[] = "/tmp/steamcontroller-test-sysfs-XXXXXX";
+  if (!mkdtemp(root)) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  Test_HotplugUevents(root);
+
+  nftw(root, Test_RemoveFile, 16, FTW_DEPTH | FTW_PHYS);
+  return Test_Result();
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include "test.h"
+#include "common.h"
+
+/** Percentiles land on the upper bound of their bucket, but never beyond the maximum. */
+static void Test_HistogramPercentiles() {
+  static SteamControllerHistogram histogram;
+  SteamControllerLatencyStats     stats;
+
+  SteamController_HistogramGetStats(&histogram, &stats);
+  CHECK(stats.count == 0 && stats.p50 == 0 && stats.p99 == 0 && stats.max == 0);
+
+  // Below 16 ns every latency has a bucket of its own.
+  for (int i=0; i<98; i++)
+    SteamController_HistogramRecord(&histogram, 10);
+
+  // 1000 is 31 * 32 + 8, its bucket holds 992 to 1023.
+  SteamController_HistogramRecord(&histogram, 1000);
+  SteamController_HistogramRecord(&histogram, 100000);
+
+  SteamController_HistogramGetStats(&histogram, &stats);
+  CHECK(stats.count == 100);
+  CHECK(stats.p50 == 10);
+  CHECK(stats.p90 == 10);
+  CHECK(stats.p99 == 1023);
+  CHECK(stats.max == 100000);
+  CHECK(stats.mean == (98 * 10 + 1000 + 100000) / 100);
+
+  SteamController_HistogramReset(&histogram);
+  SteamController_HistogramGetStats(&histogram, &stats);
+  CHECK(stats.count == 0 && stats.max == 0);
+
+  // The bucket of 1000 goes up to 1023, the maximum is lower.
+  for (int i=0; i<10; i++)
+    SteamController_HistogramRecord(&histogram, 1000);
+
+  SteamController_HistogramGetStats(&histogram, &stats);
+  CHECK(stats.p50 == 1000);
+  CHECK(stats.p99 == 1000);
+  CHECK(stats.max == 1000);
+
+  // Beyond the last power of two everything shares the last bucket.
+  SteamController_HistogramReset(&histogram);
+  SteamController_HistogramRecord(&histogram, (uint64_t)1 << 50);
+  SteamController_HistogramGetStats(&histogram, &stats);
+  CHECK(stats.count == 1);
+  CHECK(stats.p50 == (uint64_t)1 << 50);
+  CHECK(stats.p99 == (uint64_t)1 << 50);
+}
+
+/** Every percentile is within a sixteenth of the latency it stands for. */
+static void Test_HistogramPrecision() {
+  static SteamControllerHistogram histogram;
+  SteamControllerLatencyStats     stats;
+
+  for (uint64_t latency=17; latency<((uint64_t)1 << 40); latency=latency * 3 + 1) {
+    SteamController_HistogramReset(&histogram);
+    SteamController_HistogramRecord(&histogram, latency);
+    SteamController_HistogramRecord(&histogram, latency * 2);
+
+    SteamController_HistogramGetStats(&histogram, &stats);
+    CHECK(stats.p50 >= latency && stats.p50 - latency <= latency / 16);
+    CHECK(stats.p99 == latency * 2);
+    CHECK(stats.max == latency * 2);
+  }
+}
+
+int main() {
+  Test_HistogramPercentiles();
+  Test_HistogramPrecision();
+  return Test_Result();
+}
@@ -0,0 +1,87 @@
+#include "test.h"
+
+/** Read every queued report so the link statistics see them. */
+static void Test_DrainEvents(SteamControllerDevice *pDevice) {
+  SteamControllerEvent  events[16];
+  bool                  morePending = true;
+
+  while (morePending)
+    SteamController_ReadEvents(pDevice, events, 16, &morePending);
+}
+
+/** Only a late report that fills a gap is a reorder, one seen before is a duplicate. */
+static void Test_LinkReorder() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  CHECK(SteamController_EnableLinkStats(pDevice, true));
+
+  // The counter advances by 2 per report, 6 arrives late.
+  static const uint32_t TimeStamps[] = { 0, 2, 4, 8, 6, 6, 4, 10, 12 };
+  for (size_t i=0; i<sizeof(TimeStamps) / sizeof(TimeStamps[0]); i++)
+    Test_QueueUpdate(pLoopback, TimeStamps[i], 0);
+  Test_DrainEvents(pDevice);
+
+  SteamControllerLinkStats stats;
+  CHECK(SteamController_GetLinkStats(pDevice, &stats));
+  CHECK(stats.receivedCount == 9);
+  CHECK(stats.gapCount == 1);
+  CHECK(stats.lostCount == 0);
+  CHECK(stats.reorderCount == 1);
+  CHECK(stats.duplicateCount == 2);
+  CHECK(stats.restartCount == 0);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** A single short advance of the counter does not change what one report is. */
+static void Test_LinkStepEstimate() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  CHECK(SteamController_EnableLinkStats(pDevice, true));
+
+  for (uint32_t timeStamp=0; timeStamp<=40; timeStamp+=2)
+    Test_QueueUpdate(pLoopback, timeStamp, 0);
+  for (uint32_t timeStamp=41; timeStamp<=61; timeStamp+=2)
+    Test_QueueUpdate(pLoopback, timeStamp, 0);
+  Test_DrainEvents(pDevice);
+
+  SteamControllerLinkStats stats;
+  CHECK(SteamController_GetLinkStats(pDevice, &stats));
+  CHECK(stats.lostCount == 0);
+  CHECK(stats.gapCount == 0);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** A counter that jumps far back started over, it does not make later reports late. */
+static void Test_LinkBackwardJump() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  CHECK(SteamController_EnableLinkStats(pDevice, true));
+
+  for (uint32_t timeStamp=100000; timeStamp<=100010; timeStamp++)
+    Test_QueueUpdate(pLoopback, timeStamp, 0);
+  for (uint32_t timeStamp=0; timeStamp<=10; timeStamp++)
+    Test_QueueUpdate(pLoopback, timeStamp, 0);
+  Test_DrainEvents(pDevice);
+
+  SteamControllerLinkStats stats;
+  CHECK(SteamController_GetLinkStats(pDevice, &stats));
+  CHECK(stats.receivedCount == 22);
+  CHECK(stats.restartCount == 1);
+  CHECK(stats.reorderCount == 0);
+  CHECK(stats.duplicateCount == 0);
+  CHECK(stats.lostCount == 0);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+int main() {
+  Test_LinkReorder();
+  Test_LinkStepEstimate();
+  Test_LinkBackwardJump();
+  return Test_Result();
+}
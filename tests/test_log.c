@@ -0,0 +1,82 @@
+#include "test.h"
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct {
+  unsigned  messageCount;
+  unsigned  level;
+  uint32_t  suppressedCount;
+} TestLogSink;
+
+static void Test_LogCallback(unsigned level, const char *pMessage, uint32_t suppressedCount, void *pUserData) {
+  TestLogSink *pSink = (TestLogSink *)pUserData;
+  (void)pMessage;
+  pSink->messageCount++;
+  pSink->level            = level;
+  pSink->suppressedCount  = suppressedCount;
+}
+
+/** Log one error, always from the same site of the library. */
+static void Test_LogFromSite() {
+  SteamControllerRemapProfile profile;
+  SteamController_InitRemapProfile(&profile);
+  profile.chordCount = STEAMCONTROLLER_REMAP_MAX_CHORDS + 1;
+  CHECK(SteamController_CompileRemapProfile(&profile) == NULL);
+}
+
+/** Messages below the level are neither passed on nor counted against the limit. */
+static void Test_LogLevel() {
+  TestLogSink sink = { 0, 0, 0 };
+  SteamController_SetLogCallback(Test_LogCallback, &sink);
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+
+  uint64_t suppressedCount = SteamController_GetSuppressedLogCount();
+  for (int i=0; i<2 * STEAMCONTROLLER_LOG_BURST; i++)
+    Test_LogFromSite();
+
+  CHECK(sink.messageCount == 0);
+  CHECK(SteamController_GetSuppressedLogCount() == suppressedCount);
+
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_WARNING);
+  SteamController_SetLogCallback(NULL, NULL);
+}
+
+/**
+ * A site logs a burst of messages per interval, the rest is counted and
+ * reported with its first message of the next interval.
+ */
+static void Test_LogRateLimit() {
+  TestLogSink sink = { 0, 0, 0 };
+  SteamController_SetLogCallback(Test_LogCallback, &sink);
+
+  uint64_t suppressedCount = SteamController_GetSuppressedLogCount();
+  for (int i=0; i<STEAMCONTROLLER_LOG_BURST + 5; i++)
+    Test_LogFromSite();
+
+  CHECK(sink.messageCount == STEAMCONTROLLER_LOG_BURST);
+  CHECK(sink.level == STEAMCONTROLLER_LOG_ERROR);
+  CHECK(sink.suppressedCount == 0);
+  CHECK(SteamController_GetSuppressedLogCount() == suppressedCount + 5);
+
+#if _WIN32
+  Sleep((DWORD)(STEAMCONTROLLER_LOG_INTERVAL / 1000000) + 100);
+#else
+  usleep((useconds_t)(STEAMCONTROLLER_LOG_INTERVAL / 1000) + 100000);
+#endif
+
+  Test_LogFromSite();
+  CHECK(sink.messageCount == STEAMCONTROLLER_LOG_BURST + 1);
+  CHECK(sink.suppressedCount == 5);
+
+  SteamController_SetLogCallback(NULL, NULL);
+}
+
+int main() {
+  Test_LogLevel();
+  Test_LogRateLimit();
+  return Test_Result();
+}
@@ -0,0 +1,122 @@
+#include "test.h"
+
+/** Reports are read back in order and decoded into events. */
+static void Test_ReadEvents() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  CHECK(pDevice != NULL);
+
+  SteamControllerUpdateEvent update;
+  memset(&update, 0, sizeof(update));
+  update.timeStamp          = 0x12345678;
+  update.buttons            = STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_RG;
+  update.leftTrigger        = 10;
+  update.rightTrigger       = 250;
+  update.leftXY.x           = -32768;
+  update.leftXY.y           = 32767;
+  update.rightXY.x          = 100;
+  update.rightXY.y          = -100;
+  update.acceleration.z     = 16384;
+  update.angularVelocity.x  = -5;
+  update.orientation.y      = 1234;
+
+  uint8_t report[64];
+  Test_BuildUpdateReport(report, &update);
+  SteamController_LoopbackQueueReport(pLoopback, report, sizeof(report));
+  Test_QueueBattery(pLoopback, 2900);
+  Test_QueueConnection(pLoopback, STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED);
+
+  SteamControllerEvent event;
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_UPDATE);
+  CHECK(event.update.timeStamp == 0x12345678);
+  CHECK(event.update.buttons == (STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_RG));
+  CHECK(event.update.leftTrigger == 10 && event.update.rightTrigger == 250);
+  CHECK(event.update.leftXY.x == -32768 && event.update.leftXY.y == 32767);
+  CHECK(event.update.rightXY.x == 100 && event.update.rightXY.y == -100);
+  CHECK(event.update.acceleration.z == 16384);
+  CHECK(event.update.angularVelocity.x == -5);
+  CHECK(event.update.orientation.y == 1234);
+
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_BATTERY);
+  CHECK(event.battery.voltage == 2900);
+
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_CONNECTION);
+  CHECK(event.connection.details == STEAMCONTROLLER_CONNECTION_EVENT_DISCONNECTED);
+
+  CHECK(SteamController_ReadEvent(pDevice, &event) == 0);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** A leading zero byte, as some hidraw backends deliver it, is skipped. */
+static void Test_LeadingZero() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  uint8_t report[65] = { 0x00, 0x01, 0x00, STEAMCONTROLLER_EVENT_BATTERY, 0x0b };
+  report[0x0d] = 0x34;
+  report[0x0e] = 0x12;
+  SteamController_LoopbackQueueReport(pLoopback, report, sizeof(report));
+
+  SteamControllerEvent event;
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_BATTERY);
+  CHECK(event.battery.voltage == 0x1234);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+static void Test_Looping() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  Test_QueueUpdate(pLoopback, 1, 0);
+  Test_QueueUpdate(pLoopback, 2, 0);
+  SteamController_LoopbackSetLooping(pLoopback, true);
+
+  SteamControllerEvent event;
+  uint32_t timeStamps[5];
+  for (int i=0; i<5; i++) {
+    CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_UPDATE);
+    timeStamps[i] = event.update.timeStamp;
+  }
+  CHECK(timeStamps[0] == 1 && timeStamps[1] == 2 && timeStamps[2] == 1 && timeStamps[3] == 2 && timeStamps[4] == 1);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** Feature reports are recorded, get requests are answered with canned responses. */
+static void Test_FeatureReports() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) > 0);
+  SteamController_LoopbackClearFeatureReports(pLoopback);
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) == 0);
+  CHECK(SteamController_LoopbackGetFeatureReport(pLoopback, 0) == NULL);
+
+  CHECK(SteamController_TriggerHaptic(pDevice, 1, 500, 600, 3));
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) == 1);
+
+  const uint8_t *pReport = SteamController_LoopbackGetFeatureReport(pLoopback, 0);
+  CHECK(pReport != NULL);
+  if (pReport) {
+    CHECK(pReport[1] == 0x8f);
+    CHECK(pReport[2] == 7);
+    CHECK(pReport[3] == 1);
+    CHECK(pReport[4] == (500 & 0xff));
+  }
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+int main() {
+  Test_ReadEvents();
+  Test_LeadingZero();
+  Test_Looping();
+  Test_FeatureReports();
+  return Test_Result();
+}
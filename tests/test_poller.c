@@ -0,0 +1,188 @@
+#include "test.h"
+
+#if __linux__
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define TEST_REPORT_SIZE  64
+
+/** Transport reading input reports from a pipe, one report per read like hidraw. */
+typedef struct {
+  int fds[2];
+} TestPipe;
+
+static uint8_t Test_PipeReadRaw(void *pContext, uint8_t *pBuffer, uint8_t maxLen) {
+  ssize_t len = read(((TestPipe *)pContext)->fds[0], pBuffer, maxLen < TEST_REPORT_SIZE ? maxLen : TEST_REPORT_SIZE);
+  return len > 0 ? (uint8_t)len : 0;
+}
+
+static bool Test_PipeSetFeatureReport(void *pContext, uint8_t *pReport) {
+  (void)pContext;
+  (void)pReport;
+  return true;
+}
+
+static bool Test_PipeGetFeatureReport(void *pContext, uint8_t *pReport) {
+  (void)pContext;
+  (void)pReport;
+  return false;
+}
+
+static int Test_PipeGetPollFd(void *pContext) {
+  return ((TestPipe *)pContext)->fds[0];
+}
+
+static const SteamControllerTransport Test_PipeTransport = {
+  .readRaw          = Test_PipeReadRaw,
+  .setFeatureReport = Test_PipeSetFeatureReport,
+  .getFeatureReport = Test_PipeGetFeatureReport,
+  .getPollFd        = Test_PipeGetPollFd,
+};
+
+static SteamControllerDevice *Test_OpenPipe(TestPipe *pPipe) {
+  if (pipe(pPipe->fds) < 0)
+    return NULL;
+
+  fcntl(pPipe->fds[0], F_SETFL, O_NONBLOCK);
+  return SteamController_OpenTransport(&Test_PipeTransport, pPipe, false);
+}
+
+static void Test_ClosePipe(SteamControllerDevice *pDevice, TestPipe *pPipe) {
+  SteamController_Close(pDevice);
+  close(pPipe->fds[0]);
+  if (pPipe->fds[1] >= 0)
+    close(pPipe->fds[1]);
+}
+
+static void Test_WriteUpdate(TestPipe *pPipe, uint32_t timeStamp) {
+  SteamControllerUpdateEvent update;
+  memset(&update, 0, sizeof(update));
+  update.timeStamp = timeStamp;
+
+  uint8_t report[64];
+  Test_BuildUpdateReport(report, &update);
+  CHECK(write(pPipe->fds[1], report, sizeof(report)) == sizeof(report));
+}
+
+typedef struct {
+  SteamControllerDevice *pDevice;
+  SteamControllerPoller *pRemoveFrom;   /**< Remove the device from this poller when it is dispatched. */
+  size_t                 dispatchCount;
+  size_t                 eventCount;
+  size_t                 hangupCount;
+} TestPollerSink;
+
+static void Test_PollerCallback(SteamControllerDevice *pDevice, bool isHangup, void *pUserData) {
+  TestPollerSink *pSink = (TestPollerSink *)pUserData;
+  CHECK(pDevice == pSink->pDevice);
+
+  pSink->dispatchCount++;
+  if (isHangup)
+    pSink->hangupCount++;
+
+  SteamControllerEvent event;
+  while (SteamController_ReadEvent(pDevice, &event))
+    pSink->eventCount++;
+
+  if (pSink->pRemoveFrom)
+    CHECK(SteamController_PollerRemove(pSink->pRemoveFrom, pDevice));
+}
+
+/** Only devices with pending input are dispatched, removed devices never are. */
+static void Test_PollerDispatch() {
+  SteamControllerPoller *pPoller = SteamController_CreatePoller();
+  CHECK(pPoller != NULL);
+
+  // Without a file descriptor there is nothing to wait for.
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pLoopbackDevice = SteamController_OpenLoopback(pLoopback, false);
+  CHECK(!SteamController_PollerAdd(pPoller, pLoopbackDevice, NULL));
+
+  TestPipe        pipeA, pipeB;
+  TestPollerSink  sinkA = { Test_OpenPipe(&pipeA), NULL, 0, 0, 0 };
+  TestPollerSink  sinkB = { Test_OpenPipe(&pipeB), NULL, 0, 0, 0 };
+  CHECK(sinkA.pDevice != NULL && sinkB.pDevice != NULL);
+  CHECK(SteamController_PollerAdd(pPoller, sinkA.pDevice, &sinkA));
+  CHECK(SteamController_PollerAdd(pPoller, sinkB.pDevice, &sinkB));
+
+  CHECK(SteamController_PollerWait(pPoller, 0, Test_PollerCallback) == 0);
+
+  Test_WriteUpdate(&pipeA, 1);
+  CHECK(SteamController_PollerWait(pPoller, 1000, Test_PollerCallback) == 1);
+  CHECK(sinkA.dispatchCount == 1 && sinkA.eventCount == 1);
+  CHECK(sinkB.dispatchCount == 0);
+
+  Test_WriteUpdate(&pipeA, 2);
+  Test_WriteUpdate(&pipeA, 3);
+  Test_WriteUpdate(&pipeB, 1);
+  CHECK(SteamController_PollerWait(pPoller, 1000, Test_PollerCallback) == 2);
+  CHECK(sinkA.dispatchCount == 2 && sinkA.eventCount == 3);
+  CHECK(sinkB.dispatchCount == 1 && sinkB.eventCount == 1);
+
+  // Removed devices are not dispatched and can't be removed twice.
+  CHECK(SteamController_PollerRemove(pPoller, sinkB.pDevice));
+  CHECK(!SteamController_PollerRemove(pPoller, sinkB.pDevice));
+  Test_WriteUpdate(&pipeB, 2);
+  CHECK(SteamController_PollerWait(pPoller, 0, Test_PollerCallback) == 0);
+  CHECK(sinkB.dispatchCount == 1);
+
+  // Removing a device from within its callback.
+  sinkA.pRemoveFrom = pPoller;
+  Test_WriteUpdate(&pipeA, 4);
+  CHECK(SteamController_PollerWait(pPoller, 1000, Test_PollerCallback) == 1);
+  CHECK(sinkA.dispatchCount == 3 && sinkA.eventCount == 4);
+  Test_WriteUpdate(&pipeA, 5);
+  CHECK(SteamController_PollerWait(pPoller, 0, Test_PollerCallback) == 0);
+  CHECK(sinkA.dispatchCount == 3);
+
+  // Added again, it is dispatched again.
+  sinkA.pRemoveFrom = NULL;
+  CHECK(SteamController_PollerAdd(pPoller, sinkA.pDevice, &sinkA));
+  CHECK(SteamController_PollerWait(pPoller, 1000, Test_PollerCallback) == 1);
+  CHECK(sinkA.dispatchCount == 4 && sinkA.eventCount == 5);
+
+  SteamController_DestroyPoller(pPoller);
+  Test_ClosePipe(sinkA.pDevice, &pipeA);
+  Test_ClosePipe(sinkB.pDevice, &pipeB);
+  SteamController_Close(pLoopbackDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** A device whose input is gone is reported once and no longer watched. */
+static void Test_PollerHangup() {
+  SteamControllerPoller *pPoller = SteamController_CreatePoller();
+  CHECK(pPoller != NULL);
+
+  TestPipe        hangupPipe;
+  TestPollerSink  sink = { Test_OpenPipe(&hangupPipe), NULL, 0, 0, 0 };
+  CHECK(sink.pDevice != NULL);
+  CHECK(SteamController_PollerAdd(pPoller, sink.pDevice, &sink));
+
+  close(hangupPipe.fds[1]);
+  hangupPipe.fds[1] = -1;
+
+  CHECK(SteamController_PollerWait(pPoller, 1000, Test_PollerCallback) == 1);
+  CHECK(sink.dispatchCount == 1 && sink.hangupCount == 1);
+  CHECK(!SteamController_PollerRemove(pPoller, sink.pDevice));
+  CHECK(SteamController_PollerWait(pPoller, 0, Test_PollerCallback) == 0);
+
+  SteamController_DestroyPoller(pPoller);
+  Test_ClosePipe(sink.pDevice, &hangupPipe);
+}
+
+int main() {
+  // The transports have no response for the queries made when opening them.
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  Test_PollerDispatch();
+  Test_PollerHangup();
+  return Test_Result();
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif
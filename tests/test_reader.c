@@ -0,0 +1,124 @@
+#include "test.h"
+
+#if __linux__
+
+#include <unistd.h>
+
+#define TEST_OVERFLOW_COUNT   10
+
+/** Wait until the reader thread has published the update with the given time stamp. */
+static bool Test_WaitForTimeStamp(SteamControllerDevice *pDevice, uint32_t timeStamp) {
+  for (int i=0; i<2000; i++) {
+    SteamControllerState state;
+    SteamController_GetStateSnapshot(pDevice, &state);
+    if (state.timeStamp == timeStamp)
+      return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+/** A full ring drops new events and counts them, the events it holds come out in order. */
+static void Test_ReaderOverflow() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  const uint32_t reportCount = STEAMCONTROLLER_EVENT_RING_SIZE + TEST_OVERFLOW_COUNT;
+  for (uint32_t i=1; i<=reportCount; i++)
+    Test_QueueUpdate(pLoopback, i, 0);
+
+  SteamControllerTimedEvent events[STEAMCONTROLLER_EVENT_RING_SIZE];
+  uint32_t                  overflowCount = 1;
+  CHECK(SteamController_DrainEvents(pDevice, events, STEAMCONTROLLER_EVENT_RING_SIZE, &overflowCount) == 0);
+  CHECK(overflowCount == 0);
+
+  CHECK(SteamController_StartReaderThread(pDevice));
+  CHECK(SteamController_StartReaderThread(pDevice));
+
+  // The snapshot is kept up to date even when the ring is full.
+  CHECK(Test_WaitForTimeStamp(pDevice, reportCount));
+
+  size_t count = SteamController_DrainEvents(pDevice, events, 100, &overflowCount);
+  CHECK(count == 100);
+  CHECK(overflowCount == TEST_OVERFLOW_COUNT);
+
+  count += SteamController_DrainEvents(pDevice, events + count, STEAMCONTROLLER_EVENT_RING_SIZE - count, &overflowCount);
+  CHECK(count == STEAMCONTROLLER_EVENT_RING_SIZE);
+  CHECK(overflowCount == 0);
+
+  for (size_t i=0; i<count; i++) {
+    CHECK(events[i].event.eventType == STEAMCONTROLLER_EVENT_UPDATE);
+    CHECK(events[i].event.update.timeStamp == i + 1);
+    CHECK(events[i].hostTime != 0);
+  }
+
+  CHECK(SteamController_DrainEvents(pDevice, events, STEAMCONTROLLER_EVENT_RING_SIZE, &overflowCount) == 0);
+
+  SteamController_StopReaderThread(pDevice);
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/**
+ * Drained while the reader thread keeps producing, the ring wraps many times.
+ * Events only go missing where the overflow count says so.
+ */
+static void Test_ReaderConcurrentDrain() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  // Time stamps 1 to 7 over and over.
+  for (uint32_t i=1; i<=7; i++)
+    Test_QueueUpdate(pLoopback, i, 0);
+  SteamController_LoopbackSetLooping(pLoopback, true);
+
+  CHECK(SteamController_StartReaderThread(pDevice));
+
+  uint32_t  lastTimeStamp   = 0;
+  size_t    eventCount      = 0;
+  size_t    gapCount        = 0;
+  uint64_t  totalOverflow   = 0;
+
+  for (int i=0; i<2000 && eventCount<20 * STEAMCONTROLLER_EVENT_RING_SIZE; i++) {
+    SteamControllerTimedEvent events[64];
+    uint32_t                  overflowCount;
+    size_t count = SteamController_DrainEvents(pDevice, events, 64, &overflowCount);
+    totalOverflow += overflowCount;
+
+    for (size_t j=0; j<count; j++) {
+      uint32_t timeStamp = events[j].event.update.timeStamp;
+      if (lastTimeStamp && timeStamp != lastTimeStamp % 7 + 1)
+        gapCount++;
+      lastTimeStamp = timeStamp;
+    }
+
+    eventCount += count;
+    if (!count)
+      usleep(100);
+  }
+
+  CHECK(eventCount >= 20 * STEAMCONTROLLER_EVENT_RING_SIZE);
+
+  // A gap needs dropped events, but drops that add up to whole loops leave none.
+  CHECK(gapCount == 0 || totalOverflow != 0);
+
+  SteamController_StopReaderThread(pDevice);
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+int main() {
+  // The loopback has no response for the queries made when opening it.
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  Test_ReaderOverflow();
+  Test_ReaderConcurrentDrain();
+  return Test_Result();
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif
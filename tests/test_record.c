@@ -0,0 +1,171 @@
+#include "test.h"
+
+#if __linux__
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#define TEST_REPORT_COUNT   20
+
+/** Input records of a capture file, in file order. @return Number of records. */
+static size_t Test_LoadInputRecords(const char *pPath, SteamControllerRecord *pRecords, size_t maxRecords) {
+  FILE *pFile = fopen(pPath, "rb");
+  if (!pFile)
+    return 0;
+
+  SteamControllerRecordHeader header;
+  size_t count = 0;
+  if (fread(&header, sizeof(header), 1, pFile) == 1) {
+    SteamControllerRecord record;
+    while (count < maxRecords && fread(&record, sizeof(record), 1, pFile) == 1) {
+      if (record.kind == STEAMCONTROLLER_RECORD_INPUT)
+        pRecords[count++] = record;
+    }
+  }
+
+  fclose(pFile);
+  return count;
+}
+
+/** Read events until the device has no more. @return Number of events read. */
+static size_t Test_DrainEvents(SteamControllerDevice *pDevice, SteamControllerEvent *pEvents, size_t maxEvents) {
+  size_t  count       = 0;
+  bool    morePending = true;
+
+  while (morePending && count < maxEvents) {
+    size_t read = SteamController_ReadEvents(pDevice, pEvents + count, maxEvents - count, &morePending);
+    if (!read)
+      break;
+    count += read;
+  }
+  return count;
+}
+
+/**
+ * Reports captured from a device come out of a replay unchanged: capturing
+ * the replay again gives the same input bytes, and they decode the same.
+ */
+static void Test_RecordReplayRoundTrip() {
+  char capturePath[]  = "/tmp/steamcontroller-capture-XXXXXX";
+  char replayPath[]   = "/tmp/steamcontroller-replay-XXXXXX";
+  int  captureFd      = mkstemp(capturePath);
+  int  replayFd       = mkstemp(replayPath);
+  CHECK(captureFd >= 0 && replayFd >= 0);
+  close(captureFd);
+  close(replayFd);
+
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  for (uint32_t i=0; i<TEST_REPORT_COUNT; i++) {
+    SteamControllerUpdateEvent update;
+    memset(&update, 0, sizeof(update));
+    update.timeStamp      = 100 + i;
+    update.buttons        = (i * 0x010101) & 0xffffff;
+    update.leftTrigger    = (uint8_t)(i * 13);
+    update.leftXY.x       = (int16_t)(i * 1000 - 9000);
+    update.orientation.z  = (int16_t)(i * -777);
+
+    uint8_t report[64];
+    Test_BuildUpdateReport(report, &update);
+    SteamController_LoopbackQueueReport(pLoopback, report, sizeof(report));
+  }
+  Test_QueueBattery(pLoopback, 3141);
+
+  // Capture the loopback.
+  SteamControllerRecorder *pRecorder  = SteamController_CreateRecorder(capturePath);
+  SteamControllerDevice   *pDevice    = SteamController_OpenLoopback(pLoopback, true);
+  CHECK(pRecorder != NULL && pDevice != NULL);
+  SteamController_SetRecorder(pDevice, pRecorder, 7);
+
+  SteamControllerEvent capturedEvents[TEST_REPORT_COUNT + 1];
+  CHECK(Test_DrainEvents(pDevice, capturedEvents, TEST_REPORT_COUNT + 1) == TEST_REPORT_COUNT + 1);
+
+  SteamController_SetRecorder(pDevice, NULL, 0);
+  SteamController_Close(pDevice);
+  SteamController_DestroyRecorder(pRecorder);
+
+  // Replay it, capturing the replay.
+  pRecorder = SteamController_CreateRecorder(replayPath);
+  pDevice   = SteamController_OpenReplay(capturePath, 7, false);
+  CHECK(pRecorder != NULL && pDevice != NULL);
+  CHECK(SteamController_IsWirelessDongle(pDevice));
+  SteamController_SetRecorder(pDevice, pRecorder, 7);
+
+  SteamControllerEvent replayedEvents[TEST_REPORT_COUNT + 1];
+  CHECK(Test_DrainEvents(pDevice, replayedEvents, TEST_REPORT_COUNT + 1) == TEST_REPORT_COUNT + 1);
+  for (size_t i=0; i<TEST_REPORT_COUNT + 1; i++) {
+    CHECK(replayedEvents[i].eventType == capturedEvents[i].eventType);
+    if (capturedEvents[i].eventType != STEAMCONTROLLER_EVENT_UPDATE)
+      continue;
+    CHECK(replayedEvents[i].update.timeStamp == capturedEvents[i].update.timeStamp);
+    CHECK(replayedEvents[i].update.buttons == capturedEvents[i].update.buttons);
+    CHECK(replayedEvents[i].update.leftXY.x == capturedEvents[i].update.leftXY.x);
+    CHECK(replayedEvents[i].update.orientation.z == capturedEvents[i].update.orientation.z);
+  }
+
+  SteamController_SetRecorder(pDevice, NULL, 0);
+  SteamController_Close(pDevice);
+  SteamController_DestroyRecorder(pRecorder);
+
+  static SteamControllerRecord captured[TEST_REPORT_COUNT + 2], replayed[TEST_REPORT_COUNT + 2];
+  size_t capturedCount = Test_LoadInputRecords(capturePath, captured, TEST_REPORT_COUNT + 2);
+  size_t replayedCount = Test_LoadInputRecords(replayPath, replayed, TEST_REPORT_COUNT + 2);
+  CHECK(capturedCount == TEST_REPORT_COUNT + 1);
+  CHECK(replayedCount == capturedCount);
+
+  for (size_t i=0; i<capturedCount && i<replayedCount; i++) {
+    CHECK(captured[i].length == 64);
+    CHECK(replayed[i].length == captured[i].length);
+    CHECK(memcmp(replayed[i].data, captured[i].data, captured[i].length) == 0);
+  }
+
+  SteamController_DestroyLoopback(pLoopback);
+  unlink(capturePath);
+  unlink(replayPath);
+}
+
+/** Real time pacing starts with the first report, not with the start of the capture file. */
+static void Test_ReplayRealTimeStartsWithFirstReport() {
+  char capturePath[] = "/tmp/steamcontroller-capture-XXXXXX";
+  int  captureFd     = mkstemp(capturePath);
+  CHECK(captureFd >= 0);
+  close(captureFd);
+
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  Test_QueueUpdate(pLoopback, 1, STEAMCONTROLLER_BUTTON_A);
+
+  SteamControllerRecorder *pRecorder = SteamController_CreateRecorder(capturePath);
+  usleep(500000);
+
+  SteamControllerDevice *pDevice = SteamController_OpenLoopback(pLoopback, false);
+  SteamController_SetRecorder(pDevice, pRecorder, 1);
+  SteamControllerEvent event;
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_UPDATE);
+  SteamController_SetRecorder(pDevice, NULL, 0);
+  SteamController_Close(pDevice);
+  SteamController_DestroyRecorder(pRecorder);
+
+  pDevice = SteamController_OpenReplay(capturePath, 1, true);
+  CHECK(pDevice != NULL);
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_UPDATE);
+  CHECK(event.update.buttons == STEAMCONTROLLER_BUTTON_A);
+  SteamController_Close(pDevice);
+
+  SteamController_DestroyLoopback(pLoopback);
+  unlink(capturePath);
+}
+
+int main() {
+  // The loopback has no response for the queries made when opening it.
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  Test_RecordReplayRoundTrip();
+  Test_ReplayRealTimeStartsWithFirstReport();
+  return Test_Result();
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,185 @@
+#include "test.h"
+#include "common.h"
+
+#if __linux__
+#include <pthread.h>
+#endif
+
+#define TEST_ACTION(action)   ((uint64_t)1 << (action))
+
+static SteamControllerState Test_RemapState(uint32_t buttons) {
+  SteamControllerState state;
+  memset(&state, 0, sizeof(state));
+  state.activeButtons = buttons;
+  return state;
+}
+
+/** Bit number of a single button. */
+static unsigned Test_ButtonBit(uint32_t button) {
+  unsigned bit = 0;
+  while (!(button & (1u << bit)))
+    bit++;
+  return bit;
+}
+
+/** Buttons of every byte of the button bits map through the lookup tables, layers pick other actions. */
+static void Test_RemapButtonsAndLayers() {
+  SteamControllerRemapProfile profile;
+  SteamController_InitRemapProfile(&profile);
+  profile.layerButtons[0] = STEAMCONTROLLER_BUTTON_LG;
+  profile.buttonActions[0][Test_ButtonBit(STEAMCONTROLLER_BUTTON_A)]      = 1;
+  profile.buttonActions[0][Test_ButtonBit(STEAMCONTROLLER_BUTTON_RT)]     = 2;
+  profile.buttonActions[0][Test_ButtonBit(STEAMCONTROLLER_BUTTON_STICK)]  = 3;
+  profile.buttonActions[1][Test_ButtonBit(STEAMCONTROLLER_BUTTON_A)]      = 63;
+
+  SteamControllerRemapTable *pTable = SteamController_CompileRemapProfile(&profile);
+  CHECK(pTable != NULL);
+
+  SteamControllerState state = Test_RemapState(0);
+  CHECK(SteamController_RemapTableState(pTable, &state) == 0);
+
+  state = Test_RemapState(STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_RT | STEAMCONTROLLER_BUTTON_STICK | STEAMCONTROLLER_BUTTON_B);
+  CHECK(SteamController_RemapTableState(pTable, &state) == (TEST_ACTION(1) | TEST_ACTION(2) | TEST_ACTION(3)));
+
+  state = Test_RemapState(STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_LG);
+  CHECK(SteamController_RemapTableState(pTable, &state) == TEST_ACTION(63));
+
+  SteamController_DestroyRemapTable(pTable);
+}
+
+/** A held chord fires instead of the actions of its buttons. */
+static void Test_RemapChords() {
+  SteamControllerRemapProfile profile;
+  SteamController_InitRemapProfile(&profile);
+  profile.buttonActions[0][Test_ButtonBit(STEAMCONTROLLER_BUTTON_A)] = 1;
+  profile.buttonActions[0][Test_ButtonBit(STEAMCONTROLLER_BUTTON_B)] = 2;
+  profile.buttonActions[0][Test_ButtonBit(STEAMCONTROLLER_BUTTON_X)] = 3;
+  profile.chords[0].buttons = STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_B;
+  profile.chords[0].layer   = 0;
+  profile.chords[0].action  = 10;
+  profile.chordCount = 1;
+
+  SteamControllerRemapTable *pTable = SteamController_CompileRemapProfile(&profile);
+  CHECK(pTable != NULL);
+
+  SteamControllerState state = Test_RemapState(STEAMCONTROLLER_BUTTON_A);
+  CHECK(SteamController_RemapTableState(pTable, &state) == TEST_ACTION(1));
+
+  state = Test_RemapState(STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_B | STEAMCONTROLLER_BUTTON_X);
+  CHECK(SteamController_RemapTableState(pTable, &state) == (TEST_ACTION(10) | TEST_ACTION(3)));
+
+  SteamController_DestroyRemapTable(pTable);
+
+  // Too many chords, or one without buttons, is refused.
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  profile.chords[0].buttons = 0;
+  CHECK(SteamController_CompileRemapProfile(&profile) == NULL);
+  profile.chords[0].buttons = STEAMCONTROLLER_BUTTON_A;
+  profile.chordCount = STEAMCONTROLLER_REMAP_MAX_CHORDS + 1;
+  CHECK(SteamController_CompileRemapProfile(&profile) == NULL);
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_WARNING);
+}
+
+/** A pad works as a four way DPAD outside of its deadzone, while its buttons are held. */
+static void Test_RemapPadRegions() {
+  SteamControllerRemapProfile profile;
+  SteamController_InitRemapProfile(&profile);
+  profile.padButtons[1] = STEAMCONTROLLER_BUTTON_RFINGER;
+  profile.padActions[0][1][STEAMCONTROLLER_REMAP_UP]    = 20;
+  profile.padActions[0][1][STEAMCONTROLLER_REMAP_RIGHT] = 21;
+  profile.padActions[0][1][STEAMCONTROLLER_REMAP_LEFT]  = 22;
+  profile.padActions[0][1][STEAMCONTROLLER_REMAP_DOWN]  = 23;
+
+  SteamControllerRemapTable *pTable = SteamController_CompileRemapProfile(&profile);
+  CHECK(pTable != NULL);
+
+  static const struct {
+    int16_t   x, y;
+    uint64_t  actions;
+  } Cases[] = {
+    {      0,  20000, TEST_ACTION(20) },
+    {  20000,   5000, TEST_ACTION(21) },
+    { -20000,  -5000, TEST_ACTION(22) },
+    {   5000, -20000, TEST_ACTION(23) },
+    {   3000,   3000, 0 },                // Within the deadzone.
+  };
+
+  for (size_t i=0; i<sizeof(Cases) / sizeof(Cases[0]); i++) {
+    SteamControllerState state = Test_RemapState(STEAMCONTROLLER_BUTTON_RFINGER);
+    state.rightPad.x = Cases[i].x;
+    state.rightPad.y = Cases[i].y;
+    CHECK(SteamController_RemapTableState(pTable, &state) == Cases[i].actions);
+
+    // Not touched.
+    state.activeButtons = 0;
+    CHECK(SteamController_RemapTableState(pTable, &state) == 0);
+  }
+
+  SteamController_DestroyRemapTable(pTable);
+}
+
+static SteamControllerRemapTable *Test_CompileSingleAction(uint8_t action) {
+  SteamControllerRemapProfile profile;
+  SteamController_InitRemapProfile(&profile);
+  profile.buttonActions[0][Test_ButtonBit(STEAMCONTROLLER_BUTTON_A)] = action;
+  return SteamController_CompileRemapProfile(&profile);
+}
+
+#if __linux__
+
+typedef struct {
+  SteamControllerRemap      *pRemap;
+  SteamControllerAtomicU32  isDone;
+  bool                      hasMix;
+} TestRemapReader;
+
+static void *Test_RemapReaderThread(void *pContext) {
+  TestRemapReader *pReader = (TestRemapReader *)pContext;
+  SteamControllerState state = Test_RemapState(STEAMCONTROLLER_BUTTON_A);
+
+  while (!SteamController_AtomicLoad32(&pReader->isDone)) {
+    uint64_t actions = SteamController_RemapState(pReader->pRemap, &state);
+    if (actions != TEST_ACTION(1) && actions != TEST_ACTION(2))
+      pReader->hasMix = true;
+  }
+  return NULL;
+}
+
+#endif
+
+/** Old tables returned by a swap can be freed right away, while another thread remaps. */
+static void Test_RemapSwap() {
+  SteamControllerRemap *pRemap = SteamController_CreateRemap(Test_CompileSingleAction(1));
+  CHECK(pRemap != NULL);
+
+  SteamControllerState state = Test_RemapState(STEAMCONTROLLER_BUTTON_A);
+  CHECK(SteamController_RemapState(pRemap, &state) == TEST_ACTION(1));
+
+  SteamControllerRemapTable *pOld = SteamController_SwapRemapTable(pRemap, Test_CompileSingleAction(2));
+  CHECK(pOld != NULL);
+  SteamController_DestroyRemapTable(pOld);
+  CHECK(SteamController_RemapState(pRemap, &state) == TEST_ACTION(2));
+
+#if __linux__
+  TestRemapReader reader = { pRemap, 0, false };
+  pthread_t       thread;
+  CHECK(pthread_create(&thread, NULL, Test_RemapReaderThread, &reader) == 0);
+
+  for (int i=0; i<1000; i++)
+    SteamController_DestroyRemapTable(SteamController_SwapRemapTable(pRemap, Test_CompileSingleAction(1 + (i & 1))));
+
+  SteamController_AtomicStore32(&reader.isDone, 1);
+  pthread_join(thread, NULL);
+  CHECK(!reader.hasMix);
+#endif
+
+  SteamController_DestroyRemap(pRemap);
+}
+
+int main() {
+  Test_RemapButtonsAndLayers();
+  Test_RemapChords();
+  Test_RemapPadRegions();
+  Test_RemapSwap();
+  return Test_Result();
+}
@@ -0,0 +1,120 @@
+#include "test.h"
+
+/** Only settings that changed since the last commit are sent. */
+static void Test_CommitSkipsKnown() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  SteamController_LoopbackClearFeatureReports(pLoopback);
+
+  SteamControllerSettings settings;
+  SteamController_BeginSettings(&settings);
+  SteamController_SetSetting(&settings, 0x2d, 50);
+  SteamController_SetSetting(&settings, 0x32, 200);
+
+  CHECK(SteamController_CommitSettings(pDevice, &settings) == 1);
+  CHECK(SteamController_CommitSettings(pDevice, &settings) == 0);
+
+  SteamController_SetSetting(&settings, 0x2d, 60);
+  CHECK(SteamController_CommitSettings(pDevice, &settings) == 1);
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) == 2);
+
+  // Only the brightness is in the second report.
+  const uint8_t *pReport = SteamController_LoopbackGetFeatureReport(pLoopback, 1);
+  CHECK(pReport[1] == 0x87 && pReport[2] == 3);    // SET_SETTINGS
+  CHECK(pReport[3] == 0x2d && pReport[4] == 60);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** Values above 255 go out little endian and are recognized when committed again. */
+static void Test_CommitWideValue() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  SteamController_LoopbackClearFeatureReports(pLoopback);
+
+  CHECK(SteamController_SetTimeOut(pDevice, 300));
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) == 1);
+
+  static const uint8_t Expected[] = { 0x87, 0x03, 0x32, 0x2c, 0x01 };
+  const uint8_t *pReport = SteamController_LoopbackGetFeatureReport(pLoopback, 0);
+  CHECK(!memcmp(pReport + 1, Expected, sizeof(Expected)));
+
+  CHECK(SteamController_SetTimeOut(pDevice, 300));
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) == 1);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** Haptic pulse times and counts are 16 bit values on the wire. */
+static void Test_HapticWideValues() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+  SteamController_LoopbackClearFeatureReports(pLoopback);
+
+  CHECK(SteamController_TriggerHaptic(pDevice, 1, 0x1234, 0x5678, 0x9abc));
+  CHECK(SteamController_LoopbackGetFeatureReportCount(pLoopback) == 1);
+
+  static const uint8_t Expected[] = { 0x8f, 0x07, 0x01, 0x34, 0x12, 0x78, 0x56, 0xbc, 0x9a };
+  const uint8_t *pReport = SteamController_LoopbackGetFeatureReport(pLoopback, 0);
+  CHECK(!memcmp(pReport + 1, Expected, sizeof(Expected)));
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+/** A controller that connects has to be configured from scratch. */
+static void Test_ConnectionInvalidates() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, true);
+
+  SteamControllerSettings settings;
+  SteamController_BeginSettings(&settings);
+  SteamController_SetSetting(&settings, 0x2d, 50);
+
+  CHECK(SteamController_CommitSettings(pDevice, &settings) == 1);
+
+  Test_QueueConnection(pLoopback, STEAMCONTROLLER_CONNECTION_EVENT_CONNECTED);
+  SteamControllerEvent event;
+  CHECK(SteamController_ReadEvent(pDevice, &event) == STEAMCONTROLLER_EVENT_CONNECTION);
+
+  CHECK(SteamController_CommitSettings(pDevice, &settings) == 1);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+#if __linux__
+
+/** An asynchronous configure forgets the settings only once it was sent. */
+static void Test_ConfigureAsyncInvalidates() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  SteamControllerSettings settings;
+  SteamController_BeginSettings(&settings);
+  SteamController_SetSetting(&settings, 0x2d, 50);
+
+  CHECK(SteamController_CommitSettings(pDevice, &settings) == 1);
+  CHECK(SteamController_ConfigureAsync(pDevice, STEAMCONTROLLER_DEFAULT_FLAGS, NULL, NULL));
+  SteamController_FlushCommands(pDevice);
+
+  CHECK(SteamController_CommitSettings(pDevice, &settings) == 1);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+#endif
+
+int main() {
+  Test_CommitSkipsKnown();
+  Test_CommitWideValue();
+  Test_HapticWideValues();
+  Test_ConnectionInvalidates();
+#if __linux__
+  Test_ConfigureAsyncInvalidates();
+#endif
+  return Test_Result();
+}
@@ -0,0 +1,222 @@
+#include "test.h"
+
+#if __linux__
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define TEST_SHM_NAME     "/steamcontroller-test-shm"
+#define TEST_LOST_COUNT   5
+#define TEST_REPORT_SIZE  64
+
+/** Transport reading input reports from a pipe, one report per read like hidraw. */
+static int Test_PipeFds[2];
+
+static uint8_t Test_PipeReadRaw(void *pContext, uint8_t *pBuffer, uint8_t maxLen) {
+  (void)pContext;
+  ssize_t len = read(Test_PipeFds[0], pBuffer, maxLen < TEST_REPORT_SIZE ? maxLen : TEST_REPORT_SIZE);
+  return len > 0 ? (uint8_t)len : 0;
+}
+
+static bool Test_PipeSetFeatureReport(void *pContext, uint8_t *pReport) {
+  (void)pContext;
+  (void)pReport;
+  return true;
+}
+
+static bool Test_PipeGetFeatureReport(void *pContext, uint8_t *pReport) {
+  (void)pContext;
+  (void)pReport;
+  return false;
+}
+
+static int Test_PipeGetPollFd(void *pContext) {
+  (void)pContext;
+  return Test_PipeFds[0];
+}
+
+static const SteamControllerTransport Test_PipeTransport = {
+  .readRaw          = Test_PipeReadRaw,
+  .setFeatureReport = Test_PipeSetFeatureReport,
+  .getFeatureReport = Test_PipeGetFeatureReport,
+  .getPollFd        = Test_PipeGetPollFd,
+};
+
+static void Test_WriteUpdate(uint32_t timeStamp, uint32_t buttons) {
+  SteamControllerUpdateEvent update;
+  memset(&update, 0, sizeof(update));
+  update.timeStamp  = timeStamp;
+  update.buttons    = buttons;
+
+  uint8_t report[64];
+  Test_BuildUpdateReport(report, &update);
+  CHECK(write(Test_PipeFds[1], report, sizeof(report)) == sizeof(report));
+}
+
+static SteamControllerTimedEvent Test_TimedUpdate(uint32_t timeStamp) {
+  SteamControllerTimedEvent timedEvent;
+  memset(&timedEvent, 0, sizeof(timedEvent));
+  timedEvent.hostTime                   = timeStamp;
+  timedEvent.event.eventType            = STEAMCONTROLLER_EVENT_UPDATE;
+  timedEvent.event.update.timeStamp     = timeStamp;
+  return timedEvent;
+}
+
+/** A second server can't take over the region of a running one. */
+static void Test_ShmServerIsExclusive() {
+  SteamControllerShmServer *pServer = SteamController_CreateShmServer(TEST_SHM_NAME);
+  CHECK(pServer != NULL);
+
+  SteamControllerShmClient *pClient = SteamController_OpenShmClient(TEST_SHM_NAME);
+  CHECK(pClient != NULL);
+
+  CHECK(SteamController_CreateShmServer(TEST_SHM_NAME) == NULL);
+
+  // The client still sees the first server.
+  SteamControllerState state;
+  CHECK(!SteamController_ShmClientGetState(pClient, 0, &state));
+
+  SteamController_CloseShmClient(pClient);
+  SteamController_DestroyShmServer(pServer);
+}
+
+/** A region nobody holds is left over from a server that died. */
+static void Test_ShmServerReplacesStale() {
+  int fd = shm_open(TEST_SHM_NAME, O_RDWR | O_CREAT | O_EXCL, 0644);
+  CHECK(fd >= 0);
+  close(fd);
+
+  SteamControllerShmServer *pServer = SteamController_CreateShmServer(TEST_SHM_NAME);
+  CHECK(pServer != NULL);
+
+  SteamControllerShmClient *pClient = SteamController_OpenShmClient(TEST_SHM_NAME);
+  CHECK(pClient != NULL);
+
+  SteamController_CloseShmClient(pClient);
+  SteamController_DestroyShmServer(pServer);
+}
+
+/**
+ * Input read by the server reaches every client through the region. A client
+ * that attaches late sees the latest state right away, but only new events.
+ */
+static void Test_ShmPublishToClients() {
+  SteamControllerShmServer *pServer = SteamController_CreateShmServer(TEST_SHM_NAME);
+  CHECK(pServer != NULL);
+
+  SteamControllerShmClient *pEarly = SteamController_OpenShmClient(TEST_SHM_NAME);
+  CHECK(pEarly != NULL);
+
+  CHECK(pipe(Test_PipeFds) == 0);
+  fcntl(Test_PipeFds[0], F_SETFL, O_NONBLOCK);
+  SteamControllerDevice *pDevice = SteamController_OpenTransport(&Test_PipeTransport, NULL, false);
+  CHECK(pDevice != NULL);
+
+  SteamControllerState state;
+  int slot = SteamController_ShmServerAddDevice(pServer, pDevice);
+  CHECK(slot == 0);
+  CHECK(SteamController_ShmClientGetState(pEarly, 0, &state));
+  CHECK(state.timeStamp == 0);
+  CHECK(!SteamController_ShmClientGetState(pEarly, 1, &state));
+
+  Test_WriteUpdate(1, 0);
+  Test_WriteUpdate(2, STEAMCONTROLLER_BUTTON_A);
+  Test_WriteUpdate(3, STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_B);
+  CHECK(SteamController_ShmServerWait(pServer, 1000) == 1);
+
+  SteamControllerTimedEvent events[STEAMCONTROLLER_SHM_EVENT_RING_SIZE];
+  uint32_t                  lostCount = 1;
+  CHECK(SteamController_ShmClientReadEvents(pEarly, 0, events, STEAMCONTROLLER_SHM_EVENT_RING_SIZE, &lostCount) == 3);
+  CHECK(lostCount == 0);
+  for (uint32_t i=0; i<3; i++)
+    CHECK(events[i].event.update.timeStamp == i + 1);
+  CHECK(SteamController_ShmClientReadEvents(pEarly, 0, events, STEAMCONTROLLER_SHM_EVENT_RING_SIZE, NULL) == 0);
+
+  CHECK(SteamController_ShmClientGetState(pEarly, 0, &state));
+  CHECK(state.timeStamp == 3);
+  CHECK(state.activeButtons == (STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_B));
+
+  // Attached after the server published.
+  SteamControllerShmClient *pLate = SteamController_OpenShmClient(TEST_SHM_NAME);
+  CHECK(pLate != NULL);
+  CHECK(SteamController_ShmClientGetState(pLate, 0, &state));
+  CHECK(state.timeStamp == 3);
+  CHECK(state.activeButtons == (STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_B));
+  CHECK(SteamController_ShmClientReadEvents(pLate, 0, events, STEAMCONTROLLER_SHM_EVENT_RING_SIZE, NULL) == 0);
+
+  Test_WriteUpdate(4, 0);
+  CHECK(SteamController_ShmServerWait(pServer, 1000) == 1);
+
+  SteamControllerShmClient *pClients[] = { pEarly, pLate };
+  for (int i=0; i<2; i++) {
+    CHECK(SteamController_ShmClientReadEvents(pClients[i], 0, events, STEAMCONTROLLER_SHM_EVENT_RING_SIZE, &lostCount) == 1);
+    CHECK(lostCount == 0);
+    CHECK(events[0].event.update.timeStamp == 4);
+    CHECK(events[0].hostTime != 0);
+  }
+
+  // Removing the device closes it and empties the slot.
+  SteamController_ShmServerRemoveDevice(pServer, 0);
+  CHECK(!SteamController_ShmClientGetState(pLate, 0, &state));
+
+  SteamController_CloseShmClient(pLate);
+  SteamController_CloseShmClient(pEarly);
+  SteamController_DestroyShmServer(pServer);
+  close(Test_PipeFds[0]);
+  close(Test_PipeFds[1]);
+}
+
+/** A client that falls behind by more than the ring gets the newest events and the number it lost. */
+static void Test_ShmClientLosesOldEvents() {
+  SteamControllerShmServer *pServer = SteamController_CreateShmServer(TEST_SHM_NAME);
+  CHECK(pServer != NULL);
+
+  SteamControllerShmClient *pClient = SteamController_OpenShmClient(TEST_SHM_NAME);
+  CHECK(pClient != NULL);
+
+  const uint32_t eventCount = STEAMCONTROLLER_SHM_EVENT_RING_SIZE + TEST_LOST_COUNT;
+  for (uint32_t i=1; i<=eventCount; i++) {
+    SteamControllerTimedEvent timedEvent = Test_TimedUpdate(i);
+    SteamController_ShmServerPublish(pServer, 1, &timedEvent);
+  }
+
+  SteamControllerTimedEvent events[STEAMCONTROLLER_SHM_EVENT_RING_SIZE];
+  uint32_t                  lostCount = 0;
+  size_t count = SteamController_ShmClientReadEvents(pClient, 1, events, 100, &lostCount);
+  CHECK(count == 100);
+  CHECK(lostCount == TEST_LOST_COUNT);
+
+  count += SteamController_ShmClientReadEvents(pClient, 1, events + count, STEAMCONTROLLER_SHM_EVENT_RING_SIZE - count, &lostCount);
+  CHECK(count == STEAMCONTROLLER_SHM_EVENT_RING_SIZE);
+  CHECK(lostCount == 0);
+
+  for (size_t i=0; i<count; i++)
+    CHECK(events[i].event.update.timeStamp == i + 1 + TEST_LOST_COUNT);
+
+  SteamControllerState state;
+  SteamController_ShmClientGetState(pClient, 1, &state);
+  CHECK(state.timeStamp == eventCount);
+
+  SteamController_CloseShmClient(pClient);
+  SteamController_DestroyShmServer(pServer);
+}
+
+int main() {
+  // The pipe transport has no response for the queries made when opening it.
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  shm_unlink(TEST_SHM_NAME);
+  Test_ShmServerIsExclusive();
+  Test_ShmServerReplacesStale();
+  Test_ShmPublishToClients();
+  Test_ShmClientLosesOldEvents();
+  return Test_Result();
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif
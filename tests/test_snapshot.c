@@ -0,0 +1,135 @@
+#include "test.h"
+#include "common.h"
+
+#if __linux__
+#include <pthread.h>
+#endif
+
+#define TEST_UPDATE_COUNT   200000
+
+/** Update whose fields all follow from one counter. */
+static SteamControllerEvent Test_CountingUpdate(uint32_t counter) {
+  SteamControllerEvent event;
+  memset(&event, 0, sizeof(event));
+  event.eventType                       = STEAMCONTROLLER_EVENT_UPDATE;
+  event.update.timeStamp                = counter;
+  event.update.buttons                  = counter & STEAMCONTROLLER_BUTTON_A ? STEAMCONTROLLER_BUTTON_A : 0;
+  event.update.leftTrigger              = (uint8_t)counter;
+  event.update.rightXY.x                = (int16_t)counter;
+  event.update.rightXY.y                = (int16_t)~counter;
+  event.update.acceleration.x           = (int16_t)counter;
+  event.update.angularVelocity.z        = (int16_t)(counter >> 16);
+  event.update.orientation.y            = (int16_t)~counter;
+  return event;
+}
+
+/** Whether all fields of a state come from the same update. */
+static bool Test_IsConsistent(const SteamControllerState *pState) {
+  SteamControllerEvent event = Test_CountingUpdate(pState->timeStamp);
+  return pState->activeButtons           == event.update.buttons
+      && pState->leftTrigger             == event.update.leftTrigger
+      && pState->rightPad.x              == event.update.rightXY.x
+      && pState->rightPad.y              == event.update.rightXY.y
+      && pState->acceleration.x          == event.update.acceleration.x
+      && pState->angularVelocity.z       == event.update.angularVelocity.z
+      && pState->orientation.y           == event.update.orientation.y;
+}
+
+/** The snapshot is the state SteamController_UpdateState builds from the same events. */
+static void Test_SnapshotMatchesState() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  SteamControllerState expected, snapshot;
+  memset(&expected, 0, sizeof(expected));
+
+  for (uint32_t i=1; i<=5; i++) {
+    SteamControllerEvent event = Test_CountingUpdate(i);
+    SteamController_UpdateState(&expected, &event);
+    SteamController_UpdateStateSnapshot(pDevice, &event);
+
+    SteamController_GetStateSnapshot(pDevice, &snapshot);
+    CHECK(memcmp(&snapshot, &expected, sizeof(snapshot)) == 0);
+    CHECK(Test_IsConsistent(&snapshot));
+  }
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+#if __linux__
+
+typedef struct {
+  SteamControllerDevice    *pDevice;
+  SteamControllerAtomicU32 *pIsDone;
+  size_t                    tornCount;
+  size_t                    backwardCount;
+} TestSnapshotReader;
+
+static void *Test_SnapshotReaderThread(void *pContext) {
+  TestSnapshotReader *pReader = (TestSnapshotReader *)pContext;
+  uint32_t lastTimeStamp = 0;
+
+  while (!SteamController_AtomicLoad32(pReader->pIsDone)) {
+    SteamControllerState state;
+    SteamController_GetStateSnapshot(pReader->pDevice, &state);
+
+    // Nothing was published yet.
+    if (state.timeStamp == 0)
+      continue;
+
+    if (!Test_IsConsistent(&state))
+      pReader->tornCount++;
+    if (state.timeStamp < lastTimeStamp)
+      pReader->backwardCount++;
+
+    lastTimeStamp = state.timeStamp;
+  }
+  return NULL;
+}
+
+/** Readers racing the writer only ever see whole updates, and never an older one after a newer. */
+static void Test_SnapshotConcurrentReads() {
+  SteamControllerLoopback *pLoopback = SteamController_CreateLoopback();
+  SteamControllerDevice   *pDevice   = SteamController_OpenLoopback(pLoopback, false);
+
+  SteamControllerAtomicU32  isDone = 0;
+  TestSnapshotReader        readers[2];
+  pthread_t                 threads[2];
+
+  for (int i=0; i<2; i++) {
+    readers[i] = (TestSnapshotReader){ pDevice, &isDone, 0, 0 };
+    CHECK(pthread_create(&threads[i], NULL, Test_SnapshotReaderThread, &readers[i]) == 0);
+  }
+
+  for (uint32_t i=1; i<=TEST_UPDATE_COUNT; i++) {
+    SteamControllerEvent event = Test_CountingUpdate(i);
+    SteamController_UpdateStateSnapshot(pDevice, &event);
+  }
+
+  SteamController_AtomicStore32(&isDone, 1);
+  for (int i=0; i<2; i++) {
+    pthread_join(threads[i], NULL);
+    CHECK(readers[i].tornCount == 0);
+    CHECK(readers[i].backwardCount == 0);
+  }
+
+  SteamControllerState state;
+  SteamController_GetStateSnapshot(pDevice, &state);
+  CHECK(state.timeStamp == TEST_UPDATE_COUNT);
+
+  SteamController_Close(pDevice);
+  SteamController_DestroyLoopback(pLoopback);
+}
+
+#endif
+
+int main() {
+  // The loopback has no response for the queries made when opening it.
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  Test_SnapshotMatchesState();
+#if __linux__
+  Test_SnapshotConcurrentReads();
+#endif
+  return Test_Result();
+}
@@ -0,0 +1,51 @@
+#include "test.h"
+
+#include <stdint.h>
+
+static void Test_TableLayout() {
+  SteamControllerStateTable *pTable = SteamController_CreateStateTable(3, 2);
+  CHECK(pTable != NULL);
+
+  SteamControllerStateArrays arrays;
+  SteamController_StateTableGetArrays(pTable, &arrays);
+
+  // Regions are padded to whole cache lines in every array.
+  CHECK(arrays.length == 128);
+  CHECK(((uintptr_t)arrays.leftTrigger & 63) == 0);
+  CHECK(((uintptr_t)arrays.stickX & 63) == 0);
+  CHECK(SteamController_StateTableSlot(pTable, 2) == 2);
+  CHECK(SteamController_StateTableSlot(pTable, 3) == 64);
+
+  SteamController_DestroyStateTable(pTable);
+}
+
+/** The full negative deflection on both axes does not overflow. */
+static void Test_TableMaxStickMagnitude() {
+  SteamControllerStateTable *pTable = SteamController_CreateStateTable(3, 2);
+
+  SteamControllerStateArrays arrays;
+  SteamController_StateTableGetArrays(pTable, &arrays);
+
+  size_t controller = 99;
+  CHECK(SteamController_StateTableMaxStickMagnitude(pTable, &controller) == 0);
+  CHECK(controller == 0);
+
+  size_t slot = SteamController_StateTableSlot(pTable, 1);
+  arrays.stickX[slot] = 32767;
+  arrays.stickY[slot] = 10;
+
+  slot = SteamController_StateTableSlot(pTable, 4);
+  arrays.stickX[slot] = -32768;
+  arrays.stickY[slot] = -32768;
+
+  CHECK(SteamController_StateTableMaxStickMagnitude(pTable, &controller) == 2147483648u);
+  CHECK(controller == 4);
+
+  SteamController_DestroyStateTable(pTable);
+}
+
+int main() {
+  Test_TableLayout();
+  Test_TableMaxStickMagnitude();
+  return Test_Result();
+}
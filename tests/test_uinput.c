@@ -0,0 +1,86 @@
+#define _GNU_SOURCE     // pipe2
+
+#include "test.h"
+
+#if __linux__
+
+#include <linux/input.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/** Read what the bridge wrote to a pipe. @return Number of events. */
+static size_t Test_ReadInputEvents(int fd, struct input_event *pEvents, size_t maxEvents) {
+  ssize_t len = read(fd, pEvents, maxEvents * sizeof(struct input_event));
+  return len > 0 ? (size_t)len / sizeof(struct input_event) : 0;
+}
+
+static bool Test_HasInputEvent(const struct input_event *pEvents, size_t count, uint16_t type, uint16_t code, int32_t value) {
+  for (size_t i=0; i<count; i++) {
+    if (pEvents[i].type == type && pEvents[i].code == code && pEvents[i].value == value)
+      return true;
+  }
+  return false;
+}
+
+/** Changes that could not be written because the device was busy are sent with the next write. */
+static void Test_UinputResendsAfterFailure() {
+  int gamepadFds[2], mouseFds[2];
+  CHECK(pipe2(gamepadFds, O_NONBLOCK) == 0);
+  CHECK(pipe2(mouseFds, O_NONBLOCK) == 0);
+
+  SteamControllerUinput *pUinput = SteamController_CreateUinputSink(gamepadFds[1], mouseFds[1]);
+  CHECK(pUinput != NULL);
+
+  // Fill both pipes, so the next writes fail with EAGAIN.
+  char filler[4096];
+  memset(filler, 0, sizeof(filler));
+  while (write(gamepadFds[1], filler, sizeof(filler)) > 0);
+  while (write(mouseFds[1], filler, sizeof(filler)) > 0);
+
+  SteamControllerState state;
+  memset(&state, 0, sizeof(state));
+  state.activeButtons = STEAMCONTROLLER_BUTTON_A | STEAMCONTROLLER_BUTTON_RPAD;
+  state.stick.x       = 1000;
+
+  CHECK(!SteamController_UinputWriteState(pUinput, &state, 0));
+
+  // Make room again.
+  while (read(gamepadFds[0], filler, sizeof(filler)) > 0);
+  while (read(mouseFds[0], filler, sizeof(filler)) > 0);
+
+  CHECK(SteamController_UinputWriteState(pUinput, &state, 0));
+
+  struct input_event events[16];
+  size_t count = Test_ReadInputEvents(gamepadFds[0], events, 16);
+  CHECK(Test_HasInputEvent(events, count, EV_KEY, BTN_A, 1));
+  CHECK(Test_HasInputEvent(events, count, EV_ABS, ABS_X, 1000));
+
+  count = Test_ReadInputEvents(mouseFds[0], events, 16);
+  CHECK(Test_HasInputEvent(events, count, EV_KEY, BTN_LEFT, 1));
+
+  // Now that it went through, nothing is repeated.
+  CHECK(SteamController_UinputWriteState(pUinput, &state, 0));
+  CHECK(Test_ReadInputEvents(gamepadFds[0], events, 16) == 0);
+  CHECK(Test_ReadInputEvents(mouseFds[0], events, 16) == 0);
+
+  SteamController_DestroyUinput(pUinput);
+  for (int i=0; i<2; i++) {
+    close(gamepadFds[i]);
+    close(mouseFds[i]);
+  }
+}
+
+int main() {
+  // Failed writes are logged, that is expected here.
+  SteamController_SetLogLevel(STEAMCONTROLLER_LOG_NONE);
+  Test_UinputResendsAfterFailure();
+  return Test_Result();
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include "test.h"
+
+#if __linux__
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#define TEST_REPORT_COUNT   10
+
+typedef struct {
+  size_t    eventCount;
+  size_t    endCount;
+  uint32_t  lastTimeStamp;
+  bool      isInOrder;
+} TestUringSink;
+
+static void Test_UringCallback(SteamControllerDevice *pDevice, const SteamControllerTimedEvent *pEvent, void *pUserData) {
+  TestUringSink *pSink = (TestUringSink *)pUserData;
+  CHECK(pDevice == NULL);
+
+  if (!pEvent) {
+    pSink->endCount++;
+    return;
+  }
+
+  CHECK(pEvent->event.eventType == STEAMCONTROLLER_EVENT_UPDATE);
+  if (pEvent->event.update.timeStamp != pSink->lastTimeStamp + 1)
+    pSink->isInOrder = false;
+  pSink->lastTimeStamp = pEvent->event.update.timeStamp;
+  pSink->eventCount++;
+}
+
+/** Write whole reports followed by the start of another one. */
+static bool Test_WriteReportFile(const char *pPath) {
+  FILE *pFile = fopen(pPath, "wb");
+  if (!pFile)
+    return false;
+
+  uint8_t report[64];
+  for (uint32_t i=1; i<=TEST_REPORT_COUNT; i++) {
+    SteamControllerUpdateEvent update;
+    memset(&update, 0, sizeof(update));
+    update.timeStamp  = i;
+    update.buttons    = STEAMCONTROLLER_BUTTON_A;
+    Test_BuildUpdateReport(report, &update);
+    fwrite(report, sizeof(report), 1, pFile);
+  }
+
+  // Truncated, the rest would be whatever the buffer held before.
+  fwrite(report, 20, 1, pFile);
+  fclose(pFile);
+  return true;
+}
+
+/** Every whole report of a file is decoded in order, a truncated last one ends the file. */
+static void Test_UringReadsFile(bool forceFallback) {
+  char path[] = "/tmp/steamcontroller-reports-XXXXXX";
+  int  fd     = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+  CHECK(Test_WriteReportFile(path));
+
+  SteamControllerUring *pUring = SteamController_CreateUring(forceFallback);
+  CHECK(pUring != NULL);
+  if (forceFallback)
+    CHECK(!SteamController_UringIsAvailable(pUring));
+
+  TestUringSink sink = { 0, 0, 0, true };
+  CHECK(SteamController_UringAddFile(pUring, path, &sink));
+
+  for (int i=0; i<100 && !sink.endCount; i++)
+    CHECK(SteamController_UringWait(pUring, 1000, Test_UringCallback) >= 0);
+
+  CHECK(sink.eventCount == TEST_REPORT_COUNT);
+  CHECK(sink.endCount == 1);
+  CHECK(sink.isInOrder);
+  CHECK(sink.lastTimeStamp == TEST_REPORT_COUNT);
+
+  SteamController_DestroyUring(pUring);
+  unlink(path);
+}
+
+int main() {
+  Test_UringReadsFile(false);
+  Test_UringReadsFile(true);
+  return Test_Result();
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif